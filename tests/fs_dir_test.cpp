@@ -0,0 +1,356 @@
+/*
+* The Sleuth Kit
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+/*
+ * This is a test file for The Sleuth Kit.  It checks how TSK_FS_DIR
+ * stores the names that the file system code adds to it: synthetic
+ * directories are filled with tsk_fs_dir_add() and every name, short
+ * name and address is read back.  Duplicate handling, lookups with
+ * tsk_fs_dir_contains() and reuse after tsk_fs_dir_reset() are also
+ * checked, for directories that are small and large enough to be indexed.
+ *
+ * With -b, it instead reports how long it takes to build and close
+ * directories with 1k, 10k and 100k entries, with and without the
+ * duplicate check that non-FAT file systems do.
+ */
+#include "tsk/tsk_tools_i.h"
+#include "tsk/fs/tsk_fs_i.h"
+
+#include <chrono>
+#include <string>
+
+static int s_fails = 0;
+
+#define CHECK(a_cond, ...) \
+    do { \
+        if (!(a_cond)) { \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            s_fails++; \
+        } \
+    } while (0)
+
+/* There is no metadata behind the synthetic names */
+static uint8_t
+fake_file_add_meta(TSK_FS_INFO * a_fs, TSK_FS_FILE * a_fs_file,
+    TSK_INUM_T a_addr)
+{
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_FS_INODE_NUM);
+    tsk_error_set_errstr("fake_file_add_meta: no metadata");
+    return 1;
+}
+
+/* The directory code only looks at the file system type */
+static void
+fake_fs(TSK_FS_INFO * a_fs, TSK_FS_TYPE_ENUM a_ftype)
+{
+    memset(a_fs, 0, sizeof(TSK_FS_INFO));
+    a_fs->tag = TSK_FS_INFO_TAG;
+    a_fs->ftype = a_ftype;
+    a_fs->file_add_meta = fake_file_add_meta;
+}
+
+/* Name of entry a_idx, some are long to span the name memory blocks */
+static std::string
+entry_name(size_t a_idx, const char *a_prefix)
+{
+    std::string name(a_prefix);
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%07" PRIuSIZE, a_idx);
+    name += buf;
+    if (a_idx % 97 == 0)
+        name.append(300 + a_idx % 1000, 'x');
+    else if (a_idx == 1234)
+        name.append(9000, 'y');
+    name += ".txt";
+    return name;
+}
+
+static std::string
+entry_shrt_name(size_t a_idx)
+{
+    char buf[32];
+    if (a_idx % 3)
+        return "";
+    snprintf(buf, sizeof(buf), "F%06" PRIuSIZE "~1.TXT", a_idx % 1000000);
+    return buf;
+}
+
+static uint8_t
+add_entry(TSK_FS_DIR * a_fs_dir, TSK_FS_NAME * a_fs_name,
+    const std::string & a_name, const std::string & a_shrt,
+    TSK_INUM_T a_addr, TSK_FS_NAME_FLAG_ENUM a_flags)
+{
+    strncpy(a_fs_name->name, a_name.c_str(), a_fs_name->name_size);
+    strncpy(a_fs_name->shrt_name, a_shrt.c_str(),
+        a_fs_name->shrt_name_size);
+    a_fs_name->meta_addr = a_addr;
+    a_fs_name->meta_seq = (uint32_t) (a_addr % 7);
+    a_fs_name->type = TSK_FS_NAME_TYPE_REG;
+    a_fs_name->flags = a_flags;
+    return tsk_fs_dir_add(a_fs_dir, a_fs_name);
+}
+
+static void
+check_entries(TSK_FS_DIR * a_fs_dir, size_t a_cnt, const char *a_prefix)
+{
+    CHECK(tsk_fs_dir_getsize(a_fs_dir) == a_cnt,
+        "%s: %" PRIuSIZE " entries instead of %" PRIuSIZE, a_prefix,
+        tsk_fs_dir_getsize(a_fs_dir), a_cnt);
+
+    for (size_t i = 0; i < a_cnt && i < tsk_fs_dir_getsize(a_fs_dir); i++) {
+        const TSK_FS_NAME *fs_name = tsk_fs_dir_get_name(a_fs_dir, i);
+        std::string name = entry_name(i, a_prefix);
+        std::string shrt = entry_shrt_name(i);
+
+        CHECK(name == fs_name->name, "%s: wrong name at %" PRIuSIZE,
+            a_prefix, i);
+        CHECK(fs_name->name_size > name.size(),
+            "%s: name size too small at %" PRIuSIZE, a_prefix, i);
+        CHECK(shrt == fs_name->shrt_name,
+            "%s: wrong short name at %" PRIuSIZE, a_prefix, i);
+        CHECK(fs_name->meta_addr == 1000 + i
+            && fs_name->meta_seq == (1000 + i) % 7
+            && fs_name->par_addr == a_fs_dir->addr,
+            "%s: wrong addresses at %" PRIuSIZE, a_prefix, i);
+    }
+}
+
+static void
+test(void)
+{
+    TSK_FS_INFO fs;
+    TSK_FS_DIR *fs_dir;
+    TSK_FS_NAME *fs_name;
+    TSK_FS_FILE *fs_file;
+    const size_t cnt = 5000;
+
+    if ((fs_name = tsk_fs_name_alloc(16384, 64)) == NULL) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+
+    /* FAT skips the duplicate check, so the first directory is a big one */
+    fake_fs(&fs, TSK_FS_TYPE_FAT32);
+    if ((fs_dir = tsk_fs_dir_alloc(&fs, 55, 128)) == NULL) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+    for (size_t i = 0; i < cnt; i++) {
+        if (add_entry(fs_dir, fs_name, entry_name(i, "first"),
+                entry_shrt_name(i), 1000 + i, TSK_FS_NAME_FLAG_ALLOC)) {
+            tsk_error_print(stderr);
+            exit(1);
+        }
+    }
+    check_entries(fs_dir, cnt, "first");
+    CHECK(tsk_fs_dir_contains(fs_dir, 1000 + 4321,
+            tsk_fs_dir_hash(entry_name(4321, "first").c_str()))
+        == TSK_FS_NAME_FLAG_ALLOC, "first: entry not found");
+    CHECK(tsk_fs_dir_contains(fs_dir, 1000 + 4321,
+            tsk_fs_dir_hash(entry_name(4322, "first").c_str())) == 0,
+        "first: wrong entry found");
+
+    // the copy that tsk_fs_dir_get() makes
+    if ((fs_file = tsk_fs_dir_get(fs_dir, 1234)) == NULL) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+    CHECK(entry_name(1234, "first") == fs_file->name->name,
+        "tsk_fs_dir_get: wrong name");
+    tsk_fs_file_close(fs_file);
+
+    // the entries are refilled from scratch after a reset
+    tsk_fs_dir_reset(fs_dir);
+    fs_dir->addr = 66;
+    for (size_t i = 0; i < cnt / 2; i++) {
+        if (add_entry(fs_dir, fs_name, entry_name(i, "second"),
+                entry_shrt_name(i), 1000 + i, TSK_FS_NAME_FLAG_ALLOC)) {
+            tsk_error_print(stderr);
+            exit(1);
+        }
+    }
+    check_entries(fs_dir, cnt / 2, "second");
+    CHECK(tsk_fs_dir_contains(fs_dir, 1000 + 10,
+            tsk_fs_dir_hash(entry_name(10, "first").c_str())) == 0,
+        "second: entry from before the reset found");
+    tsk_fs_dir_close(fs_dir);
+
+    /* Other file systems replace an unallocated name with an allocated
+     * one of the same name and address and ignore other duplicates. */
+    fake_fs(&fs, TSK_FS_TYPE_EXT2);
+    if ((fs_dir = tsk_fs_dir_alloc(&fs, 77, 4)) == NULL) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+    for (size_t i = 0; i < 600; i++) {
+        if (add_entry(fs_dir, fs_name, entry_name(i, "dup"), "",
+                1000 + i, TSK_FS_NAME_FLAG_UNALLOC)) {
+            tsk_error_print(stderr);
+            exit(1);
+        }
+
+        // lookups in a small directory and in an indexed one
+        if ((i == 10) || (i == 500)) {
+            for (size_t j = 0; j <= i; j++) {
+                uint32_t hash = tsk_fs_dir_hash(entry_name(j,
+                        "dup").c_str());
+                CHECK(tsk_fs_dir_contains(fs_dir, 1000 + j, hash)
+                    == TSK_FS_NAME_FLAG_UNALLOC,
+                    "dup: %" PRIuSIZE " not found in %" PRIuSIZE, j, i);
+                CHECK(tsk_fs_dir_contains(fs_dir, 1001 + i, hash) == 0,
+                    "dup: %" PRIuSIZE " found in %" PRIuSIZE
+                    " at the wrong address", j, i);
+            }
+        }
+    }
+    for (size_t i = 0; i < 600; i++) {
+        TSK_FS_NAME_FLAG_ENUM flags = (i % 2) ? TSK_FS_NAME_FLAG_ALLOC :
+            TSK_FS_NAME_FLAG_UNALLOC;
+        if (add_entry(fs_dir, fs_name, entry_name(i, "dup"),
+                entry_shrt_name(i), 1000 + i, flags)) {
+            tsk_error_print(stderr);
+            exit(1);
+        }
+    }
+    // the same name at another address is not a duplicate
+    if (add_entry(fs_dir, fs_name, entry_name(7, "dup"), "", 7,
+            TSK_FS_NAME_FLAG_ALLOC)) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+    CHECK(tsk_fs_dir_getsize(fs_dir) == 601,
+        "dup: %" PRIuSIZE " entries instead of 601",
+        tsk_fs_dir_getsize(fs_dir));
+    for (size_t i = 0; i < 600 && i < tsk_fs_dir_getsize(fs_dir); i++) {
+        const TSK_FS_NAME *dent = tsk_fs_dir_get_name(fs_dir, i);
+        std::string shrt = (i % 2) ? entry_shrt_name(i) : "";
+        CHECK(entry_name(i, "dup") == dent->name,
+            "dup: wrong name at %" PRIuSIZE, i);
+        CHECK(shrt == (dent->shrt_name ? dent->shrt_name : ""),
+            "dup: wrong short name at %" PRIuSIZE, i);
+        CHECK(dent->flags == ((i % 2) ? TSK_FS_NAME_FLAG_ALLOC :
+                TSK_FS_NAME_FLAG_UNALLOC), "dup: wrong flags at %" PRIuSIZE,
+            i);
+        CHECK(tsk_fs_dir_contains(fs_dir, 1000 + i,
+                tsk_fs_dir_hash(dent->name)) == dent->flags,
+            "dup: wrong lookup at %" PRIuSIZE, i);
+    }
+    tsk_fs_dir_close(fs_dir);
+
+    tsk_fs_name_free(fs_name);
+}
+
+
+/* Build and close directories of a_cnt names for about a_seconds.
+ * @returns the time per directory in seconds */
+static double
+time_dirs(TSK_FS_INFO * a_fs, TSK_FS_NAME * a_fs_name, size_t a_cnt,
+    double a_seconds)
+{
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    double elapsed = 0;
+    size_t dirs = 0;
+
+    while (elapsed < a_seconds) {
+        TSK_FS_DIR *fs_dir;
+        if ((fs_dir = tsk_fs_dir_alloc(a_fs, 5, 128)) == NULL) {
+            tsk_error_print(stderr);
+            exit(1);
+        }
+        for (size_t i = 0; i < a_cnt; i++) {
+            snprintf(a_fs_name->name, a_fs_name->name_size,
+                "document-%08" PRIuSIZE ".txt", i);
+            snprintf(a_fs_name->shrt_name, a_fs_name->shrt_name_size,
+                "DOCUME~%" PRIuSIZE ".TXT", i % 1000);
+            a_fs_name->meta_addr = 100 + i;
+            if (tsk_fs_dir_add(fs_dir, a_fs_name)) {
+                tsk_error_print(stderr);
+                exit(1);
+            }
+        }
+        tsk_fs_dir_close(fs_dir);
+        dirs++;
+        elapsed = std::chrono::duration < double >(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    return elapsed / dirs;
+}
+
+static void
+benchmark(double a_seconds)
+{
+    TSK_FS_INFO fs;
+    TSK_FS_NAME *fs_name;
+    size_t sizes[] = { 1000, 10000, 100000 };
+    // FAT does not check for duplicates, the others do
+    TSK_FS_TYPE_ENUM ftypes[] = { TSK_FS_TYPE_FAT32, TSK_FS_TYPE_NTFS };
+
+    if ((fs_name = tsk_fs_name_alloc(256, 32)) == NULL) {
+        tsk_error_print(stderr);
+        exit(1);
+    }
+    fs_name->type = TSK_FS_NAME_TYPE_REG;
+    fs_name->flags = TSK_FS_NAME_FLAG_ALLOC;
+
+    printf("%6s %10s %14s %14s\n", "type", "entries", "usec per dir",
+        "nsec per name");
+    for (size_t t = 0; t < sizeof(ftypes) / sizeof(ftypes[0]); t++) {
+        fake_fs(&fs, ftypes[t]);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            double secs = time_dirs(&fs, fs_name, sizes[s], a_seconds);
+            printf("%6s %10" PRIuSIZE " %14.1f %14.1f\n",
+                tsk_fs_type_toname(ftypes[t]), sizes[s], secs * 1e6,
+                secs * 1e9 / sizes[s]);
+        }
+    }
+    tsk_fs_name_free(fs_name);
+}
+
+
+static void
+usage(const char *a_prog)
+{
+    fprintf(stderr, "usage: %s [-b seconds]\n", a_prog);
+    fprintf(stderr,
+        "\t-b seconds: Report the cost of building and closing directories, spending about this long on each size\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    double seconds = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 == argc) || (argv[i][0] != '-') || (argv[i][2] != '\0'))
+            usage(argv[0]);
+        switch (argv[i][1]) {
+        case 'b':
+            seconds = atof(argv[++i]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (seconds > 0) {
+        benchmark(seconds);
+        return 0;
+    }
+
+    test();
+    if (s_fails) {
+        fprintf(stderr, "%d problems found\n", s_fails);
+        return 1;
+    }
+    printf("directory names stored correctly\n");
+    return 0;
+}
@@ -0,0 +1,449 @@
+/*
+* The Sleuth Kit
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+/*
+ * This is a test file for The Sleuth Kit.  It checks the LZVN decoder
+ * that is used for compressed HFS+ files.  LZVN streams are generated
+ * from several kinds of data with an encoder that uses every opcode
+ * type.  They are decoded with lzvn_decode_buffer() and with the fully
+ * bounds-checked lzvn_decode_buffer_checked(), and the two must return
+ * the same length and the same data.  That is also done for truncated
+ * and corrupted streams and for output buffers that are too small.
+ *
+ * With -b, it instead reports the decoding speed of both in MB/s on one
+ * core.
+ */
+#include "tsk/tsk_tools_i.h"
+#include "tsk/fs/lzvn.h"
+
+#include <chrono>
+#include <vector>
+
+static uint64_t s_rng;
+
+static uint32_t
+rnd(uint32_t a_max)
+{
+    // xorshift64, so that streams are the same on all platforms
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return a_max ? (uint32_t) (s_rng % a_max) : 0;
+}
+
+
+/*
+ * LZVN encoder.  It is greedy and not meant to compress well; it picks
+ * randomly between the opcodes that can encode each literal and match.
+ */
+class LzvnEncoder {
+  public:
+    std::vector < uint8_t > out;
+
+    void encode(const uint8_t * a_data, size_t a_len) {
+        std::vector < int32_t > head(1 << 14, -1);
+        size_t pos = 0;
+        size_t lit = 0;         // start of the pending literal
+
+        out.clear();
+        m_d_prev = 0;
+        while (pos < a_len) {
+            size_t best_len = 0;
+            size_t best_d = 0;
+
+            // try the previous distance, then the last position with the
+            // same 4 bytes
+            if (m_d_prev && m_d_prev <= pos)
+                check(a_data, a_len, pos, m_d_prev, &best_len, &best_d);
+            if (pos + 4 <= a_len) {
+                uint32_t h = hash(&a_data[pos]);
+                if (head[h] >= 0 && pos - head[h] < 65536)
+                    check(a_data, a_len, pos, pos - head[h], &best_len,
+                        &best_d);
+                head[h] = (int32_t) pos;
+            }
+
+            if (best_len < 3) {
+                pos++;
+                continue;
+            }
+
+            // at most 3 literal bytes go with the match opcode
+            if (pos - lit > 3 || (pos - lit > 0 && rnd(4) == 0)) {
+                size_t keep = rnd(4);
+                if (keep > pos - lit)
+                    keep = pos - lit;
+                literal(&a_data[lit], pos - lit - keep);
+                lit = pos - keep;
+            }
+            match(&a_data[lit], pos - lit, best_len, best_d);
+            if (rnd(50) == 0)
+                out.push_back(rnd(2) ? 0x0e : 0x16);        // nop
+            pos += best_len;
+            lit = pos;
+        }
+        literal(&a_data[lit], a_len - lit);
+
+        // end of stream: opcode and 7 padding bytes
+        out.push_back(0x06);
+        out.insert(out.end(), 7, 0);
+    }
+
+  private:
+    size_t m_d_prev;
+
+    static uint32_t hash(const uint8_t * a_p) {
+        uint32_t v;
+        memcpy(&v, a_p, 4);
+        return (v * 2654435761U) >> 18;
+    }
+
+    static void check(const uint8_t * a_data, size_t a_len, size_t a_pos,
+        size_t a_d, size_t * a_best_len, size_t * a_best_d) {
+        size_t len = 0;
+        while (a_pos + len < a_len && len < 2000
+            && a_data[a_pos + len] == a_data[a_pos + len - a_d])
+            len++;
+        if (len > *a_best_len) {
+            *a_best_len = len;
+            *a_best_d = a_d;
+        }
+    }
+
+    void literal(const uint8_t * a_p, size_t a_len) {
+        while (a_len > 0) {
+            size_t n = a_len;
+            if (n > 271)
+                n = 271;
+            if (n >= 16 && rnd(3)) {
+                out.push_back(0xe0);    // lrg_l
+                out.push_back((uint8_t) (n - 16));
+            }
+            else {
+                if (n > 15)
+                    n = 1 + rnd(15);
+                out.push_back((uint8_t) (0xe0 | n));        // sml_l
+            }
+            out.insert(out.end(), a_p, a_p + n);
+            a_p += n;
+            a_len -= n;
+        }
+    }
+
+    void match(const uint8_t * a_lit, size_t a_l, size_t a_m, size_t a_d) {
+        // longest match that sml_d, pre_d and lrg_d can encode for each
+        // literal length; other combinations are other opcodes
+        static const size_t max_m[4] = { 10, 8, 6, 4 };
+        int choices[4];
+        int cnt = 0;
+        size_t m;
+
+        if (a_d == m_d_prev && a_l == 0) {
+            repeat(a_m);
+            return;
+        }
+        if (a_d == m_d_prev && a_l > 0)
+            choices[cnt++] = 0; // pre_d
+        if (a_d < 0x600)
+            choices[cnt++] = 1; // sml_d
+        if (a_d < 0x4000)
+            choices[cnt++] = 2; // med_d
+        choices[cnt++] = 3;     // lrg_d
+
+        switch (choices[rnd(cnt)]) {
+        case 0:
+            m = a_m < max_m[a_l] ? a_m : max_m[a_l];
+            out.push_back((uint8_t) (a_l << 6 | (m - 3) << 3 | 6));
+            break;
+        case 1:
+            m = a_m < max_m[a_l] ? a_m : max_m[a_l];
+            out.push_back((uint8_t) (a_l << 6 | (m - 3) << 3 | a_d >> 8));
+            out.push_back((uint8_t) a_d);
+            break;
+        case 2:
+            m = a_m < 34 ? a_m : 34;
+            out.push_back((uint8_t) (0xa0 | a_l << 3 | (m - 3) >> 2));
+            out.push_back((uint8_t) (a_d << 2 | ((m - 3) & 3)));
+            out.push_back((uint8_t) (a_d >> 6));
+            break;
+        default:
+            m = a_m < max_m[a_l] ? a_m : max_m[a_l];
+            out.push_back((uint8_t) (a_l << 6 | (m - 3) << 3 | 7));
+            out.push_back((uint8_t) a_d);
+            out.push_back((uint8_t) (a_d >> 8));
+            break;
+        }
+        out.insert(out.end(), a_lit, a_lit + a_l);
+        m_d_prev = a_d;
+        repeat(a_m - m);
+    }
+
+    // match at the previous distance: sml_m and lrg_m
+    void repeat(size_t a_m) {
+        while (a_m > 0) {
+            size_t n = a_m;
+            if (n > 271)
+                n = 271;
+            if (n >= 16 && rnd(3)) {
+                out.push_back(0xf0);
+                out.push_back((uint8_t) (n - 16));
+            }
+            else {
+                if (n > 15)
+                    n = 1 + rnd(15);
+                out.push_back((uint8_t) (0xf0 | n));
+            }
+            a_m -= n;
+        }
+    }
+};
+
+
+enum DATA_KIND { DATA_ZERO, DATA_PERIOD, DATA_TEXT, DATA_RANDOM, DATA_MIXED,
+    DATA_KIND_CNT };
+
+static const char *s_kind_names[DATA_KIND_CNT] =
+    { "zero", "periodic", "text", "random", "mixed" };
+
+static void
+make_data(std::vector < uint8_t > &a_buf, int a_kind, size_t a_len)
+{
+    static const char *words[] = { "the ", "sleuth ", "kit ", "file ",
+        "system ", "block ", "inode ", "\n", "compressed ", "data ",
+        "0123456789 ", "HFS+ ", "resource ", "fork "
+    };
+    a_buf.clear();
+    while (a_buf.size() < a_len) {
+        int kind = a_kind;
+        size_t seg = 1 + rnd(a_kind == DATA_MIXED ? 4000 : (uint32_t) a_len);
+        size_t start = a_buf.size();
+
+        if (kind == DATA_MIXED)
+            kind = rnd(DATA_MIXED + 1);
+        switch (kind) {
+        case DATA_ZERO:
+            a_buf.insert(a_buf.end(), seg, 0);
+            break;
+        case DATA_PERIOD:{
+                size_t period = 1 + rnd(24);
+                for (size_t i = 0; i < period; i++)
+                    a_buf.push_back((uint8_t) rnd(256));
+                for (size_t i = period; i < seg; i++)
+                    a_buf.push_back(a_buf[start + i - period]);
+                break;
+            }
+        case DATA_TEXT:
+            while (a_buf.size() - start < seg) {
+                const char *w = words[rnd(sizeof(words) / sizeof(words[0]))];
+                a_buf.insert(a_buf.end(), w, w + strlen(w));
+            }
+            break;
+        case DATA_RANDOM:
+            for (size_t i = 0; i < seg; i++)
+                a_buf.push_back((uint8_t) rnd(256));
+            break;
+        default:
+            // repeat of earlier data, up to the largest LZVN distance
+            if (start > 0) {
+                size_t d = 1 + rnd(start < 65535 ? (uint32_t) start : 65535);
+                for (size_t i = 0; i < seg; i++)
+                    a_buf.push_back(a_buf[start + i - d]);
+            }
+            break;
+        }
+    }
+    a_buf.resize(a_len);
+}
+
+
+static int s_fails = 0;
+
+/* Decode with both decoders and compare the results */
+static size_t
+compare(const uint8_t * a_src, size_t a_src_len, size_t a_dst_len,
+    const std::vector < uint8_t > *a_expect, const char *a_what,
+    const char *a_case)
+{
+    const size_t guard = 64;
+    std::vector < uint8_t > fast(a_dst_len + guard, 0xa5);
+    std::vector < uint8_t > checked(a_dst_len + guard, 0xa5);
+    size_t fast_len, checked_len;
+
+    fast_len = lzvn_decode_buffer(&fast[0], a_dst_len, a_src, a_src_len);
+    checked_len =
+        lzvn_decode_buffer_checked(&checked[0], a_dst_len, a_src,
+        a_src_len);
+
+    if (fast_len != checked_len) {
+        fprintf(stderr, "%s, %s: decoded %" PRIuSIZE " bytes instead of %"
+            PRIuSIZE "\n", a_what, a_case, fast_len, checked_len);
+        s_fails++;
+    }
+    else if (memcmp(&fast[0], &checked[0], fast_len) != 0) {
+        fprintf(stderr, "%s, %s: decoded data differs\n", a_what,
+            a_case);
+        s_fails++;
+    }
+    else if ((a_expect != NULL) && ((fast_len != a_expect->size())
+            || (fast_len
+                && memcmp(&fast[0], &(*a_expect)[0], fast_len) != 0))) {
+        fprintf(stderr, "%s, %s: stream did not decode to its input\n",
+            a_what, a_case);
+        s_fails++;
+    }
+    for (size_t i = a_dst_len; i < a_dst_len + guard; i++) {
+        if ((fast[i] != 0xa5) || (checked[i] != 0xa5)) {
+            fprintf(stderr, "%s, %s: write past the end of the buffer\n",
+                a_what, a_case);
+            s_fails++;
+            break;
+        }
+    }
+    return fast_len;
+}
+
+static void
+differential(int a_count)
+{
+    std::vector < uint8_t > data;
+    std::vector < uint8_t > src;
+    LzvnEncoder enc;
+    char what[128];
+
+    for (int n = 0; n < a_count; n++) {
+        int kind = n % DATA_KIND_CNT;
+        size_t len = rnd(4) ? 65536 : 1 + rnd(140000);
+
+        make_data(data, kind, len);
+        enc.encode(data.size() ? &data[0] : NULL, data.size());
+        snprintf(what, sizeof(what), "stream %d (%s, %" PRIuSIZE " bytes)",
+            n, s_kind_names[kind], len);
+
+        // the whole stream, into buffers of the exact and a larger size
+        compare(&enc.out[0], enc.out.size(), len, &data, what,
+            "exact buffer");
+        compare(&enc.out[0], enc.out.size(), len + rnd(1000), &data, what,
+            "larger buffer");
+
+        // output buffer too small
+        compare(&enc.out[0], enc.out.size(), rnd((uint32_t) len), NULL,
+            what, "short buffer");
+
+        // truncated stream
+        compare(&enc.out[0], rnd((uint32_t) enc.out.size()), len, NULL,
+            what, "truncated");
+
+        // corrupted stream
+        src = enc.out;
+        for (uint32_t i = 1 + rnd(8); i > 0; i--)
+            src[rnd((uint32_t) src.size())] = (uint8_t) rnd(256);
+        compare(&src[0], src.size(), len, NULL, what, "corrupted");
+
+        // random bytes
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = (uint8_t) rnd(256);
+        compare(&src[0], src.size(), len, NULL, what, "random");
+    }
+}
+
+
+static void
+benchmark(double a_seconds)
+{
+    std::vector < uint8_t > data;
+    std::vector < uint8_t > dst(65536);
+    LzvnEncoder enc;
+
+    printf("%-10s %12s %12s\n", "data", "checked MB/s", "fast MB/s");
+    for (int kind = 0; kind < DATA_KIND_CNT; kind++) {
+        std::vector < std::vector < uint8_t > >streams;
+        double mbps[2];
+
+        for (int i = 0; i < 16; i++) {
+            make_data(data, kind, 65536);
+            enc.encode(&data[0], data.size());
+            streams.push_back(enc.out);
+        }
+        for (int fast = 0; fast < 2; fast++) {
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            double elapsed = 0;
+            size_t bytes = 0;
+
+            while (elapsed < a_seconds) {
+                for (size_t i = 0; i < streams.size(); i++) {
+                    if (fast)
+                        bytes += lzvn_decode_buffer(&dst[0], dst.size(),
+                            &streams[i][0], streams[i].size());
+                    else
+                        bytes += lzvn_decode_buffer_checked(&dst[0],
+                            dst.size(), &streams[i][0], streams[i].size());
+                }
+                elapsed = std::chrono::duration < double >(
+                    std::chrono::steady_clock::now() - start).count();
+            }
+            mbps[fast] = bytes / elapsed / 1e6;
+        }
+        printf("%-10s %12.1f %12.1f\n", s_kind_names[kind], mbps[0],
+            mbps[1]);
+    }
+}
+
+
+static void
+usage(const char *a_prog)
+{
+    fprintf(stderr, "usage: %s [-s seed] [-n streams] [-b seconds]\n",
+        a_prog);
+    fprintf(stderr, "\t-s seed: Seed for the generated streams\n");
+    fprintf(stderr,
+        "\t-n streams: Number of streams in the differential test\n");
+    fprintf(stderr,
+        "\t-b seconds: Report decoding speed, spending about this long on each decoder and kind of data\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int count = 500;
+    double seconds = 0;
+    int i;
+
+    s_rng = 0x5eed;
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 == argc) || (argv[i][0] != '-') || (argv[i][2] != '\0'))
+            usage(argv[0]);
+        switch (argv[i][1]) {
+        case 'b':
+            seconds = atof(argv[++i]);
+            break;
+        case 'n':
+            count = atoi(argv[++i]);
+            break;
+        case 's':
+            s_rng = strtoull(argv[++i], NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (s_rng == 0)
+        s_rng = 1;
+
+    if (seconds > 0) {
+        benchmark(seconds);
+        return 0;
+    }
+
+    differential(count);
+    if (s_fails) {
+        fprintf(stderr, "%d differences found\n", s_fails);
+        return 1;
+    }
+    printf("%d streams decoded identically\n", count);
+    return 0;
+}
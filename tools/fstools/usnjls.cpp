@@ -27,7 +27,7 @@ usage()
     TFPRINTF(stderr,
              _TSK_T
              ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size]"
-              " [-o imgoffset] [-lmvV] image [inode]\n"),
+              " [-o imgoffset] [-u first_usn[-last_usn]] [-lmvV] image [inode]\n"),
              progname);
     tsk_fprintf(stderr,
                 "\t-i imgtype: The format of the image file "
@@ -43,6 +43,8 @@ usage()
                 " in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-l: Long output format with detailed information\n");
     tsk_fprintf(stderr, "\t-m: Time machine output format\n");
+    tsk_fprintf(stderr,
+                "\t-u first_usn[-last_usn]: Only list records in this USN range\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: print version\n");
 
@@ -67,6 +69,9 @@ main(int argc, char **argv1)
     TSK_TCHAR *cp = NULL;
     unsigned int ssize = 0;
     TSK_FS_USNJLS_FLAG_ENUM flag = TSK_FS_USNJLS_NONE;
+    TSK_FS_USNJ_FILTER filter;
+
+    memset(&filter, 0, sizeof(filter));
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -82,7 +87,7 @@ main(int argc, char **argv1)
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:lmvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:lmu:vV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'): {
             default:
@@ -136,6 +141,22 @@ main(int argc, char **argv1)
         case _TSK_T('m'):
             flag = TSK_FS_USNJLS_MAC;
             break;
+        case _TSK_T('u'):
+            filter.flags = (TSK_FS_USNJ_FILTER_FLAG_ENUM)
+                (filter.flags | TSK_FS_USNJ_FILTER_USN);
+            filter.usn_min = TSTRTOULL(OPTARG, &cp, 0);
+            filter.usn_max = UINT64_MAX;
+            if (*cp == _TSK_T('-') && cp[1] != _TSK_T('\0'))
+                filter.usn_max = TSTRTOULL(&cp[1], &cp, 0);
+            else if (*cp == _TSK_T('-'))
+                cp++;
+            if (*cp || cp == OPTARG || filter.usn_min > filter.usn_max) {
+                TFPRINTF(stderr,
+                         _TSK_T("invalid argument: USN range: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            break;
         case _TSK_T('v'):
             tsk_verbose++;
             break;
@@ -238,7 +259,7 @@ main(int argc, char **argv1)
         exit(1);
     }
 
-    if (tsk_fs_usnjls(fs, inum, flag)) {
+    if (tsk_fs_usnjls(fs, inum, flag, filter.flags ? &filter : NULL)) {
         tsk_error_print(stderr);
         fs->close(fs);
         img->close(img);
@@ -547,10 +547,13 @@ TSK_RETVAL_ENUM
     else if (retval == TSK_FILTER_SKIP)
         return TSK_OK;
 
-    /* Walk the files, starting at the given inum */
-    if (tsk_fs_dir_walk(a_fs_info, a_inum,
+    /* Walk the files, starting at the given inum.  The directories are
+     * loaded on worker threads, but the callbacks stay on this thread
+     * and in the usual order. */
+    if (tsk_fs_dir_walk_parallel(a_fs_info, a_inum,
             (TSK_FS_DIR_WALK_FLAG_ENUM) (TSK_FS_DIR_WALK_FLAG_RECURSE |
-                m_fileFilterFlags), dirWalkCb, this)) {
+                m_fileFilterFlags), TSK_FS_DIR_WALK_PARALLEL_ORDERED,
+            dirWalkCb, this)) {
 
         tsk_error_set_errstr2(
             "Error walking directory in file system at offset %" PRIuOFF, a_fs_info->offset);
@@ -881,7 +881,7 @@ TskAutoDb::md5HashAttr(unsigned char md5Hash[16], const TSK_FS_ATTR * fs_attr)
 
     TSK_MD5_Init(&md);
 
-    if (tsk_fs_attr_walk(fs_attr, TSK_FS_FILE_WALK_FLAG_NONE,
+    if (tsk_fs_attr_walk(fs_attr, TSK_FS_FILE_WALK_FLAG_LARGE,
             md5HashCallback, (void *) &md)) {
         registerError();
         return 1;
@@ -892,81 +892,122 @@ TskAutoDb::md5HashAttr(unsigned char md5Hash[16], const TSK_FS_ATTR * fs_attr)
 }
 
 /**
-* Callback invoked per every unallocated block in the filesystem
-* Creates file ranges and file entries 
-* A single file entry per consecutive range of blocks
-* @param a_block block being walked
+* Callback invoked for every run of unallocated blocks in the filesystem.
+* Adds the run to the unallocated space files of the file system.
+* @param a_fs file system being walked
+* @param a_addr first block of the run
+* @param a_len number of blocks in the run
+* @param a_flags flags of the blocks in the run
 * @param a_ptr a pointer to an UNALLOC_BLOCK_WLK_TRACK struct
-* @returns TSK_WALK_CONT if continue, otherwise TSK_WALK_STOP if stop processing requested
+* @returns TSK_WALK_CONT if continue, TSK_WALK_STOP if stop processing requested, TSK_WALK_ERROR on error
 */
-TSK_WALK_RET_ENUM TskAutoDb::fsWalkUnallocBlocksCb(const TSK_FS_BLOCK *a_block, void *a_ptr) {
+TSK_WALK_RET_ENUM TskAutoDb::fsWalkUnallocRunsCb(TSK_FS_INFO * /*a_fs*/, TSK_DADDR_T a_addr,
+    TSK_DADDR_T a_len, TSK_FS_BLOCK_FLAG_ENUM /*a_flags*/, void *a_ptr) {
     UNALLOC_BLOCK_WLK_TRACK * unallocBlockWlkTrack = (UNALLOC_BLOCK_WLK_TRACK *) a_ptr;
 
     if (unallocBlockWlkTrack->tskAutoDb.m_stopAllProcessing)
         return TSK_WALK_STOP;
 
-    // initialize if this is the first block
-    if (unallocBlockWlkTrack->isStart) {
-        unallocBlockWlkTrack->isStart = false;
-        unallocBlockWlkTrack->curRangeStart = a_block->addr;
-        unallocBlockWlkTrack->prevBlock = a_block->addr;
-        unallocBlockWlkTrack->size = unallocBlockWlkTrack->fsInfo.block_size;
-        unallocBlockWlkTrack->nextSequenceNo = 0;
-        return TSK_WALK_CONT;
-    }
+    if (unallocBlockWlkTrack->tskAutoDb.addUnallocRun(*unallocBlockWlkTrack, a_addr, a_len) == TSK_ERR)
+        return TSK_WALK_ERROR;
 
-    // We want to keep consecutive blocks in the same run, so simply update prevBlock and the size
-    // if this one is consecutive with the last call. But, if we have hit the max chunk
-    // size, then break up this set of consecutive blocks.
-    if ((a_block->addr == unallocBlockWlkTrack->prevBlock + 1) && ((unallocBlockWlkTrack->maxChunkSize <= 0) ||
-            (unallocBlockWlkTrack->size < unallocBlockWlkTrack->maxChunkSize))) {
-        unallocBlockWlkTrack->prevBlock = a_block->addr;
-		unallocBlockWlkTrack->size += unallocBlockWlkTrack->fsInfo.block_size;
-        return TSK_WALK_CONT;
-    }
+    return TSK_WALK_CONT;
+}
 
-    // this block is not contiguous with the previous one or we've hit the maximum size; create and add a range object
-    const uint64_t rangeStartOffset = unallocBlockWlkTrack->curRangeStart * unallocBlockWlkTrack->fsInfo.block_size 
-        + unallocBlockWlkTrack->fsInfo.offset;
-    const uint64_t rangeSizeBytes = (1 + unallocBlockWlkTrack->prevBlock - unallocBlockWlkTrack->curRangeStart) 
-        * unallocBlockWlkTrack->fsInfo.block_size;
-    unallocBlockWlkTrack->ranges.push_back(TSK_DB_FILE_LAYOUT_RANGE(rangeStartOffset, rangeSizeBytes, unallocBlockWlkTrack->nextSequenceNo++));
-
-    // Return (instead of adding this run) if we are going to:
-    // a) Make one big file with all unallocated space (minChunkSize == 0)
-    // or
-    // b) Only make an unallocated file once we have at least chunkSize bytes
-    // of data in our current run (minChunkSize > 0)
-    // In either case, reset the range pointers and add this block to the size
-    if ((unallocBlockWlkTrack->minChunkSize == 0) ||
-        ((unallocBlockWlkTrack->minChunkSize > 0) &&
-        (unallocBlockWlkTrack->size < unallocBlockWlkTrack->minChunkSize))) {
-
-        unallocBlockWlkTrack->size += unallocBlockWlkTrack->fsInfo.block_size;
-        unallocBlockWlkTrack->curRangeStart = a_block->addr;
-        unallocBlockWlkTrack->prevBlock = a_block->addr;
-        return TSK_WALK_CONT;
-    }
-    
-    // at this point we are either chunking and have reached the chunk limit
-    // or we're not chunking. Either way we now add what we've got to the DB
-    int64_t fileObjId = 0;
-    if (unallocBlockWlkTrack->tskAutoDb.m_db->addUnallocBlockFile(unallocBlockWlkTrack->tskAutoDb.m_curUnallocDirId, 
-        unallocBlockWlkTrack->fsObjId, unallocBlockWlkTrack->size, unallocBlockWlkTrack->ranges, fileObjId, unallocBlockWlkTrack->tskAutoDb.m_curImgId) == TSK_ERR) {
-            // @@@ Handle error -> Don't have access to registerError() though...
-    }
 
-    // reset
-    unallocBlockWlkTrack->curRangeStart = a_block->addr;
-    unallocBlockWlkTrack->prevBlock = a_block->addr;
-    unallocBlockWlkTrack->size = unallocBlockWlkTrack->fsInfo.block_size; // The current block is part of the new range
-    unallocBlockWlkTrack->ranges.clear();
-    unallocBlockWlkTrack->nextSequenceNo = 0;
+/**
+* Add a run of unallocated blocks to the unallocated space files of a file system.
+* Consecutive blocks are kept in the same range, ranges are split when the
+* file reaches the maximum chunk size and files are created once the minimum
+* chunk size is reached (see setAddUnallocSpace()).  The work done is
+* proportional to the number of runs and chunks, not to the number of blocks.
+* @param unallocBlockWlkTrack state of the file being built
+* @param a_addr first block of the run
+* @param a_len number of blocks in the run
+* @returns TSK_OK on success, TSK_ERR on error
+*/
+TSK_RETVAL_ENUM TskAutoDb::addUnallocRun(UNALLOC_BLOCK_WLK_TRACK & unallocBlockWlkTrack,
+    TSK_DADDR_T a_addr, TSK_DADDR_T a_len) {
+    const int64_t blockSize = unallocBlockWlkTrack.fsInfo.block_size;
+    const TSK_DADDR_T endAddr = a_addr + a_len;
+    TSK_DADDR_T addr = a_addr;
+
+    while (addr < endAddr) {
+        // initialize if this is the first block
+        if (unallocBlockWlkTrack.isStart) {
+            unallocBlockWlkTrack.isStart = false;
+            unallocBlockWlkTrack.curRangeStart = addr;
+            unallocBlockWlkTrack.prevBlock = addr;
+            unallocBlockWlkTrack.size = blockSize;
+            unallocBlockWlkTrack.nextSequenceNo = 0;
+            addr++;
+            continue;
+        }
+
+        // We want to keep consecutive blocks in the same run, so simply update prevBlock and the size
+        // if this one is consecutive with the last one. But, if we have hit the max chunk
+        // size, then break up this set of consecutive blocks.
+        if ((addr == unallocBlockWlkTrack.prevBlock + 1) && ((unallocBlockWlkTrack.maxChunkSize <= 0) ||
+                (unallocBlockWlkTrack.size < unallocBlockWlkTrack.maxChunkSize))) {
+            TSK_DADDR_T count = endAddr - addr;
+
+            // number of blocks that can be added before reaching the max chunk size
+            if (unallocBlockWlkTrack.maxChunkSize > 0) {
+                TSK_DADDR_T maxCount = (TSK_DADDR_T) ((unallocBlockWlkTrack.maxChunkSize -
+                    unallocBlockWlkTrack.size + blockSize - 1) / blockSize);
+                if (count > maxCount)
+                    count = maxCount;
+            }
+            unallocBlockWlkTrack.prevBlock += count;
+            unallocBlockWlkTrack.size += count * blockSize;
+            addr += count;
+            continue;
+        }
+
+        // this block is not contiguous with the previous one or we've hit the maximum size; create and add a range object
+        const uint64_t rangeStartOffset = unallocBlockWlkTrack.curRangeStart * blockSize
+            + unallocBlockWlkTrack.fsInfo.offset;
+        const uint64_t rangeSizeBytes = (1 + unallocBlockWlkTrack.prevBlock - unallocBlockWlkTrack.curRangeStart)
+            * blockSize;
+        unallocBlockWlkTrack.ranges.push_back(TSK_DB_FILE_LAYOUT_RANGE(rangeStartOffset, rangeSizeBytes, unallocBlockWlkTrack.nextSequenceNo++));
+
+        // Do not add the file yet if we are going to:
+        // a) Make one big file with all unallocated space (minChunkSize == 0)
+        // or
+        // b) Only make an unallocated file once we have at least chunkSize bytes
+        // of data in our current run (minChunkSize > 0)
+        // In either case, reset the range pointers and add this block to the size
+        if ((unallocBlockWlkTrack.minChunkSize == 0) ||
+            ((unallocBlockWlkTrack.minChunkSize > 0) &&
+            (unallocBlockWlkTrack.size < unallocBlockWlkTrack.minChunkSize))) {
+
+            unallocBlockWlkTrack.size += blockSize;
+            unallocBlockWlkTrack.curRangeStart = addr;
+            unallocBlockWlkTrack.prevBlock = addr;
+            addr++;
+            continue;
+        }
+
+        // at this point we are either chunking and have reached the chunk limit
+        // or we're not chunking. Either way we now add what we've got to the DB
+        int64_t fileObjId = 0;
+        if (m_db->addUnallocBlockFile(m_curUnallocDirId, unallocBlockWlkTrack.fsObjId,
+            unallocBlockWlkTrack.size, unallocBlockWlkTrack.ranges, fileObjId, m_curImgId) == TSK_ERR) {
+            return TSK_ERR;
+        }
+
+        // reset
+        unallocBlockWlkTrack.curRangeStart = addr;
+        unallocBlockWlkTrack.prevBlock = addr;
+        unallocBlockWlkTrack.size = blockSize; // The current block is part of the new range
+        unallocBlockWlkTrack.ranges.clear();
+        unallocBlockWlkTrack.nextSequenceNo = 0;
+        addr++;
+    }
 
     //we don't know what the last unalloc block is in advance
     //and will handle the last range in addFsInfoUnalloc()
-    
-    return TSK_WALK_CONT;
+    return TSK_OK;
 }
 
 
@@ -989,14 +1030,15 @@ TSK_RETVAL_ENUM TskAutoDb::addFsInfoUnalloc(const TSK_DB_FS_INFO & dbFsInfo) {
     if (m_db->addUnallocFsBlockFilesParent(dbFsInfo.objId, m_curUnallocDirId, m_curImgId) == TSK_ERR) {
         tsk_error_set_errstr2("addFsInfoUnalloc: error creating dir for unallocated space");
         registerError();
+        tsk_fs_close(fsInfo);
         return TSK_ERR;
     }
 
-    //walk unalloc blocks on the fs and process them
+    //walk the runs of unalloc blocks on the fs and process them
     //initialize the unalloc block walk tracking 
     UNALLOC_BLOCK_WLK_TRACK unallocBlockWlkTrack(*this, *fsInfo, dbFsInfo.objId, m_minChunkSize, m_maxChunkSize);
-    uint8_t block_walk_ret = tsk_fs_block_walk(fsInfo, fsInfo->first_block, fsInfo->last_block, (TSK_FS_BLOCK_WALK_FLAG_ENUM)(TSK_FS_BLOCK_WALK_FLAG_UNALLOC | TSK_FS_BLOCK_WALK_FLAG_AONLY), 
-        fsWalkUnallocBlocksCb, &unallocBlockWlkTrack);
+    uint8_t block_walk_ret = tsk_fs_block_run_walk(fsInfo, fsInfo->first_block, fsInfo->last_block, TSK_FS_BLOCK_WALK_FLAG_UNALLOC,
+        fsWalkUnallocRunsCb, &unallocBlockWlkTrack);
 
     if (block_walk_ret == 1) {
         stringstream errss;
@@ -1015,6 +1057,7 @@ TSK_RETVAL_ENUM TskAutoDb::addFsInfoUnalloc(const TSK_DB_FS_INFO & dbFsInfo) {
 
     // handle creation of the last range
     // make range inclusive from curBlockStart to prevBlock
+    // (a fs without unallocated blocks gets a file with its first block)
     const uint64_t byteStart = unallocBlockWlkTrack.curRangeStart * fsInfo->block_size + fsInfo->offset;
     const uint64_t byteLen = (1 + unallocBlockWlkTrack.prevBlock - unallocBlockWlkTrack.curRangeStart) * fsInfo->block_size;
     unallocBlockWlkTrack.ranges.push_back(TSK_DB_FILE_LAYOUT_RANGE(byteStart, byteLen, unallocBlockWlkTrack.nextSequenceNo++));
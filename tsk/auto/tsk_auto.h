@@ -33,6 +33,7 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 
 
 #define TSK_AUTO_TAG 0x9191ABAB
@@ -239,7 +240,7 @@ class TskAuto {
   protected:
     TSK_IMG_INFO * m_img_info;
     bool m_internalOpen;        ///< True if m_img_info was opened in TskAuto and false if passed in
-    bool m_stopAllProcessing;   ///< True if no further processing should occur
+    std::atomic<bool> m_stopAllProcessing;   ///< True if no further processing should occur (can be set from another thread)
 
 
     uint8_t isNtfsSystemFiles(TSK_FS_FILE * fs_file, const char *path);
@@ -0,0 +1,265 @@
+/*
+ * The Sleuth Kit
+ *
+ * Copyright (c) 2026 The Sleuth Kit contributors.  All rights reserved
+ * Contact: Brian Carrier [carrier <at> sleuthkit [dot] org]
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+#include "tsk_base_i.h"
+
+/** \file tsk_addr_set.c
+ * TSK_ADDR_SET is a compressed bitmap of 64-bit addresses (such as the
+ * metadata addresses that are pointed to by names).  An address is split
+ * into a high part that selects a container and a 16-bit low part that is
+ * stored in it.  A container keeps a sorted array of the low parts while
+ * it has up to TSK_ADDR_SET_ARRAY_MAX of them and a 64K bit bitmap after
+ * that, so sparse sets stay small and dense ones cost a bit per address.
+ * A lookup is a binary search over the containers and one in (or a bit
+ * test of) the container.
+ */
+
+/* Most low parts that a container keeps in an array.  The array is then
+ * as big as the bitmap would be. */
+#define TSK_ADDR_SET_ARRAY_MAX  4096
+#define TSK_ADDR_SET_WORDS      (65536 / 64)
+
+typedef struct {
+    uint64_t high;              // address >> 16
+    uint32_t cnt;               // number of addresses in the container
+    uint32_t alloc;             // number of entries allocated in vals
+    uint16_t *vals;             // sorted low parts (NULL for bitmaps)
+    uint64_t *bits;             // bitmap of the low parts (NULL for arrays)
+} TSK_ADDR_SET_CONT;
+
+struct TSK_ADDR_SET {
+    TSK_ADDR_SET_CONT *conts;   // sorted by high
+    size_t cont_cnt;
+    size_t cont_alloc;
+    uint64_t cnt;               // number of addresses in the set
+};
+
+
+/**
+ * \internal
+ * Allocate an empty address set.
+ * @returns NULL on error
+ */
+TSK_ADDR_SET *
+tsk_addr_set_alloc()
+{
+    return (TSK_ADDR_SET *) tsk_malloc(sizeof(TSK_ADDR_SET));
+}
+
+/**
+ * \internal
+ * Free an address set.
+ * @param a_set Set to free (can be NULL)
+ */
+void
+tsk_addr_set_free(TSK_ADDR_SET * a_set)
+{
+    size_t i;
+
+    if (a_set == NULL)
+        return;
+
+    for (i = 0; i < a_set->cont_cnt; i++) {
+        free(a_set->conts[i].vals);
+        free(a_set->conts[i].bits);
+    }
+    free(a_set->conts);
+    free(a_set);
+}
+
+/* Find the container for a_high.
+ * @returns its index or, if there is none, the index that it would be
+ * inserted at with a_found set to 0 */
+static size_t
+tsk_addr_set_cont(const TSK_ADDR_SET * a_set, uint64_t a_high,
+    uint8_t * a_found)
+{
+    size_t lo = 0, hi = a_set->cont_cnt;
+
+    // addresses are often added (and looked up) in increasing order
+    if ((hi > 0) && (a_set->conts[hi - 1].high <= a_high)) {
+        *a_found = (a_set->conts[hi - 1].high == a_high);
+        return *a_found ? hi - 1 : hi;
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_set->conts[mid].high < a_high)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *a_found = ((lo < a_set->cont_cnt) && (a_set->conts[lo].high == a_high));
+    return lo;
+}
+
+/* Find a_low in the array of an array container.
+ * @returns its index or, if it is not there, the index that it would be
+ * inserted at with a_found set to 0 */
+static uint32_t
+tsk_addr_set_val(const TSK_ADDR_SET_CONT * a_cont, uint16_t a_low,
+    uint8_t * a_found)
+{
+    uint32_t lo = 0, hi = a_cont->cnt;
+
+    if ((hi > 0) && (a_cont->vals[hi - 1] <= a_low)) {
+        *a_found = (a_cont->vals[hi - 1] == a_low);
+        return *a_found ? hi - 1 : hi;
+    }
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (a_cont->vals[mid] < a_low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *a_found = ((lo < a_cont->cnt) && (a_cont->vals[lo] == a_low));
+    return lo;
+}
+
+/* Convert a full array container to a bitmap container.
+ * @returns 1 on error */
+static uint8_t
+tsk_addr_set_to_bits(TSK_ADDR_SET_CONT * a_cont)
+{
+    uint32_t i;
+
+    if ((a_cont->bits = (uint64_t *) tsk_malloc(TSK_ADDR_SET_WORDS *
+                sizeof(uint64_t))) == NULL)
+        return 1;
+
+    for (i = 0; i < a_cont->cnt; i++)
+        a_cont->bits[a_cont->vals[i] / 64] |=
+            (uint64_t) 1 << (a_cont->vals[i] % 64);
+    free(a_cont->vals);
+    a_cont->vals = NULL;
+    a_cont->alloc = 0;
+    return 0;
+}
+
+/**
+ * \internal
+ * Add an address to a set.  Adding addresses in increasing order is
+ * fastest.
+ * @param a_set Set to add to
+ * @param a_addr Address to add
+ * @returns 1 on error and 0 on success (including if it was already there)
+ */
+uint8_t
+tsk_addr_set_add(TSK_ADDR_SET * a_set, uint64_t a_addr)
+{
+    uint64_t high = a_addr >> 16;
+    uint16_t low = (uint16_t) (a_addr & 0xffff);
+    TSK_ADDR_SET_CONT *cont;
+    uint8_t found;
+    size_t c;
+    uint32_t v;
+
+    c = tsk_addr_set_cont(a_set, high, &found);
+    if (found == 0) {
+        if (a_set->cont_cnt == a_set->cont_alloc) {
+            size_t alloc = a_set->cont_alloc ? a_set->cont_alloc * 2 : 8;
+            TSK_ADDR_SET_CONT *conts;
+            if ((conts = (TSK_ADDR_SET_CONT *) tsk_realloc(a_set->conts,
+                        alloc * sizeof(TSK_ADDR_SET_CONT))) == NULL)
+                return 1;
+            a_set->conts = conts;
+            a_set->cont_alloc = alloc;
+        }
+        memmove(&a_set->conts[c + 1], &a_set->conts[c],
+            (a_set->cont_cnt - c) * sizeof(TSK_ADDR_SET_CONT));
+        memset(&a_set->conts[c], 0, sizeof(TSK_ADDR_SET_CONT));
+        a_set->conts[c].high = high;
+        a_set->cont_cnt++;
+    }
+    cont = &a_set->conts[c];
+
+    if (cont->bits) {
+        uint64_t mask = (uint64_t) 1 << (low % 64);
+        if ((cont->bits[low / 64] & mask) == 0) {
+            cont->bits[low / 64] |= mask;
+            cont->cnt++;
+            a_set->cnt++;
+        }
+        return 0;
+    }
+
+    v = tsk_addr_set_val(cont, low, &found);
+    if (found)
+        return 0;
+
+    if (cont->cnt == TSK_ADDR_SET_ARRAY_MAX) {
+        if (tsk_addr_set_to_bits(cont))
+            return 1;
+        cont->bits[low / 64] |= (uint64_t) 1 << (low % 64);
+        cont->cnt++;
+        a_set->cnt++;
+        return 0;
+    }
+
+    if (cont->cnt == cont->alloc) {
+        uint32_t alloc = cont->alloc ? cont->alloc * 2 : 4;
+        uint16_t *vals;
+        if (alloc > TSK_ADDR_SET_ARRAY_MAX)
+            alloc = TSK_ADDR_SET_ARRAY_MAX;
+        if ((vals = (uint16_t *) tsk_realloc(cont->vals,
+                    alloc * sizeof(uint16_t))) == NULL)
+            return 1;
+        cont->vals = vals;
+        cont->alloc = alloc;
+    }
+    memmove(&cont->vals[v + 1], &cont->vals[v],
+        (cont->cnt - v) * sizeof(uint16_t));
+    cont->vals[v] = low;
+    cont->cnt++;
+    a_set->cnt++;
+    return 0;
+}
+
+/**
+ * \internal
+ * Test if an address is in a set.  This does not change the set, so it
+ * can be called by several threads at once.
+ * @param a_set Set to search (can be NULL)
+ * @param a_addr Address to look for
+ * @returns 1 if the address is in the set and 0 if not
+ */
+uint8_t
+tsk_addr_set_find(const TSK_ADDR_SET * a_set, uint64_t a_addr)
+{
+    uint16_t low = (uint16_t) (a_addr & 0xffff);
+    const TSK_ADDR_SET_CONT *cont;
+    uint8_t found;
+    size_t c;
+
+    if (a_set == NULL)
+        return 0;
+
+    c = tsk_addr_set_cont(a_set, a_addr >> 16, &found);
+    if (found == 0)
+        return 0;
+    cont = &a_set->conts[c];
+
+    if (cont->bits)
+        return (cont->bits[low / 64] >> (low % 64)) & 1;
+
+    tsk_addr_set_val(cont, low, &found);
+    return found;
+}
+
+/**
+ * \internal
+ * Return the number of addresses in a set.
+ * @param a_set Set to count (can be NULL)
+ */
+uint64_t
+tsk_addr_set_count(const TSK_ADDR_SET * a_set)
+{
+    return a_set ? a_set->cnt : 0;
+}
@@ -155,6 +155,11 @@ extern "C" {
     extern uint8_t tsk_list_add(TSK_LIST ** list, uint64_t key);
     extern void tsk_list_free(TSK_LIST * list);
 
+    /**
+    * Compressed set of 64-bit addresses.  Its contents are internal.
+    */
+    typedef struct TSK_ADDR_SET TSK_ADDR_SET;
+
 
     // note that the stack code is in this file and not internal for convenience to users
     /**
@@ -279,6 +284,9 @@ extern "C" {
     extern void tsk_version_print(FILE *);
     extern const char *tsk_version_get_str();
 
+    extern void tsk_parallel_set_threads(unsigned int a_count);
+    extern unsigned int tsk_parallel_get_threads();
+
 
 /*********** RETURN VALUES ************/
 
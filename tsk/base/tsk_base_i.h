@@ -39,6 +39,28 @@ extern "C" {
     extern void tsk_take_lock(tsk_lock_t *);
     extern void tsk_release_lock(tsk_lock_t *);
 
+    extern void *tsk_atomic_ptr_load(void *volatile *a_ptr);
+    extern void *tsk_atomic_ptr_cas(void *volatile *a_ptr, void *a_old,
+        void *a_new);
+    extern size_t tsk_atomic_add(volatile size_t * a_val, size_t a_delta);
+
+    /**
+     * \internal
+     * Callback used by tsk_parallel_for() for each task.
+     * @param a_ptr Pointer that was passed to tsk_parallel_for()
+     * @param a_idx Index of the task to run
+     * @returns 1 on error (with tsk_error set) and 0 on success
+     */
+    typedef uint8_t(*TSK_PARALLEL_TASK_CB) (void *a_ptr, size_t a_idx);
+    extern uint8_t tsk_parallel_for(size_t a_count,
+        TSK_PARALLEL_TASK_CB a_task, void *a_ptr);
+
+    typedef struct TSK_PARALLEL_POOL TSK_PARALLEL_POOL;
+    extern TSK_PARALLEL_POOL *tsk_parallel_pool_alloc();
+    extern uint8_t tsk_parallel_pool_run(TSK_PARALLEL_POOL * a_pool,
+        size_t a_count, TSK_PARALLEL_TASK_CB a_task, void *a_ptr);
+    extern void tsk_parallel_pool_free(TSK_PARALLEL_POOL * a_pool);
+
 #ifndef rounddown
 #define rounddown(x, y)	\
     ((((x) % (y)) == 0) ? (x) : \
@@ -48,6 +70,13 @@ extern "C" {
     extern void *tsk_malloc(size_t);
     extern void *tsk_realloc(void *, size_t);
 
+    extern TSK_ADDR_SET *tsk_addr_set_alloc();
+    extern void tsk_addr_set_free(TSK_ADDR_SET * a_set);
+    extern uint8_t tsk_addr_set_add(TSK_ADDR_SET * a_set, uint64_t a_addr);
+    extern uint8_t tsk_addr_set_find(const TSK_ADDR_SET * a_set,
+        uint64_t a_addr);
+    extern uint64_t tsk_addr_set_count(const TSK_ADDR_SET * a_set);
+
 // getopt for windows
 #ifdef TSK_WIN32
     extern int tsk_optind;
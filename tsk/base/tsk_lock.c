@@ -107,6 +107,7 @@ tsk_release_lock(tsk_lock_t * lock)
 
     // single-threaded
 #else
+#define TSK_ATOMIC_PLAIN
 
 void
 tsk_init_lock(tsk_lock_t * lock)
@@ -129,3 +130,119 @@ tsk_release_lock(tsk_lock_t * lock)
 }
 
 #endif
+
+
+/*
+ * Atomic operations on pointers and sizes.  These are used for caches that
+ * are filled once per entry and then read without taking a lock.
+ */
+
+#if defined(TSK_ATOMIC_PLAIN)
+
+void *
+tsk_atomic_ptr_load(void *volatile *a_ptr)
+{
+    return *a_ptr;
+}
+
+void *
+tsk_atomic_ptr_cas(void *volatile *a_ptr, void *a_old, void *a_new)
+{
+    void *cur = *a_ptr;
+    if (cur == a_old)
+        *a_ptr = a_new;
+    return cur;
+}
+
+size_t
+tsk_atomic_add(volatile size_t * a_val, size_t a_delta)
+{
+    return *a_val += a_delta;
+}
+
+#elif defined(TSK_WIN32)
+
+void *
+tsk_atomic_ptr_load(void *volatile *a_ptr)
+{
+    return InterlockedCompareExchangePointer(a_ptr, NULL, NULL);
+}
+
+void *
+tsk_atomic_ptr_cas(void *volatile *a_ptr, void *a_old, void *a_new)
+{
+    return InterlockedCompareExchangePointer(a_ptr, a_new, a_old);
+}
+
+size_t
+tsk_atomic_add(volatile size_t * a_val, size_t a_delta)
+{
+#ifdef _WIN64
+    return (size_t) InterlockedExchangeAdd64((volatile LONG64 *) a_val,
+        (LONG64) a_delta) + a_delta;
+#else
+    return (size_t) InterlockedExchangeAdd((volatile LONG *) a_val,
+        (LONG) a_delta) + a_delta;
+#endif
+}
+
+#elif defined(__GNUC__)
+
+void *
+tsk_atomic_ptr_load(void *volatile *a_ptr)
+{
+    return __atomic_load_n(a_ptr, __ATOMIC_ACQUIRE);
+}
+
+void *
+tsk_atomic_ptr_cas(void *volatile *a_ptr, void *a_old, void *a_new)
+{
+    __atomic_compare_exchange_n(a_ptr, &a_old, a_new, 0,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return a_old;
+}
+
+size_t
+tsk_atomic_add(volatile size_t * a_val, size_t a_delta)
+{
+    return __atomic_add_fetch(a_val, a_delta, __ATOMIC_ACQ_REL);
+}
+
+#else
+
+// no compiler support, so fall back to a global mutex
+static pthread_mutex_t tsk_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void *
+tsk_atomic_ptr_load(void *volatile *a_ptr)
+{
+    void *cur;
+    pthread_mutex_lock(&tsk_atomic_mutex);
+    cur = *a_ptr;
+    pthread_mutex_unlock(&tsk_atomic_mutex);
+    return cur;
+}
+
+void *
+tsk_atomic_ptr_cas(void *volatile *a_ptr, void *a_old, void *a_new)
+{
+    void *cur;
+    pthread_mutex_lock(&tsk_atomic_mutex);
+    cur = *a_ptr;
+    if (cur == a_old)
+        *a_ptr = a_new;
+    pthread_mutex_unlock(&tsk_atomic_mutex);
+    return cur;
+}
+
+size_t
+tsk_atomic_add(volatile size_t * a_val, size_t a_delta)
+{
+    size_t ret;
+    pthread_mutex_lock(&tsk_atomic_mutex);
+    ret = *a_val += a_delta;
+    pthread_mutex_unlock(&tsk_atomic_mutex);
+    return ret;
+}
+
+#endif
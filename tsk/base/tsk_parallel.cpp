@@ -0,0 +1,356 @@
+/*
+ * The Sleuth Kit
+ *
+ * Copyright (c) 2026 The Sleuth Kit contributors.  All rights reserved
+ * Contact: Brian Carrier [carrier <at> sleuthkit [dot] org]
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/** \file tsk_parallel.cpp
+ * Contains the internal worker pool that the file system code uses to
+ * spread independent pieces of work (chunks of a journal, allocation groups,
+ * etc.) over several threads.
+ */
+
+#include "tsk_base_i.h"
+
+#include <atomic>
+#include <string.h>
+
+#ifdef TSK_MULTITHREAD_LIB
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#endif
+
+/* 0 means "use the number of cores" */
+static std::atomic < unsigned int >tsk_parallel_threads(0);
+
+#ifdef TSK_MULTITHREAD_LIB
+/* Set while a thread runs parallel tasks, so that parallel code that a
+ * task calls (e.g. a meta walk during the orphan hunt) runs on that
+ * thread only instead of starting threads of its own */
+static thread_local bool tsk_parallel_in_task = false;
+#endif
+
+/**
+ * \ingroup baselib
+ * Set the maximum number of worker threads that the library will use
+ * internally for parallel scans.  Setting the value to 1 forces all of the
+ * work to be done on the calling thread.
+ *
+ * @param a_count Number of threads to use (0 to use the number of cores)
+ */
+void
+tsk_parallel_set_threads(unsigned int a_count)
+{
+    tsk_parallel_threads = a_count;
+}
+
+/**
+ * \ingroup baselib
+ * Return the maximum number of worker threads that the library will use
+ * internally for parallel scans.  This is 1 when called from one of the
+ * library's own parallel tasks, because nested scans are not spread over
+ * more threads.
+ *
+ * @returns number of threads (always 1 or more)
+ */
+unsigned int
+tsk_parallel_get_threads()
+{
+    unsigned int cnt = tsk_parallel_threads;
+#ifdef TSK_MULTITHREAD_LIB
+    if (tsk_parallel_in_task)
+        return 1;
+    if (cnt == 0)
+        cnt = std::thread::hardware_concurrency();
+#endif
+    if (cnt == 0)
+        cnt = 1;
+    return cnt;
+}
+
+/* State shared between the workers of one tsk_parallel_for() call */
+struct TSK_PARALLEL_STATE {
+    size_t count;
+    TSK_PARALLEL_TASK_CB task;
+    void *ptr;
+    std::atomic < size_t > next;
+    std::atomic < int >failed;
+    TSK_ERROR_INFO error;       // copy of the error of the first failed task
+};
+
+static void
+tsk_parallel_worker(TSK_PARALLEL_STATE * a_state)
+{
+#ifdef TSK_MULTITHREAD_LIB
+    bool in_task = tsk_parallel_in_task;
+    tsk_parallel_in_task = true;
+#endif
+
+    while (a_state->failed == 0) {
+        size_t idx = a_state->next.fetch_add(1);
+        if (idx >= a_state->count)
+            break;
+
+        if (a_state->task(a_state->ptr, idx)) {
+            // only the first failure is reported back to the caller
+            int expected = 0;
+            if (a_state->failed.compare_exchange_strong(expected, 1)) {
+                TSK_ERROR_INFO *info = tsk_error_get_info();
+                if (info != NULL)
+                    memcpy(&a_state->error, info, sizeof(TSK_ERROR_INFO));
+            }
+        }
+    }
+
+#ifdef TSK_MULTITHREAD_LIB
+    tsk_parallel_in_task = in_task;
+#endif
+}
+
+/* Copy the error of the first failed task to the calling thread.
+ * Returns 1 if a task failed and 0 otherwise. */
+static uint8_t
+tsk_parallel_finish(TSK_PARALLEL_STATE * a_state)
+{
+    if (a_state->failed) {
+        TSK_ERROR_INFO *info = tsk_error_get_info();
+        if (info != NULL)
+            memcpy(info, &a_state->error, sizeof(TSK_ERROR_INFO));
+        return 1;
+    }
+    return 0;
+}
+
+static void
+tsk_parallel_state_init(TSK_PARALLEL_STATE * a_state, size_t a_count,
+    TSK_PARALLEL_TASK_CB a_task, void *a_ptr)
+{
+    a_state->count = a_count;
+    a_state->task = a_task;
+    a_state->ptr = a_ptr;
+    a_state->next = 0;
+    a_state->failed = 0;
+    memset(&a_state->error, 0, sizeof(a_state->error));
+}
+
+/**
+ * \internal
+ * Run a_task for every index in [0, a_count).  The tasks are handed out
+ * dynamically to up to tsk_parallel_get_threads() threads (including the
+ * calling thread), so the callback must be safe to run concurrently and
+ * can make no assumptions about the order in which indices are processed.
+ *
+ * If a task returns 1, no new tasks are started and the error that the task
+ * set is copied into the error state of the calling thread.
+ *
+ * @param a_count Number of tasks
+ * @param a_task Callback to run for each task
+ * @param a_ptr Pointer to pass to the callback
+ * @returns 1 if a task failed and 0 on success
+ */
+uint8_t
+tsk_parallel_for(size_t a_count, TSK_PARALLEL_TASK_CB a_task, void *a_ptr)
+{
+    TSK_PARALLEL_STATE state;
+    size_t nthreads = tsk_parallel_get_threads();
+
+    tsk_parallel_state_init(&state, a_count, a_task, a_ptr);
+
+    if (nthreads > a_count)
+        nthreads = a_count;
+
+#ifdef TSK_MULTITHREAD_LIB
+    if (nthreads > 1) {
+        std::vector < std::thread > workers;
+        try {
+            for (size_t i = 1; i < nthreads; i++)
+                workers.push_back(std::thread(tsk_parallel_worker, &state));
+        }
+        catch(...) {
+            // could not start as many threads as requested, carry on
+            // with the ones that we have
+        }
+        tsk_parallel_worker(&state);
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+    else
+#endif
+    {
+        for (size_t i = 0; i < a_count; i++) {
+            if (a_task(a_ptr, i))
+                return 1;
+        }
+        return 0;
+    }
+
+    return tsk_parallel_finish(&state);
+}
+
+
+/* Worker threads that stay around between tsk_parallel_pool_run() calls */
+struct TSK_PARALLEL_POOL {
+#ifdef TSK_MULTITHREAD_LIB
+    std::mutex lock;
+    std::condition_variable work_cond;  // a job was posted or the pool is closing
+    std::condition_variable done_cond;  // a worker left the current job
+    std::vector < std::thread > workers;
+    TSK_PARALLEL_STATE *job;    // current job (NULL if none is open)
+    uint64_t generation;        // incremented for every posted job
+    size_t active;              // number of workers inside the current job
+    bool quit;
+#endif
+};
+
+#ifdef TSK_MULTITHREAD_LIB
+static void
+tsk_parallel_pool_worker(TSK_PARALLEL_POOL * a_pool)
+{
+    uint64_t seen = 0;
+    std::unique_lock < std::mutex > lk(a_pool->lock);
+
+    while (true) {
+        while ((a_pool->quit == false) && (a_pool->generation == seen))
+            a_pool->work_cond.wait(lk);
+        if (a_pool->quit)
+            break;
+
+        seen = a_pool->generation;
+        // the caller may already have finished the job on its own
+        if (a_pool->job == NULL)
+            continue;
+
+        TSK_PARALLEL_STATE *job = a_pool->job;
+        a_pool->active++;
+        lk.unlock();
+        tsk_parallel_worker(job);
+        lk.lock();
+        if (--a_pool->active == 0)
+            a_pool->done_cond.notify_all();
+    }
+}
+#endif
+
+/**
+ * \internal
+ * Start a set of worker threads that can be fed several batches of tasks
+ * with tsk_parallel_pool_run(), so that code that works in many small
+ * batches does not pay for starting threads on every batch.  The pool uses
+ * tsk_parallel_get_threads() - 1 threads (the calling thread makes up the
+ * last one).  If not all of the threads can be started, the pool carries on
+ * with the ones that were.
+ *
+ * @returns pool, which must be freed with tsk_parallel_pool_free(), or NULL
+ * on error
+ */
+TSK_PARALLEL_POOL *
+tsk_parallel_pool_alloc()
+{
+    TSK_PARALLEL_POOL *pool = new(std::nothrow) TSK_PARALLEL_POOL;
+    if (pool == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUX_MALLOC);
+        tsk_error_set_errstr("tsk_parallel_pool_alloc: out of memory");
+        return NULL;
+    }
+
+#ifdef TSK_MULTITHREAD_LIB
+    pool->job = NULL;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->quit = false;
+
+    size_t nthreads = tsk_parallel_get_threads();
+    try {
+        for (size_t i = 1; i < nthreads; i++)
+            pool->workers.push_back(std::thread(tsk_parallel_pool_worker,
+                    pool));
+    }
+    catch(...) {
+        // carry on with the threads that we have
+    }
+#endif
+    return pool;
+}
+
+/**
+ * \internal
+ * Run a_task for every index in [0, a_count) on the threads of a pool and
+ * the calling thread, and wait for all of them to finish.  The rules for
+ * the callback and the error handling are the same as for
+ * tsk_parallel_for().  Only one thread may run jobs on a pool at a time.
+ *
+ * @param a_pool Pool to run the tasks on (NULL to run them on the calling
+ * thread only)
+ * @param a_count Number of tasks
+ * @param a_task Callback to run for each task
+ * @param a_ptr Pointer to pass to the callback
+ * @returns 1 if a task failed and 0 on success
+ */
+uint8_t
+tsk_parallel_pool_run(TSK_PARALLEL_POOL * a_pool, size_t a_count,
+    TSK_PARALLEL_TASK_CB a_task, void *a_ptr)
+{
+    TSK_PARALLEL_STATE state;
+
+    tsk_parallel_state_init(&state, a_count, a_task, a_ptr);
+
+#ifdef TSK_MULTITHREAD_LIB
+    if ((a_pool != NULL) && (a_count > 1)
+        && (a_pool->workers.empty() == false)) {
+        {
+            std::lock_guard < std::mutex > lk(a_pool->lock);
+            a_pool->job = &state;
+            a_pool->generation++;
+        }
+        a_pool->work_cond.notify_all();
+
+        tsk_parallel_worker(&state);
+
+        // close the job so that late workers skip it, then wait for the
+        // ones that are still running tasks
+        std::unique_lock < std::mutex > lk(a_pool->lock);
+        a_pool->job = NULL;
+        while (a_pool->active > 0)
+            a_pool->done_cond.wait(lk);
+        lk.unlock();
+        return tsk_parallel_finish(&state);
+    }
+#endif
+
+    for (size_t i = 0; i < a_count; i++) {
+        if (a_task(a_ptr, i))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * \internal
+ * Stop the threads of a pool and free it.
+ *
+ * @param a_pool Pool to free (can be NULL)
+ */
+void
+tsk_parallel_pool_free(TSK_PARALLEL_POOL * a_pool)
+{
+    if (a_pool == NULL)
+        return;
+
+#ifdef TSK_MULTITHREAD_LIB
+    {
+        std::lock_guard < std::mutex > lk(a_pool->lock);
+        a_pool->quit = true;
+    }
+    a_pool->work_cond.notify_all();
+    for (size_t i = 0; i < a_pool->workers.size(); i++)
+        a_pool->workers[i].join();
+#endif
+    delete a_pool;
+}
@@ -468,6 +468,7 @@ exfatfs_set_func_ptrs(FATFS_INFO *a_fatfs)
 
     /* Content category functions. */
     fs->block_walk = fatfs_block_walk;
+    fs->block_run_walk = fatfs_block_run_walk;
     fs->block_getflags = fatfs_block_getflags;
 
     /* Meta data category functions. */
@@ -97,20 +97,19 @@ ext2fs_bg_has_super(uint32_t feature_ro_compat, uint32_t group_block)
 
 
 
-/* ext2fs_group_load - load 32-bit or 64-bit block group descriptor into cache
+/* ext2fs_group_addrs - look up the bitmap and inode table locations of a
+ * group in the group descriptor table that was read by ext2fs_open.
  *
- * Note: This routine assumes &ext2fs->lock is locked by the caller.
- *
- * return 1 on error and 0 on success.  On success one of either ext2fs->grp_buf or ext2fs->ext4_grp_buf will
- * be non-null and contain the valid data. Because Ext4 can have 32-bit group descriptors, check which buffer is 
- * non-null to determine what to read instead of duplicating the logic everywhere.
+ * Note: This routine does not need &ext2fs->lock.
  *
+ * return 1 on error and 0 on success
  * */
 static uint8_t
-    ext2fs_group_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
+ext2fs_group_addrs(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num,
+    TSK_DADDR_T * a_bmap, TSK_DADDR_T * a_imap, TSK_DADDR_T * a_itab)
 {
     TSK_FS_INFO *fs = (TSK_FS_INFO *) ext2fs;
-    size_t gd_size = tsk_getu16(fs->endian, ext2fs->fs->s_desc_size);
+    TSK_DADDR_T bmap, imap, itab;
 
     /*
     * Sanity check
@@ -123,98 +122,88 @@ static uint8_t
             PRI_EXT2GRP "", grp_num);
         return 1;
     }
-    // already loaded
-    else if (ext2fs->grp_num == grp_num) {
-        return 0;
+    // descriptor could not be read at open time
+    if (grp_num >= ext2fs->grp_descs_count) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_READ);
+        tsk_error_set_errstr("ext2fs_group_load: Group descriptor %"
+            PRI_EXT2GRP " at %" PRIuOFF, grp_num,
+            ext2fs->groups_offset + grp_num * ext2fs->grp_desc_size);
+        return 1;
     }
 
-    // 64-bit version.  
-    if (((fs->ftype == TSK_FS_TYPE_EXT4)) && (EXT2FS_HAS_INCOMPAT_FEATURE(fs, ext2fs->fs,
-        EXT2FS_FEATURE_INCOMPAT_64BIT)
-        && (tsk_getu16(fs->endian, ext2fs->fs->s_desc_size) >= 64))) {
-            TSK_OFF_T offs;
-            ssize_t cnt;
+    if (ext2fs->grp_desc_64) {
+        ext4fs_gd *gd = (ext4fs_gd *) & ext2fs->grp_descs[grp_num *
+            ext2fs->grp_desc_size];
+        bmap = ext4_getu64(fs->endian, gd->bg_block_bitmap_hi,
+            gd->bg_block_bitmap_lo);
+        imap = ext4_getu64(fs->endian, gd->bg_inode_bitmap_hi,
+            gd->bg_inode_bitmap_lo);
+        itab = ext4_getu64(fs->endian, gd->bg_inode_table_hi,
+            gd->bg_inode_table_lo);
+    }
+    else {
+        ext2fs_gd *gd = (ext2fs_gd *) & ext2fs->grp_descs[grp_num *
+            ext2fs->grp_desc_size];
+        bmap = tsk_getu32(fs->endian, gd->bg_block_bitmap);
+        imap = tsk_getu32(fs->endian, gd->bg_inode_bitmap);
+        itab = tsk_getu32(fs->endian, gd->bg_inode_table);
+    }
 
-            if (gd_size < (int)sizeof(ext4fs_gd))
-                gd_size = sizeof(ext4fs_gd);
+    // sanity checks
+    if ((bmap > fs->last_block) || (imap > fs->last_block)
+        || (itab > fs->last_block)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr("extXfs_group_load: Group %" PRI_EXT2GRP
+            " descriptor block locations too large at byte offset %"
+            PRIuDADDR, grp_num,
+            ext2fs->groups_offset + grp_num * ext2fs->grp_desc_size);
+        return 1;
+    }
 
-            if (ext2fs->ext4_grp_buf == NULL) {
-                if ((ext2fs->ext4_grp_buf = (ext4fs_gd *) tsk_malloc(gd_size)) == NULL) 
-                    return 1;
-            }
-            offs = ext2fs->groups_offset + grp_num * gd_size;
+    if (a_bmap)
+        *a_bmap = bmap;
+    if (a_imap)
+        *a_imap = imap;
+    if (a_itab)
+        *a_itab = itab;
+    return 0;
+}
+
+/* ext2fs_group_load - make the current group descriptor point to a group
+ *
+ * Note: This routine assumes &ext2fs->lock is locked by the caller.
+ *
+ * return 1 on error and 0 on success.  On success one of either ext2fs->grp_buf or ext2fs->ext4_grp_buf will
+ * be non-null and contain the valid data. Because Ext4 can have 32-bit group descriptors, check which buffer is 
+ * non-null to determine what to read instead of duplicating the logic everywhere.
+ *
+ * */
+static uint8_t
+    ext2fs_group_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
+{
+    // already loaded
+    if (ext2fs->grp_num == grp_num) {
+        return 0;
+    }
 
-            cnt = tsk_fs_read(&ext2fs->fs_info, offs, (char *) ext2fs->ext4_grp_buf, gd_size);
+    // this does the sanity checks
+    if (ext2fs_group_addrs(ext2fs, grp_num, NULL, NULL, NULL)) {
+        return 1;
+    }
 
+    if (ext2fs->grp_desc_64) {
+        ext2fs->ext4_grp_buf = (ext4fs_gd *) & ext2fs->grp_descs[grp_num *
+            ext2fs->grp_desc_size];
 #ifdef Ext4_DBG
-            debug_print_buf((char *) ext2fs->ext4_grp_buf, gd_size);
+        debug_print_buf((char *) ext2fs->ext4_grp_buf,
+            ext2fs->grp_desc_size);
 #endif
-            if (cnt != (ssize_t) gd_size) {
-                if (cnt >= 0) {
-                    tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_READ);
-                }
-                tsk_error_set_errstr2("ext2fs_group_load: Group descriptor %"
-                    PRI_EXT2GRP " at %" PRIuOFF, grp_num, offs);
-                return 1;
-            }
-
-            // sanity checks
-            if ((ext4_getu64(fs->endian,
-                ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
-                ext2fs->ext4_grp_buf->bg_block_bitmap_lo) > fs->last_block) ||
-                (ext4_getu64(fs->endian,
-                ext2fs->ext4_grp_buf->bg_inode_bitmap_hi,
-                ext2fs->ext4_grp_buf->bg_inode_bitmap_lo) > fs->last_block) ||
-                (ext4_getu64(fs->endian,
-                ext2fs->ext4_grp_buf->bg_inode_table_hi,
-                ext2fs->ext4_grp_buf->bg_inode_table_lo) > fs->last_block)) {
-                    tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
-                    tsk_error_set_errstr("extXfs_group_load: Ext4 Group %" PRI_EXT2GRP
-                        " descriptor block locations too large at byte offset %"
-                        PRIuDADDR, grp_num, offs);
-                    return 1;
-            }
     }
     else {
-        TSK_OFF_T offs;
-        ssize_t cnt;
-        if (gd_size < (int)sizeof(ext2fs_gd))
-            gd_size = sizeof(ext2fs_gd);
-
-        if (ext2fs->grp_buf == NULL) {
-            if ((ext2fs->grp_buf = (ext2fs_gd *) tsk_malloc(gd_size)) == NULL) 
-                return 1;
-        }
-        offs = ext2fs->groups_offset + grp_num * gd_size;
-
-        cnt = tsk_fs_read(&ext2fs->fs_info, offs, (char *) ext2fs->grp_buf, gd_size);
-
-        if (cnt != (ssize_t) gd_size) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
-            }
-            tsk_error_set_errstr2("ext2fs_group_load: Group descriptor %"
-                PRI_EXT2GRP " at %" PRIuOFF, grp_num, offs);
-            return 1;
-        }
-
-        // sanity checks
-        if ((tsk_getu32(fs->endian,
-            ext2fs->grp_buf->bg_block_bitmap) > fs->last_block) ||
-            (tsk_getu32(fs->endian,
-            ext2fs->grp_buf->bg_inode_bitmap) > fs->last_block) ||
-            (tsk_getu32(fs->endian,
-            ext2fs->grp_buf->bg_inode_table) > fs->last_block)) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
-                tsk_error_set_errstr("extXfs_group_load: Group %" PRI_EXT2GRP
-                    " descriptor block locations too large at byte offset %"
-                    PRIuDADDR, grp_num, offs);
-                return 1;
-        }
+        ext2fs->grp_buf = (ext2fs_gd *) & ext2fs->grp_descs[grp_num *
+            ext2fs->grp_desc_size];
 
         if (tsk_verbose) {
             TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
@@ -230,6 +219,78 @@ static uint8_t
     return 0;
 }
 
+/* ext2fs_group_table_load - read all of the group descriptors
+ *
+ * Descriptors that cannot be read are not an error here.  They are
+ * reported when the group is used.
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ext2fs_group_table_load(EXT2FS_INFO * ext2fs)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) ext2fs;
+    size_t gd_size = tsk_getu16(fs->endian, ext2fs->fs->s_desc_size);
+    TSK_OFF_T avail;
+    size_t len;
+    ssize_t cnt;
+
+    // 64-bit version.  
+    if (((fs->ftype == TSK_FS_TYPE_EXT4)) && (EXT2FS_HAS_INCOMPAT_FEATURE(fs, ext2fs->fs,
+        EXT2FS_FEATURE_INCOMPAT_64BIT)
+        && (tsk_getu16(fs->endian, ext2fs->fs->s_desc_size) >= 64))) {
+        if (gd_size < sizeof(ext4fs_gd))
+            gd_size = sizeof(ext4fs_gd);
+        ext2fs->grp_desc_64 = 1;
+    }
+    else {
+        if (gd_size < sizeof(ext2fs_gd))
+            gd_size = sizeof(ext2fs_gd);
+        ext2fs->grp_desc_64 = 0;
+    }
+    ext2fs->grp_desc_size = gd_size;
+    ext2fs->grp_descs_count = 0;
+
+    // do not trust the group count further than the image goes
+    avail = fs->img_info->size - fs->offset - ext2fs->groups_offset;
+    if (avail <= 0)
+        return 0;
+    if ((uint64_t) ext2fs->groups_count * gd_size < (uint64_t) avail)
+        len = (size_t) ext2fs->groups_count * gd_size;
+    else
+        len = (size_t) (avail / gd_size) * gd_size;
+    if (len == 0)
+        return 0;
+
+    if ((ext2fs->grp_descs = (uint8_t *) tsk_malloc(len)) == NULL)
+        return 1;
+
+    cnt = tsk_fs_read(fs, ext2fs->groups_offset, (char *) ext2fs->grp_descs,
+        len);
+    if (cnt < 0) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "ext2fs_group_table_load: Error reading group descriptors at %"
+                PRIuOFF "\n", ext2fs->groups_offset);
+        tsk_error_reset();
+        return 0;
+    }
+    ext2fs->grp_descs_count = (EXT2_GRPNUM_T) (cnt / gd_size);
+    if (ext2fs->grp_descs_count == 0)
+        return 0;
+
+    if ((ext2fs->bmap_cache = (void **) tsk_malloc(ext2fs->grp_descs_count *
+                sizeof(void *))) == NULL)
+        return 1;
+    if ((ext2fs->imap_cache = (void **) tsk_malloc(ext2fs->grp_descs_count *
+                sizeof(void *))) == NULL)
+        return 1;
+    ext2fs->bitmap_cache_used = 0;
+    ext2fs->bitmap_cache_max = EXT2FS_BITMAP_CACHE_MAX;
+
+    return 0;
+}
+
 #ifdef EXT4_CHECKSUMS
 /**
  * ext4_group_desc_csum - Calculates the checksum of a group descriptor
@@ -291,7 +352,98 @@ ext2fs_print_map(uint8_t * map, int len)
     ((tsk_getu32(ext2fs->fs_info.endian, ext2fs->fs->s_inodes_per_group) * ext2fs->inode_size - 1) \
            / ext2fs->fs_info.block_size + 1)
 
+/* ext2fs_map_get - look up the block (a_inode == 0) or inode (a_inode == 1)
+ * bitmap of a group in the per-group cache, reading it on first use.
+ *
+ * Note: This routine does not need &ext2fs->lock.  Cached bitmaps are
+ * never changed or freed until the file system is closed.
+ *
+ * @param a_map [out] Bitmap or NULL if the memory budget for the cache
+ * has been used.  Use ext2fs_bmap_load or ext2fs_imap_load in that case.
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ext2fs_map_get(EXT2FS_INFO * ext2fs, uint8_t a_inode,
+    EXT2_GRPNUM_T grp_num, const uint8_t ** a_map)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
+    void **cache = a_inode ? ext2fs->imap_cache : ext2fs->bmap_cache;
+    void *cur;
+    uint8_t *buf;
+    TSK_DADDR_T addr;
+    ssize_t cnt;
+
+    *a_map = NULL;
+
+    /*
+     * Look up the group descriptor info.  This does the sanity check.
+     */
+    if (a_inode) {
+        if (ext2fs_group_addrs(ext2fs, grp_num, NULL, &addr, NULL))
+            return 1;
+    }
+    else {
+        if (ext2fs_group_addrs(ext2fs, grp_num, &addr, NULL, NULL))
+            return 1;
+    }
+
+    if ((cur = tsk_atomic_ptr_load(&cache[grp_num])) != NULL) {
+        *a_map = (const uint8_t *) cur;
+        return 0;
+    }
+
+    // reserve the memory before reading the bitmap
+    if (tsk_atomic_add(&ext2fs->bitmap_cache_used,
+            fs->block_size) > ext2fs->bitmap_cache_max) {
+        tsk_atomic_add(&ext2fs->bitmap_cache_used,
+            (size_t) 0 - fs->block_size);
+        return 0;
+    }
+
+    if ((buf = (uint8_t *) tsk_malloc(fs->block_size)) == NULL) {
+        tsk_atomic_add(&ext2fs->bitmap_cache_used,
+            (size_t) 0 - fs->block_size);
+        return 1;
+    }
+
+    cnt = tsk_fs_read(fs, addr * fs->block_size, (char *) buf,
+        fs->block_size);
+    if (cnt != fs->block_size) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ext2fs_map_get: %s bitmap %"
+            PRI_EXT2GRP " at %" PRIu64, a_inode ? "Inode" : "block",
+            grp_num, addr);
+        free(buf);
+        tsk_atomic_add(&ext2fs->bitmap_cache_used,
+            (size_t) 0 - fs->block_size);
+        return 1;
+    }
+
+    if (tsk_verbose > 1)
+        ext2fs_print_map(buf, tsk_getu32(fs->endian, a_inode ?
+                ext2fs->fs->s_inodes_per_group :
+                ext2fs->fs->s_blocks_per_group));
+
+    // another thread may have loaded the same bitmap in the meantime
+    if ((cur = tsk_atomic_ptr_cas(&cache[grp_num], NULL, buf)) != NULL) {
+        free(buf);
+        tsk_atomic_add(&ext2fs->bitmap_cache_used,
+            (size_t) 0 - fs->block_size);
+        buf = (uint8_t *) cur;
+    }
+
+    *a_map = buf;
+    return 0;
+}
+
 /* ext2fs_bmap_load - look up block bitmap & load into cache
+ *
+ * This is only used once the memory budget of the per-group cache
+ * (ext2fs_map_get) has been used.
  *
  * Note: This routine assumes &ext2fs->lock is locked by the caller.
  *
@@ -305,9 +457,9 @@ ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
     TSK_DADDR_T addr;
 
     /*
-     * Look up the group descriptor info.  The load will do the sanity check.
+     * Look up the group descriptor info.  This does the sanity check.
      */
-    if (ext2fs_group_load(ext2fs, grp_num)) {
+    if (ext2fs_group_addrs(ext2fs, grp_num, &addr, NULL, NULL)) {
         return 1;
     }
 
@@ -320,23 +472,6 @@ ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
     else if (ext2fs->bmap_grp_num == grp_num) {
         return 0;
     }
-    
-    if (ext2fs->ext4_grp_buf != NULL) { 
-        addr = ext4_getu64(fs->endian,
-            ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
-            ext2fs->ext4_grp_buf->bg_block_bitmap_lo);
-    }
-    else {
-        addr = (TSK_DADDR_T) tsk_getu32(fs->endian, ext2fs->grp_buf->bg_block_bitmap);
-    }
-
-    if (addr > fs->last_block) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
-        tsk_error_set_errstr
-            ("ext2fs_bmap_load: Block too large for image: %" PRIu64, addr);
-        return 1;
-    }
 
     cnt = tsk_fs_read(fs, addr * fs->block_size, 
         (char *) ext2fs->bmap_buf, ext2fs->fs_info.block_size);
@@ -348,6 +483,8 @@ ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
         }
         tsk_error_set_errstr2("ext2fs_bmap_load: block bitmap %"
             PRI_EXT2GRP " at %" PRIu64, grp_num, addr);
+        // the buffer no longer holds the bitmap of bmap_grp_num
+        ext2fs->bmap_grp_num = 0xffffffff;
         return 1;
     }
 
@@ -360,6 +497,9 @@ ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
 
 
 /* ext2fs_imap_load - look up inode bitmap & load into cache
+ *
+ * This is only used once the memory budget of the per-group cache
+ * (ext2fs_map_get) has been used.
  *
  * Note: This routine assumes &ext2fs->lock is locked by the caller.
  *
@@ -373,9 +513,9 @@ static uint8_t
     TSK_DADDR_T addr;
 
     /*
-    * Look up the group descriptor info.
+    * Look up the group descriptor info.  This does the sanity check.
     */
-    if (ext2fs_group_load(ext2fs, grp_num)) {
+    if (ext2fs_group_addrs(ext2fs, grp_num, NULL, &addr, NULL)) {
         return 1;
     }
 
@@ -390,26 +530,6 @@ static uint8_t
         return 0;
     }
 
-    /*
-    * Look up the inode allocation bitmap.
-    */
-    if (ext2fs->ext4_grp_buf != NULL) { 
-        addr = ext4_getu64(fs->endian,
-            ext2fs->ext4_grp_buf->bg_inode_bitmap_hi,
-            ext2fs->ext4_grp_buf->bg_inode_bitmap_lo);
-    }
-    else {
-        addr = (TSK_DADDR_T) tsk_getu32(fs->endian, ext2fs->grp_buf->bg_inode_bitmap);
-    }
-
-    if (addr > fs->last_block) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
-        tsk_error_set_errstr
-            ("ext2fs_imap_load: Block too large for image: %" PRIu64, addr);
-        return 1;
-    }
-
     cnt = tsk_fs_read(fs, addr * fs->block_size, 
         (char *) ext2fs->imap_buf, ext2fs->fs_info.block_size);
 
@@ -420,6 +540,8 @@ static uint8_t
         }
         tsk_error_set_errstr2("ext2fs_imap_load: Inode bitmap %"
             PRI_EXT2GRP " at %" PRIu64, grp_num, addr);
+        // the buffer no longer holds the bitmap of imap_grp_num
+        ext2fs->imap_grp_num = 0xffffffff;
         return 1;
     }
 
@@ -431,6 +553,36 @@ static uint8_t
     return 0;
 }
 
+/* ext2fs_map_isset - test a bit in the block (a_inode == 0) or inode
+ * (a_inode == 1) bitmap of a group
+ *
+ * return -1 on error, 1 if the bit is set and 0 if not
+ * */
+static int
+ext2fs_map_isset(EXT2FS_INFO * ext2fs, uint8_t a_inode,
+    EXT2_GRPNUM_T grp_num, TSK_DADDR_T a_bit)
+{
+    const uint8_t *map;
+    int ret;
+
+    if (ext2fs_map_get(ext2fs, a_inode, grp_num, &map))
+        return -1;
+    if (map != NULL)
+        return isset(map, a_bit) ? 1 : 0;
+
+    // the per-group cache is full, use the single group buffers
+    tsk_take_lock(&ext2fs->lock);
+    if (a_inode ? ext2fs_imap_load(ext2fs, grp_num) :
+        ext2fs_bmap_load(ext2fs, grp_num)) {
+        tsk_release_lock(&ext2fs->lock);
+        return -1;
+    }
+    ret = isset(a_inode ? ext2fs->imap_buf : ext2fs->bmap_buf, a_bit) ?
+        1 : 0;
+    tsk_release_lock(&ext2fs->lock);
+    return ret;
+}
+
 /* ext2fs_dinode_load - look up disk inode & load into ext2fs_inode structure
  * @param ext2fs A ext2fs file system information structure
  * @param dino_inum Metadata address
@@ -439,7 +591,7 @@ static uint8_t
  * return 1 on error and 0 on success
  * */
 
-static uint8_t
+uint8_t
 ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
     ext2fs_inode * dino_buf)
 {
@@ -447,6 +599,7 @@ ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
     TSK_OFF_T addr;
     ssize_t cnt;
     TSK_INUM_T rel_inum;
+    TSK_DADDR_T itab_addr;
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
 
     /*
@@ -474,11 +627,7 @@ ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
     grp_num = (EXT2_GRPNUM_T) ((dino_inum - fs->first_inum) /
         tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group));
 
-    /* lock access to grp_buf */
-    tsk_take_lock(&ext2fs->lock);
-
-    if (ext2fs_group_load(ext2fs, grp_num)) {
-        tsk_release_lock(&ext2fs->lock);
+    if (ext2fs_group_addrs(ext2fs, grp_num, NULL, NULL, &itab_addr)) {
         return 1;
     }
 
@@ -488,37 +637,19 @@ ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
     rel_inum =
         (dino_inum - 1) - tsk_getu32(fs->endian,
         ext2fs->fs->s_inodes_per_group) * grp_num;
-    if (ext2fs->ext4_grp_buf != NULL) {
-#ifdef Ext4_DBG
-        printf("DEBUG: d_inode_load 64bit gd_size=%d\n",
-            tsk_getu16(fs->endian, ext2fs->fs->s_desc_size));
-#endif
-        /* Test for possible overflow */
-        if ((TSK_OFF_T)ext4_getu64(fs->endian, ext2fs->ext4_grp_buf->bg_inode_table_hi, ext2fs->ext4_grp_buf->bg_inode_table_lo) 
-                >= LLONG_MAX / fs->block_size) {
-            tsk_release_lock(&ext2fs->lock);
 
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_READ);
-            tsk_error_set_errstr
+    /* Test for possible overflow */
+    if ((TSK_OFF_T) itab_addr >= LLONG_MAX / fs->block_size) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_READ);
+        tsk_error_set_errstr
             ("ext2fs_dinode_load: Overflow when calculating address");
-            return 1;
-        }
-
-        addr =
-            (TSK_OFF_T) ext4_getu64(fs->endian,
-            ext2fs->ext4_grp_buf->bg_inode_table_hi,
-            ext2fs->ext4_grp_buf->bg_inode_table_lo)
-            * (TSK_OFF_T) fs->block_size +
-            rel_inum * (TSK_OFF_T) ext2fs->inode_size;
-    }
-    else {
-        addr =
-            (TSK_OFF_T) tsk_getu32(fs->endian,
-            ext2fs->grp_buf->bg_inode_table) * (TSK_OFF_T) fs->block_size +
-            rel_inum * (TSK_OFF_T) ext2fs->inode_size;
+        return 1;
     }
-    tsk_release_lock(&ext2fs->lock);
+
+    addr =
+        (TSK_OFF_T) itab_addr * (TSK_OFF_T) fs->block_size +
+        rel_inum * (TSK_OFF_T) ext2fs->inode_size;
 
     cnt = tsk_fs_read(fs, addr, (char *) dino_buf, ext2fs->inode_size);
 
@@ -571,6 +702,7 @@ ext2fs_dinode_copy(EXT2FS_INFO * ext2fs, TSK_FS_META * fs_meta,
     ext2fs_sb *sb = ext2fs->fs;
     EXT2_GRPNUM_T grp_num;
     TSK_INUM_T ibase = 0;
+    int is_set;
 
 
     if (dino_buf == NULL) {
@@ -813,13 +945,6 @@ ext2fs_dinode_copy(EXT2FS_INFO * ext2fs, TSK_FS_META * fs_meta,
         tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group));
 
 
-    tsk_take_lock(&ext2fs->lock);
-
-    if (ext2fs_imap_load(ext2fs, grp_num)) {
-        tsk_release_lock(&ext2fs->lock);
-        return 1;
-    }
-
     ibase =
         grp_num * tsk_getu32(fs->endian,
         ext2fs->fs->s_inodes_per_group) + fs->first_inum;
@@ -827,11 +952,11 @@ ext2fs_dinode_copy(EXT2FS_INFO * ext2fs, TSK_FS_META * fs_meta,
     /*
      * Apply the allocated/unallocated restriction.
      */
-    fs_meta->flags = (isset(ext2fs->imap_buf, inum - ibase) ?
+    if ((is_set = ext2fs_map_isset(ext2fs, 1, grp_num, inum - ibase)) < 0)
+        return 1;
+    fs_meta->flags = (is_set ?
         TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-    tsk_release_lock(&ext2fs->lock);
-
 
     /*
      * Apply the used/unused restriction.
@@ -904,6 +1029,136 @@ ext2fs_inode_lookup(TSK_FS_INFO * fs, TSK_FS_FILE * a_fs_file,
 
 
 
+/* ext2fs_itable_used - number of inodes at the start of a group's inode
+ * table that can be in use.  This is based on the EXT4_BG_INODE_UNINIT
+ * flag and bg_itable_unused, which are only maintained when the file system
+ * has group descriptor checksums.
+ *
+ * Note: This routine does not need &ext2fs->lock.
+ *
+ * return the number of inodes (all of them if it is not known)
+ * */
+static uint32_t
+ext2fs_itable_used(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) ext2fs;
+    uint32_t ipg = tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group);
+    ext4fs_gd *gd;
+    uint32_t unused;
+
+    if ((grp_num >= ext2fs->grp_descs_count)
+        || ((EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                    EXT2FS_FEATURE_RO_COMPAT_GDT_CSUM) == 0)
+            && (EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                    EXT4FS_FEATURE_RO_COMPAT_METADATA_CSUM) == 0)))
+        return ipg;
+
+    // the flags and the low half of bg_itable_unused are at the same
+    // place in the 32-byte ext2fs_gd (in its f1 field)
+    gd = (ext4fs_gd *) & ext2fs->grp_descs[grp_num * ext2fs->grp_desc_size];
+    if (EXT4BG_HAS_FLAG(fs, gd, EXT4_BG_INODE_UNINIT))
+        return 0;
+
+    unused = tsk_getu16(fs->endian, gd->bg_itable_unused_lo);
+    if (ext2fs->grp_desc_64)
+        unused |= (uint32_t) tsk_getu16(fs->endian,
+            gd->bg_itable_unused_hi) << 16;
+    if (unused > ipg)
+        return ipg;
+    return ipg - unused;
+}
+
+/* Maximum number of bytes of inode table that ext2fs_inode_walk reads at once */
+#define EXT2FS_ITABLE_READ_MAX (1024 * 1024)
+
+/* Buffer with a part of the inode tables, used by ext2fs_inode_walk */
+typedef struct {
+    char *buf;                  ///< EXT2FS_ITABLE_READ_MAX bytes
+    TSK_OFF_T off;              ///< Byte offset of buf in the file system
+    size_t len;                 ///< Number of valid bytes in buf
+    TSK_INUM_T last_inum;       ///< Last inode that the walk will need
+    uint8_t used_only;          ///< 1 to not read the unused part of the inode tables
+} EXT2FS_ITABLE_BUF;
+
+/* ext2fs_itable_load - copy a disk inode out of the inode table buffer,
+ * refilling the buffer with the inode tables that follow when the inode is
+ * not in it.  With flex_bg the inode tables of several groups are next to
+ * each other, so one read can cover more than one group.
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ext2fs_itable_load(EXT2FS_INFO * ext2fs, EXT2FS_ITABLE_BUF * a_itbuf,
+    TSK_INUM_T a_inum, ext2fs_inode * dino_buf)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
+    uint32_t ipg = tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group);
+    EXT2_GRPNUM_T grp_num = (EXT2_GRPNUM_T) ((a_inum - 1) / ipg);
+    EXT2_GRPNUM_T last_grp = (EXT2_GRPNUM_T) ((a_itbuf->last_inum - 1) / ipg);
+    TSK_DADDR_T itab_addr, next_itab;
+    TSK_OFF_T addr, end;
+    uint32_t used;
+    ssize_t cnt;
+
+    if ((a_inum < fs->first_inum) || (a_inum > fs->last_inum - 1)
+        || (ext2fs_group_addrs(ext2fs, grp_num, NULL, NULL, &itab_addr))
+        || ((TSK_OFF_T) itab_addr >= LLONG_MAX / fs->block_size)) {
+        // let the single inode version report the error
+        tsk_error_reset();
+        return ext2fs_dinode_load(ext2fs, a_inum, dino_buf);
+    }
+
+    addr = (TSK_OFF_T) itab_addr * fs->block_size +
+        (TSK_OFF_T) (a_inum - 1 - (TSK_INUM_T) grp_num * ipg) *
+        ext2fs->inode_size;
+
+    if ((addr < a_itbuf->off)
+        || (addr + ext2fs->inode_size > a_itbuf->off + (TSK_OFF_T) a_itbuf->len)) {
+
+        /* Figure out how much of the following inode tables we want */
+        used = a_itbuf->used_only ? ext2fs_itable_used(ext2fs, grp_num) : ipg;
+        end = (TSK_OFF_T) itab_addr * fs->block_size +
+            (TSK_OFF_T) used * ext2fs->inode_size;
+        while ((end - addr < EXT2FS_ITABLE_READ_MAX) && (used == ipg)
+            && (grp_num < last_grp)
+            && (ext2fs_group_addrs(ext2fs, grp_num + 1, NULL, NULL,
+                    &next_itab) == 0)
+            && (next_itab == itab_addr + INODE_TABLE_SIZE(ext2fs))) {
+            grp_num++;
+            itab_addr = next_itab;
+            used = a_itbuf->used_only ? ext2fs_itable_used(ext2fs,
+                grp_num) : ipg;
+            end = (TSK_OFF_T) itab_addr * fs->block_size +
+                (TSK_OFF_T) used * ext2fs->inode_size;
+        }
+        tsk_error_reset();
+        if (grp_num == last_grp) {
+            TSK_OFF_T last_end = (TSK_OFF_T) itab_addr * fs->block_size +
+                (TSK_OFF_T) (a_itbuf->last_inum - (TSK_INUM_T) grp_num * ipg) *
+                ext2fs->inode_size;
+            if (last_end < end)
+                end = last_end;
+        }
+        if (end - addr > EXT2FS_ITABLE_READ_MAX)
+            end = addr + EXT2FS_ITABLE_READ_MAX;
+        if (end < addr + ext2fs->inode_size)
+            end = addr + ext2fs->inode_size;
+
+        a_itbuf->off = addr;
+        a_itbuf->len = 0;
+        cnt = tsk_fs_read(fs, addr, a_itbuf->buf, (size_t) (end - addr));
+        if (cnt < ext2fs->inode_size) {
+            // let the single inode version report the error
+            tsk_error_reset();
+            return ext2fs_dinode_load(ext2fs, a_inum, dino_buf);
+        }
+        a_itbuf->len = (size_t) cnt;
+    }
+
+    memcpy(dino_buf, &a_itbuf->buf[addr - a_itbuf->off], ext2fs->inode_size);
+    return 0;
+}
+
 /* ext2fs_inode_walk - inode iterator
  *
  * flags used: TSK_FS_META_FLAG_USED, TSK_FS_META_FLAG_UNUSED,
@@ -924,8 +1179,11 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     TSK_INUM_T ibase = 0;
     TSK_FS_FILE *fs_file;
     unsigned int myflags;
+    int is_set;
     ext2fs_inode *dino_buf = NULL;
     unsigned int size = 0;
+    uint32_t ipg = tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group);
+    EXT2FS_ITABLE_BUF itbuf;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -1010,6 +1268,17 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         return 1;
     }
 
+    /* The inode tables are read in large chunks instead of one inode
+     * at a time */
+    memset(&itbuf, 0, sizeof(itbuf));
+    itbuf.last_inum = end_inum_tmp;
+    itbuf.used_only = (flags & TSK_FS_META_FLAG_UNALLOC) ? 0 : 1;
+    if ((itbuf.buf = (char *) tsk_malloc(EXT2FS_ITABLE_READ_MAX)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        free(dino_buf);
+        return 1;
+    }
+
     for (inum = start_inum; inum <= end_inum_tmp; inum++) {
         int retval;
         EXT2_GRPNUM_T grp_num;
@@ -1018,36 +1287,38 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
          * Be sure to use the proper group descriptor data. XXX Linux inodes
          * start at 1, as in Fortran.
          */
-        grp_num =
-            (EXT2_GRPNUM_T) ((inum - 1) / tsk_getu32(fs->endian,
-                ext2fs->fs->s_inodes_per_group));
+        grp_num = (EXT2_GRPNUM_T) ((inum - 1) / ipg);
 
-        /* lock access to imap_buf */
-        tsk_take_lock(&ext2fs->lock);
+        ibase = grp_num * ipg + 1;
 
-        if (ext2fs_imap_load(ext2fs, grp_num)) {
-            tsk_release_lock(&ext2fs->lock);
-            free(dino_buf);
-            return 1;
+        /* If only allocated inodes are wanted, skip the groups (and the
+         * ends of groups) whose inodes have never been used */
+        if ((itbuf.used_only) &&
+            (inum - ibase >= ext2fs_itable_used(ext2fs, grp_num))) {
+            inum = ibase + ipg - 1;
+            continue;
         }
-        ibase =
-            grp_num * tsk_getu32(fs->endian,
-            ext2fs->fs->s_inodes_per_group) + 1;
 
         /*
          * Apply the allocated/unallocated restriction.
          */
-        myflags = (isset(ext2fs->imap_buf, inum - ibase) ?
+        if ((is_set = ext2fs_map_isset(ext2fs, 1, grp_num,
+                    inum - ibase)) < 0) {
+            tsk_fs_file_close(fs_file);
+            free(dino_buf);
+            free(itbuf.buf);
+            return 1;
+        }
+        myflags = (is_set ?
             TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-        tsk_release_lock(&ext2fs->lock);
-
         if ((flags & myflags) != myflags)
             continue;
 
-        if (ext2fs_dinode_load(ext2fs, inum, dino_buf)) {
+        if (ext2fs_itable_load(ext2fs, &itbuf, inum, dino_buf)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
 
@@ -1078,6 +1349,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (ext2fs_dinode_copy(ext2fs, fs_file->meta, inum, dino_buf)) {
             tsk_fs_meta_close(fs_file->meta);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
 
@@ -1085,11 +1357,13 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
     }
@@ -1103,6 +1377,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
         /* call action */
@@ -1110,11 +1385,13 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
     }
@@ -1124,6 +1401,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
      */
     tsk_fs_file_close(fs_file);
     free(dino_buf);
+    free(itbuf.buf);
 
     return 0;
 }
@@ -1138,6 +1416,8 @@ ext2fs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
     EXT2_GRPNUM_T grp_num;
     TSK_DADDR_T dbase = 0;      /* first block number in group */
     TSK_DADDR_T dmin = 0;       /* first block after inodes */
+    TSK_DADDR_T bmap_addr, imap_addr, itab_addr;
+    int is_set;
 
     // these blocks are not described in the group descriptors
     // sparse
@@ -1148,12 +1428,8 @@ ext2fs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
 
     grp_num = ext2_dtog_lcl(a_fs, ext2fs->fs, a_addr);
 
-    /* lock access to bmap_buf */
-    tsk_take_lock(&ext2fs->lock);
-
-    /* Lookup bitmap if not loaded */
-    if (ext2fs_bmap_load(ext2fs, grp_num)) {
-        tsk_release_lock(&ext2fs->lock);
+    if (ext2fs_group_addrs(ext2fs, grp_num, &bmap_addr, &imap_addr,
+            &itab_addr)) {
         return 0;
     }
 
@@ -1166,7 +1442,10 @@ ext2fs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
      * s_first_data_block field.
      */
     dbase = ext2_cgbase_lcl(a_fs, ext2fs->fs, grp_num);
-    flags = (isset(ext2fs->bmap_buf, a_addr - dbase) ?
+    if ((is_set = ext2fs_map_isset(ext2fs, 0, grp_num, a_addr - dbase)) < 0) {
+        return 0;
+    }
+    flags = (is_set ?
         TSK_FS_BLOCK_FLAG_ALLOC : TSK_FS_BLOCK_FLAG_UNALLOC);
     
     /*
@@ -1186,54 +1465,149 @@ ext2fs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
      * locations of superblocks and group descriptor blocks are reserved.
      * They just happen to be reserved for something else :-)
      */
+    dmin = itab_addr + INODE_TABLE_SIZE(ext2fs);
 
-    if (ext2fs->ext4_grp_buf != NULL) {
-        dmin = ext4_getu64(a_fs->endian, ext2fs->ext4_grp_buf->bg_inode_table_hi,
-                    ext2fs->ext4_grp_buf->bg_inode_table_lo) + + INODE_TABLE_SIZE(ext2fs);
+    if ((a_addr >= dbase && a_addr < bmap_addr)
+        || (a_addr == bmap_addr)
+        || (a_addr == imap_addr)
+        || (a_addr >= itab_addr && a_addr < dmin))
+        flags |= TSK_FS_BLOCK_FLAG_META;
+    else
+        flags |= TSK_FS_BLOCK_FLAG_CONT;
 
-        if ((a_addr >= dbase
-                && a_addr < ext4_getu64(a_fs->endian, 
-                ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
-                ext2fs->ext4_grp_buf->bg_block_bitmap_lo))
-            || (a_addr == ext4_getu64(a_fs->endian, 
-                ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
-                ext2fs->ext4_grp_buf->bg_block_bitmap_lo))
-            || (a_addr == ext4_getu64(a_fs->endian, 
-                ext2fs->ext4_grp_buf->bg_inode_bitmap_hi,
-                ext2fs->ext4_grp_buf->bg_inode_bitmap_lo))
-            || (a_addr >= ext4_getu64(a_fs->endian, 
-                ext2fs->ext4_grp_buf->bg_inode_table_hi,
-                ext2fs->ext4_grp_buf->bg_inode_table_lo)
-                && a_addr < dmin))
-            flags |= TSK_FS_BLOCK_FLAG_META;
-        else
-            flags |= TSK_FS_BLOCK_FLAG_CONT;
+    return (TSK_FS_BLOCK_FLAG_ENUM)flags;
+}
+
+
+/* Report a run to the callback of ext2fs_block_run_walk and return from
+ * the walk if the callback wants to stop */
+#define EXT2FS_RUN_ACTION(addr, len, flags) \
+    do { \
+        TSK_WALK_RET_ENUM run_ret = a_action(a_fs, (addr), (len), \
+            (TSK_FS_BLOCK_FLAG_ENUM) (flags), a_ptr); \
+        if (run_ret != TSK_WALK_CONT) { \
+            free(bmap); \
+            return (run_ret == TSK_WALK_ERROR) ? 1 : 0; \
+        } \
+    } while (0)
 
+/* ext2fs_block_run_walk - report runs of blocks with the same flags
+ *
+ * The runs are computed from each group's block bitmap and the
+ * locations of the group's bitmaps and inode table, using the same rules
+ * as ext2fs_block_getflags().
+ *
+ * Return 1 on error and 0 on success
+ */
+static uint8_t
+ext2fs_block_run_walk(TSK_FS_INFO * a_fs, TSK_DADDR_T a_start_blk,
+    TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr)
+{
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) a_fs;
+    uint32_t blocks_per_group =
+        tsk_getu32(a_fs->endian, ext2fs->fs->s_blocks_per_group);
+    uint8_t *bmap = NULL;
+    TSK_DADDR_T addr = a_start_blk;
+
+    // these blocks are not described in the group descriptors
+    if ((addr == 0) && (addr <= a_end_blk)) {
+        EXT2FS_RUN_ACTION(0, 1,
+            TSK_FS_BLOCK_FLAG_CONT | TSK_FS_BLOCK_FLAG_ALLOC);
+        addr = 1;
     }
-    else {
-        dmin =
-            tsk_getu32(a_fs->endian,
-            ext2fs->grp_buf->bg_inode_table) + INODE_TABLE_SIZE(ext2fs);
-
-        if ((a_addr >= dbase
-                && a_addr < tsk_getu32(a_fs->endian,
-                    ext2fs->grp_buf->bg_block_bitmap))
-            || (a_addr == tsk_getu32(a_fs->endian,
-                    ext2fs->grp_buf->bg_block_bitmap))
-            || (a_addr == tsk_getu32(a_fs->endian,
-                    ext2fs->grp_buf->bg_inode_bitmap))
-            || (a_addr >= tsk_getu32(a_fs->endian,
-                    ext2fs->grp_buf->bg_inode_table)
-                && a_addr < dmin))
-            flags |= TSK_FS_BLOCK_FLAG_META;
-        else
-            flags |= TSK_FS_BLOCK_FLAG_CONT;
+    if ((addr < ext2fs->first_data_block) && (addr <= a_end_blk)) {
+        TSK_DADDR_T end = ext2fs->first_data_block - 1;
+        if (end > a_end_blk)
+            end = a_end_blk;
+        EXT2FS_RUN_ACTION(addr, end - addr + 1,
+            TSK_FS_BLOCK_FLAG_META | TSK_FS_BLOCK_FLAG_ALLOC);
+        addr = end + 1;
     }
-    
-    tsk_release_lock(&ext2fs->lock);
-    return (TSK_FS_BLOCK_FLAG_ENUM)flags;
+
+    if ((bmap = (uint8_t *) tsk_malloc(a_fs->block_size)) == NULL)
+        return 1;
+
+    while (addr <= a_end_blk) {
+        EXT2_GRPNUM_T grp_num = ext2_dtog_lcl(a_fs, ext2fs->fs, addr);
+        TSK_DADDR_T dbase = ext2_cgbase_lcl(a_fs, ext2fs->fs, grp_num);
+        TSK_DADDR_T gend = dbase + blocks_per_group - 1;
+        TSK_DADDR_T bmap_addr, imap_addr, itab_addr, dmin;
+        TSK_DADDR_T bounds[7];
+        const uint8_t *map;
+
+        if (gend > a_end_blk)
+            gend = a_end_blk;
+
+        map = NULL;
+        if ((ext2fs_group_addrs(ext2fs, grp_num, &bmap_addr, &imap_addr,
+                    &itab_addr) == 0)
+            && (ext2fs_map_get(ext2fs, 0, grp_num, &map) == 0)
+            && (map == NULL)) {
+            /* the per-group cache is full, so copy the bitmap out of the
+             * shared buffer so that the callback is not called with the
+             * lock held */
+            tsk_take_lock(&ext2fs->lock);
+            if (ext2fs_bmap_load(ext2fs, grp_num) == 0) {
+                memcpy(bmap, ext2fs->bmap_buf, a_fs->block_size);
+                map = bmap;
+            }
+            tsk_release_lock(&ext2fs->lock);
+        }
+        if (map == NULL) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "ext2fs_block_run_walk: error loading bitmap of group %"
+                    PRI_EXT2GRP "\n", grp_num);
+            tsk_error_reset();
+            // same as ext2fs_block_getflags()
+            EXT2FS_RUN_ACTION(addr, gend - addr + 1, 0);
+            addr = gend + 1;
+            continue;
+        }
+        dmin = itab_addr + INODE_TABLE_SIZE(ext2fs);
+
+        /* The meta status can only change at these addresses */
+        bounds[0] = dbase;
+        bounds[1] = bmap_addr;
+        bounds[2] = bmap_addr + 1;
+        bounds[3] = imap_addr;
+        bounds[4] = imap_addr + 1;
+        bounds[5] = itab_addr;
+        bounds[6] = dmin;
+
+        while (addr <= gend) {
+            TSK_DADDR_T seg_end = gend, run_end;
+            int is_meta, is_alloc, i;
+            uint64_t bit;
+
+            for (i = 0; i < 7; i++) {
+                if ((bounds[i] > addr) && (bounds[i] - 1 < seg_end))
+                    seg_end = bounds[i] - 1;
+            }
+            is_meta = ((addr >= dbase && addr < bmap_addr)
+                || (addr == bmap_addr) || (addr == imap_addr)
+                || (addr >= itab_addr && addr < dmin));
+
+            bit = addr - dbase;
+            is_alloc = isset(map, bit) ? 1 : 0;
+            run_end = dbase + tsk_fs_bitmap_find(map, bit,
+                seg_end - dbase + 1, (uint8_t) ! is_alloc, 0) - 1;
+
+            EXT2FS_RUN_ACTION(addr, run_end - addr + 1,
+                (is_alloc ? TSK_FS_BLOCK_FLAG_ALLOC :
+                    TSK_FS_BLOCK_FLAG_UNALLOC) |
+                (is_meta ? TSK_FS_BLOCK_FLAG_META :
+                    TSK_FS_BLOCK_FLAG_CONT));
+            addr = run_end + 1;
+        }
+    }
+
+    free(bmap);
+    return 0;
 }
 
+#undef EXT2FS_RUN_ACTION
+
 
 /* ext2fs_block_walk - block iterator
  *
@@ -1249,8 +1623,6 @@ ext2fs_block_walk(TSK_FS_INFO * a_fs, TSK_DADDR_T a_start_blk,
     TSK_FS_BLOCK_WALK_CB a_action, void *a_ptr)
 {
     char *myname = "extXfs_block_walk";
-    TSK_FS_BLOCK *fs_block;
-    TSK_DADDR_T addr;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -1274,74 +1646,14 @@ ext2fs_block_walk(TSK_FS_INFO * a_fs, TSK_DADDR_T a_start_blk,
         return 1;
     }
 
-    /* Sanity check on a_flags -- make sure at least one ALLOC is set */
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_ALLOC |
-            TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
-    }
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_META) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_CONT | TSK_FS_BLOCK_WALK_FLAG_META);
-    }
-
-
-    if ((fs_block = tsk_fs_block_alloc(a_fs)) == NULL) {
-        return 1;
-    }
-
-    /*
-     * Iterate. This is not as tricky as it could be, because the free list
-     * map covers the entire disk partition, including blocks occupied by
-     * group descriptor blocks, bit maps, and other non-data blocks.
-     */
-    for (addr = a_start_blk; addr <= a_end_blk; addr++) {
-        int retval;
-        int myflags;
-
-        myflags = ext2fs_block_getflags(a_fs, addr);
-
-        // test if we should call the callback with this one
-        if ((myflags & TSK_FS_BLOCK_FLAG_META)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_META)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_CONT)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_ALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
-            continue;
-
-        if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-            myflags |= TSK_FS_BLOCK_FLAG_AONLY;
-
-        if (tsk_fs_block_get_flag(a_fs, fs_block, addr, myflags) == NULL) {
-            tsk_error_set_errstr2("ext2fs_block_walk: block %" PRIuDADDR,
-                addr);
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-
-        retval = a_action(fs_block, a_ptr);
-        if (retval == TSK_WALK_STOP) {
-            break;
-        }
-        else if (retval == TSK_WALK_ERROR) {
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-    }
-
     /*
-     * Cleanup.
+     * Iterate over the runs of blocks with the same flags.  This is not
+     * as tricky as it could be, because the free list map covers the
+     * entire disk partition, including blocks occupied by group
+     * descriptor blocks, bit maps, and other non-data blocks.
      */
-    tsk_fs_block_free(fs_block);
-    return 0;
+    return tsk_fs_block_walk_runs(a_fs, a_start_blk, a_end_blk, a_flags,
+        a_action, a_ptr, "ext2fs_block_walk");
 }
 
 static uint8_t
@@ -1354,50 +1666,67 @@ ext2fs_fscheck(TSK_FS_INFO * fs, FILE * hFile)
 }
 
 /** \internal
- * Add a single extent -- that is, a single data ran -- to the file data attribute.
+ * Add a leaf extent to a decoded extent tree.
  * @return 0 on success, 1 on error.
  */
-static TSK_OFF_T
-ext2fs_make_data_run_extent(TSK_FS_INFO * fs_info, TSK_FS_ATTR * fs_attr,
-    ext2fs_extent * extent)
+static uint8_t
+ext2fs_extent_map_add(TSK_FS_INFO * fs_info, EXT2FS_EXTENT_MAP * a_map,
+    const ext2fs_extent * extent)
 {
-    TSK_FS_ATTR_RUN *data_run;
-    data_run = tsk_fs_attr_run_alloc();
-    if (data_run == NULL) {
-        return 1;
+    EXT2FS_EXTENT *ext;
+
+    if (a_map->extent_cnt == a_map->extent_alloc) {
+        size_t alloc = a_map->extent_alloc ? a_map->extent_alloc * 2 : 16;
+        EXT2FS_EXTENT *tmp = (EXT2FS_EXTENT *) tsk_realloc(a_map->extents,
+            alloc * sizeof(EXT2FS_EXTENT));
+        if (tmp == NULL)
+            return 1;
+        a_map->extents = tmp;
+        a_map->extent_alloc = alloc;
     }
 
-    data_run->offset = tsk_getu32(fs_info->endian, extent->ee_block);
-    data_run->addr =
+    ext = &a_map->extents[a_map->extent_cnt];
+    ext->lblk = tsk_getu32(fs_info->endian, extent->ee_block);
+    ext->pblk =
         (((uint32_t) tsk_getu16(fs_info->endian,
                 extent->ee_start_hi)) << 16) | tsk_getu32(fs_info->endian,
         extent->ee_start_lo);
-    data_run->len = tsk_getu16(fs_info->endian, extent->ee_len);
+    ext->len = tsk_getu16(fs_info->endian, extent->ee_len);
 
-    // save the run
-    if (tsk_fs_attr_add_run(fs_info, fs_attr, data_run)) {
-        return 1;
+    if ((a_map->extent_cnt > 0) && (a_map->sorted)) {
+        const EXT2FS_EXTENT *prev = &a_map->extents[a_map->extent_cnt - 1];
+        if ((TSK_DADDR_T) prev->lblk + prev->len > ext->lblk)
+            a_map->sorted = 0;
     }
-
+    a_map->extent_cnt++;
     return 0;
 }
 
 
 /** \internal
  * Given a block that contains an extent node (which starts with extent_header),
- * walk it, and add everything encountered to the appropriate attributes.
+ * decode it and everything below it into a_map.
  * @return 0 on success, 1 on error.
  */
-static TSK_OFF_T
-ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
-    TSK_FS_ATTR * fs_attr, TSK_FS_ATTR * fs_attr_extent,
-    TSK_DADDR_T idx_block)
+static uint8_t
+ext2fs_extent_map_decode_block(TSK_FS_INFO * fs_info,
+    EXT2FS_EXTENT_MAP * a_map, TSK_DADDR_T idx_block, int a_level)
 {
     ext2fs_extent_header *header;
-    TSK_FS_ATTR_RUN *data_run;
     uint8_t *buf;
     ssize_t cnt;
     unsigned int i;
+    unsigned int num_entries;
+
+    /* the tree has at most 5 levels, so anything deeper is a loop */
+    if (a_level > EXT2FS_EXTENT_MAX_DEPTH) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+            ("ext2fs_extent_map_decode_block: extent tree is too deep (block %"
+            PRIuDADDR ")", idx_block);
+        return 1;
+    }
 
     /* first, read the block specified by the parameter */
     int fs_blocksize = fs_info->block_size;
@@ -1412,43 +1741,47 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_FS_READ);
         }
-        tsk_error_set_errstr("ext2fs_make_data_run_extent_index: Block %"
+        tsk_error_set_errstr("ext2fs_extent_map_decode_block: Block %"
             PRIuDADDR, idx_block);
         free(buf);
         return 1;
     }
     header = (ext2fs_extent_header *) buf;
 
-    /* add it to the extent attribute */
     if (tsk_getu16(fs_info->endian, header->eh_magic) != 0xF30A) {
         tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
         tsk_error_set_errstr
-            ("ext2fs_make_data_run_extent_index: extent header magic valid incorrect!");
+            ("ext2fs_extent_map_decode_block: extent header magic valid incorrect!");
         free(buf);
         return 1;
     }
 
-    data_run = tsk_fs_attr_run_alloc();
-    if (data_run == NULL) {
-        free(buf);
-        return 1;
+    /* save the block for the extent attribute */
+    if (a_map->block_cnt == a_map->block_alloc) {
+        size_t alloc = a_map->block_alloc ? a_map->block_alloc * 2 : 8;
+        TSK_DADDR_T *tmp = (TSK_DADDR_T *) tsk_realloc(a_map->blocks,
+            alloc * sizeof(TSK_DADDR_T));
+        if (tmp == NULL) {
+            free(buf);
+            return 1;
+        }
+        a_map->blocks = tmp;
+        a_map->block_alloc = alloc;
     }
-    data_run->addr = idx_block;
-    data_run->len = fs_blocksize;
+    a_map->blocks[a_map->block_cnt++] = idx_block;
 
-    if (tsk_fs_attr_add_run(fs_info, fs_attr_extent, data_run)) {
-        tsk_fs_attr_run_free(data_run);
-        free(buf);
-        return 1;
-    }
+    /* do not trust the entry count to stay inside of the block */
+    num_entries = tsk_getu16(fs_info->endian, header->eh_entries);
+    if (num_entries > (fs_blocksize - sizeof(ext2fs_extent_header)) /
+        sizeof(ext2fs_extent))
+        num_entries = (fs_blocksize - sizeof(ext2fs_extent_header)) /
+            sizeof(ext2fs_extent);
 
     /* process leaf nodes */
     if (tsk_getu16(fs_info->endian, header->eh_depth) == 0) {
         ext2fs_extent *extents = (ext2fs_extent *) (header + 1);
-        for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries);
-            i++) {
-            ext2fs_extent extent = extents[i];
-            if (ext2fs_make_data_run_extent(fs_info, fs_attr, &extent)) {
+        for (i = 0; i < num_entries; i++) {
+            if (ext2fs_extent_map_add(fs_info, a_map, &extents[i])) {
                 free(buf);
                 return 1;
             }
@@ -1457,15 +1790,14 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
     /* recurse on interior nodes */
     else {
         ext2fs_extent_idx *indices = (ext2fs_extent_idx *) (header + 1);
-        for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries);
-            i++) {
+        for (i = 0; i < num_entries; i++) {
             ext2fs_extent_idx *index = &indices[i];
             TSK_DADDR_T child_block =
                 (((uint32_t) tsk_getu16(fs_info->endian,
                         index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
                 endian, index->ei_leaf_lo);
-            if (ext2fs_make_data_run_extent_index(fs_info, fs_attr,
-                    fs_attr_extent, child_block)) {
+            if (ext2fs_extent_map_decode_block(fs_info, a_map,
+                    child_block, a_level + 1)) {
                 free(buf);
                 return 1;
             }
@@ -1476,69 +1808,207 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
     return 0;
 }
 
+
+/** \internal
+ * Release a map that was returned by ext2fs_extent_map_get().
+ */
+static void
+ext2fs_extent_map_release(EXT2FS_INFO * ext2fs, EXT2FS_EXTENT_MAP * a_map)
+{
+    uint8_t do_free;
+
+    tsk_take_lock(&ext2fs->extent_cache_lock);
+    a_map->refs--;
+    do_free = ((a_map->refs == 0) && (a_map->cached == 0)) ? 1 : 0;
+    tsk_release_lock(&ext2fs->extent_cache_lock);
+
+    if (do_free) {
+        free(a_map->extents);
+        free(a_map->blocks);
+        free(a_map);
+    }
+}
+
+
 /** \internal
- * Get the number of extent blocks rooted at the given extent_header.
- * The count does not include the extent header passed as a parameter.
+ * Get the decoded extent tree of a file.  Trees that are stored in the
+ * inode are decoded every time.  Trees with index blocks are kept in a
+ * small cache so that opening the same file again does not need to read
+ * and parse the tree blocks again.
  *
- * @return the number of extent blocks, or -1 on error.
+ * @param fs_file File to get the extent tree of
+ * @returns NULL on error.  The map must be released with ext2fs_extent_map_release().
  */
-static int32_t
-ext2fs_extent_tree_index_count(TSK_FS_INFO * fs_info,
-    TSK_FS_META * fs_meta, ext2fs_extent_header * header)
+static EXT2FS_EXTENT_MAP *
+ext2fs_extent_map_get(TSK_FS_FILE * fs_file)
 {
-    int fs_blocksize = fs_info->block_size;
-    ext2fs_extent_idx *indices;
-    int count = 0;
-    uint8_t *buf;
+    TSK_FS_META *fs_meta = fs_file->meta;
+    TSK_FS_INFO *fs_info = fs_file->fs_info;
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs_info;
+    ext2fs_extent_header *header =
+        (ext2fs_extent_header *) fs_meta->content_ptr;
+    uint16_t num_entries = tsk_getu16(fs_info->endian, header->eh_entries);
+    uint16_t depth = tsk_getu16(fs_info->endian, header->eh_depth);
+    EXT2FS_EXTENT_MAP *map;
+    EXT2FS_EXTENT_MAP *evict = NULL;
     int i;
 
-    if (tsk_getu16(fs_info->endian, header->eh_magic) != 0xF30A) {
-        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-        tsk_error_set_errstr
-            ("ext2fs_load_attrs: extent header magic valid incorrect!");
-        return -1;
+    if (depth > 0) {
+        tsk_take_lock(&ext2fs->extent_cache_lock);
+        for (i = 0; i < EXT2FS_EXTENT_CACHE_N; i++) {
+            map = ext2fs->extent_cache[i];
+            if (map == NULL)
+                break;
+            if ((map->inum == fs_meta->addr)
+                && (memcmp(map->root, fs_meta->content_ptr,
+                        sizeof(map->root)) == 0)) {
+                // move it to the front
+                memmove(&ext2fs->extent_cache[1], &ext2fs->extent_cache[0],
+                    i * sizeof(EXT2FS_EXTENT_MAP *));
+                ext2fs->extent_cache[0] = map;
+                map->refs++;
+                tsk_release_lock(&ext2fs->extent_cache_lock);
+                return map;
+            }
+        }
+        tsk_release_lock(&ext2fs->extent_cache_lock);
     }
 
-    if (tsk_getu16(fs_info->endian, header->eh_depth) == 0) {
-        return 0;
+    if ((map = (EXT2FS_EXTENT_MAP *)
+            tsk_malloc(sizeof(EXT2FS_EXTENT_MAP))) == NULL)
+        return NULL;
+    map->inum = fs_meta->addr;
+    memcpy(map->root, fs_meta->content_ptr, sizeof(map->root));
+    map->sorted = 1;
+    map->refs = 1;
+
+    if (depth == 0) {       /* leaf node */
+        ext2fs_extent *extents = (ext2fs_extent *) (header + 1);
+        for (i = 0; i < num_entries; i++) {
+            if (ext2fs_extent_map_add(fs_info, map, &extents[i]))
+                goto on_error;
+        }
+        return map;
     }
 
-    if ((buf = (uint8_t *) tsk_malloc(fs_blocksize)) == NULL) {
-        return -1;
+    /* interior node */
+    {
+        ext2fs_extent_idx *indices = (ext2fs_extent_idx *) (header + 1);
+        for (i = 0; i < num_entries; i++) {
+            ext2fs_extent_idx *index = &indices[i];
+            TSK_DADDR_T child_block =
+                (((uint32_t) tsk_getu16(fs_info->endian,
+                        index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
+                endian, index->ei_leaf_lo);
+            if (ext2fs_extent_map_decode_block(fs_info, map, child_block,
+                    1))
+                goto on_error;
+        }
+    }
+
+    /* add it to the cache.  The least recently used map is dropped and
+     * freed now or when its last user is done with it. */
+    tsk_take_lock(&ext2fs->extent_cache_lock);
+    evict = ext2fs->extent_cache[EXT2FS_EXTENT_CACHE_N - 1];
+    memmove(&ext2fs->extent_cache[1], &ext2fs->extent_cache[0],
+        (EXT2FS_EXTENT_CACHE_N - 1) * sizeof(EXT2FS_EXTENT_MAP *));
+    ext2fs->extent_cache[0] = map;
+    map->cached = 1;
+    map->refs++;
+    if (evict) {
+        evict->cached = 0;
+        if (evict->refs > 0)
+            evict = NULL;
+    }
+    tsk_release_lock(&ext2fs->extent_cache_lock);
+
+    if (evict) {
+        free(evict->extents);
+        free(evict->blocks);
+        free(evict);
+    }
+    return map;
+
+  on_error:
+    free(map->extents);
+    free(map->blocks);
+    free(map);
+    return NULL;
+}
+
+
+/** \internal
+ * Add the runs of a decoded extent tree to the data attribute.  Sorted
+ * extents are linked into a single list (with FILLER runs for the holes)
+ * that is added at once.  Otherwise, each extent is added on its own so
+ * that out of order extents end up in the right place.
+ * @return 0 on success, 1 on error.
+ */
+static uint8_t
+ext2fs_extent_map_make_runs(TSK_FS_INFO * fs_info, TSK_FS_ATTR * fs_attr,
+    const EXT2FS_EXTENT_MAP * a_map)
+{
+    TSK_FS_ATTR_RUN *head = NULL;
+    TSK_FS_ATTR_RUN *tail = NULL;
+    TSK_DADDR_T next_off = 0;
+    size_t i;
+
+    if (a_map->extent_cnt == 0)
+        return 0;
+
+    if (a_map->sorted == 0) {
+        for (i = 0; i < a_map->extent_cnt; i++) {
+            TSK_FS_ATTR_RUN *data_run;
+            if ((data_run = tsk_fs_attr_run_alloc()) == NULL)
+                return 1;
+            data_run->offset = a_map->extents[i].lblk;
+            data_run->addr = a_map->extents[i].pblk;
+            data_run->len = a_map->extents[i].len;
+            if (tsk_fs_attr_add_run(fs_info, fs_attr, data_run))
+                return 1;
+        }
+        return 0;
     }
 
-    indices = (ext2fs_extent_idx *) (header + 1);
-    for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries); i++) {
-        ext2fs_extent_idx *index = &indices[i];
-        TSK_DADDR_T block =
-            (((uint32_t) tsk_getu16(fs_info->endian,
-                    index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
-            endian, index->ei_leaf_lo);
-        ssize_t cnt =
-            tsk_fs_read_block(fs_info, block, (char *) buf, fs_blocksize);
-        int ret;
+    for (i = 0; i < a_map->extent_cnt; i++) {
+        const EXT2FS_EXTENT *ext = &a_map->extents[i];
+        TSK_FS_ATTR_RUN *data_run;
 
-        if (cnt != fs_blocksize) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
+        if (ext->lblk > next_off) {
+            if ((data_run = tsk_fs_attr_run_alloc()) == NULL) {
+                tsk_fs_attr_run_free(head);
+                return 1;
             }
-            tsk_error_set_errstr2("ext2fs_extent_tree_index_count: Block %"
-                PRIuDADDR, block);
-            return -1;
+            data_run->offset = next_off;
+            data_run->len = ext->lblk - next_off;
+            data_run->flags = TSK_FS_ATTR_RUN_FLAG_FILLER;
+            if (tail)
+                tail->next = data_run;
+            else
+                head = data_run;
+            tail = data_run;
         }
 
-        if ((ret =
-                ext2fs_extent_tree_index_count(fs_info, fs_meta,
-                    (ext2fs_extent_header *) buf)) < 0) {
-            return -1;
+        if ((data_run = tsk_fs_attr_run_alloc()) == NULL) {
+            tsk_fs_attr_run_free(head);
+            return 1;
         }
-        count += ret;
-        count++;
+        data_run->offset = ext->lblk;
+        data_run->addr = ext->pblk;
+        data_run->len = ext->len;
+        if (tail)
+            tail->next = data_run;
+        else
+            head = data_run;
+        tail = data_run;
+        next_off = (TSK_DADDR_T) ext->lblk + ext->len;
     }
 
-    free(buf);
-    return count;
+    if (tsk_fs_attr_add_run(fs_info, fs_attr, head)) {
+        tsk_fs_attr_run_free(head);
+        return 1;
+    }
+    return 0;
 }
 
 
@@ -1553,11 +2023,11 @@ ext4_load_attrs_extents(TSK_FS_FILE *fs_file)
 {
     TSK_FS_META *fs_meta = fs_file->meta;
     TSK_FS_INFO *fs_info = fs_file->fs_info;
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs_info;
     TSK_OFF_T length = 0;
     TSK_FS_ATTR *fs_attr;
-    int i;
-    ext2fs_extent *extents = NULL;
-    ext2fs_extent_idx *indices = NULL;
+    EXT2FS_EXTENT_MAP *map;
+    size_t i;
     
     ext2fs_extent_header *header = (ext2fs_extent_header *) fs_meta->content_ptr;
     uint16_t num_entries = tsk_getu16(fs_info->endian, header->eh_entries);
@@ -1622,19 +2092,8 @@ ext4_load_attrs_extents(TSK_FS_FILE *fs_file)
             ("ext2fs_load_attr: Inode reports too many extents");
             return 1;
         }
-        
-        extents = (ext2fs_extent *) (header + 1);
-        for (i = 0; i < num_entries; i++) {
-            ext2fs_extent extent = extents[i];
-            if (ext2fs_make_data_run_extent(fs_info, fs_attr, &extent)) {
-                return 1;
-            }
-        }
     }
     else {                  /* interior node */
-        TSK_FS_ATTR *fs_attr_extent;
-        int32_t extent_index_size;
-        
         if (num_entries >
             (fs_info->block_size -
              sizeof(ext2fs_extent_header)) /
@@ -1644,42 +2103,55 @@ ext4_load_attrs_extents(TSK_FS_FILE *fs_file)
             ("ext2fs_load_attr: Inode reports too many extent indices");
             return 1;
         }
-        
+    }
+
+    if ((map = ext2fs_extent_map_get(fs_file)) == NULL) {
+        return 1;
+    }
+
+    if (ext2fs_extent_map_make_runs(fs_info, fs_attr, map)) {
+        ext2fs_extent_map_release(ext2fs, map);
+        return 1;
+    }
+
+    if (tsk_fs_attr_run_idx_build(fs_attr)) {
+        ext2fs_extent_map_release(ext2fs, map);
+        return 1;
+    }
+
+    /* the blocks of the tree itself go into their own attribute */
+    if (depth > 0) {
+        TSK_FS_ATTR *fs_attr_extent;
+
         if ((fs_attr_extent =
              tsk_fs_attrlist_getnew(fs_meta->attr,
                                     TSK_FS_ATTR_NONRES)) == NULL) {
-             return 1;
-         }
-        
-        extent_index_size =
-        ext2fs_extent_tree_index_count(fs_info, fs_meta, header);
-        if (extent_index_size < 0) {
+            ext2fs_extent_map_release(ext2fs, map);
             return 1;
         }
-        
+
         if (tsk_fs_attr_set_run(fs_file, fs_attr_extent, NULL, NULL,
                                 TSK_FS_ATTR_TYPE_UNIX_EXTENT, TSK_FS_ATTR_ID_DEFAULT,
-                                fs_info->block_size * extent_index_size,
-                                fs_info->block_size * extent_index_size,
-                                fs_info->block_size * extent_index_size, 0, 0)) {
+                                fs_info->block_size * map->block_cnt,
+                                fs_info->block_size * map->block_cnt,
+                                fs_info->block_size * map->block_cnt, 0, 0)) {
+            ext2fs_extent_map_release(ext2fs, map);
             return 1;
         }
-        
-        indices = (ext2fs_extent_idx *) (header + 1);
-        for (i = 0; i < num_entries; i++) {
-            ext2fs_extent_idx *index = &indices[i];
-            TSK_DADDR_T child_block =
-            (((uint32_t) tsk_getu16(fs_info->endian,
-                                    index->
-                                    ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
-                                                                     endian, index->ei_leaf_lo);
-            if (ext2fs_make_data_run_extent_index(fs_info, fs_attr,
-                                                  fs_attr_extent, child_block)) {
+
+        for (i = 0; i < map->block_cnt; i++) {
+            TSK_FS_ATTR_RUN *data_run;
+            if ((data_run = tsk_fs_attr_run_alloc()) == NULL) {
+                ext2fs_extent_map_release(ext2fs, map);
                 return 1;
             }
+            data_run->addr = map->blocks[i];
+            data_run->len = 1;
+            tsk_fs_attr_append_run(fs_info, fs_attr_extent, data_run);
         }
     }
-    
+
+    ext2fs_extent_map_release(ext2fs, map);
     fs_meta->attr_state = TSK_FS_META_ATTR_STUDIED;
     
     return 0;
@@ -2604,7 +3076,9 @@ ext2fs_istat(TSK_FS_INFO * fs, TSK_FS_ISTAT_FLAG_ENUM istat_flags, FILE * hFile,
     tsk_fprintf(hFile, "%sAllocated\n",
         (fs_meta->flags & TSK_FS_META_FLAG_ALLOC) ? "" : "Not ");
 
-    tsk_fprintf(hFile, "Group: %" PRIuGID "\n", ext2fs->grp_num);
+    tsk_fprintf(hFile, "Group: %" PRIuGID "\n",
+        (EXT2_GRPNUM_T) ((inum - fs->first_inum) /
+            tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group)));
 
     // Note that if this is a "virtual file", then ext2fs->dino_buf may not be set.
     tsk_fprintf(hFile, "Generation Id: %" PRIu32 "\n",
@@ -3119,16 +3593,35 @@ static void
 ext2fs_close(TSK_FS_INFO * fs)
 {
     EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs;
+    int i;
 
     fs->tag = 0;
     free(ext2fs->fs);
-    free(ext2fs->grp_buf);
-    free(ext2fs->ext4_grp_buf);
+    // grp_buf and ext4_grp_buf point into grp_descs
+    free(ext2fs->grp_descs);
+    if (ext2fs->bmap_cache != NULL) {
+        EXT2_GRPNUM_T i;
+        for (i = 0; i < ext2fs->grp_descs_count; i++) {
+            free(ext2fs->bmap_cache[i]);
+            free(ext2fs->imap_cache[i]);
+        }
+    }
+    free(ext2fs->bmap_cache);
+    free(ext2fs->imap_cache);
     free(ext2fs->bmap_buf);
     free(ext2fs->imap_buf);
 
     tsk_deinit_lock(&ext2fs->lock);
 
+    for (i = 0; i < EXT2FS_EXTENT_CACHE_N; i++) {
+        if (ext2fs->extent_cache[i] != NULL) {
+            free(ext2fs->extent_cache[i]->extents);
+            free(ext2fs->extent_cache[i]->blocks);
+            free(ext2fs->extent_cache[i]);
+        }
+    }
+    tsk_deinit_lock(&ext2fs->extent_cache_lock);
+
     tsk_fs_free(fs);
 }
 
@@ -3399,6 +3892,7 @@ ext2fs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     fs->inode_walk = ext2fs_inode_walk;
     fs->block_walk = ext2fs_block_walk;
     fs->block_getflags = ext2fs_block_getflags;
+    fs->block_run_walk = ext2fs_block_run_walk;
 
     fs->get_default_attr_type = tsk_fs_unix_get_default_attr_type;
     //fs->load_attrs = tsk_fs_unix_make_data_run;
@@ -3406,6 +3900,9 @@ ext2fs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
 
     fs->file_add_meta = ext2fs_inode_lookup;
     fs->dir_open_meta = ext2fs_dir_open_meta;
+    if (EXT2FS_HAS_COMPAT_FEATURE(fs, ext2fs->fs,
+            EXT2FS_FEATURE_COMPAT_DIR_INDEX))
+        fs->dir_find_name = ext2fs_dir_find_name;
     fs->fsstat = ext2fs_fsstat;
     fs->fscheck = ext2fs_fscheck;
     fs->istat = ext2fs_istat;
@@ -3431,6 +3928,15 @@ ext2fs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     /* group descriptor */
     ext2fs->grp_buf = NULL;
     ext2fs->grp_num = 0xffffffff;
+    if (ext2fs_group_table_load(ext2fs)) {
+        fs->tag = 0;
+        free(ext2fs->fs);
+        free(ext2fs->grp_descs);
+        free(ext2fs->bmap_cache);
+        free(ext2fs->imap_cache);
+        tsk_fs_free((TSK_FS_INFO *)ext2fs);
+        return NULL;
+    }
 
 
     /*
@@ -3446,6 +3952,7 @@ ext2fs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
                 ext2fs->fs->s_blocks_per_group));
 
     tsk_init_lock(&ext2fs->lock);
+    tsk_init_lock(&ext2fs->extent_cache_lock);
 
     return (fs);
 }
@@ -372,3 +372,447 @@ ext2fs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
 
     return retval_final;
 }
+
+
+
+/*
+ * Hash functions for hash tree (dir_index) directories.  These must
+ * produce the same values as the kernel, so they follow fs/ext4/hash.c.
+ */
+
+#define EXT2_DX_HASH_EOF        0x7fffffffU
+
+/* The original "legacy" hash */
+static uint32_t
+ext2fs_dx_hack_hash(const char *a_name, size_t a_len, uint8_t a_unsigned)
+{
+    uint32_t hash;
+    uint32_t hash0 = 0x12a3fe2d;
+    uint32_t hash1 = 0x37abe8f9;
+    size_t i;
+
+    for (i = 0; i < a_len; i++) {
+        int c = a_unsigned ? (int) (unsigned char) a_name[i] :
+            (int) (signed char) a_name[i];
+        hash = hash1 + (hash0 ^ (uint32_t) (c * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+/* Pack (up to) a_num * 4 bytes of the name into a_buf, padded with
+ * a value that depends on the name length */
+static void
+ext2fs_dx_str2hashbuf(const char *a_name, size_t a_len, uint32_t * a_buf,
+    int a_num, uint8_t a_unsigned)
+{
+    uint32_t pad, val;
+    size_t i;
+
+    pad = (uint32_t) a_len | ((uint32_t) a_len << 8);
+    pad |= pad << 16;
+
+    val = pad;
+    if (a_len > (size_t) a_num * 4)
+        a_len = (size_t) a_num * 4;
+    for (i = 0; i < a_len; i++) {
+        int c = a_unsigned ? (int) (unsigned char) a_name[i] :
+            (int) (signed char) a_name[i];
+        val = (uint32_t) c + (val << 8);
+        if ((i % 4) == 3) {
+            *a_buf++ = val;
+            val = pad;
+            a_num--;
+        }
+    }
+    if (--a_num >= 0)
+        *a_buf++ = val;
+    while (--a_num >= 0)
+        *a_buf++ = pad;
+}
+
+#define EXT2_DX_ROL32(x, s)     (((x) << (s)) | ((x) >> (32 - (s))))
+#define EXT2_DX_F(x, y, z)      ((z) ^ ((x) & ((y) ^ (z))))
+#define EXT2_DX_G(x, y, z)      (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define EXT2_DX_H(x, y, z)      ((x) ^ (y) ^ (z))
+#define EXT2_DX_ROUND(f, a, b, c, d, x, s) \
+    (a += f(b, c, d) + (x), a = EXT2_DX_ROL32(a, s))
+#define EXT2_DX_K2              0x5A827999U
+#define EXT2_DX_K3              0x6ED9EBA1U
+
+static void
+ext2fs_dx_half_md4(uint32_t a_buf[4], const uint32_t a_in[8])
+{
+    uint32_t a = a_buf[0], b = a_buf[1], c = a_buf[2], d = a_buf[3];
+
+    /* Round 1 */
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, a_in[0], 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, a_in[1], 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, a_in[2], 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, a_in[3], 19);
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, a_in[4], 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, a_in[5], 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, a_in[6], 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, a_in[7], 19);
+
+    /* Round 2 */
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, a_in[1] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, a_in[3] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, a_in[5] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, a_in[7] + EXT2_DX_K2, 13);
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, a_in[0] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, a_in[2] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, a_in[4] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, a_in[6] + EXT2_DX_K2, 13);
+
+    /* Round 3 */
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, a_in[3] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, a_in[7] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, a_in[2] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, a_in[6] + EXT2_DX_K3, 15);
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, a_in[1] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, a_in[5] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, a_in[0] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, a_in[4] + EXT2_DX_K3, 15);
+
+    a_buf[0] += a;
+    a_buf[1] += b;
+    a_buf[2] += c;
+    a_buf[3] += d;
+}
+
+static void
+ext2fs_dx_tea(uint32_t a_buf[4], const uint32_t a_in[4])
+{
+    uint32_t sum = 0;
+    uint32_t b0 = a_buf[0], b1 = a_buf[1];
+    uint32_t a = a_in[0], b = a_in[1], c = a_in[2], d = a_in[3];
+    int n;
+
+    for (n = 0; n < 16; n++) {
+        sum += 0x9E3779B9;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+    a_buf[0] += b0;
+    a_buf[1] += b1;
+}
+
+/**
+ * \internal
+ * Calculate the major hash of a name the way it is stored in the
+ * index of a hash tree directory.
+ *
+ * @param ext2fs File system the directory is in
+ * @param a_version Hash version (EXT2_DX_HASH_*, after the unsigned adjustment)
+ * @param a_name Name to hash
+ * @param a_len Length of a_name
+ * @param [out] a_hash The hash (with the collision bit cleared)
+ * @returns 1 if the hash version is not supported and 0 on success
+ */
+static uint8_t
+ext2fs_dx_hash(EXT2FS_INFO * ext2fs, uint8_t a_version,
+    const char *a_name, size_t a_len, uint32_t * a_hash)
+{
+    TSK_FS_INFO *fs = &(ext2fs->fs_info);
+    uint32_t buf[4];
+    uint32_t in[8];
+    uint32_t hash;
+    int i;
+
+    buf[0] = 0x67452301;
+    buf[1] = 0xefcdab89;
+    buf[2] = 0x98badcfe;
+    buf[3] = 0x10325476;
+
+    /* an all-zero seed means that the default is used */
+    for (i = 0; i < 4; i++) {
+        if (tsk_getu32(fs->endian, &ext2fs->fs->s_hash_seed[i * 4])) {
+            for (i = 0; i < 4; i++)
+                buf[i] =
+                    tsk_getu32(fs->endian, &ext2fs->fs->s_hash_seed[i * 4]);
+            break;
+        }
+    }
+
+    switch (a_version) {
+    case EXT2_DX_HASH_LEGACY:
+    case EXT2_DX_HASH_LEGACY_UNSIGNED:
+        hash = ext2fs_dx_hack_hash(a_name, a_len,
+            a_version == EXT2_DX_HASH_LEGACY_UNSIGNED);
+        break;
+
+    case EXT2_DX_HASH_HALF_MD4:
+    case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+        do {
+            ext2fs_dx_str2hashbuf(a_name, a_len, in, 8,
+                a_version == EXT2_DX_HASH_HALF_MD4_UNSIGNED);
+            ext2fs_dx_half_md4(buf, in);
+            if (a_len <= 32)
+                break;
+            a_len -= 32;
+            a_name += 32;
+        } while (1);
+        hash = buf[1];
+        break;
+
+    case EXT2_DX_HASH_TEA:
+    case EXT2_DX_HASH_TEA_UNSIGNED:
+        do {
+            ext2fs_dx_str2hashbuf(a_name, a_len, in, 4,
+                a_version == EXT2_DX_HASH_TEA_UNSIGNED);
+            ext2fs_dx_tea(buf, in);
+            if (a_len <= 16)
+                break;
+            a_len -= 16;
+            a_name += 16;
+        } while (1);
+        hash = buf[0];
+        break;
+
+    default:
+        return 1;
+    }
+
+    hash &= ~1;
+    if (hash == (EXT2_DX_HASH_EOF << 1))
+        hash = (EXT2_DX_HASH_EOF - 1) << 1;
+    *a_hash = hash;
+    return 0;
+}
+
+
+/*
+ * Look for an allocated entry with the given name in one leaf block of
+ * a hash tree directory.  Only the entries on the rec_len chain are
+ * considered, so deleted entries in the slack space are never returned.
+ *
+ * @returns 0 if found (and a_fs_name is filled in) and 1 if not
+ */
+static int8_t
+ext2fs_dx_leaf_find(EXT2FS_INFO * ext2fs, const char *a_buf, size_t a_len,
+    const char *a_name, size_t a_name_len, TSK_FS_NAME * a_fs_name)
+{
+    TSK_FS_INFO *fs = &(ext2fs->fs_info);
+    size_t idx = 0;
+
+    while (idx + EXT2FS_DIRSIZ_lcl(1) <= a_len) {
+        const ext2fs_dentry2 *dir = (const ext2fs_dentry2 *) &a_buf[idx];
+        uint32_t inode = tsk_getu32(fs->endian, dir->inode);
+        uint16_t reclen = tsk_getu16(fs->endian, dir->rec_len);
+        unsigned int namelen;
+
+        if (ext2fs->deentry_type == EXT2_DE_V1)
+            namelen = tsk_getu16(fs->endian,
+                ((const ext2fs_dentry1 *) dir)->name_len);
+        else
+            namelen = dir->name_len;
+
+        if ((reclen < EXT2FS_DIRSIZ_lcl(namelen)) || (reclen % 4)
+            || (idx + reclen > a_len))
+            return 1;
+
+        if ((inode != 0) && (inode <= fs->last_inum)
+            && (namelen == a_name_len)
+            && (memcmp(dir->name, a_name, a_name_len) == 0)) {
+            if (ext2fs_dent_copy(ext2fs, (char *) dir, a_fs_name))
+                return 1;
+            a_fs_name->flags = TSK_FS_NAME_FLAG_ALLOC;
+            return 0;
+        }
+        idx += reclen;
+    }
+    return 1;
+}
+
+
+/** \internal
+* Find an allocated name in a directory using its hash tree (dir_index)
+* instead of parsing every block of the directory.  Only the index blocks
+* on the path to the leaf and the leaf blocks that can hold the name are
+* read.  Directories without an index, deleted directories and names that
+* are not in the index (including deleted ones) are left to the caller,
+* which will do a full scan with ext2fs_dir_open_meta().
+*
+* @param a_fs File system to analyze
+* @param a_addr Address of the directory
+* @param a_name Name to look for
+* @param [out] a_fs_name Details of the name that was found.  The name buffer
+* must be larger than a_name.
+* @returns -1 on error, 0 if found, and 1 if the directory must be scanned
+*/
+int8_t
+ext2fs_dir_find_name(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
+    const char *a_name, TSK_FS_NAME * a_fs_name)
+{
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) a_fs;
+    TSK_FS_FILE *fs_file;
+    ext2fs_inode *dino_buf;
+    size_t dino_size;
+    char *buf;
+    const ext2fs_dentry2 *dotdot;
+    const ext2fs_dx_root_info *info;
+    const ext2fs_dx_countlimit *cl;
+    size_t name_len = strlen(a_name);
+    size_t block_size = a_fs->block_size;
+    size_t ent_off;
+    uint8_t version;
+    uint8_t levels;
+    uint8_t level;
+    uint32_t hash;
+    uint32_t blk;
+    uint32_t nblocks;
+    int8_t retval = 1;
+
+    if ((a_addr < a_fs->first_inum) || (a_addr > a_fs->last_inum)
+        || (name_len == 0) || (name_len > EXT2FS_MAXNAMLEN)
+        || (name_len >= a_fs_name->name_size))
+        return 1;
+
+    /* The index is only used if the inode says so */
+    dino_size = ext2fs->inode_size > sizeof(ext2fs_inode) ?
+        ext2fs->inode_size : sizeof(ext2fs_inode);
+    if ((dino_buf = (ext2fs_inode *) tsk_malloc(dino_size)) == NULL)
+        return -1;
+    if (ext2fs_dinode_load(ext2fs, a_addr, dino_buf)) {
+        free(dino_buf);
+        return -1;
+    }
+    if ((tsk_getu32(a_fs->endian, dino_buf->i_flags) & EXT2_IN_INDEX) == 0) {
+        free(dino_buf);
+        return 1;
+    }
+    free(dino_buf);
+
+    if ((fs_file = tsk_fs_file_open_meta(a_fs, NULL, a_addr)) == NULL)
+        return -1;
+
+    if ((fs_file->meta->type != TSK_FS_META_TYPE_DIR)
+        || (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC)
+        || (fs_file->meta->size < (TSK_OFF_T) block_size)) {
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+    nblocks = (uint32_t) (fs_file->meta->size / block_size);
+
+    if ((buf = tsk_malloc(block_size)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        return -1;
+    }
+
+    /* Validate the dx_root that follows the "." and ".." entries */
+    if (tsk_fs_file_read(fs_file, 0, buf, block_size,
+            TSK_FS_FILE_READ_FLAG_NONE) != (ssize_t) block_size) {
+        retval = -1;
+        goto done;
+    }
+    dotdot = (const ext2fs_dentry2 *) &buf[12];
+    info = (const ext2fs_dx_root_info *) &buf[24];
+    if ((tsk_getu16(a_fs->endian, dotdot->rec_len) != block_size - 12)
+        || (tsk_getu32(a_fs->endian, info->reserved_zero) != 0)
+        || (info->info_length != sizeof(ext2fs_dx_root_info))
+        || (info->indirect_levels >= EXT2_DX_MAX_LEVELS)
+        || (info->unused_flags & 1))
+        goto done;
+
+    version = info->hash_version;
+    if ((version <= EXT2_DX_HASH_TEA)
+        && (tsk_getu32(a_fs->endian,
+                ext2fs->fs->s_flags) & EXT2FS_FLAGS_UNSIGNED_HASH))
+        version += 3;
+    if (ext2fs_dx_hash(ext2fs, version, a_name, name_len, &hash))
+        goto done;
+
+    levels = info->indirect_levels;
+    ent_off = 24 + info->info_length;
+
+    /* Walk down the index */
+    for (level = 0;; level++) {
+        const ext2fs_dx_entry *ents;
+        uint16_t count, limit;
+        uint16_t lo, hi;
+
+        cl = (const ext2fs_dx_countlimit *) &buf[ent_off];
+        ents = (const ext2fs_dx_entry *) &buf[ent_off];
+        count = tsk_getu16(a_fs->endian, cl->count);
+        limit = tsk_getu16(a_fs->endian, cl->limit);
+        if ((count == 0) || (count > limit)
+            || (ent_off + (size_t) limit * sizeof(ext2fs_dx_entry) >
+                block_size))
+            goto done;
+
+        /* Find the last entry whose hash is <= the name hash.  Entry 0
+         * has no hash and covers everything below entry 1. */
+        lo = 1;
+        hi = count;
+        while (lo < hi) {
+            uint16_t mid = lo + (hi - lo) / 2;
+            if (tsk_getu32(a_fs->endian, ents[mid].hash) > hash)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        lo--;
+        blk = tsk_getu32(a_fs->endian, ents[lo].block) & 0x0fffffff;
+
+        if (level < levels) {
+            /* interior node: fake entry that covers the block, then the entries */
+            if ((blk == 0) || (blk >= nblocks)
+                || (tsk_fs_file_read(fs_file,
+                        (TSK_OFF_T) blk * block_size, buf, block_size,
+                        TSK_FS_FILE_READ_FLAG_NONE) !=
+                    (ssize_t) block_size)) {
+                goto done;
+            }
+            ent_off = 8;
+            continue;
+        }
+
+        /* Search the leaf and any following leaves that continue a run
+         * of colliding hashes */
+        while (1) {
+            uint32_t next_hash;
+            char *leaf;
+
+            if ((blk == 0) || (blk >= nblocks))
+                goto done;
+            if ((leaf = tsk_malloc(block_size)) == NULL) {
+                retval = -1;
+                goto done;
+            }
+            if (tsk_fs_file_read(fs_file, (TSK_OFF_T) blk * block_size,
+                    leaf, block_size, TSK_FS_FILE_READ_FLAG_NONE) !=
+                (ssize_t) block_size) {
+                free(leaf);
+                goto done;
+            }
+            retval = ext2fs_dx_leaf_find(ext2fs, leaf, block_size,
+                a_name, name_len, a_fs_name);
+            free(leaf);
+            if (retval == 0) {
+                a_fs_name->par_addr = a_addr;
+                a_fs_name->par_seq = 0;
+                goto done;
+            }
+
+            if (++lo >= count)
+                goto done;
+            next_hash = tsk_getu32(a_fs->endian, ents[lo].hash);
+            if ((next_hash & ~1) != hash)
+                goto done;
+            blk = tsk_getu32(a_fs->endian, ents[lo].block) & 0x0fffffff;
+        }
+    }
+
+  done:
+    free(buf);
+    tsk_fs_file_close(fs_file);
+    if ((retval != 0) && (tsk_verbose))
+        tsk_fprintf(stderr,
+            "ext2fs_dir_find_name: %s not found with index of directory %"
+            PRIuINUM "\n", a_name, a_addr);
+    return retval;
+}
@@ -64,6 +64,7 @@ fatfs_open(TSK_IMG_INFO *a_img_info, TSK_OFF_T a_offset, TSK_FS_TYPE_ENUM a_ftyp
     fs->dev_bsize = a_img_info->sector_size;
     fs->journ_inum = 0;
     fs->tag = TSK_FS_INFO_TAG;
+    fatfs->fat_table_max = FATFS_FAT_TABLE_MAX;
 
 	// Look for a FAT boot sector. Try up to three times because FAT32 and exFAT file systems have backup boot sectors.
     for (find_boot_sector_attempt = 0; find_boot_sector_attempt < 3; ++find_boot_sector_attempt) {
@@ -219,6 +220,141 @@ getFATCacheIdx(FATFS_INFO * fatfs, TSK_DADDR_T sect)
     return cidx;
 }
 
+/*
+ * Load the whole FAT into fatfs->fat_table, decoding each entry and
+ * computing the length of the contiguous run that starts at each cluster.
+ * Only the first call does any work.  The table is not loaded if it does not
+ * fit in fatfs->fat_table_max or if the FAT cannot be read, in which case
+ * fatfs_getFAT() keeps using the FAT caches.
+ *
+ * @returns the table or NULL if it is not available
+ */
+static uint32_t *
+fatfs_fat_table_load(FATFS_INFO * fatfs)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & fatfs->fs_info;
+    uint32_t *table = NULL;
+    uint32_t *run;
+    uint8_t *buf = NULL;
+    size_t ecnt, len;
+    ssize_t cnt;
+    uint32_t mask;
+    TSK_DADDR_T i;
+
+    tsk_take_lock(&fatfs->cache_lock);
+    if (fatfs->fat_table_tried) {
+        tsk_release_lock(&fatfs->cache_lock);
+        return (uint32_t *) tsk_atomic_ptr_load((void *volatile *)
+            &fatfs->fat_table);
+    }
+    fatfs->fat_table_tried = 1;
+
+    // entries and run lengths are stored as 32-bit values
+    if (fatfs->lastclust >= 0xffffffffULL
+        || (fatfs->lastclust + 1) > fatfs->fat_table_max / 8) {
+        goto done;
+    }
+    ecnt = (size_t) fatfs->lastclust + 1;
+
+    switch (fatfs->fs_info.ftype) {
+    case TSK_FS_TYPE_FAT12:
+        if (fatfs->lastclust & 0xf000)
+            goto done;
+        len = ecnt + (ecnt >> 1) + 1;
+        mask = FATFS_12_MASK;
+        break;
+    case TSK_FS_TYPE_FAT16:
+        len = ecnt << 1;
+        mask = FATFS_16_MASK;
+        break;
+    case TSK_FS_TYPE_FAT32:
+    case TSK_FS_TYPE_EXFAT:
+        len = ecnt << 2;
+        mask = FATFS_32_MASK;
+        break;
+    default:
+        goto done;
+    }
+
+    if (((buf = (uint8_t *) tsk_malloc(len)) == NULL) ||
+        ((table = (uint32_t *) tsk_malloc(ecnt * 2 *
+                    sizeof(uint32_t))) == NULL)) {
+        free(buf);
+        tsk_error_reset();
+        goto done;
+    }
+
+    cnt = tsk_fs_read(fs, fatfs->firstfatsect * fs->block_size,
+        (char *) buf, len);
+    if (cnt != (ssize_t) len) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "fatfs_fat_table_load: Error reading FAT, using FAT cache\n");
+        tsk_error_reset();
+        free(buf);
+        free(table);
+        table = NULL;
+        goto done;
+    }
+
+    for (i = 0; i < ecnt; i++) {
+        uint32_t value;
+
+        if (fatfs->fs_info.ftype == TSK_FS_TYPE_FAT12) {
+            value = tsk_getu16(fs->endian, &buf[i + (i >> 1)]);
+            if (i & 1)
+                value >>= 4;
+        }
+        else if (fatfs->fs_info.ftype == TSK_FS_TYPE_FAT16) {
+            value = tsk_getu16(fs->endian, &buf[i << 1]);
+        }
+        else {
+            value = tsk_getu32(fs->endian, &buf[i << 2]);
+        }
+        value &= mask;
+
+        /* sanity check */
+        if ((value > fatfs->lastclust) && (value < (0x0ffffff7 & mask))) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "fatfs_fat_table_load: contents of entry %" PRIuDADDR
+                    " too large - resetting\n", i);
+            value = 0;
+        }
+        table[i] = value;
+    }
+    free(buf);
+
+    // run[i] is the number of clusters from i on that are chained i, i+1, ...
+    run = &table[ecnt];
+    run[ecnt - 1] = 1;
+    for (i = ecnt - 1; i > 0; i--) {
+        run[i - 1] = (table[i - 1] == i) ? run[i] + 1 : 1;
+    }
+
+    tsk_atomic_ptr_cas((void *volatile *) &fatfs->fat_table, NULL, table);
+
+  done:
+    tsk_release_lock(&fatfs->cache_lock);
+    return table;
+}
+
+/*
+ * Return the in-memory FAT, loading it first if needed.
+ *
+ * @returns the table or NULL if it is not available
+ */
+static uint32_t *
+fatfs_fat_table_get(FATFS_INFO * fatfs)
+{
+    uint32_t *table = (uint32_t *) tsk_atomic_ptr_load((void *volatile *)
+        &fatfs->fat_table);
+
+    if ((table == NULL) && (fatfs->fat_table_max > 0))
+        table = fatfs_fat_table_load(fatfs);
+    return table;
+}
+
 /*
  * Set *value to the entry in the File Allocation Table (FAT) 
  * for the given cluster
@@ -239,6 +375,7 @@ fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust, TSK_DADDR_T * value)
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & fatfs->fs_info;
     TSK_DADDR_T sect, offs;
     int cidx;
+    uint32_t *table;
 
     /* Sanity Check */
     if (clust > fatfs->lastclust) {
@@ -259,6 +396,11 @@ fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust, TSK_DADDR_T * value)
         return 1;
     }
 
+    if ((table = fatfs_fat_table_get(fatfs)) != NULL) {
+        *value = table[clust];
+        return 0;
+    }
+
     switch (fatfs->fs_info.ftype) {
     case TSK_FS_TYPE_FAT12:
         if (clust & 0xf000) {
@@ -413,6 +555,113 @@ fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust, TSK_DADDR_T * value)
     }
 }
 
+/*
+ * Return the number of clusters, starting at clust, that follow each
+ * other on disk in a cluster chain.  That is, the FAT entry of each of
+ * them but the last is the address of the next one.  The FAT entry of the
+ * last cluster of the run can be read with fatfs_getFAT().
+ *
+ * This is always 1 if the FAT could not be loaded into memory or if clust
+ * is not a valid cluster address.
+ */
+TSK_DADDR_T
+fatfs_getFAT_run(FATFS_INFO * fatfs, TSK_DADDR_T clust)
+{
+    uint32_t *table;
+
+    if ((clust > fatfs->lastclust) ||
+        ((table = fatfs_fat_table_get(fatfs)) == NULL))
+        return 1;
+
+    return table[fatfs->lastclust + 1 + clust];
+}
+
+/*
+ * Return the first cluster in [first, last] that is in the set or 0 if
+ * none of them are.
+ */
+TSK_DADDR_T
+fatfs_clust_seen_find(const FATFS_CLUST_SEEN * seen, TSK_DADDR_T first,
+    TSK_DADDR_T last)
+{
+    size_t lo = 0, hi = seen->cnt;
+
+    // find the first range that ends at or after first
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (seen->rng[2 * mid + 1] < first)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if ((lo < seen->cnt) && (seen->rng[2 * lo] <= last))
+        return (seen->rng[2 * lo] > first) ? seen->rng[2 * lo] : first;
+    return 0;
+}
+
+/*
+ * Add the clusters [first, last] to the set.
+ *
+ * Return 1 on error and 0 on success
+ */
+uint8_t
+fatfs_clust_seen_add(FATFS_CLUST_SEEN * seen, TSK_DADDR_T first,
+    TSK_DADDR_T last)
+{
+    size_t lo = 0, hi = seen->cnt, end;
+
+    // find the first range that ends at or right before first
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (seen->rng[2 * mid + 1] + 1 < first)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // merge all of the ranges that overlap or touch [first, last]
+    for (end = lo; (end < seen->cnt) && (seen->rng[2 * end] <= last + 1);
+        end++) {
+        if (seen->rng[2 * end] < first)
+            first = seen->rng[2 * end];
+        if (seen->rng[2 * end + 1] > last)
+            last = seen->rng[2 * end + 1];
+    }
+
+    if (end > lo) {
+        memmove(&seen->rng[2 * (lo + 1)], &seen->rng[2 * end],
+            (seen->cnt - end) * 2 * sizeof(TSK_DADDR_T));
+        seen->cnt -= end - lo - 1;
+    }
+    else {
+        if (seen->cnt == seen->alloc) {
+            size_t alloc = seen->alloc ? seen->alloc * 2 : 16;
+            TSK_DADDR_T *rng = (TSK_DADDR_T *) tsk_realloc(seen->rng,
+                alloc * 2 * sizeof(TSK_DADDR_T));
+            if (rng == NULL)
+                return 1;
+            seen->rng = rng;
+            seen->alloc = alloc;
+        }
+        memmove(&seen->rng[2 * (lo + 1)], &seen->rng[2 * lo],
+            (seen->cnt - lo) * 2 * sizeof(TSK_DADDR_T));
+        seen->cnt++;
+    }
+    seen->rng[2 * lo] = first;
+    seen->rng[2 * lo + 1] = last;
+    return 0;
+}
+
+void
+fatfs_clust_seen_free(FATFS_CLUST_SEEN * seen)
+{
+    free(seen->rng);
+    seen->rng = NULL;
+    seen->cnt = 0;
+    seen->alloc = 0;
+}
+
 /**************************************************************************
  *
  * BLOCK WALKING
@@ -432,14 +681,6 @@ fatfs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
     TSK_FS_BLOCK_WALK_CB a_action, void *a_ptr)
 {
     char *myname = "fatfs_block_walk";
-    FATFS_INFO *fatfs = (FATFS_INFO *) fs;
-    char *data_buf = NULL;
-    ssize_t cnt;
-    TSK_FS_BLOCK *fs_block;
-
-    TSK_DADDR_T addr;
-    int myflags;
-    unsigned int i;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -467,229 +708,82 @@ fatfs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
             "fatfs_block_walk: Block Walking %" PRIuDADDR " to %"
             PRIuDADDR "\n", a_start_blk, a_end_blk);
 
+    /* The runs come from fatfs_block_run_walk() and the sectors of
+     * the matching runs are read in large chunks */
+    return tsk_fs_block_walk_runs(fs, a_start_blk, a_end_blk, a_flags,
+        a_action, a_ptr, myname);
+}
 
-    /* Sanity check on a_flags -- make sure at least one ALLOC is set */
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_ALLOC |
-            TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
-    }
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_META) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_CONT | TSK_FS_BLOCK_WALK_FLAG_META);
+/*
+ * Report runs of sectors with the same flags.  The sectors before the
+ * data area are allocated metadata (or the FAT12/16 root directory),
+ * the data area is examined a cluster at a time, and the sectors after
+ * the last cluster are unallocated.
+ *
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+fatfs_block_run_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
+    TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr)
+{
+    FATFS_INFO *fatfs = (FATFS_INFO *) fs;
+    TSK_DADDR_T addr = a_start_blk;
+    TSK_DADDR_T data_end;
+    TSK_WALK_RET_ENUM retval;
+
+#define FATFS_RUN_ACTION(len, flags) \
+    do { \
+        retval = a_action(fs, addr, (len), (TSK_FS_BLOCK_FLAG_ENUM) (flags), \
+            a_ptr); \
+        if (retval != TSK_WALK_CONT) \
+            return (retval == TSK_WALK_ERROR) ? 1 : 0; \
+        addr += (len); \
+    } while (0)
+
+    /* FATs and boot sector */
+    if ((addr < fatfs->firstdatasect) && (addr <= a_end_blk)) {
+        TSK_DADDR_T end = fatfs->firstdatasect - 1;
+        if (end > a_end_blk)
+            end = a_end_blk;
+        FATFS_RUN_ACTION(end - addr + 1,
+            TSK_FS_BLOCK_FLAG_META | TSK_FS_BLOCK_FLAG_ALLOC);
     }
 
-    if ((fs_block = tsk_fs_block_alloc(fs)) == NULL) {
-        return 1;
+    /* root directory for FAT12/16 */
+    if ((addr < fatfs->firstclustsect) && (addr <= a_end_blk)) {
+        TSK_DADDR_T end = fatfs->firstclustsect - 1;
+        if (end > a_end_blk)
+            end = a_end_blk;
+        FATFS_RUN_ACTION(end - addr + 1,
+            TSK_FS_BLOCK_FLAG_CONT | TSK_FS_BLOCK_FLAG_ALLOC);
     }
 
-    /* cycle through the sectors.  We do the sectors before the first
-     * cluster separate from the data area */
-    addr = a_start_blk;
+    /* The clusters */
+    data_end = fatfs->firstclustsect + fatfs->csize * fatfs->clustcnt;
+    while ((addr < data_end) && (addr <= a_end_blk)) {
+        TSK_DADDR_T clust = FATFS_SECT_2_CLUST(fatfs, addr);
+        TSK_DADDR_T end = FATFS_CLUST_2_SECT(fatfs, clust) + fatfs->csize - 1;
+        int8_t ret;
 
-    /* Before the data area beings (FAT, root directory etc.) */
-    if ((a_start_blk < fatfs->firstclustsect)
-        && (a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)) {
+        if (end > a_end_blk)
+            end = a_end_blk;
 
-        if (tsk_verbose)
-            tsk_fprintf(stderr,
-                "fatfs_block_walk: Walking non-data area (pre %"
-                PRIuDADDR "\n)", fatfs->firstclustsect);
-
-        if ((data_buf = (char *) tsk_malloc(fs->block_size * 8)) == NULL) {
-            tsk_fs_block_free(fs_block);
+        ret = fatfs->is_cluster_alloc(fatfs, clust);
+        if (ret == -1)
             return 1;
-        }
-
-        /* Read 8 sectors at a time to be faster */
-        for (; addr < fatfs->firstclustsect && addr <= a_end_blk;) {
-
-            if ((a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY) == 0) {
-                cnt =
-                    tsk_fs_read_block(fs, addr, data_buf,
-                    fs->block_size * 8);
-                if (cnt != fs->block_size * 8) {
-                    if (cnt >= 0) {
-                        tsk_error_reset();
-                        tsk_error_set_errno(TSK_ERR_FS_READ);
-                    }
-                    tsk_error_set_errstr2
-                        ("fatfs_block_walk: pre-data area block: %"
-                        PRIuDADDR, addr);
-                    free(data_buf);
-                    tsk_fs_block_free(fs_block);
-                    return 1;
-                }
-            }
-
-            /* Process the sectors until we get to the clusters, 
-             * end of target, or end of buffer */
-            for (i = 0;
-                i < 8 && (addr) <= a_end_blk
-                && (addr) < fatfs->firstclustsect; i++, addr++) {
-                int retval;
-
-                myflags = TSK_FS_BLOCK_FLAG_ALLOC;
-
-                /* stuff before the first data sector is the 
-                 * FAT and boot sector */
-                if (addr < fatfs->firstdatasect)
-                    myflags |= TSK_FS_BLOCK_FLAG_META;
-                /* This must be the root directory for FAT12/16 */
-                else
-                    myflags |= TSK_FS_BLOCK_FLAG_CONT;
-
-                // test this sector (we already tested ALLOC)
-                if ((myflags & TSK_FS_BLOCK_FLAG_META)
-                    && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_META)))
-                    continue;
-                else if ((myflags & TSK_FS_BLOCK_FLAG_CONT)
-                    && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
-                    continue;
-
-                if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-                    myflags |= TSK_FS_BLOCK_FLAG_AONLY;
 
-                tsk_fs_block_set(fs, fs_block, addr,
-                    myflags | TSK_FS_BLOCK_FLAG_RAW,
-                    &data_buf[i * fs->block_size]);
-
-                retval = a_action(fs_block, a_ptr);
-                if (retval == TSK_WALK_STOP) {
-                    free(data_buf);
-                    tsk_fs_block_free(fs_block);
-                    return 0;
-                }
-                else if (retval == TSK_WALK_ERROR) {
-                    free(data_buf);
-                    tsk_fs_block_free(fs_block);
-                    return 1;
-                }
-            }
-        }
-
-        free(data_buf);
-
-        /* Was that it? */
-        if (addr >= a_end_blk) {
-            tsk_fs_block_free(fs_block);
-            return 0;
-        }
+        FATFS_RUN_ACTION(end - addr + 1, TSK_FS_BLOCK_FLAG_CONT |
+            ((ret == 1) ? TSK_FS_BLOCK_FLAG_ALLOC :
+                TSK_FS_BLOCK_FLAG_UNALLOC));
     }
-    /* Reset the first sector to the start of the data area if we did
-     * not examine it - the next calculation will screw up otherwise */
-    else if (addr < fatfs->firstclustsect) {
-        addr = fatfs->firstclustsect;
-    }
-
 
-    /* Now we read in the clusters in cluster-sized chunks,
-     * sectors are too small
-     */
-
-    /* Determine the base sector of the cluster where the first 
-     * sector is located */
-    addr = FATFS_CLUST_2_SECT(fatfs, (FATFS_SECT_2_CLUST(fatfs, addr)));
-
-    if ((data_buf = tsk_malloc(fs->block_size * fatfs->csize)) == NULL) {
-        tsk_fs_block_free(fs_block);
-        return 1;
-    }
-
-    if (tsk_verbose)
-        tsk_fprintf(stderr,
-            "fatfs_block_walk: Walking data area blocks (%" PRIuDADDR
-            " to %" PRIuDADDR ")\n", addr, a_end_blk);
-
-    for (; addr <= a_end_blk; addr += fatfs->csize) {
-        int retval;
-        size_t read_size;
-
-        /* Identify its allocation status */
-        retval = fatfs_is_sectalloc(fatfs, addr);
-        if (retval == -1) {
-            free(data_buf);
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-        else if (retval == 1) {
-            myflags = TSK_FS_BLOCK_FLAG_ALLOC;
-        }
-        else {
-            myflags = TSK_FS_BLOCK_FLAG_UNALLOC;
-        }
-
-        /* At this point, there should be no more meta - just content */
-        myflags |= TSK_FS_BLOCK_FLAG_CONT;
-
-        // test if we should call the callback with this one
-        if ((myflags & TSK_FS_BLOCK_FLAG_CONT)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_ALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
-            continue;
-
-        if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-            myflags |= TSK_FS_BLOCK_FLAG_AONLY;
-
-        
-        /* The final cluster may not be full */
-        if (a_end_blk - addr + 1 < fatfs->csize)
-            read_size = (size_t) (a_end_blk - addr + 1);
-        else
-            read_size = fatfs->csize;
-
-        if ((a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY) == 0) {
-            cnt = tsk_fs_read_block
-                (fs, addr, data_buf, fs->block_size * read_size);
-            if (cnt != (ssize_t)(fs->block_size * read_size)) {
-                if (cnt >= 0) {
-                    tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_READ);
-                }
-                tsk_error_set_errstr2("fatfs_block_walk: block: %"
-                    PRIuDADDR, addr);
-                free(data_buf);
-                tsk_fs_block_free(fs_block);
-                return 1;
-            }
-        }
-
-        /* go through each sector in the cluster */
-        for (i = 0; i < read_size; i++) {
-            int retval;
-
-            if (addr + i < a_start_blk)
-                continue;
-            else if (addr + i > a_end_blk)
-                break;
-
-            tsk_fs_block_set(fs, fs_block, addr + i,
-                myflags | TSK_FS_BLOCK_FLAG_RAW,
-                &data_buf[i * fs->block_size]);
-
-            retval = a_action(fs_block, a_ptr);
-            if (retval == TSK_WALK_STOP) {
-                free(data_buf);
-                tsk_fs_block_free(fs_block);
-                return 0;
-            }
-            else if (retval == TSK_WALK_ERROR) {
-                free(data_buf);
-                tsk_fs_block_free(fs_block);
-                return 1;
-            }
-        }
+    /* The unused area after the last cluster */
+    if (addr <= a_end_blk) {
+        FATFS_RUN_ACTION(a_end_blk - addr + 1,
+            TSK_FS_BLOCK_FLAG_CONT | TSK_FS_BLOCK_FLAG_UNALLOC);
     }
+#undef FATFS_RUN_ACTION
 
-    free(data_buf);
-    tsk_fs_block_free(fs_block);
     return 0;
 }
 
@@ -824,6 +918,10 @@ fatfs_close(TSK_FS_INFO *fs)
 	memset(fatfs->boot_sector_buffer, 0, FATFS_MASTER_BOOT_RECORD_SIZE);
     tsk_deinit_lock(&fatfs->cache_lock);
     tsk_deinit_lock(&fatfs->dir_lock);
+    free(fatfs->fat_table);
+    fatfs->fat_table = NULL;
+    free(fatfs->dir_sectors_bitmap);
+    fatfs->dir_sectors_bitmap = NULL;
 	
     tsk_fs_free(fs);
 }
@@ -91,7 +91,9 @@ fatfs_make_root(FATFS_INFO *a_fatfs, TSK_FS_META *a_fs_meta)
         a_fatfs->fs_info.ftype == TSK_FS_TYPE_EXFAT) {
         TSK_DADDR_T cnum = 0;
         TSK_DADDR_T clust = 0;
-        TSK_LIST *list_seen = NULL;
+        FATFS_CLUST_SEEN seen;
+
+        memset(&seen, 0, sizeof(seen));
 
         /* Convert the address of the first sector of the root directory into
          * the address of its first cluster. */
@@ -102,22 +104,26 @@ fatfs_make_root(FATFS_INFO *a_fatfs, TSK_FS_META *a_fs_meta)
         cnum = 0;
         while ((clust) && (0 == FATFS_ISEOF(clust, FATFS_32_MASK))) {
             TSK_DADDR_T nxt = 0;
+            TSK_DADDR_T run_len = fatfs_getFAT_run(a_fatfs, clust);
+            TSK_DADDR_T loop_clust;
 
             /* Make sure we do not get into an infinite loop */
-            if (tsk_list_find(list_seen, clust)) {
+            if ((loop_clust = fatfs_clust_seen_find(&seen, clust,
+                        clust + run_len - 1)) != 0) {
+                cnum += loop_clust - clust;
                 if (tsk_verbose) {
                     tsk_fprintf(stderr,
                         "Loop found while determining root directory size\n");
                 }
                 break;
             }
-            if (tsk_list_add(&list_seen, clust)) {
-                tsk_list_free(list_seen);
-                list_seen = NULL;
+            if (fatfs_clust_seen_add(&seen, clust, clust + run_len - 1)) {
+                fatfs_clust_seen_free(&seen);
                 return 1;
             }
 
-            cnum++;
+            cnum += run_len;
+            clust += run_len - 1;
             if (fatfs_getFAT(a_fatfs, clust, &nxt)) {
                 break;
             }
@@ -125,8 +131,7 @@ fatfs_make_root(FATFS_INFO *a_fatfs, TSK_FS_META *a_fs_meta)
                 clust = nxt;
             }
         }
-        tsk_list_free(list_seen);
-        list_seen = NULL;
+        fatfs_clust_seen_free(&seen);
 
         /* Calculate the size of the root directory. */
         a_fs_meta->size = (cnum * a_fatfs->csize) << a_fatfs->ssize_sh;
@@ -730,11 +735,12 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
         return 0;
     }
     else {
-        TSK_LIST *list_seen = NULL;
+        FATFS_CLUST_SEEN seen;
         TSK_FS_ATTR_RUN *data_run = NULL;
         TSK_FS_ATTR_RUN *data_run_head = NULL;
         TSK_OFF_T full_len_s = 0;
         TSK_DADDR_T sbase;
+        TSK_OFF_T clust_bytes = (TSK_OFF_T) fatfs->csize * fs->block_size;
         /* Do normal cluster chain walking for a file or directory, including
          * FAT32 and exFAT root directories. */
 
@@ -744,14 +750,36 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
                 " in normal mode\n", func_name, fs_meta->addr);
         }
 
-        /* Cycle through the cluster chain */
+        memset(&seen, 0, sizeof(seen));
+
+        /* Cycle through the cluster chain.  Clusters that follow each other
+         * on disk are handled as one run when the FAT is in memory. */
         while ((clust & fatfs->mask) > 0 && (int64_t) size_remain > 0 &&
             (0 == FATFS_ISEOF(clust, fatfs->mask))) {
+            TSK_DADDR_T run_len, loop_clust = 0;
+
+            run_len = fatfs_getFAT_run(fatfs, clust);
+            if ((TSK_OFF_T) run_len >
+                (size_remain + clust_bytes - 1) / clust_bytes)
+                run_len = (size_remain + clust_bytes - 1) / clust_bytes;
+
+            /* Make sure we do not get into an infinite loop.  The clusters
+             * after the first one in the run are reached through the FAT. */
+            if (run_len > 1) {
+                loop_clust = fatfs_clust_seen_find(&seen, clust + 1,
+                    clust + run_len - 1);
+                if (loop_clust)
+                    run_len = loop_clust - clust;
+            }
 
             /* Convert the cluster addr to a sector addr */
             sbase = FATFS_CLUST_2_SECT(fatfs, clust);
 
-            if (sbase + fatfs->csize - 1 > fs->last_block) {
+            if (sbase + fatfs->csize * run_len - 1 > fs->last_block) {
+                // report the first cluster that is past the end
+                while (sbase + fatfs->csize - 1 <= fs->last_block)
+                    sbase += fatfs->csize;
+
                 fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
                 tsk_error_reset();
 
@@ -759,6 +787,8 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
                 tsk_error_set_errstr
                     ("%s: Invalid sector address in FAT (too large): %"
                     PRIuDADDR " (plus %d sectors)", func_name, sbase, fatfs->csize);
+                tsk_fs_attr_run_free(data_run_head);
+                fatfs_clust_seen_free(&seen);
                 return 1;
             }
 
@@ -769,6 +799,7 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
                 TSK_FS_ATTR_RUN *data_run_tmp = tsk_fs_attr_run_alloc();
                 if (data_run_tmp == NULL) {
                     tsk_fs_attr_run_free(data_run_head);
+                    fatfs_clust_seen_free(&seen);
                     fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
                     return 1;
                 }
@@ -787,9 +818,25 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
                 data_run->addr = sbase;
             }
 
-            data_run->len += fatfs->csize;
-            full_len_s += fatfs->csize;
-            size_remain -= (fatfs->csize * fs->block_size);
+            data_run->len += fatfs->csize * run_len;
+            full_len_s += fatfs->csize * run_len;
+            size_remain -= clust_bytes * run_len;
+
+            if (loop_clust) {
+                if (tsk_verbose)
+                    tsk_fprintf(stderr,
+                        "Loop found while processing file\n");
+                break;
+            }
+
+            if ((run_len > 1) &&
+                fatfs_clust_seen_add(&seen, clust + 1, clust + run_len - 1)) {
+                fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
+                tsk_fs_attr_run_free(data_run_head);
+                fatfs_clust_seen_free(&seen);
+                return 1;
+            }
+            clust += run_len - 1;
 
             if ((int64_t) size_remain > 0) {
                 TSK_DADDR_T nxt;
@@ -798,28 +845,28 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
                         "  cluster: %" PRIuDADDR, func_name, fs_meta->addr, clust);
                     fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
                     tsk_fs_attr_run_free(data_run_head);
-                    tsk_list_free(list_seen);
-                    list_seen = NULL;
+                    fatfs_clust_seen_free(&seen);
                     return 1;
                 }
                 clust = nxt;
 
                 /* Make sure we do not get into an infinite loop */
-                if (tsk_list_find(list_seen, clust)) {
+                if (fatfs_clust_seen_find(&seen, clust, clust)) {
                     if (tsk_verbose)
                         tsk_fprintf(stderr,
                             "Loop found while processing file\n");
                     break;
                 }
 
-                if (tsk_list_add(&list_seen, clust)) {
+                if (fatfs_clust_seen_add(&seen, clust, clust)) {
                     fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
-                    tsk_list_free(list_seen);
-                    list_seen = NULL;
+                    tsk_fs_attr_run_free(data_run_head);
+                    fatfs_clust_seen_free(&seen);
                     return 1;
                 }
             }
         }
+        fatfs_clust_seen_free(&seen);
 
         // add the run list to the inode structure
         if ((fs_attr =
@@ -838,8 +885,10 @@ fatfs_make_data_runs(TSK_FS_FILE * a_fs_file)
             return 1;
         }
 
-        tsk_list_free(list_seen);
-        list_seen = NULL;
+        if (tsk_fs_attr_run_idx_build(fs_attr)) {
+            fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
+            return 1;
+        }
 
         fs_meta->attr_state = TSK_FS_META_ATTR_STUDIED;
 
@@ -1051,6 +1100,98 @@ inode_walk_dent_act(TSK_FS_FILE * fs_file, const char *a_path, void *a_ptr)
     return TSK_WALK_CONT;
 }
 
+/*
+ * Return the bitmap of the sectors that are allocated to the root directory
+ * and to the allocated directories under it.  The bitmap is made by the
+ * first call and kept in FATFS_INFO for the later inode walks.
+ *
+ * @param fatfs File system
+ * @param fs_file File to use while walking the root directory
+ * @returns the bitmap or NULL on error
+ */
+static const uint8_t *
+fatfs_dir_sectors_get(FATFS_INFO * fatfs, TSK_FS_FILE * fs_file)
+{
+    TSK_FS_INFO *fs = &fatfs->fs_info;
+    uint8_t *bitmap;
+    void *cur;
+
+    if ((bitmap = (uint8_t *) tsk_atomic_ptr_load((void *volatile *)
+                &fatfs->dir_sectors_bitmap)) != NULL)
+        return bitmap;
+
+    if ((bitmap =
+            (uint8_t *) tsk_malloc((size_t) ((fs->block_count +
+                        7) / 8))) == NULL) {
+        return NULL;
+    }
+
+    if (tsk_verbose) {
+        tsk_fprintf(stderr,
+            "fatfs_inode_walk: Walking directories to collect sector info\n");
+    }
+
+    /* Manufacture an inode for the root directory. */
+    if (fatfs_make_root(fatfs, fs_file->meta)) {
+        free(bitmap);
+        return NULL;
+    }
+
+    /* Do a file_walk on the root directory to set the bits in the 
+     * directory sectors bitmap for each sector allocated to the root
+     * directory. */
+    if (tsk_fs_file_walk(fs_file,
+            (TSK_FS_FILE_WALK_FLAG_ENUM)(TSK_FS_FILE_WALK_FLAG_SLACK | TSK_FS_FILE_WALK_FLAG_AONLY),
+            inode_walk_file_act, (void*)bitmap)) {
+        free(bitmap);
+        return NULL;
+    }
+
+    /* Now walk recursively through the entire directory tree to set the 
+     * bits in the directory sectors bitmap for each sector allocated to 
+     * the children of the root directory. */
+    if (tsk_fs_dir_walk(fs, fs->root_inum,
+            (TSK_FS_DIR_WALK_FLAG_ENUM)(TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_RECURSE |
+            TSK_FS_DIR_WALK_FLAG_NOORPHAN), inode_walk_dent_act,
+            (void *) bitmap)) {
+        tsk_error_errstr2_concat
+            ("- fatfs_inode_walk: mapping directories");
+        free(bitmap);
+        return NULL;
+    }
+
+    // another thread may have made the bitmap in the meantime
+    if ((cur = tsk_atomic_ptr_cas((void *volatile *)
+                &fatfs->dir_sectors_bitmap, NULL, bitmap)) != NULL) {
+        free(bitmap);
+        bitmap = (uint8_t *) cur;
+    }
+    return bitmap;
+}
+
+/* 1 if sect is in the (possibly NULL) directory sectors bitmap */
+#define FATFS_IS_DIR_SECT(bitmap, sect) \
+    (((bitmap) != NULL) && isset((bitmap), (sect)))
+
+/*
+ * Return 1 if all a_len bytes (a multiple of 8) of a_buf are zero.  A
+ * zeroed 32-byte slot is never a FATXX or exFAT directory entry, so this
+ * is used to skip empty sectors and slots before the full dentry tests.
+ */
+static uint8_t
+fatfs_is_zero(const char *a_buf, size_t a_len)
+{
+    uint64_t acc = 0;
+    size_t i;
+
+    for (i = 0; i < a_len; i += 8) {
+        uint64_t val;
+        memcpy(&val, &a_buf[i], 8);
+        acc |= val;
+    }
+    return acc == 0;
+}
+
 /**
  * Walk the inodes in a specified range and do a TSK_FS_META_WALK_CB callback
  * for each inode that satisfies criteria specified by a set of 
@@ -1081,11 +1222,15 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
     TSK_DADDR_T lsect = 0; 
     TSK_DADDR_T sect = 0; 
     char *dino_buf = NULL;
+    char *clust_buf = NULL;
     FATFS_DENTRY *dep = NULL;
     unsigned int dentry_idx = 0;
-    uint8_t *dir_sectors_bitmap = NULL;
+    const uint8_t *dir_sectors_bitmap = NULL;
     ssize_t cnt = 0;
     uint8_t done = 0;
+    TSK_DADDR_T read_max = 0;
+    TSK_DADDR_T read_sect = 0;
+    TSK_DADDR_T read_cnt = 0;
 
     tsk_error_reset();
     if (fatfs_ptr_arg_is_null(a_fs, "a_fs", func_name) ||
@@ -1189,54 +1334,15 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
         }
     }
 
-    /* Allocate a bitmap to keep track of which sectors are allocated to
-     * directories. */
-    if ((dir_sectors_bitmap =
-            (uint8_t*)tsk_malloc((size_t) ((a_fs->block_count +
-                        7) / 8))) == NULL) {
-        tsk_fs_file_close(fs_file);
-        return 1;
-    }
-
-    /* If not doing an orphan files search, populate the directory sectors 
-     * bitmap. The bitmap will be used to make sure that no sector marked as
-     * allocated to a directory is skipped when searching for directory 
-     * entries to map to inodes. */
+    /* If not doing an orphan files search, get the bitmap of the sectors
+     * that are allocated to directories. The bitmap will be used to make
+     * sure that no sector marked as allocated to a directory is skipped when
+     * searching for directory entries to map to inodes. An orphan files
+     * search uses an empty bitmap. */
     if ((flags & TSK_FS_META_FLAG_ORPHAN) == 0) {
-        if (tsk_verbose) {
-            tsk_fprintf(stderr,
-                "fatfs_inode_walk: Walking directories to collect sector info\n");
-        }
-
-        /* Manufacture an inode for the root directory. */
-        if (fatfs_make_root(fatfs, fs_file->meta)) {
+        if ((dir_sectors_bitmap =
+                fatfs_dir_sectors_get(fatfs, fs_file)) == NULL) {
             tsk_fs_file_close(fs_file);
-            free(dir_sectors_bitmap);
-            return 1;
-        }
-
-        /* Do a file_walk on the root directory to set the bits in the 
-         * directory sectors bitmap for each sector allocated to the root
-         * directory. */
-        if (tsk_fs_file_walk(fs_file,
-                (TSK_FS_FILE_WALK_FLAG_ENUM)(TSK_FS_FILE_WALK_FLAG_SLACK | TSK_FS_FILE_WALK_FLAG_AONLY),
-                inode_walk_file_act, (void*)dir_sectors_bitmap)) {
-            tsk_fs_file_close(fs_file);
-            free(dir_sectors_bitmap);
-            return 1;
-        }
-
-        /* Now walk recursively through the entire directory tree to set the 
-         * bits in the directory sectors bitmap for each sector allocated to 
-         * the children of the root directory. */
-        if (tsk_fs_dir_walk(a_fs, a_fs->root_inum,
-                (TSK_FS_DIR_WALK_FLAG_ENUM)(TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_RECURSE |
-                TSK_FS_DIR_WALK_FLAG_NOORPHAN), inode_walk_dent_act,
-                (void *) dir_sectors_bitmap)) {
-            tsk_error_errstr2_concat
-                ("- fatfs_inode_walk: mapping directories");
-            tsk_fs_file_close(fs_file);
-            free(dir_sectors_bitmap);
             return 1;
         }
     }
@@ -1261,7 +1367,6 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
             ("%s: Begin inode in sector too big for image: %"
             PRIuDADDR, func_name, ssect);
         tsk_fs_file_close(fs_file);
-        free(dir_sectors_bitmap);
         return 1;
     }
 
@@ -1273,15 +1378,17 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
             ("%s: End inode in sector too big for image: %"
             PRIuDADDR, func_name, lsect);
         tsk_fs_file_close(fs_file);
-        free(dir_sectors_bitmap);
         return 1;
     }
 
-    /* Allocate a buffer big enough to read in a cluster at a time. */
-    if ((dino_buf = (char*)tsk_malloc(fatfs->csize << fatfs->ssize_sh)) ==
+    /* Allocate a buffer big enough to read in several clusters at a time. */
+    read_max = (FATFS_INODE_WALK_READ_B >> fatfs->ssize_sh) / fatfs->csize *
+        fatfs->csize;
+    if (read_max < fatfs->csize)
+        read_max = fatfs->csize;
+    if ((dino_buf = (char*)tsk_malloc((size_t) read_max << fatfs->ssize_sh)) ==
         NULL) {
         tsk_fs_file_close(fs_file);
-        free(dir_sectors_bitmap);
         return 1;
     }
 
@@ -1295,9 +1402,8 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
 
         /* Read in a chunk of the image to process on this iteration of the inode
          * walk. The actual size of the read will depend on whether or not it is 
-         * coming from the root directory of a FAT12 or FAT16 file system. As 
-         * indicated by the size of the buffer, the data area (exFAT cluster 
-         * heap) will for the most part be read in a cluster at a time. 
+         * coming from the root directory of a FAT12 or FAT16 file system. The
+         * data area (exFAT cluster heap) is read a cluster or more at a time.
          * However, the root directory for a FAT12/FAT16 file system precedes 
          * the data area and the read size for it should be a sector, not a 
          * cluster. */
@@ -1321,13 +1427,14 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
                     ("%s (root dir): sector: %" PRIuDADDR,
                     func_name, sect);
                 tsk_fs_file_close(fs_file);
-                free(dir_sectors_bitmap);
                 free(dino_buf);
                 return 1;
             }
 
             cluster_is_alloc = 1;
             num_sectors_to_process = 1;
+            clust_buf = dino_buf;
+            read_cnt = 0;
         }
         else {
             /* The walk has proceeded into the data area (exFAT cluster heap).
@@ -1348,7 +1455,6 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
             }
             else if (cluster_is_alloc == -1) {
                 tsk_fs_file_close(fs_file);
-                free(dir_sectors_bitmap);
                 free(dino_buf);
                 return 1;
             }
@@ -1357,7 +1463,7 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
              * directory, then skip it.  NOTE: This will miss orphan file 
              * entries in the slack space of files.
              */
-            if ((cluster_is_alloc == 1) && (isset(dir_sectors_bitmap, sect) == 0)) {
+            if ((cluster_is_alloc == 1) && (FATFS_IS_DIR_SECT(dir_sectors_bitmap, sect) == 0)) {
                 sect += fatfs->csize;
                 continue;
             }
@@ -1370,21 +1476,65 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
                 num_sectors_to_process = fatfs->csize;
             }
 
-            /* Read in a cluster. */
-            cnt = tsk_fs_read_block
-                (a_fs, sect, dino_buf, num_sectors_to_process << fatfs->ssize_sh);
-            if (cnt != (ssize_t)(num_sectors_to_process << fatfs->ssize_sh)) {
-                if (cnt >= 0) {
+            /* Read in the cluster, unless it is already in the buffer. The
+             * clusters after it that will also be processed are read along
+             * with it, so that runs of unallocated and directory clusters are
+             * scanned with one large read. */
+            if ((sect < read_sect) ||
+                (sect + num_sectors_to_process > read_sect + read_cnt)) {
+                TSK_DADDR_T nsect = num_sectors_to_process;
+
+                while (((nsect % fatfs->csize) == 0) &&
+                    (nsect + fatfs->csize <= read_max) &&
+                    (sect + nsect <= lsect)) {
+                    TSK_DADDR_T next = sect + nsect;
+                    int next_alloc = fatfs_is_sectalloc(fatfs, next);
+
+                    if (next_alloc == -1) {
+                        // the walk will report the error when it gets there
+                        tsk_error_reset();
+                        break;
+                    }
+                    else if ((next_alloc == 0) &&
+                        ((flags & TSK_FS_META_FLAG_UNALLOC) == 0)) {
+                        break;
+                    }
+                    else if ((next_alloc == 1) &&
+                        (FATFS_IS_DIR_SECT(dir_sectors_bitmap, next) == 0)) {
+                        break;
+                    }
+
+                    if (lsect - next + 1 < fatfs->csize)
+                        nsect += lsect - next + 1;
+                    else
+                        nsect += fatfs->csize;
+                }
+
+                cnt = tsk_fs_read_block
+                    (a_fs, sect, dino_buf, (size_t) nsect << fatfs->ssize_sh);
+                if ((cnt != (ssize_t)(nsect << fatfs->ssize_sh)) &&
+                    (nsect > num_sectors_to_process)) {
+                    // try again with only this cluster
                     tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                    nsect = num_sectors_to_process;
+                    cnt = tsk_fs_read_block
+                        (a_fs, sect, dino_buf, num_sectors_to_process << fatfs->ssize_sh);
                 }
-                tsk_error_set_errstr2("%s: sector: %"
-                    PRIuDADDR, func_name, sect);
-                tsk_fs_file_close(fs_file);
-                free(dir_sectors_bitmap);
-                free(dino_buf);
-                return 1;
+                if (cnt != (ssize_t)(nsect << fatfs->ssize_sh)) {
+                    if (cnt >= 0) {
+                        tsk_error_reset();
+                        tsk_error_set_errno(TSK_ERR_FS_READ);
+                    }
+                    tsk_error_set_errstr2("%s: sector: %"
+                        PRIuDADDR, func_name, sect);
+                    tsk_fs_file_close(fs_file);
+                    free(dino_buf);
+                    return 1;
+                }
+                read_sect = sect;
+                read_cnt = nsect;
             }
+            clust_buf = &dino_buf[(sect - read_sect) << fatfs->ssize_sh];
         }
 
         /* Now that the sectors are read in, prepare to step through them in 
@@ -1392,7 +1542,7 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
          * contents of each chunk is a directory entry unless the sector that
          * contains it is not allocated to a directory or is unallocated.*/
         do_basic_dentry_test = 1;
-        if ((isset(dir_sectors_bitmap, sect) == 0) || (cluster_is_alloc == 0)) {
+        if ((FATFS_IS_DIR_SECT(dir_sectors_bitmap, sect) == 0) || (cluster_is_alloc == 0)) {
             do_basic_dentry_test = 0;
         }
 
@@ -1409,11 +1559,17 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
 
             /* Advance the directory entry pointer to the start of the 
              * sector. */
-            dep = (FATFS_DENTRY*)(&dino_buf[sector_idx << fatfs->ssize_sh]);
+            dep = (FATFS_DENTRY*)(&clust_buf[sector_idx << fatfs->ssize_sh]);
+
+            /* Sectors of zeros do not hold any directory entries. */
+            if (fatfs_is_zero((const char *) dep, fatfs->ssize)) {
+                sect++;
+                continue;
+            }
 
             /* If the sector is not allocated to a directory and the first 
              * chunk is not a directory entry, skip the sector. */
-            if (!isset(dir_sectors_bitmap, sect) &&
+            if (!FATFS_IS_DIR_SECT(dir_sectors_bitmap, sect) &&
                 !fatfs->is_dentry(fatfs, dep, (FATFS_DATA_UNIT_ALLOC_STATUS_ENUM)cluster_is_alloc, do_basic_dentry_test)) {
                 sect++;
                 continue;
@@ -1446,6 +1602,11 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
                     break;
                 }
 
+                /* Zeroed slots are skipped before the full dentry tests. */
+                if (fatfs_is_zero((const char *) dep, sizeof(FATFS_DENTRY))) {
+                    continue;
+                }
+
                 /* If the potential entry is likely not an entry, or it is an  
                  * entry that is not reported in an inode walk, or it does not   
                  * satisfy the inode selection flags, then skip it. */
@@ -1467,7 +1628,6 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
                     }
                     else {
                         tsk_fs_file_close(fs_file);
-                        free(dir_sectors_bitmap);
                         free(dino_buf);
                         return 1;
                     }
@@ -1484,13 +1644,11 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
                 retval = a_action(fs_file, a_ptr);
                 if (retval == TSK_WALK_STOP) {
                     tsk_fs_file_close(fs_file);
-                    free(dir_sectors_bitmap);
                     free(dino_buf);
                     return 0;
                 }
                 else if (retval == TSK_WALK_ERROR) {
                     tsk_fs_file_close(fs_file);
-                    free(dir_sectors_bitmap);
                     free(dino_buf);
                     return 1;
                 }
@@ -1505,7 +1663,6 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
         }
     }
 
-    free(dir_sectors_bitmap);
     free(dino_buf);
 
     // handle the virtual orphans folder and FAT files if they asked for them
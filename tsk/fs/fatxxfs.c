@@ -787,6 +787,7 @@ fatxxfs_open(FATFS_INFO *fatfs)
      */
 
     fs->block_walk = fatfs_block_walk;
+    fs->block_run_walk = fatfs_block_run_walk;
     fs->block_getflags = fatfs_block_getflags;
 
     fs->inode_walk = fatfs_inode_walk;
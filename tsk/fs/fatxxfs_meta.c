@@ -605,29 +605,35 @@ fatxxfs_dinode_copy(FATFS_INFO *a_fatfs, TSK_INUM_T a_inum,
     if ((dentry->attrib & FATFS_ATTR_DIRECTORY) &&
         ((dentry->attrib & FATFS_ATTR_LFN) != FATFS_ATTR_LFN)) {
         if (fs_meta->flags & TSK_FS_META_FLAG_ALLOC) {
-            TSK_LIST *list_seen = NULL;
+            FATFS_CLUST_SEEN seen;
 
             /* count the total number of clusters in this file */
             TSK_DADDR_T clust = FATXXFS_DENTRY_CLUST(fs, dentry);
             int cnum = 0;
 
+            memset(&seen, 0, sizeof(seen));
+
             while ((clust) && (0 == FATFS_ISEOF(clust, a_fatfs->mask))) {
                 TSK_DADDR_T nxt;
+                TSK_DADDR_T run_len = fatfs_getFAT_run(a_fatfs, clust);
+                TSK_DADDR_T loop_clust;
 
                 /* Make sure we do not get into an infinite loop */
-                if (tsk_list_find(list_seen, clust)) {
+                if ((loop_clust = fatfs_clust_seen_find(&seen, clust,
+                            clust + run_len - 1)) != 0) {
+                    cnum += (int) (loop_clust - clust);
                     if (tsk_verbose)
                         tsk_fprintf(stderr,
                             "Loop found while determining directory size\n");
                     break;
                 }
-                if (tsk_list_add(&list_seen, clust)) {
-                    tsk_list_free(list_seen);
-                    list_seen = NULL;
+                if (fatfs_clust_seen_add(&seen, clust, clust + run_len - 1)) {
+                    fatfs_clust_seen_free(&seen);
                     return TSK_ERR;
                 }
 
-                cnum++;
+                cnum += (int) run_len;
+                clust += run_len - 1;
 
                 if (fatfs_getFAT(a_fatfs, clust, &nxt))
                     break;
@@ -635,8 +641,7 @@ fatxxfs_dinode_copy(FATFS_INFO *a_fatfs, TSK_INUM_T a_inum,
                     clust = nxt;
             }
 
-            tsk_list_free(list_seen);
-            list_seen = NULL;
+            fatfs_clust_seen_free(&seen);
 
             fs_meta->size =
                 (TSK_OFF_T) ((cnum * a_fatfs->csize) << a_fatfs->ssize_sh);
@@ -32,7 +32,51 @@
 
 
 
-/* ffs_group_load - load cylinder group descriptor info into cache
+/* ffs_group_read - read a cylinder group block and check its offsets
+ *
+ * Trust that a cylinder group always fits within a logical disk block
+ * (as promised in the 4.4BSD <ufs/ffs/fs.h> include file).
+ *
+ * @param a_buf Buffer of ffs->ffsbsize_b bytes
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ffs_group_read(FFS_INFO * ffs, FFS_GRPNUM_T grp_num, TSK_DADDR_T addr,
+    char *a_buf)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ffs->fs_info;
+    ffs_cgd *cg;
+    ssize_t cnt;
+
+    cnt = tsk_fs_read_block(fs, addr, a_buf, ffs->ffsbsize_b);
+    if (cnt != ffs->ffsbsize_b) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
+            " at %" PRIuDADDR, grp_num, addr);
+        return 1;
+    }
+
+    /* Perform a sanity check on the data to make sure offsets are in range */
+    cg = (ffs_cgd *) a_buf;
+    if ((tsk_gets32(fs->endian, cg->cg_iusedoff) > (int)ffs->ffsbsize_b)
+        || (tsk_gets32(fs->endian, cg->cg_freeoff) > (int)ffs->ffsbsize_b)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
+            " descriptor offsets too large at %" PRIuDADDR, grp_num,
+            addr);
+        return 1;
+    }
+    return 0;
+}
+
+/* ffs_group_load - load cylinder group descriptor info into the single
+ * group buffer.  This is used once the memory budget of the per-group
+ * cache (ffs_group_get) has been used.
  *
  * Note: This routine assumes &ffs->lock is locked by the caller.
  *
@@ -57,9 +101,7 @@ ffs_group_load(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
     }
 
     /*
-     * Allocate/read cylinder group info on the fly. Trust that a cylinder
-     * group always fits within a logical disk block (as promised in the
-     * 4.4BSD <ufs/ffs/fs.h> include file).
+     * Allocate/read cylinder group info on the fly.
      */
     if (ffs->grp_buf == NULL) {
         if ((ffs->grp_buf = tsk_malloc(ffs->ffsbsize_b)) == NULL) {
@@ -69,37 +111,132 @@ ffs_group_load(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
 
     addr = cgtod_lcl(fs, ffs->fs.sb1, grp_num);
     if (ffs->grp_addr != addr) {
-        ffs_cgd *cg;
-        ssize_t cnt;
-        cnt = tsk_fs_read_block(fs, addr, ffs->grp_buf, ffs->ffsbsize_b);
-        if (cnt != ffs->ffsbsize_b) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
-            }
-            tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
-                " at %" PRIuDADDR, grp_num, addr);
+        if (ffs_group_read(ffs, grp_num, addr, ffs->grp_buf)) {
+            // the buffer no longer holds the old group
+            ffs->grp_addr = 0;
             return 1;
         }
         ffs->grp_addr = addr;
-
-        /* Perform a sanity check on the data to make sure offsets are in range */
-        cg = (ffs_cgd *) ffs->grp_buf;
-        if ((tsk_gets32(fs->endian, cg->cg_iusedoff) > (int)ffs->ffsbsize_b)
-            || (tsk_gets32(fs->endian, cg->cg_freeoff) > (int)ffs->ffsbsize_b)) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
-            tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
-                " descriptor offsets too large at %" PRIuDADDR, grp_num,
-                addr);
-            return 1;
-        }
     }
 
     ffs->grp_num = grp_num;
     return 0;
 }
 
+/* ffs_group_get - get the cylinder group block of a group.  The block
+ * comes from the per-group cache, which reads it on first use.  Once the
+ * memory budget for the cache has been used, the single group buffer is
+ * loaded instead and &ffs->lock is held until ffs_group_put is called.
+ *
+ * Note: The caller must not hold &ffs->lock.
+ *
+ * return the group block or NULL on error (and the lock is not held)
+ * */
+static const ffs_cgd *
+ffs_group_get(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ffs->fs_info;
+    void *cur;
+    char *buf;
+
+    if (grp_num >= ffs->groups_count) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("ffs_group_load: invalid cylinder group number: %" PRI_FFSGRP
+            "", grp_num);
+        return NULL;
+    }
+
+    if (ffs->grp_cache != NULL) {
+        if ((cur = tsk_atomic_ptr_load(&ffs->grp_cache[grp_num])) != NULL)
+            return (const ffs_cgd *) cur;
+
+        // reserve the memory before reading the group
+        if (tsk_atomic_add(&ffs->grp_cache_used,
+                ffs->ffsbsize_b) <= ffs->grp_cache_max) {
+            if ((buf = tsk_malloc(ffs->ffsbsize_b)) == NULL) {
+                tsk_atomic_add(&ffs->grp_cache_used,
+                    (size_t) 0 - ffs->ffsbsize_b);
+                return NULL;
+            }
+            if (ffs_group_read(ffs, grp_num, cgtod_lcl(fs, ffs->fs.sb1,
+                        grp_num), buf)) {
+                free(buf);
+                tsk_atomic_add(&ffs->grp_cache_used,
+                    (size_t) 0 - ffs->ffsbsize_b);
+                return NULL;
+            }
+
+            // another thread may have loaded the same group in the meantime
+            if ((cur = tsk_atomic_ptr_cas(&ffs->grp_cache[grp_num], NULL,
+                        buf)) != NULL) {
+                free(buf);
+                tsk_atomic_add(&ffs->grp_cache_used,
+                    (size_t) 0 - ffs->ffsbsize_b);
+                return (const ffs_cgd *) cur;
+            }
+            return (const ffs_cgd *) buf;
+        }
+        tsk_atomic_add(&ffs->grp_cache_used, (size_t) 0 - ffs->ffsbsize_b);
+    }
+
+    // the per-group cache is full, use the single group buffer
+    tsk_take_lock(&ffs->lock);
+    if (ffs_group_load(ffs, grp_num)) {
+        tsk_release_lock(&ffs->lock);
+        return NULL;
+    }
+    return (const ffs_cgd *) ffs->grp_buf;
+}
+
+/* ffs_group_put - release a group block from ffs_group_get
+ * */
+static void
+ffs_group_put(FFS_INFO * ffs, const ffs_cgd * a_cg)
+{
+    if ((a_cg != NULL) && ((const char *) a_cg == ffs->grp_buf))
+        tsk_release_lock(&ffs->lock);
+}
+
+
+/* ffs_inode_inited - check if an inode has been initialized.  UFS2 does
+ * not initialize all inodes when the file system is created, so the
+ * cylinder group descriptor tells which ones are in the valid range.
+ *
+ * @param a_end [out] If not NULL, set to the inode after the last
+ * initialized inode of the group
+ *
+ * return -1 on error, 1 if the inode is initialized and 0 if not
+ * */
+static int
+ffs_inode_inited(FFS_INFO * ffs, TSK_INUM_T inum, TSK_INUM_T * a_end)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ffs->fs_info;
+    TSK_INUM_T ipg = (TSK_INUM_T) tsk_gets32(fs->endian,
+        ffs->fs.sb1->cg_inode_num);
+    const ffs_cgd2 *cg2;
+    FFS_GRPNUM_T grp_num;
+    TSK_INUM_T inited;
+
+    grp_num = (FFS_GRPNUM_T) itog_lcl(fs, ffs->fs.sb1, inum);
+    if (fs->ftype != TSK_FS_TYPE_FFS2) {
+        if (a_end)
+            *a_end = ((TSK_INUM_T) grp_num + 1) * ipg;
+        return 1;
+    }
+
+    if ((cg2 = (const ffs_cgd2 *) ffs_group_get(ffs, grp_num)) == NULL)
+        return -1;
+    inited = tsk_getu32(fs->endian, cg2->cg_initediblk);
+    ffs_group_put(ffs, (const ffs_cgd *) cg2);
+
+    if (inited > ipg)
+        inited = ipg;
+    if (a_end)
+        *a_end = (TSK_INUM_T) grp_num * ipg + inited;
+    return ((inum - (TSK_INUM_T) grp_num * ipg) < inited) ? 1 : 0;
+}
 
 /*
  * ffs_dinode_load - read disk inode and load the data into ffs_inode structure
@@ -112,6 +249,8 @@ ffs_dinode_load(FFS_INFO * ffs, TSK_INUM_T inum, ffs_inode * dino_buf)
     TSK_DADDR_T addr;
     TSK_OFF_T offs;
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & ffs->fs_info;
+    size_t isize;
+    int inited;
 
     /*
      * Sanity check.
@@ -124,6 +263,29 @@ ffs_dinode_load(FFS_INFO * ffs, TSK_INUM_T inum, ffs_inode * dino_buf)
         return 1;
     }
 
+    if (dino_buf == NULL)
+        return 1;
+
+    /* If the inode is not init, then do not worry about it */
+    if ((inited = ffs_inode_inited(ffs, inum, NULL)) < 0)
+        return 1;
+    if (inited == 0) {
+        memset((char *) dino_buf, 0, sizeof(ffs_inode2));
+        return 0;
+    }
+
+    if (fs->ftype == TSK_FS_TYPE_FFS2) {
+        isize = sizeof(ffs_inode2);
+        offs = itoo_lcl(fs, ffs->fs.sb2, inum) * isize;
+    }
+    else {
+        isize = sizeof(ffs_inode1);
+        offs = itoo_lcl(fs, ffs->fs.sb1, inum) * isize;
+    }
+
+    /* Get the base and offset addr for the inode in the tbl */
+    addr = itod_lcl(fs, ffs->fs.sb1, inum);
+
     /*
      * Allocate/read the inode table buffer on the fly.
      */
@@ -138,101 +300,113 @@ ffs_dinode_load(FFS_INFO * ffs, TSK_INUM_T inum, ffs_inode * dino_buf)
         }
     }
 
-
-    /* UFS2 is different because it does not initialize all inodes
-     * when the file system is created.  Therefore we need to check
-     * the group descriptor to find out if this is in the valid
-     * range
-     */
-    if (fs->ftype == TSK_FS_TYPE_FFS2) {
-        ffs_cgd2 *cg2;
-        FFS_GRPNUM_T grp_num;
-
-        if (dino_buf == NULL) {
+    if (ffs->itbl_addr != addr) {
+        ssize_t cnt;
+        cnt = tsk_fs_read_block(fs, addr, ffs->itbl_buf, ffs->ffsbsize_b);
+        if (cnt != ffs->ffsbsize_b) {
+            // the buffer no longer holds the old inode block
+            ffs->itbl_addr = 0;
             tsk_release_lock(&ffs->lock);
+            if (cnt >= 0) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_READ);
+            }
+            tsk_error_set_errstr2("ffs_dinode_load: %s inode table at %"
+                PRIuDADDR, (fs->ftype == TSK_FS_TYPE_FFS2) ? "FFS2" :
+                "FFS1", addr);
             return 1;
         }
+        ffs->itbl_addr = addr;
+    }
 
-        /* Lookup the cylinder group descriptor if it isn't
-         * cached
-         */
-        grp_num = (FFS_GRPNUM_T) itog_lcl(fs, ffs->fs.sb1, inum);
-        if (ffs_group_load(ffs, grp_num)) {
-            tsk_release_lock(&ffs->lock);
-            return 1;
-        }
+    memcpy((char *) dino_buf, ffs->itbl_buf + offs, isize);
 
-        cg2 = (ffs_cgd2 *) ffs->grp_buf;
+    tsk_release_lock(&ffs->lock);
 
-        /* If the inode is not init, then do not worry about it */
-        if ((inum - grp_num * tsk_getu32(fs->endian,
-                    ffs->fs.sb2->cg_inode_num)) >= tsk_getu32(fs->endian,
-                cg2->cg_initediblk)) {
-            memset((char *) dino_buf, 0, sizeof(ffs_inode2));
-        }
+    return 0;
+}
 
-        else {
-            /* Get the base and offset addr for the inode in the tbl */
-            addr = itod_lcl(fs, ffs->fs.sb1, inum);
+/* Maximum number of bytes of inode table that ffs_inode_walk reads at once */
+#define FFS_ITABLE_READ_MAX (1024 * 1024)
 
-            if (ffs->itbl_addr != addr) {
-                ssize_t cnt;
-                cnt = tsk_fs_read_block
-                    (fs, addr, ffs->itbl_buf, ffs->ffsbsize_b);
-                if (cnt != ffs->ffsbsize_b) {
-                    tsk_release_lock(&ffs->lock);
-                    if (cnt >= 0) {
-                        tsk_error_reset();
-                        tsk_error_set_errno(TSK_ERR_FS_READ);
-                    }
-                    tsk_error_set_errstr2
-                        ("ffs_dinode_load: FFS2 inode table at %"
-                        PRIuDADDR, addr);
-                    return 1;
-                }
-                ffs->itbl_addr = addr;
-            }
+/* Buffer with a part of an inode table, used by ffs_inode_walk */
+typedef struct {
+    char *buf;                  ///< FFS_ITABLE_READ_MAX bytes
+    TSK_OFF_T off;              ///< Byte offset of buf in the file system
+    size_t len;                 ///< Number of valid bytes in buf
+    TSK_INUM_T last_inum;       ///< Last inode that the walk will need
+} FFS_ITABLE_BUF;
+
+/* ffs_itable_load - copy a disk inode out of the inode table buffer,
+ * refilling the buffer with the rest of the group's inode table when the
+ * inode is not in it.  The inode table of a cylinder group is contiguous,
+ * so one read covers many inode blocks.
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ffs_itable_load(FFS_INFO * ffs, FFS_ITABLE_BUF * a_itbuf,
+    TSK_INUM_T a_inum, ffs_inode * dino_buf)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ffs->fs_info;
+    TSK_INUM_T ipg = (TSK_INUM_T) tsk_gets32(fs->endian,
+        ffs->fs.sb1->cg_inode_num);
+    size_t isize = (fs->ftype == TSK_FS_TYPE_FFS2) ?
+        sizeof(ffs_inode2) : sizeof(ffs_inode1);
+    TSK_INUM_T grp_end;
+    TSK_OFF_T blk_addr, addr, end;
+    ssize_t cnt;
+    int inited;
 
-            offs = itoo_lcl(fs, ffs->fs.sb2, inum) * sizeof(ffs_inode2);
+    if ((a_inum < fs->first_inum) || (a_inum > fs->last_inum - 1)
+        || (ipg == 0)) {
+        // let the single inode version report the error
+        return ffs_dinode_load(ffs, a_inum, dino_buf);
+    }
 
-            memcpy((char *) dino_buf, ffs->itbl_buf + offs,
-                sizeof(ffs_inode2));
-        }
+    /* If the inode is not init, then do not worry about it */
+    if ((inited = ffs_inode_inited(ffs, a_inum, &grp_end)) < 0)
+        return 1;
+    if (inited == 0) {
+        memset((char *) dino_buf, 0, sizeof(ffs_inode2));
+        return 0;
     }
-    else {
-        if (dino_buf == NULL) {
-            tsk_release_lock(&ffs->lock);
-            return 1;
-        }
 
-        addr = itod_lcl(fs, ffs->fs.sb1, inum);
-        if (ffs->itbl_addr != addr) {
-            ssize_t cnt;
-            cnt =
-                tsk_fs_read_block(fs, addr, ffs->itbl_buf,
-                ffs->ffsbsize_b);
-            if (cnt != ffs->ffsbsize_b) {
-                tsk_release_lock(&ffs->lock);
-                if (cnt >= 0) {
-                    tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_READ);
-                }
-                tsk_error_set_errstr2
-                    ("ffs_dinode_load: FFS1 inode table at %" PRIuDADDR,
-                    addr);
-                return 1;
-            }
-            ffs->itbl_addr = addr;
+    blk_addr = (TSK_OFF_T) itod_lcl(fs, ffs->fs.sb1, a_inum) * fs->block_size;
+    addr = blk_addr + (TSK_OFF_T) itoo_lcl(fs, ffs->fs.sb1, a_inum) * isize;
+
+    if ((addr < a_itbuf->off)
+        || (addr + (TSK_OFF_T) isize >
+            a_itbuf->off + (TSK_OFF_T) a_itbuf->len)) {
+
+        /* Read whole inode blocks up to the end of the group's
+         * (initialized) inode table or the last inode that the walk
+         * needs */
+        if (grp_end > a_itbuf->last_inum + 1)
+            grp_end = a_itbuf->last_inum + 1;
+        end = addr + (TSK_OFF_T) (grp_end - a_inum) * isize;
+        end = blk_addr + roundup(end - blk_addr, ffs->ffsbsize_b);
+        if (end - blk_addr > FFS_ITABLE_READ_MAX)
+            end = blk_addr + FFS_ITABLE_READ_MAX;
+
+        a_itbuf->off = blk_addr;
+        a_itbuf->len = 0;
+        cnt = tsk_fs_read(fs, blk_addr, a_itbuf->buf,
+            (size_t) (end - blk_addr));
+
+        /* Only use the complete blocks, so that a short read fails at
+         * the same inode as reading it by itself */
+        if (cnt > 0)
+            cnt -= cnt % ffs->ffsbsize_b;
+        if (cnt <= 0) {
+            // let the single inode version report the error
+            tsk_error_reset();
+            return ffs_dinode_load(ffs, a_inum, dino_buf);
         }
-
-        offs = itoo_lcl(fs, ffs->fs.sb1, inum) * sizeof(ffs_inode1);
-
-        memcpy((char *) dino_buf, ffs->itbl_buf + offs,
-            sizeof(ffs_inode1));
+        a_itbuf->len = (size_t) cnt;
     }
 
-    tsk_release_lock(&ffs->lock);
-
+    memcpy((char *) dino_buf, &a_itbuf->buf[addr - a_itbuf->off], isize);
     return 0;
 }
 
@@ -312,8 +486,8 @@ ffs_dinode_copy(FFS_INFO * ffs, TSK_FS_META * fs_meta,
     unsigned int count;
     TSK_FS_INFO *fs = &(ffs->fs_info);
     FFS_GRPNUM_T grp_num;
-    ffs_cgd *cg;
-    unsigned char *inosused = NULL;
+    const ffs_cgd *cg;
+    const unsigned char *inosused = NULL;
     TSK_INUM_T ibase;
 
     if (dino_buf == NULL) {
@@ -740,22 +914,17 @@ ffs_dinode_copy(FFS_INFO * ffs, TSK_FS_META * fs_meta,
     /* set the flags */
     grp_num = (FFS_GRPNUM_T) itog_lcl(fs, ffs->fs.sb1, dino_inum);
 
-    tsk_take_lock(&ffs->lock);
-    if (ffs_group_load(ffs, grp_num)) {
-        tsk_release_lock(&ffs->lock);
+    if ((cg = ffs_group_get(ffs, grp_num)) == NULL)
         return 1;
-    }
-
-    cg = (ffs_cgd *) ffs->grp_buf;
 
-    inosused = (unsigned char *) cg_inosused_lcl(fs, cg);
+    inosused = (const unsigned char *) cg_inosused_lcl(fs, cg);
     ibase = grp_num * tsk_gets32(fs->endian, ffs->fs.sb1->cg_inode_num);
 
     /* get the alloc flag */
     fs_meta->flags = (isset(inosused, dino_inum - ibase) ?
         TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-    tsk_release_lock(&ffs->lock);
+    ffs_group_put(ffs, cg);
 
     /* used/unused */
     fs_meta->flags |= (fs_meta->ctime ?
@@ -846,14 +1015,15 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 {
     char *myname = "ffs_inode_walk";
     FFS_INFO *ffs = (FFS_INFO *) fs;
-    ffs_cgd *cg = NULL;
+    const ffs_cgd *cg = NULL;
     TSK_INUM_T inum;
-    unsigned char *inosused = NULL;
+    const unsigned char *inosused = NULL;
     TSK_FS_FILE *fs_file;
     unsigned int myflags;
     TSK_INUM_T ibase = 0;
     TSK_INUM_T end_inum_tmp;
     ffs_inode *dino_buf;
+    FFS_ITABLE_BUF itbuf;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -929,6 +1099,16 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     if ((dino_buf = (ffs_inode *) tsk_malloc(sizeof(ffs_inode2))) == NULL)
         return 1;
 
+    /* The inode tables are read in large chunks instead of one block
+     * at a time */
+    memset(&itbuf, 0, sizeof(itbuf));
+    itbuf.last_inum = end_inum_tmp;
+    if ((itbuf.buf = (char *) tsk_malloc(FFS_ITABLE_READ_MAX)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        free(dino_buf);
+        return 1;
+    }
+
     /*
      * Iterate. This is easy because inode numbers are contiguous, unlike
      * data blocks which are interleaved with cylinder group blocks.
@@ -942,14 +1122,13 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
          */
         grp_num = itog_lcl(fs, ffs->fs.sb1, inum);
 
-        tsk_take_lock(&ffs->lock);
-        if (ffs_group_load(ffs, grp_num)) {
-            tsk_release_lock(&ffs->lock);
+        if ((cg = ffs_group_get(ffs, grp_num)) == NULL) {
+            tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
-        cg = (ffs_cgd *) ffs->grp_buf;
-        inosused = (unsigned char *) cg_inosused_lcl(fs, cg);
+        inosused = (const unsigned char *) cg_inosused_lcl(fs, cg);
         ibase =
             grp_num * tsk_gets32(fs->endian, ffs->fs.sb1->cg_inode_num);
 
@@ -959,15 +1138,16 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         myflags = (isset(inosused, inum - ibase) ?
             TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-        tsk_release_lock(&ffs->lock);
+        ffs_group_put(ffs, cg);
 
         if ((a_flags & myflags) != myflags)
             continue;
 
 
-        if (ffs_dinode_load(ffs, inum, dino_buf)) {
+        if (ffs_itable_load(ffs, &itbuf, inum, dino_buf)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
 
@@ -1014,6 +1194,7 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (ffs_dinode_copy(ffs, fs_file->meta, inum, dino_buf)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
 
@@ -1021,11 +1202,13 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
     }
@@ -1039,6 +1222,7 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
         /* call action */
@@ -1046,11 +1230,13 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbuf.buf);
             return 1;
         }
     }
@@ -1060,6 +1246,7 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
      */
     tsk_fs_file_close(fs_file);
     free(dino_buf);
+    free(itbuf.buf);
 
     return 0;
 }
@@ -1070,11 +1257,11 @@ ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
 {
     FFS_INFO *ffs = (FFS_INFO *) a_fs;
     FFS_GRPNUM_T grp_num;
-    ffs_cgd *cg = 0;
+    const ffs_cgd *cg = 0;
     TSK_DADDR_T frag_base = 0;
     TSK_DADDR_T dblock_addr = 0;        /* first data block in group */
     TSK_DADDR_T sblock_addr = 0;        /* super block in group */
-    unsigned char *freeblocks = NULL;
+    const unsigned char *freeblocks = NULL;
     int flags;
 
     // sparse
@@ -1083,14 +1270,10 @@ ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
 
     grp_num = dtog_lcl(a_fs, ffs->fs.sb1, a_addr);
 
-    tsk_take_lock(&ffs->lock);
-    if (ffs_group_load(ffs, grp_num)) {
-        tsk_release_lock(&ffs->lock);
+    if ((cg = ffs_group_get(ffs, grp_num)) == NULL)
         return 0;
-    }
 
-    cg = (ffs_cgd *) ffs->grp_buf;
-    freeblocks = (unsigned char *) cg_blksfree_lcl(a_fs, cg);
+    freeblocks = (const unsigned char *) cg_blksfree_lcl(a_fs, cg);
 
     // get the base fragment for the group
     frag_base = cgbase_lcl(a_fs, ffs->fs.sb1, grp_num);
@@ -1109,7 +1292,7 @@ ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
     flags = (isset(freeblocks, a_addr - frag_base) ?
         TSK_FS_BLOCK_FLAG_UNALLOC : TSK_FS_BLOCK_FLAG_ALLOC);
 
-    tsk_release_lock(&ffs->lock);
+    ffs_group_put(ffs, cg);
 
     if (a_addr >= sblock_addr && a_addr < dblock_addr)
         flags |= TSK_FS_BLOCK_FLAG_META;
@@ -1303,7 +1486,7 @@ ffs_fsstat(TSK_FS_INFO * fs, FILE * hFile)
     unsigned int i;
     time_t tmptime;
     ffs_csum1 *csum1 = NULL;
-    ffs_cgd *cgd = NULL;
+    const ffs_cgd *cgd = NULL;
 
     FFS_INFO *ffs = (FFS_INFO *) fs;
     ffs_sb1 *sb1 = ffs->fs.sb1;
@@ -1483,12 +1666,8 @@ ffs_fsstat(TSK_FS_INFO * fs, FILE * hFile)
 
     for (i = 0; i < ffs->groups_count; i++) {
 
-        tsk_take_lock(&ffs->lock);
-        if (ffs_group_load(ffs, i)) {
-            tsk_release_lock(&ffs->lock);
+        if ((cgd = ffs_group_get(ffs, i)) == NULL)
             return 1;
-        }
-        cgd = (ffs_cgd *) ffs->grp_buf;
 
         tsk_fprintf(hFile, "\nGroup %d:\n", i);
         if (cgd) {
@@ -1497,14 +1676,14 @@ ffs_fsstat(TSK_FS_INFO * fs, FILE * hFile)
                 tmptime = tsk_getu32(fs->endian, cgd->wtime);
             }
             else {
-                ffs_cgd2 *cgd2 = (ffs_cgd2 *) cgd;
+                const ffs_cgd2 *cgd2 = (const ffs_cgd2 *) cgd;
                 tmptime = (uint32_t) tsk_getu64(fs->endian, cgd2->wtime);
             }
             tsk_fprintf(hFile, "  Last Written: %s\n",
                 (tmptime > 0) ? tsk_fs_time_to_str(tmptime,
                     timeBuf) : "empty");
         }
-        tsk_release_lock(&ffs->lock);
+        ffs_group_put(ffs, cgd);
 
         tsk_fprintf(hFile, "  Inode Range: %" PRIu32 " - %" PRIu32 "\n",
             (tsk_gets32(fs->endian, sb1->cg_inode_num) * i),
@@ -1706,9 +1885,8 @@ ffs_istat(TSK_FS_INFO * fs, TSK_FS_ISTAT_FLAG_ENUM istat_flags, FILE * hFile, TS
     tsk_fprintf(hFile, "%sAllocated\n",
         (fs_meta->flags & TSK_FS_META_FLAG_ALLOC) ? "" : "Not ");
 
-    tsk_take_lock(&ffs->lock);
-    tsk_fprintf(hFile, "Group: %" PRI_FFSGRP "\n", ffs->grp_num);
-    tsk_release_lock(&ffs->lock);
+    tsk_fprintf(hFile, "Group: %" PRI_FFSGRP "\n",
+        (FFS_GRPNUM_T) itog_lcl(fs, ffs->fs.sb1, inum));
 
     if (fs_meta->link)
         tsk_fprintf(hFile, "symbolic link to: %s\n", fs_meta->link);
@@ -1982,6 +2160,13 @@ ffs_close(TSK_FS_INFO * fs)
     free(ffs->grp_buf);
     free(ffs->itbl_buf);
 
+    if (ffs->grp_cache != NULL) {
+        FFS_GRPNUM_T i;
+        for (i = 0; i < ffs->groups_count; i++)
+            free(ffs->grp_cache[i]);
+        free(ffs->grp_cache);
+    }
+
     tsk_deinit_lock(&ffs->lock);
 
     free(ffs->fs.sb1);
@@ -2237,6 +2422,17 @@ ffs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset, TSK_FS_TYPE_ENUM ftype, uint
     ffs->itbl_buf = NULL;
     ffs->itbl_addr = 0;
 
+    /* The per-group cache is optional, so do not fail if the group count
+     * is too large for it */
+    ffs->grp_cache_used = 0;
+    ffs->grp_cache_max = FFS_GRP_CACHE_MAX;
+    if (ffs->groups_count > 0) {
+        ffs->grp_cache =
+            (void **) tsk_malloc(ffs->groups_count * sizeof(void *));
+        if (ffs->grp_cache == NULL)
+            tsk_error_reset();
+    }
+
     /*
      * Print some stats.
      */
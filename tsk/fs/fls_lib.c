@@ -251,7 +251,8 @@ tsk_fs_fls(TSK_FS_INFO * fs, TSK_FS_FLS_FLAG_ENUM lclflags,
             data.macpre[0] = '\0';
         }
 
-        retval = tsk_fs_dir_walk(fs, inode, flags, print_dent_act, &data);
+        retval = tsk_fs_dir_walk_parallel(fs, inode, flags,
+            TSK_FS_DIR_WALK_PARALLEL_ORDERED, print_dent_act, &data);
 
         free(data.macpre);
         data.macpre = NULL;
@@ -259,6 +260,7 @@ tsk_fs_fls(TSK_FS_INFO * fs, TSK_FS_FLS_FLAG_ENUM lclflags,
     }
 #else
     data.macpre = tpre;
-    return tsk_fs_dir_walk(fs, inode, flags, print_dent_act, &data);
+    return tsk_fs_dir_walk_parallel(fs, inode, flags,
+        TSK_FS_DIR_WALK_PARALLEL_ORDERED, print_dent_act, &data);
 #endif
 }
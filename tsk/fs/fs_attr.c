@@ -72,6 +72,96 @@ tsk_fs_attr_run_free(TSK_FS_ATTR_RUN * fs_attr_run)
 
 
 
+/**
+ * \internal
+ * Free the run index of an attribute.  This must be called whenever the
+ * run list is changed.
+ *
+ * @param a_fs_attr Attribute to free the index of
+ */
+static void
+tsk_fs_attr_run_idx_free(TSK_FS_ATTR * a_fs_attr)
+{
+    free(a_fs_attr->run_idx);
+    a_fs_attr->run_idx = NULL;
+    a_fs_attr->run_idx_cnt = 0;
+}
+
+
+/**
+ * \internal
+ * Build an array with the runs of a non-resident attribute so that
+ * tsk_fs_attr_read() can find the run for an offset with a binary search
+ * instead of walking the list.  The list is kept as is.  Nothing is built
+ * for short lists or for lists that are not in increasing offset order.
+ * The index is freed when the run list is changed by the tsk_fs_attr_
+ * functions, so this should be called once the attribute is complete.
+ *
+ * @param a_fs_attr Attribute to index
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_attr_run_idx_build(TSK_FS_ATTR * a_fs_attr)
+{
+    TSK_FS_ATTR_RUN *run;
+    size_t cnt = 0;
+    size_t i;
+
+    tsk_fs_attr_run_idx_free(a_fs_attr);
+
+    for (run = a_fs_attr->nrd.run; run; run = run->next) {
+        if ((run->next) && (run->next->offset < run->offset + run->len))
+            return 0;
+        cnt++;
+    }
+    if (cnt < TSK_FS_ATTR_RUN_IDX_MIN)
+        return 0;
+
+    if ((a_fs_attr->run_idx = (TSK_FS_ATTR_RUN_IDX *)
+            tsk_malloc(cnt * sizeof(TSK_FS_ATTR_RUN_IDX))) == NULL)
+        return 1;
+
+    for (i = 0, run = a_fs_attr->nrd.run; run; run = run->next, i++) {
+        a_fs_attr->run_idx[i].end = run->offset + run->len;
+        a_fs_attr->run_idx[i].run = run;
+    }
+    a_fs_attr->run_idx_cnt = cnt;
+    return 0;
+}
+
+
+/**
+ * \internal
+ * Find the first run that ends after a given block offset.  Uses the run
+ * index if there is one and otherwise returns the start of the list.
+ *
+ * @param a_fs_attr Attribute to search
+ * @param a_blk Block offset in the attribute
+ * @returns run to start processing at
+ */
+TSK_FS_ATTR_RUN *
+tsk_fs_attr_run_find(const TSK_FS_ATTR * a_fs_attr, TSK_DADDR_T a_blk)
+{
+    size_t lo, hi;
+
+    if (a_fs_attr->run_idx == NULL)
+        return a_fs_attr->nrd.run;
+
+    lo = 0;
+    hi = a_fs_attr->run_idx_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_fs_attr->run_idx[mid].end <= a_blk)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo >= a_fs_attr->run_idx_cnt)
+        return NULL;
+    return a_fs_attr->run_idx[lo].run;
+}
+
+
 /** 
  * \internal
  * Allocates and initializes a new structure.  
@@ -132,6 +222,7 @@ tsk_fs_attr_free(TSK_FS_ATTR * a_fs_attr)
     if (a_fs_attr->nrd.run)
         tsk_fs_attr_run_free(a_fs_attr->nrd.run);
     a_fs_attr->nrd.run = NULL;
+    tsk_fs_attr_run_idx_free(a_fs_attr);
 
     free(a_fs_attr->rd.buf);
     a_fs_attr->rd.buf = NULL;
@@ -154,6 +245,7 @@ tsk_fs_attr_clear(TSK_FS_ATTR * a_fs_attr)
 {
     a_fs_attr->size = a_fs_attr->type =
         a_fs_attr->id = a_fs_attr->flags = 0;
+    tsk_fs_attr_run_idx_free(a_fs_attr);
     if (a_fs_attr->nrd.run) {
         tsk_fs_attr_run_free(a_fs_attr->nrd.run);
         a_fs_attr->nrd.run = NULL;
@@ -297,6 +389,8 @@ tsk_fs_attr_set_run(TSK_FS_FILE * a_fs_file, TSK_FS_ATTR * a_fs_attr,
         return 1;
     }
 
+    tsk_fs_attr_run_idx_free(a_fs_attr);
+
     a_fs_attr->fs_file = a_fs_file;
     a_fs_attr->flags = (TSK_FS_ATTR_INUSE | TSK_FS_ATTR_NONRES | flags);
     a_fs_attr->type = type;
@@ -500,6 +594,8 @@ tsk_fs_attr_add_run(TSK_FS_INFO * a_fs, TSK_FS_ATTR * a_fs_attr,
         return 1;
     }
 
+    tsk_fs_attr_run_idx_free(a_fs_attr);
+
     run_len = 0;
     data_run_cur = a_data_run_new;
     while (data_run_cur) {
@@ -716,6 +812,8 @@ tsk_fs_attr_append_run(TSK_FS_INFO * a_fs, TSK_FS_ATTR * a_fs_attr,
         return;
     }
 
+    tsk_fs_attr_run_idx_free(a_fs_attr);
+
     if (a_fs_attr->nrd.run == NULL) {
         a_fs_attr->nrd.run = a_data_run;
         a_data_run->offset = 0;
@@ -830,6 +928,11 @@ tsk_fs_attr_walk_res(const TSK_FS_ATTR * fs_attr,
  * Processes a non-resident TSK_FS_ATTR structure and calls the callback with the associated
  * data. 
  *
+ * The callback is normally called for each block.  With
+ * TSK_FS_FILE_WALK_FLAG_LARGE, consecutive blocks of a run that would get
+ * the same flags are read together (up to TSK_FS_ATTR_WALK_LARGE_SIZE
+ * bytes) and given to the callback at once.
+ *
  * @param fs_attr Resident data structure to be walked
  * @param a_flags Flags for walking
  * @param a_action Callback action
@@ -849,6 +952,7 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
     uint32_t skip_remain;
     TSK_FS_INFO *fs = fs_attr->fs_file->fs_info;
     uint8_t stop_loop = 0;
+    size_t max_blks = 1;
 
     if ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0) {
         tsk_error_set_errno(TSK_ERR_FS_ARG);
@@ -865,8 +969,20 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
 
     skip_remain = fs_attr->nrd.skiplen;
 
+    /* figure out how many blocks we give to the callback at once (there
+     * is no need for a buffer bigger than the content) */
+    if (a_flags & TSK_FS_FILE_WALK_FLAG_LARGE) {
+        TSK_OFF_T blks = (tot_size + skip_remain + fs->block_size - 1)
+            / fs->block_size;
+        max_blks = TSK_FS_ATTR_WALK_LARGE_SIZE / fs->block_size;
+        if ((TSK_OFF_T) max_blks > blks)
+            max_blks = (size_t) blks;
+        if (max_blks == 0)
+            max_blks = 1;
+    }
+
     if ((a_flags & TSK_FS_FILE_WALK_FLAG_AONLY) == 0) {
-        if ((buf = (char *) tsk_malloc(fs->block_size)) == NULL) {
+        if ((buf = (char *) tsk_malloc(max_blks * fs->block_size)) == NULL) {
             return 1;
         }
     }
@@ -876,13 +992,18 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
     for (fs_attr_run = fs_attr->nrd.run; fs_attr_run;
         fs_attr_run = fs_attr_run->next) {
         TSK_DADDR_T addr, len_idx;
+        uint8_t is_zero_run = ((fs_attr_run->flags &
+                (TSK_FS_ATTR_RUN_FLAG_SPARSE | TSK_FS_ATTR_RUN_FLAG_FILLER))
+            != 0);
 
         addr = fs_attr_run->addr;
 
-        /* cycle through each block in the run */
-        for (len_idx = 0; len_idx < fs_attr_run->len; len_idx++) {
+        /* cycle through each block (or group of blocks) in the run */
+        for (len_idx = 0; len_idx < fs_attr_run->len;) {
 
             TSK_FS_BLOCK_FLAG_ENUM myflags;
+            size_t blks = 1;
+            size_t span_len;
 
             /* If the address is too large then give an error */
             if (addr + len_idx > fs->last_block) {
@@ -898,18 +1019,60 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                 return 1;
             }
 
+            if ((is_zero_run) || (off > fs_attr->nrd.initsize))
+                myflags = fs->block_getflags(fs, 0);
+            else
+                myflags = fs->block_getflags(fs, addr + len_idx);
+
+            /* Add the following blocks of the run that are handled the
+             * same way: the same flags and the same side of the initsize.
+             * Blocks that are partly skipped are done on their own. */
+            if ((max_blks > 1) && (skip_remain == 0)) {
+                uint8_t past_init = (off >= fs_attr->nrd.initsize);
+                uint8_t sparse_init = (off > fs_attr->nrd.initsize);
+
+                while ((blks < max_blks)
+                    && (len_idx + blks < fs_attr_run->len)
+                    && (off + (TSK_OFF_T) (blks * fs->block_size) <
+                        tot_size)) {
+                    TSK_OFF_T blk_off =
+                        off + (TSK_OFF_T) (blks * fs->block_size);
+                    TSK_DADDR_T blk_addr = addr + len_idx + blks;
+
+                    if (is_zero_run == 0) {
+                        if (((blk_off >= fs_attr->nrd.initsize) !=
+                                past_init)
+                            || ((blk_off > fs_attr->nrd.initsize) !=
+                                sparse_init))
+                            break;
+                        // blocks missing from the image are done on
+                        // their own so that the error is for that block
+                        if (blk_addr > fs->last_block_act)
+                            break;
+                        if ((sparse_init == 0)
+                            && (fs->block_getflags(fs, blk_addr) != myflags))
+                            break;
+                    }
+                    else if (blk_addr > fs->last_block) {
+                        break;
+                    }
+                    blks++;
+                }
+            }
+            span_len = blks * fs->block_size;
+
             // load the buffer if they want more than just the address
             if ((a_flags & TSK_FS_FILE_WALK_FLAG_AONLY) == 0) {
 
                 /* sparse files just get 0s */
                 if (fs_attr_run->flags & TSK_FS_ATTR_RUN_FLAG_SPARSE) {
-                    memset(buf, 0, fs->block_size);
+                    memset(buf, 0, span_len);
                 }
                 /* FILLER entries exist when the source file system can store run
                  * info out of order and we did not get all of the run info.  We
                  * return 0s if data is read from this type of run. */
                 else if (fs_attr_run->flags & TSK_FS_ATTR_RUN_FLAG_FILLER) {
-                    memset(buf, 0, fs->block_size);
+                    memset(buf, 0, span_len);
                     if (tsk_verbose)
                         fprintf(stderr,
                             "tsk_fs_attr_walk_nonres: File %" PRIuINUM
@@ -920,14 +1083,14 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                 // we return 0s for reads past the initsize
                 else if ((off >= fs_attr->nrd.initsize)
                     && ((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)) {
-                    memset(buf, 0, fs->block_size);
+                    memset(buf, 0, span_len);
                 }
                 else {
                     ssize_t cnt;
 
                     cnt = tsk_fs_read_block
-                        (fs, addr + len_idx, buf, fs->block_size);
-                    if (cnt != fs->block_size) {
+                        (fs, addr + len_idx, buf, span_len);
+                    if (cnt != (ssize_t) span_len) {
                         if (cnt >= 0) {
                             tsk_error_reset();
                             tsk_error_set_errno(TSK_ERR_FS_READ);
@@ -938,10 +1101,10 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                         free(buf);
                         return 1;
                     }
-                    if ((off + fs->block_size > fs_attr->nrd.initsize)
+                    if ((off + (TSK_OFF_T) span_len > fs_attr->nrd.initsize)
                         && ((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)) {
                         memset(&buf[fs_attr->nrd.initsize - off], 0,
-                            fs->block_size -
+                            span_len -
                             (size_t) (fs_attr->nrd.initsize - off));
                     }
                 }
@@ -958,18 +1121,14 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
             else {
                 size_t ret_len;
 
-                /* Do we want to return a full block, or just the end? */
-                if ((TSK_OFF_T) fs->block_size - skip_remain <
-                    tot_size - off)
-                    ret_len = fs->block_size - skip_remain;
+                /* Do we want to return the full span, or just the end? */
+                if ((TSK_OFF_T) (span_len - skip_remain) < tot_size - off)
+                    ret_len = span_len - skip_remain;
                 else
                     ret_len = (size_t) (tot_size - off);
 
                 /* Only do sparse or FILLER clusters if NOSPARSE is not set */
-                if ((fs_attr_run->flags & TSK_FS_ATTR_RUN_FLAG_SPARSE) ||
-                    (fs_attr_run->flags & TSK_FS_ATTR_RUN_FLAG_FILLER) ||
-                    (off > fs_attr->nrd.initsize)) {
-                    myflags = fs->block_getflags(fs, 0);
+                if ((is_zero_run) || (off > fs_attr->nrd.initsize)) {
                     myflags |= TSK_FS_BLOCK_FLAG_SPARSE;
                     if ((a_flags & TSK_FS_FILE_WALK_FLAG_NOSPARSE) == 0) {
                         retval =
@@ -978,7 +1137,6 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                     }
                 }
                 else {
-                    myflags = fs->block_getflags(fs, addr + len_idx);
                     myflags |= TSK_FS_BLOCK_FLAG_RAW;
 
                     retval =
@@ -998,6 +1156,7 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                     break;
                 }
             }
+            len_idx += blks;
         }
         if (stop_loop)
             break;
@@ -1015,7 +1174,8 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
 /**
  * \ingroup fslib
  * Process an attribute and call a callback function with its contents. The callback will be 
- * called with chunks of data that are fs->block_size or less.  The address given in the callback
+ * called with chunks of data that are fs->block_size or less (unless TSK_FS_FILE_WALK_FLAG_LARGE
+ * is given, in which case they can be several blocks long).  The address given in the callback
  * will be correct only for raw files (when the raw file contents were stored in the block).  For
  * compressed and sparse attributes, the address may be zero.
  *
@@ -1182,7 +1342,8 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
         len_remain = len_toread;
 
         // cycle through the run until we find where we can start to process the clusters
-        for (data_run_cur = a_fs_attr->nrd.run; data_run_cur;
+        for (data_run_cur =
+            tsk_fs_attr_run_find(a_fs_attr, blkoffset_toread); data_run_cur;
             data_run_cur = data_run_cur->next) {
             TSK_DADDR_T blkoffset_inrun;
             size_t len_inrun;
@@ -1253,9 +1414,6 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
                 // add the byte offset in the block
                 fs_offset_b += byteoffset_toread;
 
-                // reset this in case we need to also read from the next run 
-                byteoffset_toread = 0;
-
                 cnt =
                     tsk_fs_read(fs, fs_offset_b,
                     &a_buf[len_toread - len_remain], len_inrun);
@@ -1288,6 +1446,9 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
 
             }
             len_remain -= len_inrun;
+
+            // reset this in case we need to also read from the next run
+            byteoffset_toread = 0;
         }
         return (ssize_t) (len_toread - len_remain);
     }
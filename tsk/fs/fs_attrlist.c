@@ -194,6 +194,29 @@ tsk_fs_attrlist_markunused(TSK_FS_ATTRLIST * a_fs_attrlist)
     }
 }
 
+/** \internal
+ * Build the run index of each non-resident attribute in the list.  File
+ * systems call this once all of the runs of a file have been loaded.
+ * @param a_fs_attrlist Attribute list to index
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_attrlist_run_idx_build(TSK_FS_ATTRLIST * a_fs_attrlist)
+{
+    TSK_FS_ATTR *fs_attr_cur;
+    if (a_fs_attrlist == NULL)
+        return 0;
+
+    for (fs_attr_cur = a_fs_attrlist->head; fs_attr_cur;
+        fs_attr_cur = fs_attr_cur->next) {
+        if ((fs_attr_cur->flags & TSK_FS_ATTR_INUSE)
+            && (fs_attr_cur->flags & TSK_FS_ATTR_NONRES)
+            && (tsk_fs_attr_run_idx_build(fs_attr_cur)))
+            return 1;
+    }
+    return 0;
+}
+
 /**
  * \internal
  * Search the attribute list of TSK_FS_ATTR structures for an entry with a given
@@ -205,3 +205,425 @@ tsk_fs_block_walk(TSK_FS_INFO * a_fs,
     return a_fs->block_walk(a_fs, a_start_blk, a_end_blk, a_flags,
         a_action, a_ptr);
 }
+
+
+
+/*
+ * Position of the lowest / highest set bit in a non-zero 64-bit word.
+ */
+static unsigned int
+tsk_fs_bitmap_ctz(uint64_t a_word)
+{
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_ctzll(a_word);
+#else
+    unsigned int i = 0;
+    while ((a_word & 0xff) == 0) {
+        a_word >>= 8;
+        i += 8;
+    }
+    while ((a_word & 1) == 0) {
+        a_word >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+static unsigned int
+tsk_fs_bitmap_clz(uint64_t a_word)
+{
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_clzll(a_word);
+#else
+    unsigned int i = 0;
+    while ((a_word & 0xff00000000000000ULL) == 0) {
+        a_word <<= 8;
+        i += 8;
+    }
+    while ((a_word & 0x8000000000000000ULL) == 0) {
+        a_word <<= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/**
+ * \internal
+ * Find the first bit in an allocation bitmap that has a given value.  The
+ * bitmap is examined 64 bits at a time, so long runs of equal bits are
+ * skipped quickly.
+ *
+ * @param a_map Bitmap
+ * @param a_start Index of the first bit to examine
+ * @param a_end Index after the last bit to examine
+ * @param a_value Value (0 or 1) to look for
+ * @param a_msb_first 1 if bit 0 is the most significant bit of the first
+ * byte (HFS+) and 0 if it is the least significant bit (most other file systems)
+ * @returns Index of the first matching bit or a_end if there is none
+ */
+uint64_t
+tsk_fs_bitmap_find(const uint8_t * a_map, uint64_t a_start,
+    uint64_t a_end, uint8_t a_value, uint8_t a_msb_first)
+{
+    uint64_t i = a_start;
+
+#define TSK_FS_BITMAP_BIT(map, i, msb) \
+    (((map)[(i) / 8] >> ((msb) ? 7 - ((i) % 8) : ((i) % 8))) & 1)
+
+    /* Bits before the first full word */
+    for (; i < a_end && (i % 64); i++) {
+        if (TSK_FS_BITMAP_BIT(a_map, i, a_msb_first) == a_value)
+            return i;
+    }
+
+    /* Full words */
+    for (; i + 64 <= a_end; i += 64) {
+        uint64_t word;
+
+        if (a_msb_first)
+            word = tsk_getu64(TSK_BIG_ENDIAN, &a_map[i / 8]);
+        else
+            word = tsk_getu64(TSK_LIT_ENDIAN, &a_map[i / 8]);
+
+        if (a_value == 0)
+            word = ~word;
+
+        if (word) {
+            if (a_msb_first)
+                return i + tsk_fs_bitmap_clz(word);
+            else
+                return i + tsk_fs_bitmap_ctz(word);
+        }
+    }
+
+    /* Bits after the last full word */
+    for (; i < a_end; i++) {
+        if (TSK_FS_BITMAP_BIT(a_map, i, a_msb_first) == a_value)
+            return i;
+    }
+#undef TSK_FS_BITMAP_BIT
+
+    return a_end;
+}
+
+
+/**
+ * \internal
+ * Returns 1 if a block (or run) with the given flags should be passed
+ * to the callback of a walk with the given walk flags.
+ */
+static uint8_t
+tsk_fs_block_flags_match(int a_myflags, TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags)
+{
+    if ((a_myflags & TSK_FS_BLOCK_FLAG_META)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_META)))
+        return 0;
+    else if ((a_myflags & TSK_FS_BLOCK_FLAG_CONT)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
+        return 0;
+    else if ((a_myflags & TSK_FS_BLOCK_FLAG_ALLOC)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
+        return 0;
+    else if ((a_myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
+        return 0;
+    return 1;
+}
+
+
+/* State used while merging and filtering the runs of a file system */
+typedef struct {
+    TSK_FS_BLOCK_WALK_FLAG_ENUM flags;
+    TSK_FS_BLOCK_RUN_WALK_CB action;
+    void *ptr;
+    uint8_t have_run;           // 1 if the run below is waiting to be reported
+    TSK_DADDR_T addr;
+    TSK_DADDR_T len;
+    TSK_FS_BLOCK_FLAG_ENUM run_flags;
+    TSK_WALK_RET_ENUM ret;      // value returned by the last callback
+} TSK_FS_BLOCK_RUN_STATE;
+
+/*
+ * Callback used with the file system specific run walks.  Runs that
+ * follow each other and have the same flags are merged.
+ */
+static TSK_WALK_RET_ENUM
+tsk_fs_block_run_merge_cb(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr,
+    TSK_DADDR_T a_len, TSK_FS_BLOCK_FLAG_ENUM a_flags, void *a_ptr)
+{
+    TSK_FS_BLOCK_RUN_STATE *state = (TSK_FS_BLOCK_RUN_STATE *) a_ptr;
+
+    if (a_len == 0)
+        return TSK_WALK_CONT;
+
+    if (state->have_run) {
+        if ((state->run_flags == a_flags)
+            && (state->addr + state->len == a_addr)) {
+            state->len += a_len;
+            return TSK_WALK_CONT;
+        }
+
+        state->have_run = 0;
+        if (tsk_fs_block_flags_match(state->run_flags, state->flags)) {
+            state->ret = state->action(a_fs, state->addr, state->len,
+                state->run_flags, state->ptr);
+            if (state->ret != TSK_WALK_CONT)
+                return state->ret;
+        }
+    }
+
+    state->have_run = 1;
+    state->addr = a_addr;
+    state->len = a_len;
+    state->run_flags = a_flags;
+    return TSK_WALK_CONT;
+}
+
+/*
+ * Run walk for file systems that do not have a specific implementation.
+ * It asks for the flags of each block.
+ */
+static uint8_t
+tsk_fs_block_run_walk_getflags(TSK_FS_INFO * a_fs,
+    TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
+    TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr)
+{
+    TSK_DADDR_T addr;
+
+    for (addr = a_start_blk; addr <= a_end_blk; addr++) {
+        TSK_WALK_RET_ENUM retval = a_action(a_fs, addr, 1,
+            a_fs->block_getflags(a_fs, addr), a_ptr);
+        if (retval == TSK_WALK_STOP)
+            break;
+        else if (retval == TSK_WALK_ERROR)
+            return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * \ingroup fslib
+ *
+ * Cycle through a range of file system blocks and call the callback
+ * function once for each range of consecutive blocks that have the same
+ * allocation and content/metadata status.  File systems that support it
+ * compute the ranges directly from their allocation bitmaps, which is much
+ * faster than looking at each block (as tsk_fs_block_walk() does).
+ * Block content is not read.
+ *
+ * @param a_fs File system to analyze
+ * @param a_start_blk Block address to start walking from
+ * @param a_end_blk Block address to walk to
+ * @param a_flags Flags used during walk to determine which runs to call callback with (AONLY is ignored)
+ * @param a_action Callback function
+ * @param a_ptr Pointer that will be passed to callback
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_block_run_walk(TSK_FS_INFO * a_fs,
+    TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
+    TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags,
+    TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr)
+{
+    TSK_FS_BLOCK_RUN_STATE state;
+    uint8_t retval;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_block_run_walk: FS_INFO structure is not allocated");
+        return 1;
+    }
+    if (a_start_blk < a_fs->first_block || a_start_blk > a_fs->last_block) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
+        tsk_error_set_errstr("tsk_fs_block_run_walk: start block: %"
+            PRIuDADDR, a_start_blk);
+        return 1;
+    }
+    if (a_end_blk < a_start_blk || a_end_blk > a_fs->last_block) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
+        tsk_error_set_errstr("tsk_fs_block_run_walk: end block: %"
+            PRIuDADDR, a_end_blk);
+        return 1;
+    }
+
+    /* Sanity check on a_flags -- make sure at least one ALLOC is set */
+    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC) == 0) &&
+        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC) == 0)) {
+        a_flags |=
+            (TSK_FS_BLOCK_WALK_FLAG_ALLOC |
+            TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
+    }
+    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_META) == 0) &&
+        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT) == 0)) {
+        a_flags |=
+            (TSK_FS_BLOCK_WALK_FLAG_CONT | TSK_FS_BLOCK_WALK_FLAG_META);
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.flags = a_flags;
+    state.action = a_action;
+    state.ptr = a_ptr;
+    state.ret = TSK_WALK_CONT;
+
+    if (a_fs->block_run_walk)
+        retval = a_fs->block_run_walk(a_fs, a_start_blk, a_end_blk,
+            tsk_fs_block_run_merge_cb, &state);
+    else
+        retval = tsk_fs_block_run_walk_getflags(a_fs, a_start_blk,
+            a_end_blk, tsk_fs_block_run_merge_cb, &state);
+
+    if (retval || (state.ret == TSK_WALK_ERROR))
+        return 1;
+
+    /* Report the last run */
+    if ((state.ret == TSK_WALK_CONT) && (state.have_run)
+        && tsk_fs_block_flags_match(state.run_flags, a_flags)) {
+        if (a_action(a_fs, state.addr, state.len, state.run_flags,
+                a_ptr) == TSK_WALK_ERROR)
+            return 1;
+    }
+    return 0;
+}
+
+
+/* Blocks are read in chunks of this many bytes by tsk_fs_block_walk_runs() */
+#define TSK_FS_BLOCK_WALK_READ_SIZE (1024 * 1024)
+
+/* State for tsk_fs_block_walk_runs() */
+typedef struct {
+    TSK_FS_BLOCK_WALK_FLAG_ENUM flags;
+    TSK_FS_BLOCK_WALK_CB action;
+    void *ptr;
+    TSK_FS_BLOCK *fs_block;
+    char *buf;
+    size_t buf_blocks;          // number of blocks that fit in buf
+    const char *myname;
+} TSK_FS_BLOCK_WALK_RUNS_STATE;
+
+static TSK_WALK_RET_ENUM
+tsk_fs_block_walk_runs_cb(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr,
+    TSK_DADDR_T a_len, TSK_FS_BLOCK_FLAG_ENUM a_flags, void *a_ptr)
+{
+    TSK_FS_BLOCK_WALK_RUNS_STATE *state =
+        (TSK_FS_BLOCK_WALK_RUNS_STATE *) a_ptr;
+    TSK_DADDR_T addr = a_addr;
+    TSK_DADDR_T end = a_addr + a_len;
+    int myflags = a_flags | TSK_FS_BLOCK_FLAG_RAW;
+
+    if (state->flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
+        myflags |= TSK_FS_BLOCK_FLAG_AONLY;
+
+    while (addr < end) {
+        size_t cnt = state->buf_blocks, i;
+
+        if (end - addr < cnt)
+            cnt = (size_t) (end - addr);
+
+        /* Let the single block code generate the error for blocks
+         * that are missing from the image.  This is done for AONLY
+         * walks too, as it was when every block went through it. */
+        if (addr > a_fs->last_block_act) {
+            if (tsk_fs_block_get_flag(a_fs, state->fs_block, addr,
+                    (TSK_FS_BLOCK_FLAG_ENUM) myflags) == NULL) {
+                tsk_error_set_errstr2("%s: block %" PRIuDADDR,
+                    state->myname, addr);
+                return TSK_WALK_ERROR;
+            }
+        }
+        if (addr + cnt - 1 > a_fs->last_block_act)
+            cnt = (size_t) (a_fs->last_block_act - addr + 1);
+
+        if ((myflags & TSK_FS_BLOCK_FLAG_AONLY) == 0) {
+            ssize_t len;
+
+            len = tsk_img_read(a_fs->img_info,
+                a_fs->offset + (TSK_OFF_T) addr * a_fs->block_size,
+                state->buf, cnt * a_fs->block_size);
+            if (len != (ssize_t) (cnt * a_fs->block_size)) {
+                if (len >= 0) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                }
+                tsk_error_set_errstr2("%s: block %" PRIuDADDR,
+                    state->myname, addr);
+                return TSK_WALK_ERROR;
+            }
+        }
+
+        for (i = 0; i < cnt; i++) {
+            TSK_WALK_RET_ENUM retval;
+
+            tsk_fs_block_set(a_fs, state->fs_block, addr + i,
+                (TSK_FS_BLOCK_FLAG_ENUM) myflags,
+                state->buf ? &state->buf[i * a_fs->block_size] : NULL);
+
+            retval = state->action(state->fs_block, state->ptr);
+            if (retval != TSK_WALK_CONT)
+                return retval;
+        }
+        addr += cnt;
+    }
+    return TSK_WALK_CONT;
+}
+
+/**
+ * \internal
+ * Generic block walk for file systems that implement block_run_walk.
+ * The allocation status comes from the runs, so runs that do not match
+ * the flags are skipped as a whole, and the blocks of the runs that do
+ * match are read in large chunks.  The caller is responsible for the
+ * sanity checks on the block range.
+ *
+ * @param a_fs File system to analyze
+ * @param a_start_blk Block address to start walking from
+ * @param a_end_blk Block address to walk to
+ * @param a_flags Flags used during walk to determine which blocks to call callback with
+ * @param a_action Callback function
+ * @param a_ptr Pointer that will be passed to callback
+ * @param a_myname Name of the calling walk (for error messages)
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_block_walk_runs(TSK_FS_INFO * a_fs,
+    TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
+    TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags, TSK_FS_BLOCK_WALK_CB a_action,
+    void *a_ptr, const char *a_myname)
+{
+    TSK_FS_BLOCK_WALK_RUNS_STATE state;
+    uint8_t retval;
+
+    state.flags = a_flags;
+    state.action = a_action;
+    state.ptr = a_ptr;
+    state.myname = a_myname;
+    state.buf_blocks = TSK_FS_BLOCK_WALK_READ_SIZE / a_fs->block_size;
+    if (state.buf_blocks == 0)
+        state.buf_blocks = 1;
+
+    if ((state.fs_block = tsk_fs_block_alloc(a_fs)) == NULL)
+        return 1;
+
+    state.buf = NULL;
+    if ((a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY) == 0) {
+        if ((state.buf =
+                (char *) tsk_malloc(state.buf_blocks *
+                    a_fs->block_size)) == NULL) {
+            tsk_fs_block_free(state.fs_block);
+            return 1;
+        }
+    }
+
+    retval = tsk_fs_block_run_walk(a_fs, a_start_blk, a_end_blk, a_flags,
+        tsk_fs_block_walk_runs_cb, &state);
+
+    free(state.buf);
+    tsk_fs_block_free(state.fs_block);
+    return retval;
+}
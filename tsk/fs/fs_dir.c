@@ -18,6 +18,225 @@
 #include "tsk_fatfs.h"
 
 
+/* Size of the first and the largest blocks of name memory */
+#define DIR_ARENA_MIN   2048
+#define DIR_ARENA_MAX   (256 * 1024)
+
+/* Directories with fewer names than this are searched linearly */
+#define DIR_IDX_MIN     64
+
+/** \internal
+ * A block of memory that the name strings of a directory are carved
+ * out of.  The strings follow the header.
+ */
+typedef struct DIR_ARENA_BLK {
+    struct DIR_ARENA_BLK *prev; // previous (smaller) block
+    size_t size;                // number of bytes after the header
+    size_t used;
+} DIR_ARENA_BLK;
+
+/** \internal
+ * Slot of the open addressing index of the names in a directory.
+ */
+typedef struct {
+    size_t pos;                 // index in names + 1, 0 if the slot is empty
+    uint32_t hash;              // tsk_fs_dir_hash() of the name
+} DIR_IDX_SLOT;
+
+/** \internal
+ * What tsk_fs_dir_alloc() actually allocates.  The public structure
+ * comes first so that the two can be cast between.  The name and short
+ * name of every entry in names point into the arena, so they are not
+ * freed one by one.
+ *
+ * The index finds the entries with a given address and name without
+ * scanning the directory.  It is keyed on the address and name hash and
+ * is brought up to date (names[idx_cnt] onwards) when it is searched.
+ */
+typedef struct {
+    TSK_FS_DIR dir;
+    DIR_ARENA_BLK *arena;       // block that we are allocating from
+    DIR_IDX_SLOT *idx;          // NULL until the directory is large enough
+    size_t idx_size;            // number of slots (a power of 2)
+    size_t idx_cnt;             // number of names that are in the index
+} DIR_INT;
+
+
+/* Get a_len bytes of name memory for a directory.
+ * @returns NULL on error */
+static char *
+dir_arena_alloc(DIR_INT * a_dir, size_t a_len)
+{
+    DIR_ARENA_BLK *blk = a_dir->arena;
+
+    if ((blk == NULL) || (blk->size - blk->used < a_len)) {
+        size_t size = DIR_ARENA_MIN;
+        if (blk) {
+            size = blk->size * 2;
+            if (size > DIR_ARENA_MAX)
+                size = DIR_ARENA_MAX;
+        }
+        if (size < a_len)
+            size = a_len;
+
+        if ((blk = (DIR_ARENA_BLK *) tsk_malloc(sizeof(DIR_ARENA_BLK) +
+                    size)) == NULL)
+            return NULL;
+        blk->prev = a_dir->arena;
+        blk->size = size;
+        blk->used = 0;
+        a_dir->arena = blk;
+    }
+
+    blk->used += a_len;
+    return (char *) &blk[1] + blk->used - a_len;
+}
+
+/* Free the name memory of a directory.  If a_keep is set, the newest
+ * block is kept (and emptied) for reuse. */
+static void
+dir_arena_free(DIR_INT * a_dir, int a_keep)
+{
+    DIR_ARENA_BLK *blk = a_dir->arena;
+
+    if ((blk) && (a_keep)) {
+        blk->used = 0;
+        blk = blk->prev;
+        a_dir->arena->prev = NULL;
+    }
+    else {
+        a_dir->arena = NULL;
+    }
+
+    while (blk) {
+        DIR_ARENA_BLK *prev = blk->prev;
+        free(blk);
+        blk = prev;
+    }
+}
+
+/* Copy a string into a name buffer of a directory entry, reusing the
+ * existing buffer if it is big enough.
+ * @returns 1 on error */
+static uint8_t
+dir_arena_strcpy(DIR_INT * a_dir, char **a_dst, size_t * a_dst_size,
+    const char *a_src)
+{
+    size_t len;
+
+    if (a_src == NULL) {
+        if (*a_dst_size > 0)
+            (*a_dst)[0] = '\0';
+        else
+            *a_dst = NULL;
+        return 0;
+    }
+
+    len = strlen(a_src) + 1;
+    if (len > *a_dst_size) {
+        if ((*a_dst = dir_arena_alloc(a_dir, len)) == NULL)
+            return 1;
+        *a_dst_size = len;
+    }
+    memcpy(*a_dst, a_src, len);
+    return 0;
+}
+
+/* Drop the name buffers of an entry that is no longer used.  The
+ * memory stays in the arena until the directory is reset or closed. */
+static void
+dir_name_clear(TSK_FS_NAME * a_fs_name)
+{
+    a_fs_name->name = NULL;
+    a_fs_name->name_size = 0;
+    a_fs_name->shrt_name = NULL;
+    a_fs_name->shrt_name_size = 0;
+}
+
+/* Version of tsk_fs_name_copy() for names that are in a directory */
+static uint8_t
+dir_name_copy(DIR_INT * a_dir, TSK_FS_NAME * a_fs_name_to,
+    const TSK_FS_NAME * a_fs_name_from)
+{
+    if (dir_arena_strcpy(a_dir, &a_fs_name_to->name,
+            &a_fs_name_to->name_size, a_fs_name_from->name))
+        return 1;
+    if (dir_arena_strcpy(a_dir, &a_fs_name_to->shrt_name,
+            &a_fs_name_to->shrt_name_size, a_fs_name_from->shrt_name))
+        return 1;
+
+    a_fs_name_to->meta_addr = a_fs_name_from->meta_addr;
+    a_fs_name_to->meta_seq = a_fs_name_from->meta_seq;
+    a_fs_name_to->par_addr = a_fs_name_from->par_addr;
+    a_fs_name_to->par_seq = a_fs_name_from->par_seq;
+    a_fs_name_to->type = a_fs_name_from->type;
+    a_fs_name_to->flags = a_fs_name_from->flags;
+    return 0;
+}
+
+
+
+/* Slot to start looking for an address and name hash at */
+static size_t
+dir_idx_slot(const DIR_INT * a_dir, TSK_INUM_T a_addr, uint32_t a_hash)
+{
+    uint64_t key = ((uint64_t) a_addr * 0x9E3779B97F4A7C15ULL) ^ a_hash;
+    key ^= key >> 29;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 32;
+    return (size_t) key & (a_dir->idx_size - 1);
+}
+
+/* Empty the index, such as when the names are reshuffled */
+static void
+dir_idx_clear(DIR_INT * a_dir)
+{
+    if (a_dir->idx)
+        memset(a_dir->idx, 0, a_dir->idx_size * sizeof(DIR_IDX_SLOT));
+    a_dir->idx_cnt = 0;
+}
+
+/* Bring the index up to date with the names in the directory,
+ * growing it to keep it at most half full.
+ * @returns 1 if the index cannot be used and the names must be
+ * searched linearly (small directory or no memory) */
+static uint8_t
+dir_idx_update(DIR_INT * a_dir)
+{
+    TSK_FS_DIR *fs_dir = &a_dir->dir;
+
+    if (fs_dir->names_used < DIR_IDX_MIN)
+        return 1;
+
+    if (fs_dir->names_used * 2 > a_dir->idx_size) {
+        size_t size = DIR_IDX_MIN * 4;
+        DIR_IDX_SLOT *idx;
+
+        while (size < fs_dir->names_used * 4)
+            size *= 2;
+        if ((idx = (DIR_IDX_SLOT *) tsk_malloc(size *
+                    sizeof(DIR_IDX_SLOT))) == NULL)
+            return 1;
+        free(a_dir->idx);
+        a_dir->idx = idx;
+        a_dir->idx_size = size;
+        a_dir->idx_cnt = 0;
+    }
+
+    for (; a_dir->idx_cnt < fs_dir->names_used; a_dir->idx_cnt++) {
+        const TSK_FS_NAME *fs_name = &fs_dir->names[a_dir->idx_cnt];
+        uint32_t hash = tsk_fs_dir_hash(fs_name->name ? fs_name->name : "");
+        size_t slot = dir_idx_slot(a_dir, fs_name->meta_addr, hash);
+
+        while (a_dir->idx[slot].pos)
+            slot = (slot + 1) & (a_dir->idx_size - 1);
+        a_dir->idx[slot].pos = a_dir->idx_cnt + 1;
+        a_dir->idx[slot].hash = hash;
+    }
+    return 0;
+}
+
+
 /** \internal
 * Allocate a FS_DIR structure to load names into.
 *
@@ -32,7 +251,7 @@ tsk_fs_dir_alloc(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr, size_t a_cnt)
     size_t i;
 
     // allocate and initialize the structure
-    if ((fs_dir = (TSK_FS_DIR *) tsk_malloc(sizeof(TSK_FS_DIR))) == NULL) {
+    if ((fs_dir = (TSK_FS_DIR *) tsk_malloc(sizeof(DIR_INT))) == NULL) {
         return NULL;
     }
 
@@ -95,6 +314,8 @@ tsk_fs_dir_realloc(TSK_FS_DIR * a_fs_dir, size_t a_cnt)
 void
 tsk_fs_dir_reset(TSK_FS_DIR * a_fs_dir)
 {
+    size_t i;
+
     if ((a_fs_dir == NULL) || (a_fs_dir->tag != TSK_FS_DIR_TAG))
         return;
 
@@ -102,6 +323,13 @@ tsk_fs_dir_reset(TSK_FS_DIR * a_fs_dir)
         tsk_fs_file_close(a_fs_dir->fs_file);
         a_fs_dir->fs_file = NULL;
     }
+
+    // the name memory is reused from scratch
+    for (i = 0; i < a_fs_dir->names_used; i++)
+        dir_name_clear(&a_fs_dir->names[i]);
+    dir_arena_free((DIR_INT *) a_fs_dir, 1);
+    dir_idx_clear((DIR_INT *) a_fs_dir);
+
     a_fs_dir->names_used = 0;
     a_fs_dir->addr = 0;
     a_fs_dir->seq = 0;
@@ -121,7 +349,11 @@ tsk_fs_dir_copy(const TSK_FS_DIR * a_src_dir, TSK_FS_DIR * a_dst_dir)
 {
     size_t i;
 
+    // entries past the end do not keep any name memory
+    for (i = a_src_dir->names_used; i < a_dst_dir->names_used; i++)
+        dir_name_clear(&a_dst_dir->names[i]);
     a_dst_dir->names_used = 0;
+    dir_idx_clear((DIR_INT *) a_dst_dir);
 
     // make sure we got the room
     if (a_src_dir->names_used > a_dst_dir->names_alloc) {
@@ -130,7 +362,8 @@ tsk_fs_dir_copy(const TSK_FS_DIR * a_src_dir, TSK_FS_DIR * a_dst_dir)
     }
 
     for (i = 0; i < a_src_dir->names_used; i++) {
-        if (tsk_fs_name_copy(&a_dst_dir->names[i], &a_src_dir->names[i]))
+        if (dir_name_copy((DIR_INT *) a_dst_dir, &a_dst_dir->names[i],
+                &a_src_dir->names[i]))
             return 1;
     }
 
@@ -152,9 +385,31 @@ tsk_fs_dir_copy(const TSK_FS_DIR * a_src_dir, TSK_FS_DIR * a_dst_dir)
 uint8_t
 tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash)
 {
+    DIR_INT *dir = (DIR_INT *) a_fs_dir;
     size_t i;
     uint8_t bestFound = 0;
 
+    if (dir_idx_update(dir) == 0) {
+        size_t slot = dir_idx_slot(dir, meta_addr, hash);
+        size_t lastPos = 0;
+
+        // the last match wins unless one of them is allocated
+        for (; dir->idx[slot].pos; slot = (slot + 1) & (dir->idx_size - 1)) {
+            const TSK_FS_NAME *fs_name =
+                &a_fs_dir->names[dir->idx[slot].pos - 1];
+            if ((dir->idx[slot].hash != hash)
+                || (fs_name->meta_addr != meta_addr))
+                continue;
+            if (fs_name->flags == TSK_FS_NAME_FLAG_ALLOC)
+                return fs_name->flags;
+            if (dir->idx[slot].pos > lastPos) {
+                lastPos = dir->idx[slot].pos;
+                bestFound = fs_name->flags;
+            }
+        }
+        return bestFound;
+    }
+
     for (i = 0; i < a_fs_dir->names_used; i++) {
         if (meta_addr == a_fs_dir->names[i].meta_addr) {
             if (hash == tsk_fs_dir_hash(a_fs_dir->names[i].name)) {
@@ -170,27 +425,37 @@ tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash)
     return bestFound;
 }
 
-/** \internal
- * Frees the allocated memory in a name structure when we are reshuffling
- * things around. Does not free the outer TSK_FS_NAME structure.  Just the names
- * inside of it.
- */
-static void 
-tsk_fs_dir_free_name_internal(TSK_FS_NAME *fs_name) 
+/* Find the first entry with the same address and name as a_fs_name.
+ * @returns its index in names + 1, or 0 if there is none */
+static size_t
+dir_find_name(DIR_INT * a_dir, const TSK_FS_NAME * a_fs_name)
 {
-    if (fs_name->name) {
-	    free(fs_name->name);
-	    fs_name->name = NULL;
-	    fs_name->name_size = 0;
+    TSK_FS_DIR *fs_dir = &a_dir->dir;
+    size_t i, slot, found = 0;
+    uint32_t hash;
+
+    if (dir_idx_update(a_dir)) {
+        for (i = 0; i < fs_dir->names_used; i++) {
+            if ((a_fs_name->meta_addr == fs_dir->names[i].meta_addr) &&
+                (strcmp(a_fs_name->name, fs_dir->names[i].name) == 0))
+                return i + 1;
+        }
+        return 0;
     }
-    if (fs_name->shrt_name) {
-        free(fs_name->shrt_name);
-        fs_name->shrt_name = NULL;
-        fs_name->shrt_name_size = 0;
+
+    hash = tsk_fs_dir_hash(a_fs_name->name);
+    for (slot = dir_idx_slot(a_dir, a_fs_name->meta_addr, hash);
+        a_dir->idx[slot].pos; slot = (slot + 1) & (a_dir->idx_size - 1)) {
+        size_t pos = a_dir->idx[slot].pos;
+        if ((a_dir->idx[slot].hash == hash) &&
+            ((found == 0) || (pos < found)) &&
+            (a_fs_name->meta_addr == fs_dir->names[pos - 1].meta_addr) &&
+            (strcmp(a_fs_name->name, fs_dir->names[pos - 1].name) == 0))
+            found = pos;
     }
+    return found;
 }
 
-
 /** \internal
  * Add a FS_DENT structure to a FS_DIR structure by copying its
  * contents into the internal buffer. Checks for
@@ -202,58 +467,55 @@ tsk_fs_dir_free_name_internal(TSK_FS_NAME *fs_name)
 uint8_t
 tsk_fs_dir_add(TSK_FS_DIR * a_fs_dir, const TSK_FS_NAME * a_fs_name)
 {
+    DIR_INT *dir = (DIR_INT *) a_fs_dir;
     TSK_FS_NAME *fs_name_dest = NULL;
     size_t i;
 
     /* see if we already have it in the buffer / queue
      * We skip this check for FAT because it will always fail because two entries
-     * never have the same meta address. */
-    // @@@ We could do something more efficient here too with orphan files because we do not 
-    // need to check the contents of that directory either and this takes a lot of time on those
-    // large images.
+     * never have the same meta address.  Large directories (such as the orphan
+     * directory) are searched with the index instead of entry by entry. */
     if (TSK_FS_TYPE_ISFAT(a_fs_dir->fs_info->ftype) == 0) {
-        for (i = 0; i < a_fs_dir->names_used; i++) {
-            if ((a_fs_name->meta_addr == a_fs_dir->names[i].meta_addr) &&
-                (strcmp(a_fs_name->name, a_fs_dir->names[i].name) == 0)) {
+        if ((i = dir_find_name(dir, a_fs_name)) != 0) {
+            i--;
 
-                if (tsk_verbose)
-                    tsk_fprintf(stderr,
-                        "tsk_fs_dir_add: removing duplicate entry: %s (%"
-                        PRIuINUM ")\n", a_fs_name->name,
-                        a_fs_name->meta_addr);
-
-                /* We do not check type because then we cannot detect NTFS orphan file
-                 * duplicates that are added as "-/r" while a similar entry exists as "r/r"
-                 (a_fs_name->type == a_fs_dir->names[i].type)) { */
-
-                // if the one in the list is unalloc and we have an alloc, replace it
-                if ((a_fs_dir->names[i].flags & TSK_FS_NAME_FLAG_UNALLOC)
-                    && (a_fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
-                    fs_name_dest = &a_fs_dir->names[i];
-
-                    // free the memory - not the most efficient, but prevents
-                    // duplicate code.
-                    tsk_fs_dir_free_name_internal(fs_name_dest);
-                    break;
-                }
-                else {
-                    return 0;
-                }
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_fs_dir_add: removing duplicate entry: %s (%"
+                    PRIuINUM ")\n", a_fs_name->name,
+                    a_fs_name->meta_addr);
+
+            /* We do not check type because then we cannot detect NTFS orphan file
+             * duplicates that are added as "-/r" while a similar entry exists as "r/r"
+             (a_fs_name->type == a_fs_dir->names[i].type)) { */
+
+            // if the one in the list is unalloc and we have an alloc, replace it
+            // (its name buffers are reused)
+            if ((a_fs_dir->names[i].flags & TSK_FS_NAME_FLAG_UNALLOC)
+                && (a_fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
+                fs_name_dest = &a_fs_dir->names[i];
+            }
+            else {
+                return 0;
             }
         }
     }
 
     if (fs_name_dest == NULL) {
-        // make sure we got the room
+        // make sure we got the room.  Grow geometrically so that large
+        // directories do not get copied over and over.
         if (a_fs_dir->names_used >= a_fs_dir->names_alloc) {
-            if (tsk_fs_dir_realloc(a_fs_dir, a_fs_dir->names_used + 512))
+            size_t cnt = a_fs_dir->names_alloc * 2;
+            if (cnt < a_fs_dir->names_used + 512)
+                cnt = a_fs_dir->names_used + 512;
+            if (tsk_fs_dir_realloc(a_fs_dir, cnt))
                 return 1;
         }
 
         fs_name_dest = &a_fs_dir->names[a_fs_dir->names_used++];
     }
 
-    if (tsk_fs_name_copy(fs_name_dest, a_fs_name))
+    if (dir_name_copy((DIR_INT *) a_fs_dir, fs_name_dest, a_fs_name))
         return 1;
 
     // add the parent address
@@ -352,15 +614,14 @@ tsk_fs_dir_open(TSK_FS_INFO * a_fs, const char *a_dir)
 void
 tsk_fs_dir_close(TSK_FS_DIR * a_fs_dir)
 {
-    size_t i;
     if ((a_fs_dir == NULL) || (a_fs_dir->tag != TSK_FS_DIR_TAG)) {
         return;
     }
 
-    for (i = 0; i < a_fs_dir->names_used; i++) {
-        tsk_fs_dir_free_name_internal(&a_fs_dir->names[i]);
-    }
+    // the names point into the arena
     free(a_fs_dir->names);
+    dir_arena_free((DIR_INT *) a_fs_dir, 0);
+    free(((DIR_INT *) a_fs_dir)->idx);
 
     if (a_fs_dir->fs_file) {
         tsk_fs_file_close(a_fs_dir->fs_file);
@@ -483,8 +744,8 @@ tsk_fs_dir_get_name(const TSK_FS_DIR * a_fs_dir, size_t a_idx)
 }
 
 
-#define MAX_DEPTH   128
-#define DIR_STRSZ   4096
+#define MAX_DEPTH   TSK_FS_DIR_WALK_MAX_DEPTH
+#define DIR_STRSZ   TSK_FS_DIR_WALK_PATH_SIZE
 
 /** \internal
  * used to keep state between calls to dir_walk_lcl
@@ -506,41 +767,53 @@ typedef struct {
     /* Set to one to collect inode info that can be used for orphan listing */
     uint8_t save_inum_named;
 
-    /* We keep list_inum_named inside DENT_DINFO so different threads
+    /* We keep inum_named inside DENT_DINFO so different threads
      * have their own copies.  On successful completion of the dir
      * walk we reassigned ownership of this pointer into the shared
-     * TSK_FS_INFO list_inum_named field.  We're trading off the extra
+     * TSK_FS_INFO inum_named field.  We're trading off the extra
      * work in each thread for cleaner locking code.
      */
-    TSK_LIST *list_inum_named;
+    TSK_ADDR_SET *inum_named;
 
 } DENT_DINFO;
 
 
-/**
- * Saves the list_inum_named from DENT_DINFO to FS_INFO.
- * This can be called from a couple of places, so the logic
- * is here in a single method.
+/** \internal
+ * Hand a set of the metadata addresses that are pointed to by
+ * unallocated names over to FS_INFO.  This is shared by the
+ * serial and the parallel directory walks.
+ * @param a_fs File system the set is for
+ * @param a_set Set to save (ownership is taken)
  */
-static void
-save_inum_named(TSK_FS_INFO *a_fs, DENT_DINFO *dinfo) {
-
+void
+tsk_fs_dir_save_inum_named(TSK_FS_INFO * a_fs, TSK_ADDR_SET * a_set)
+{
     /* We finished the dir walk successfully, so reassign
-     * ownership of the dinfo's list_inum_named to the shared
-     * list_inum_named in TSK_FS_INFO, under a lock, if
-     * another thread hasn't already done so.
+     * ownership of the set to the shared inum_named in
+     * TSK_FS_INFO, under a lock, if another thread hasn't
+     * already done so.
      */
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if (a_fs->list_inum_named == NULL) {
-        a_fs->list_inum_named = dinfo->list_inum_named;
+    if (a_fs->inum_named == NULL) {
+        a_fs->inum_named = a_set;
     }
     else {
-        tsk_list_free(dinfo->list_inum_named);
+        tsk_addr_set_free(a_set);
     }
-    dinfo->list_inum_named = NULL;
     tsk_release_lock(&a_fs->list_inum_named_lock);
 }
 
+/**
+ * Saves the inum_named from DENT_DINFO to FS_INFO.
+ * This can be called from a couple of places, so the logic
+ * is here in a single method.
+ */
+static void
+save_inum_named(TSK_FS_INFO *a_fs, DENT_DINFO *dinfo) {
+    tsk_fs_dir_save_inum_named(a_fs, dinfo->inum_named);
+    dinfo->inum_named = NULL;
+}
+
 /* dir_walk local function that is used for recursive calls.  Callers
  * should initially call the non-local version. */
 static TSK_WALK_RET_ENUM
@@ -600,8 +873,8 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
                  * of knowing that we stopped early w/out error.
                  */
                 if (a_dinfo->save_inum_named) {
-                    tsk_list_free(a_dinfo->list_inum_named);
-                    a_dinfo->list_inum_named = NULL;
+                    tsk_addr_set_free(a_dinfo->inum_named);
+                    a_dinfo->inum_named = NULL;
                     a_dinfo->save_inum_named = 0;
                 }
                 return TSK_WALK_STOP;
@@ -618,12 +891,12 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
         if ((a_dinfo->save_inum_named) && (fs_file->meta)
             && (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC)) {
 
-            if (tsk_list_add(&a_dinfo->list_inum_named,
+            if (tsk_addr_set_add(a_dinfo->inum_named,
                     fs_file->meta->addr)) {
 
-                // if there is an error, then clear the list
-                tsk_list_free(a_dinfo->list_inum_named);
-                a_dinfo->list_inum_named = NULL;
+                // if there is an error, then clear the set
+                tsk_addr_set_free(a_dinfo->inum_named);
+                a_dinfo->inum_named = NULL;
                 a_dinfo->save_inum_named = 0;
             }
         }
@@ -808,12 +1081,19 @@ tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
      * calls the action will clear this stuff.
      */
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if ((a_fs->list_inum_named == NULL) && (a_addr == a_fs->root_inum)
+    if ((a_fs->inum_named == NULL) && (a_addr == a_fs->root_inum)
         && (a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE)) {
         dinfo.save_inum_named = 1;
     }
     tsk_release_lock(&a_fs->list_inum_named_lock);
 
+    // not being able to collect the set is not an error for the walk
+    if ((dinfo.save_inum_named)
+        && ((dinfo.inum_named = tsk_addr_set_alloc()) == NULL)) {
+        tsk_error_reset();
+        dinfo.save_inum_named = 0;
+    }
+
     retval = tsk_fs_dir_walk_lcl(a_fs, &dinfo, a_addr, a_flags,
         a_action, a_ptr);
 
@@ -824,8 +1104,8 @@ tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
             /* There was an error and we stopped early, so we should get
              * rid of the partial list we were making.
              */
-            tsk_list_free(dinfo.list_inum_named);
-            dinfo.list_inum_named = NULL;
+            tsk_addr_set_free(dinfo.inum_named);
+            dinfo.inum_named = NULL;
         }
         else {
             save_inum_named(a_fs, &dinfo);
@@ -915,13 +1195,16 @@ tsk_fs_dir_make_orphan_dir_meta(TSK_FS_INFO * a_fs,
 uint8_t
 tsk_fs_dir_find_inum_named(TSK_FS_INFO * a_fs, TSK_INUM_T a_inum)
 {
-    uint8_t retval = 0;
+    TSK_ADDR_SET *inum_named;
+
+    // the set is not changed once it is saved, so it is only
+    // the pointer that needs the lock
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    // list can be null if no unallocated file names exist
-    if (a_fs->list_inum_named)
-        retval = tsk_list_find(a_fs->list_inum_named, a_inum);
+    inum_named = a_fs->inum_named;
     tsk_release_lock(&a_fs->list_inum_named_lock);
-    return retval;
+
+    // set can be null if the names have not been loaded
+    return tsk_addr_set_find(inum_named, a_inum);
 }
 
 
@@ -936,7 +1219,7 @@ load_named_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
 
 
 /** \internal
- * Proces a file system and populate a list of the metadata structures
+ * Proces a file system and populate a set of the metadata structures
  * that are reachable by file names. This is used to find orphan files.
  * Each file system has code that does the populating.
  */
@@ -944,7 +1227,7 @@ TSK_RETVAL_ENUM
 tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs)
 {
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if (a_fs->list_inum_named != NULL) {
+    if (a_fs->inum_named != NULL) {
         tsk_release_lock(&a_fs->list_inum_named_lock);
         if (tsk_verbose)
             fprintf(stderr,
@@ -958,14 +1241,17 @@ tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs)
             "tsk_fs_dir_load_inum_named: Performing dir walk to find named files\n");
 
     /* Do a dir_walk.  There is internal caching code that will populate
-     * the structure.  The callback is really a dummy call.  This could
+     * the structure.  The callback is really a dummy call, so the
+     * directories can be loaded by several threads at once.  This could
      * be made more efficient in the future (not do callbacks...).  We
      * specify UNALLOC only as a flag on the assumption that there will
      * be fewer callbacks for UNALLOC than ALLOC.
      */
-    if (tsk_fs_dir_walk(a_fs, a_fs->root_inum,
+    if (tsk_fs_dir_walk_parallel(a_fs, a_fs->root_inum,
             TSK_FS_NAME_FLAG_UNALLOC | TSK_FS_DIR_WALK_FLAG_RECURSE |
-            TSK_FS_DIR_WALK_FLAG_NOORPHAN, load_named_dir_walk_cb, NULL)) {
+            TSK_FS_DIR_WALK_FLAG_NOORPHAN,
+            TSK_FS_DIR_WALK_PARALLEL_CONCURRENT, load_named_dir_walk_cb,
+            NULL)) {
         tsk_error_errstr2_concat
             ("- tsk_fs_dir_load_inum_named: identifying inodes allocated by file names");
         return TSK_ERR;
@@ -979,9 +1265,37 @@ tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs)
 typedef struct {
     TSK_FS_NAME *fs_name;       // temp name structure used when adding entries to fs_dir
     TSK_FS_DIR *fs_dir;         // unique names are added to this.  represents contents of OrphanFiles directory
-    TSK_LIST *orphan_subdir_list;       // keep track of files that can already be accessed via orphan directory
+    TSK_ADDR_SET *orphan_subdir;        // keep track of files that can already be accessed via orphan directory
 } FIND_ORPHAN_DATA;
 
+/* Fewest metadata addresses that are given to a thread at once when
+ * looking for unnamed metadata structures */
+#define ORPHAN_RANGE_MIN    4096
+
+/* An unallocated metadata structure that no name points to */
+typedef struct {
+    TSK_INUM_T addr;
+    uint32_t seq;
+    uint8_t is_dir;
+    char *name;                 // name from the metadata, or NULL
+} ORPHAN_META;
+
+/* The unnamed metadata structures in one range of addresses.  The
+ * ranges are walked in parallel and the results are then added to the
+ * orphan directory in address order. */
+typedef struct {
+    const TSK_ADDR_SET *inum_named;     // can be NULL
+    ORPHAN_META *metas;
+    size_t cnt;
+    size_t alloc;
+} ORPHAN_RANGE;
+
+typedef struct {
+    TSK_FS_INFO *fs;
+    TSK_INUM_T range_len;       // number of addresses in each range
+    ORPHAN_RANGE *ranges;
+} ORPHAN_SCAN;
+
 /* Used to process orphan directories and make sure that their contents
  * are now marked as reachable */
 static TSK_WALK_RET_ENUM
@@ -1016,7 +1330,7 @@ load_orphan_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
         /* check if we have already added it as an orphan (in a subdirectory)
          * Not entirely sure how possible this is, but it was added while
          * debugging an infinite loop problem. */
-        if (tsk_list_find(data->orphan_subdir_list, a_fs_file->meta->addr)) {
+        if (tsk_addr_set_find(data->orphan_subdir, a_fs_file->meta->addr)) {
             if (tsk_verbose)
                 fprintf(stderr,
                     "load_orphan_dir_walk_cb: Detected loop with address %"
@@ -1024,7 +1338,8 @@ load_orphan_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
             return TSK_WALK_STOP;
         }
 
-        tsk_list_add(&data->orphan_subdir_list, a_fs_file->meta->addr);
+        if (tsk_addr_set_add(data->orphan_subdir, a_fs_file->meta->addr))
+            return TSK_WALK_ERROR;
 
         /* FAT file systems spend a lot of time hunting for parent
          * directory addresses, so we put this code in here to save
@@ -1043,81 +1358,143 @@ load_orphan_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
     return TSK_WALK_CONT;
 }
 
-/* used to identify the unnamed metadata structures */
+/* used to identify the unnamed metadata structures in a range */
 static TSK_WALK_RET_ENUM
 find_orphan_meta_walk_cb(TSK_FS_FILE * a_fs_file, void *a_ptr)
 {
-    FIND_ORPHAN_DATA *data = (FIND_ORPHAN_DATA *) a_ptr;
-    TSK_FS_INFO *fs = a_fs_file->fs_info;
+    ORPHAN_RANGE *range = (ORPHAN_RANGE *) a_ptr;
+    ORPHAN_META *meta;
 
     /* We want only orphans, then check if this
      * inode is in the seen list
      */
-    tsk_take_lock(&fs->list_inum_named_lock);
-    if ((fs->list_inum_named)
-        && (tsk_list_find(fs->list_inum_named, a_fs_file->meta->addr))) {
-        tsk_release_lock(&fs->list_inum_named_lock);
+    if (tsk_addr_set_find(range->inum_named, a_fs_file->meta->addr))
         return TSK_WALK_CONT;
-    }
-    tsk_release_lock(&fs->list_inum_named_lock);
 
-    // check if we have already added it as an orphan (in a subdirectory)
-    if (tsk_list_find(data->orphan_subdir_list, a_fs_file->meta->addr)) {
-        return TSK_WALK_CONT;
+    if (range->cnt == range->alloc) {
+        size_t alloc = range->alloc ? range->alloc * 2 : 64;
+        ORPHAN_META *metas;
+        if ((metas = (ORPHAN_META *) tsk_realloc(range->metas,
+                    alloc * sizeof(ORPHAN_META))) == NULL)
+            return TSK_WALK_ERROR;
+        range->metas = metas;
+        range->alloc = alloc;
     }
 
+    meta = &range->metas[range->cnt];
+    meta->addr = a_fs_file->meta->addr;
+    meta->seq = a_fs_file->meta->seq;
+    meta->is_dir = (a_fs_file->meta->type == TSK_FS_META_TYPE_DIR);
+    meta->name = NULL;
+
     // use their name if they have one
     if (a_fs_file->meta->name2 != NULL &&
         strlen(a_fs_file->meta->name2->name) > 0) {
-        strncpy(data->fs_name->name, a_fs_file->meta->name2->name,
+        size_t len = strlen(a_fs_file->meta->name2->name) + 1;
+        if ((meta->name = (char *) tsk_malloc(len)) == NULL)
+            return TSK_WALK_ERROR;
+        memcpy(meta->name, a_fs_file->meta->name2->name, len);
+    }
+    range->cnt++;
+
+    return TSK_WALK_CONT;
+}
+
+/* tsk_parallel_for() task that walks one range of metadata addresses */
+static uint8_t
+find_orphan_range_task(void *a_ptr, size_t a_idx)
+{
+    ORPHAN_SCAN *scan = (ORPHAN_SCAN *) a_ptr;
+    TSK_FS_INFO *fs = scan->fs;
+    TSK_INUM_T start = fs->first_inum + a_idx * scan->range_len;
+    TSK_INUM_T end = start + scan->range_len - 1;
+
+    if ((end > fs->last_inum) || (end < start))
+        end = fs->last_inum;
+
+    return tsk_fs_meta_walk(fs, start, end,
+        TSK_FS_META_FLAG_UNALLOC | TSK_FS_META_FLAG_USED,
+        find_orphan_meta_walk_cb, &scan->ranges[a_idx]);
+}
+
+/* Add an unnamed metadata structure to the orphan directory.
+ * @returns 1 on error */
+static uint8_t
+find_orphan_add(FIND_ORPHAN_DATA * data, TSK_FS_INFO * fs,
+    const ORPHAN_META * a_meta)
+{
+    // check if we have already added it as an orphan (in a subdirectory)
+    if (tsk_addr_set_find(data->orphan_subdir, a_meta->addr)) {
+        return 0;
+    }
+
+    // use their name if they have one
+    if (a_meta->name) {
+        strncpy(data->fs_name->name, a_meta->name,
             data->fs_name->name_size);
     }
     else {
         snprintf(data->fs_name->name, data->fs_name->name_size,
-            "OrphanFile-%" PRIuINUM, a_fs_file->meta->addr);
+            "OrphanFile-%" PRIuINUM, a_meta->addr);
     }
-    data->fs_name->meta_addr = a_fs_file->meta->addr;
+    data->fs_name->meta_addr = a_meta->addr;
     /* unalloc MFT entries have their sequence number incremented
      * when they are unallocated.  Decrement it in the file name so
      * that it matches the typical situation where the name is one
      * less. */
-    data->fs_name->meta_seq = a_fs_file->meta->seq - 1;
+    data->fs_name->meta_seq = a_meta->seq - 1;
     data->fs_name->flags = TSK_FS_NAME_FLAG_UNALLOC;
     data->fs_name->type = TSK_FS_NAME_TYPE_UNDEF;
 
     if (tsk_fs_dir_add(data->fs_dir, data->fs_name))
-        return TSK_WALK_ERROR;
+        return 1;
 
     /* FAT file systems spend a lot of time hunting for parent
      * directory addresses, so we put this code in here to save
      * the info when we have it. */
     if (TSK_FS_TYPE_ISFAT(fs->ftype)) {
         if (fatfs_dir_buf_add((FATFS_INFO *) fs,
-                TSK_FS_ORPHANDIR_INUM(fs), a_fs_file->meta->addr))
-            return TSK_WALK_ERROR;
+                TSK_FS_ORPHANDIR_INUM(fs), a_meta->addr))
+            return 1;
     }
 
     /* Go into directories to mark their contents as "seen" */
-    if (a_fs_file->meta->type == TSK_FS_META_TYPE_DIR) {
+    if (a_meta->is_dir) {
 
         if (tsk_verbose)
             fprintf(stderr,
-                "find_orphan_meta_walk_cb: Going into directory %" PRIuINUM
-                " to mark contents as seen\n", a_fs_file->meta->addr);
+                "find_orphan_add: Going into directory %" PRIuINUM
+                " to mark contents as seen\n", a_meta->addr);
 
-        if (tsk_fs_dir_walk(fs, a_fs_file->meta->addr,
+        if (tsk_fs_dir_walk(fs, a_meta->addr,
                 TSK_FS_DIR_WALK_FLAG_UNALLOC | TSK_FS_DIR_WALK_FLAG_RECURSE
                 | TSK_FS_DIR_WALK_FLAG_NOORPHAN, load_orphan_dir_walk_cb,
                 data)) {
             tsk_error_errstr2_concat
-                (" - find_orphan_meta_walk_cb: identifying inodes allocated by file names");
-            return TSK_WALK_ERROR;
+                (" - find_orphan_add: identifying inodes allocated by file names");
+            return 1;
         }
     }
 
-    return TSK_WALK_CONT;
+    return 0;
 }
 
+/* Free the results of the walk for unnamed metadata structures */
+static void
+find_orphan_scan_free(ORPHAN_SCAN * a_scan, size_t a_cnt)
+{
+    size_t i, j;
+
+    if (a_scan->ranges == NULL)
+        return;
+    for (i = 0; i < a_cnt; i++) {
+        for (j = 0; j < a_scan->ranges[i].cnt; j++)
+            free(a_scan->ranges[i].metas[j].name);
+        free(a_scan->ranges[i].metas);
+    }
+    free(a_scan->ranges);
+    a_scan->ranges = NULL;
+}
 
 
 /** \internal
@@ -1153,7 +1530,10 @@ TSK_RETVAL_ENUM
 tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
 {
     FIND_ORPHAN_DATA data;
-    size_t i;
+    ORPHAN_SCAN scan;
+    const TSK_ADDR_SET *inum_named;
+    TSK_FS_DIR *orphan_dir;
+    size_t range_cnt, r, i;
 
     tsk_take_lock(&a_fs->orphan_dir_lock);
 
@@ -1171,49 +1551,85 @@ tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
         tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_OK;
     }
+    tsk_release_lock(&a_fs->orphan_dir_lock);
 
     if (tsk_verbose)
         fprintf(stderr,
             "tsk_fs_dir_find_orphans: Searching for orphan files\n");
 
     memset(&data, 0, sizeof(FIND_ORPHAN_DATA));
+    memset(&scan, 0, sizeof(ORPHAN_SCAN));
 
     /* We first need to determine which of the unallocated meta structures
      * have a name pointing to them.  We cache this data, so see if it is
      * already known. */
     if (tsk_fs_dir_load_inum_named(a_fs) != TSK_OK) {
-        tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_ERR;
     }
-    // note that list_inum_named could still be NULL if there are no deleted names.
-
-    /* Now we walk the unallocated metadata structures and find ones that are
-     * not named.  The callback will add the names to the FS_DIR structure.
-     */
-    data.fs_dir = a_fs_dir;
+    // note that inum_named is NULL if the set could not be saved
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    inum_named = a_fs->inum_named;
+    tsk_release_lock(&a_fs->list_inum_named_lock);
 
-    // allocate a name once so that we will reuse for each name we add to FS_DIR
-    if ((data.fs_name = tsk_fs_name_alloc(256, 0)) == NULL) {
-        tsk_release_lock(&a_fs->orphan_dir_lock);
+    /* Split the metadata addresses into ranges that are walked in parallel
+     * to find the unallocated structures that are not named.  The results
+     * are then added to the FS_DIR structure in address order, so the
+     * directory is the same as if there was one walk.  YAFFS2 addresses
+     * keep the version of the object in their upper bits, so its range
+     * cannot be split. */
+    range_cnt = 1;
+    if ((tsk_parallel_get_threads() > 1)
+        && (TSK_FS_TYPE_ISYAFFS2(a_fs->ftype) == 0)) {
+        TSK_INUM_T inum_cnt = a_fs->last_inum - a_fs->first_inum + 1;
+        range_cnt = tsk_parallel_get_threads() * 4;
+        if (inum_cnt / ORPHAN_RANGE_MIN < range_cnt)
+            range_cnt = (size_t) (inum_cnt / ORPHAN_RANGE_MIN);
+        if (range_cnt == 0)
+            range_cnt = 1;
+    }
+    scan.fs = a_fs;
+    scan.range_len =
+        (a_fs->last_inum - a_fs->first_inum) / range_cnt + 1;
+    if ((scan.ranges =
+            (ORPHAN_RANGE *) tsk_malloc(range_cnt *
+                sizeof(ORPHAN_RANGE))) == NULL) {
         return TSK_ERR;
     }
+    for (r = 0; r < range_cnt; r++)
+        scan.ranges[r].inum_named = inum_named;
 
     if (tsk_verbose)
         fprintf(stderr,
             "tsk_fs_dir_find_orphans: Performing inode_walk to find unnamed metadata structures\n");
 
-    if (tsk_fs_meta_walk(a_fs, a_fs->first_inum, a_fs->last_inum,
-            TSK_FS_META_FLAG_UNALLOC | TSK_FS_META_FLAG_USED,
-            find_orphan_meta_walk_cb, &data)) {
+    if (tsk_parallel_for(range_cnt, find_orphan_range_task, &scan)) {
+        find_orphan_scan_free(&scan, range_cnt);
+        return TSK_ERR;
+    }
+
+    /* Now add the unnamed structures to the FS_DIR structure. */
+    data.fs_dir = a_fs_dir;
+
+    // allocate a name once so that we will reuse for each name we add to FS_DIR
+    if (((data.fs_name = tsk_fs_name_alloc(256, 0)) == NULL) ||
+        ((data.orphan_subdir = tsk_addr_set_alloc()) == NULL)) {
         tsk_fs_name_free(data.fs_name);
-        if (data.orphan_subdir_list) {
-            tsk_list_free(data.orphan_subdir_list);
-            data.orphan_subdir_list = NULL;
-        }
-        tsk_release_lock(&a_fs->orphan_dir_lock);
+        find_orphan_scan_free(&scan, range_cnt);
         return TSK_ERR;
     }
 
+    for (r = 0; r < range_cnt; r++) {
+        for (i = 0; i < scan.ranges[r].cnt; i++) {
+            if (find_orphan_add(&data, a_fs, &scan.ranges[r].metas[i])) {
+                tsk_fs_name_free(data.fs_name);
+                tsk_addr_set_free(data.orphan_subdir);
+                find_orphan_scan_free(&scan, range_cnt);
+                return TSK_ERR;
+            }
+        }
+    }
+
+    find_orphan_scan_free(&scan, range_cnt);
     tsk_fs_name_free(data.fs_name);
     data.fs_name = NULL;
 
@@ -1227,43 +1643,51 @@ tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
      * from subdirectories of the orphan directory.  These entries will exist if
      * they were added before their parent directory was added to the orphan directory. */
     for (i = 0; i < a_fs_dir->names_used; i++) {
-        if (tsk_list_find(data.orphan_subdir_list,
+        if (tsk_addr_set_find(data.orphan_subdir,
                 a_fs_dir->names[i].meta_addr)) {
-            if (a_fs_dir->names_used > 1) {
-                tsk_fs_name_copy(&a_fs_dir->names[i],
+            if (i + 1 < a_fs_dir->names_used) {
+                dir_name_copy((DIR_INT *) a_fs_dir, &a_fs_dir->names[i],
                     &a_fs_dir->names[a_fs_dir->names_used - 1]);
             }
-            tsk_fs_dir_free_name_internal(&a_fs_dir->names[a_fs_dir->names_used-1]);
+            dir_name_clear(&a_fs_dir->names[a_fs_dir->names_used - 1]);
             a_fs_dir->names_used--;
         }
     }
+    // the entries were moved around
+    dir_idx_clear((DIR_INT *) a_fs_dir);
 
-    if (data.orphan_subdir_list) {
-        tsk_list_free(data.orphan_subdir_list);
-        data.orphan_subdir_list = NULL;
-    }
+    tsk_addr_set_free(data.orphan_subdir);
+    data.orphan_subdir = NULL;
 
 
     // make copy of this so that we don't need to do it again.
-    if ((a_fs->orphan_dir =
+    if ((orphan_dir =
             tsk_fs_dir_alloc(a_fs, a_fs_dir->addr,
                 a_fs_dir->names_used)) == NULL) {
-        tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_ERR;
     }
 
-    if (tsk_fs_dir_copy(a_fs_dir, a_fs->orphan_dir)) {
-        tsk_release_lock(&a_fs->orphan_dir_lock);
+    if (tsk_fs_dir_copy(a_fs_dir, orphan_dir)) {
+        tsk_fs_dir_close(orphan_dir);
         return TSK_ERR;
     }
 
+    /* Another thread may have hunted for the orphans at the same time.
+     * The results are the same, so keep the first copy. */
+    tsk_take_lock(&a_fs->orphan_dir_lock);
+    if (a_fs->orphan_dir == NULL) {
+        a_fs->orphan_dir = orphan_dir;
+        orphan_dir = NULL;
+    }
+    tsk_release_lock(&a_fs->orphan_dir_lock);
+    if (orphan_dir != NULL)
+        tsk_fs_dir_close(orphan_dir);
+
     // populate the fake FS_FILE structure in the struct to be returned for the "Orphan Directory"
     if (tsk_fs_dir_add_orphan_dir_meta(a_fs, a_fs_dir)) {
-        tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_ERR;
     }
 
-    tsk_release_lock(&a_fs->orphan_dir_lock);
     return TSK_OK;
 }
 
@@ -0,0 +1,766 @@
+/*
+ * fs_dir_parallel
+ * The Sleuth Kit
+ *
+ * Copyright (c) 2026 The Sleuth Kit contributors.  All rights reserved
+ * Contact: Brian Carrier [carrier <at> sleuthkit [dot] org]
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file fs_dir_parallel.cpp
+ * Contains tsk_fs_dir_walk_parallel(), a recursive directory walk that
+ * loads the directories on a pool of worker threads.
+ */
+
+#include "tsk_fs_i.h"
+
+#ifdef TSK_MULTITHREAD_LIB
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Maximum number of loaded directories that the workers can be ahead
+ * of the callbacks in ordered mode. */
+#define DW_BACKLOG_MAX  1024
+
+/* States of a directory in the walk */
+enum {
+    DW_QUEUED,                  // waiting to be loaded
+    DW_DEFERRED,                // orphan dir, waiting for the other dirs to finish
+    DW_CLAIMED,                 // being loaded
+    DW_DONE                     // loaded
+};
+
+#define DW_NO_QUEUE ((size_t) -1)
+
+/* A directory that needs to be (or has been) loaded */
+struct DW_DIR {
+    TSK_INUM_T addr;
+    std::atomic < size_t > queue;       // queue that the dir is in, changed under its lock
+    std::string path;           // path that is passed to the callback for its entries
+    std::vector < TSK_INUM_T > seen;    // dirs that we are inside of, for loop detection
+    bool save_named;            // collect unallocated meta addresses for orphan finding
+    std::atomic < int >state;
+
+    TSK_FS_DIR *fs_dir;
+    size_t names_walked;        // number of names processed before the walk of this dir ended
+
+    // only used in ordered mode, where the callbacks are made later
+    std::vector < TSK_FS_META * >metas;
+    std::vector < DW_DIR * >subdirs;    // dir that each name recursed into, or NULL
+};
+
+/* A queue of dirs that one thread pushes to and that others steal from */
+struct DW_QUEUE {
+    std::mutex lock;
+    std::deque < DW_DIR * >dirs;
+};
+
+/* State shared between the threads of a tsk_fs_dir_walk_parallel() call */
+struct DW_STATE {
+    TSK_FS_INFO *fs;
+    TSK_FS_DIR_WALK_FLAG_ENUM flags;
+    TSK_FS_DIR_WALK_CB action;
+    void *ptr;
+    bool ordered;
+
+    std::vector < DW_QUEUE > queues;
+    std::atomic < size_t > queued;      // number of entries in the queues
+    std::atomic < size_t > pending;     // dirs that are queued or being loaded
+    std::atomic < size_t > backlog;     // ordered mode: loaded dirs that were not called back yet
+    std::atomic < int >stop;    // TSK_WALK_STOP or TSK_WALK_ERROR once the walk is ending
+    std::atomic < int >finished;        // set once all of the dirs have been loaded
+
+    // threads sleep on this when there is nothing for them to do
+    std::mutex wait_lock;
+    std::condition_variable wait_cond;
+    std::atomic < size_t > sleepers;
+    std::atomic < size_t > throttled;   // workers waiting for the backlog to shrink
+    std::vector < DW_DIR * >deferred;   // protected by wait_lock
+
+    // metadata addresses of unallocated named files
+    bool save_named;
+    std::mutex named_lock;
+    std::vector < TSK_INUM_T > named;
+
+    TSK_ERROR_INFO error;       // concurrent mode: error of the callback that failed
+
+    DW_STATE(size_t a_nqueues)
+    :queues(a_nqueues), queued(0), pending(0), backlog(0), stop(0),
+        finished(0), sleepers(0), throttled(0), save_named(false) {
+        memset(&error, 0, sizeof(error));
+    }
+};
+
+static DW_DIR *
+dw_dir_alloc(TSK_INUM_T a_addr)
+{
+    DW_DIR *dir = new DW_DIR;
+    dir->addr = a_addr;
+    dir->queue = DW_NO_QUEUE;
+    dir->save_named = false;
+    dir->state = DW_QUEUED;
+    dir->fs_dir = NULL;
+    dir->names_walked = 0;
+    return dir;
+}
+
+/* Free a dir and the subdirs that are still hanging off of it.  The
+ * caller must make sure that none of them are still in use by a worker. */
+static void
+dw_dir_free(DW_STATE * a_state, DW_DIR * a_dir)
+{
+    if (a_dir->state == DW_DONE && a_state->ordered)
+        a_state->backlog--;
+    for (size_t i = 0; i < a_dir->metas.size(); i++) {
+        if (a_dir->metas[i])
+            tsk_fs_meta_close(a_dir->metas[i]);
+    }
+    for (size_t i = 0; i < a_dir->subdirs.size(); i++) {
+        if (a_dir->subdirs[i])
+            dw_dir_free(a_state, a_dir->subdirs[i]);
+    }
+    if (a_dir->fs_dir)
+        tsk_fs_dir_close(a_dir->fs_dir);
+    delete a_dir;
+}
+
+/* Wake up any threads that are waiting in dw_sleep().  The state change
+ * that they are waiting for must already be visible. */
+static void
+dw_wake(DW_STATE * a_state)
+{
+    if (a_state->sleepers == 0)
+        return;
+    {
+        std::lock_guard < std::mutex > guard(a_state->wait_lock);
+    }
+    a_state->wait_cond.notify_all();
+}
+
+/* Sleep until a_ready returns true. */
+template < typename READY > static void
+dw_sleep(DW_STATE * a_state, READY a_ready)
+{
+    std::unique_lock < std::mutex > guard(a_state->wait_lock);
+    a_state->sleepers++;
+    while (!a_ready())
+        a_state->wait_cond.wait(guard);
+    a_state->sleepers--;
+}
+
+static void
+dw_push(DW_STATE * a_state, size_t a_qidx, DW_DIR * a_dir)
+{
+    a_state->pending++;
+    {
+        std::lock_guard < std::mutex > guard(a_state->queues[a_qidx].lock);
+        a_state->queues[a_qidx].dirs.push_back(a_dir);
+        a_dir->queue = a_qidx;
+        a_dir->state = DW_QUEUED;
+    }
+    a_state->queued++;
+    dw_wake(a_state);
+}
+
+/* Take the next dir to load: the newest from our own queue, otherwise
+ * the oldest from one of the other queues. */
+static DW_DIR *
+dw_next(DW_STATE * a_state, size_t a_qidx)
+{
+    size_t nqueues = a_state->queues.size();
+
+    for (size_t i = 0; i < nqueues; i++) {
+        DW_QUEUE & queue = a_state->queues[(a_qidx + i) % nqueues];
+        DW_DIR *dir;
+        {
+            std::lock_guard < std::mutex > guard(queue.lock);
+            if (queue.dirs.empty())
+                continue;
+            if (i == 0) {
+                dir = queue.dirs.back();
+                queue.dirs.pop_back();
+            }
+            else {
+                dir = queue.dirs.front();
+                queue.dirs.pop_front();
+            }
+            // the state must change first, see dw_take()
+            dir->state = DW_CLAIMED;
+            dir->queue = DW_NO_QUEUE;
+        }
+        a_state->queued--;
+        return dir;
+    }
+    return NULL;
+}
+
+/* Take a specific dir out of the queue that it is in.  A dir is marked
+ * as queued only after it is in a queue and as claimed before it leaves
+ * one, so a queued dir without a queue was never queued (i.e. the root).
+ * @returns true if the dir was claimed */
+static bool
+dw_take(DW_STATE * a_state, DW_DIR * a_dir)
+{
+    if (a_dir->state != DW_QUEUED)
+        return false;
+
+    if (a_dir->queue == DW_NO_QUEUE) {
+        int expected = DW_QUEUED;
+        return a_dir->state.compare_exchange_strong(expected, DW_CLAIMED);
+    }
+
+    size_t qidx = a_dir->queue;
+    if (qidx >= a_state->queues.size())
+        return false;
+    DW_QUEUE & queue = a_state->queues[qidx];
+    {
+        std::lock_guard < std::mutex > guard(queue.lock);
+        if (a_dir->queue != qidx)
+            return false;
+
+        // the dirs that we wait for are usually near the front
+        std::deque < DW_DIR * >::iterator it =
+            std::find(queue.dirs.begin(), queue.dirs.end(), a_dir);
+        if (it == queue.dirs.end())
+            return false;
+        queue.dirs.erase(it);
+        a_dir->state = DW_CLAIMED;
+        a_dir->queue = DW_NO_QUEUE;
+    }
+    a_state->queued--;
+    return true;
+}
+
+/* Save the unallocated named meta addresses to FS_INFO */
+static void
+dw_save_named(DW_STATE * a_state)
+{
+    TSK_ADDR_SET *set;
+
+    if ((set = tsk_addr_set_alloc()) == NULL) {
+        tsk_error_reset();
+        return;
+    }
+    std::sort(a_state->named.begin(), a_state->named.end());
+    for (size_t i = 0; i < a_state->named.size(); i++) {
+        if (tsk_addr_set_add(set, a_state->named[i])) {
+            tsk_addr_set_free(set);
+            tsk_error_reset();
+            return;
+        }
+    }
+    tsk_fs_dir_save_inum_named(a_state->fs, set);
+}
+
+/* Called after a dir has been loaded.  When the last one is done, the
+ * named set is saved and the orphan dir (which uses the set) is
+ * released, or the walk is marked as finished. */
+static void
+dw_loaded(DW_STATE * a_state)
+{
+    if (--a_state->pending != 0)
+        return;
+
+    std::vector < DW_DIR * >deferred;
+    {
+        std::lock_guard < std::mutex > guard(a_state->wait_lock);
+        if (a_state->save_named) {
+            if (a_state->stop == 0)
+                dw_save_named(a_state);
+            a_state->save_named = false;
+        }
+        if (a_state->stop == 0)
+            deferred.swap(a_state->deferred);
+        if (deferred.empty())
+            a_state->finished = 1;
+    }
+
+    for (size_t i = 0; i < deferred.size(); i++)
+        dw_push(a_state, 0, deferred[i]);
+    dw_wake(a_state);
+}
+
+/* Record that the walk is ending with a_retval */
+static void
+dw_set_stop(DW_STATE * a_state, int a_retval)
+{
+    int expected = 0;
+    if (a_state->stop.compare_exchange_strong(expected, a_retval)) {
+        if (a_retval == TSK_WALK_ERROR && a_state->ordered == false) {
+            TSK_ERROR_INFO *info = tsk_error_get_info();
+            if (info != NULL)
+                memcpy(&a_state->error, info, sizeof(TSK_ERROR_INFO));
+        }
+    }
+    dw_wake(a_state);
+}
+
+/* Load the names and metadata of a claimed dir and queue its subdirs.
+ * In concurrent mode this also makes the callbacks and frees the dir. */
+static void
+dw_load(DW_STATE * a_state, size_t a_qidx, DW_DIR * a_dir,
+    TSK_FS_FILE * a_fs_file)
+{
+    TSK_FS_INFO *fs = a_state->fs;
+    std::vector < TSK_INUM_T > named;
+    size_t names_used = 0;
+
+    if ((a_dir->fs_dir == NULL) && (a_state->stop == 0)) {
+        if ((a_dir->fs_dir = tsk_fs_dir_open_meta(fs, a_dir->addr)) == NULL) {
+            /* If this fails because the directory could not be
+             * loaded, then we still continue */
+            if (tsk_verbose) {
+                tsk_fprintf(stderr,
+                    "tsk_fs_dir_walk_parallel: error reading directory: %"
+                    PRIuINUM "\n", a_dir->addr);
+                tsk_error_print(stderr);
+            }
+            tsk_error_reset();
+        }
+    }
+    if (a_dir->fs_dir)
+        names_used = a_dir->fs_dir->names_used;
+
+    if (a_state->ordered) {
+        a_dir->metas.assign(names_used, NULL);
+        a_dir->subdirs.assign(names_used, NULL);
+    }
+
+    size_t i;
+    for (i = 0; i < names_used; i++) {
+        if (a_state->stop)
+            break;
+
+        a_fs_file->name = &a_dir->fs_dir->names[i];
+
+        /* load the fs_meta structure if possible.
+         * Must have non-zero inode addr or have allocated name (if inode is 0) */
+        if ((a_fs_file->name->meta_addr)
+            || (a_fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
+            if (fs->file_add_meta(fs, a_fs_file,
+                    a_fs_file->name->meta_addr)) {
+                if (tsk_verbose)
+                    tsk_error_print(stderr);
+                tsk_error_reset();
+            }
+        }
+
+        bool last = false;
+        if ((a_state->ordered == false)
+            && ((a_fs_file->name->flags & a_state->flags) ==
+                a_fs_file->name->flags)) {
+            TSK_WALK_RET_ENUM retval = a_state->action(a_fs_file,
+                a_dir->path.c_str(), a_state->ptr);
+            if (retval != TSK_WALK_CONT) {
+                dw_set_stop(a_state, retval);
+                last = true;
+            }
+        }
+
+        if ((last == false) && (a_dir->save_named) && (a_fs_file->meta)
+            && (a_fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC)) {
+            named.push_back(a_fs_file->meta->addr);
+        }
+
+        /* Recurse into the same directories as tsk_fs_dir_walk_lcl() */
+        if ((last == false)
+            && (TSK_FS_IS_DIR_NAME(a_fs_file->name->type)
+                || (a_fs_file->name->type == TSK_FS_NAME_TYPE_UNDEF))
+            && (a_fs_file->meta)
+            && (TSK_FS_IS_DIR_META(a_fs_file->meta->type))
+            && (a_state->flags & TSK_FS_DIR_WALK_FLAG_RECURSE)
+            && ((a_fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC)
+                || ((a_fs_file->name->flags & TSK_FS_NAME_FLAG_UNALLOC)
+                    && (a_fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC))
+            )
+            && (!TSK_FS_ISDOT(a_fs_file->name->name))
+            && ((a_fs_file->name->meta_addr != TSK_FS_ORPHANDIR_INUM(fs))
+                || ((a_state->flags & TSK_FS_DIR_WALK_FLAG_NOORPHAN) == 0))
+            ) {
+            TSK_INUM_T addr = a_fs_file->name->meta_addr;
+
+            /* Make sure we do not get into an infinite loop */
+            if (std::find(a_dir->seen.begin(), a_dir->seen.end(),
+                    addr) != a_dir->seen.end()) {
+                if (tsk_verbose)
+                    fprintf(stderr,
+                        "tsk_fs_dir_walk_parallel: Loop detected with address %"
+                        PRIuINUM, addr);
+            }
+            /* If we've exceeded the max depth or max length, the serial
+             * walk gives up on the rest of this directory */
+            else if ((a_dir->seen.size() >= TSK_FS_DIR_WALK_MAX_DEPTH) ||
+                (TSK_FS_DIR_WALK_PATH_SIZE <=
+                    a_dir->path.size() + strlen(a_fs_file->name->name))) {
+                if (tsk_verbose) {
+                    tsk_fprintf(stdout,
+                        "tsk_fs_dir_walk_parallel: directory : %"
+                        PRIuINUM " exceeded max length / depth\n", addr);
+                }
+                last = true;
+            }
+            else {
+                DW_DIR *subdir = dw_dir_alloc(addr);
+                subdir->path = a_dir->path;
+                subdir->path += a_fs_file->name->name;
+                subdir->path += '/';
+                subdir->seen = a_dir->seen;
+                subdir->seen.push_back(addr);
+
+                /* We do not want to save info about named unalloc files
+                 * in the Orphan directory (because then we have no
+                 * orphans) and it can only be loaded once the set
+                 * of the rest of the file system is complete. */
+                if (addr == TSK_FS_ORPHANDIR_INUM(fs)) {
+                    subdir->state = DW_DEFERRED;
+                    std::lock_guard < std::mutex >
+                        guard(a_state->wait_lock);
+                    a_state->deferred.push_back(subdir);
+                }
+                else {
+                    subdir->save_named = a_dir->save_named;
+                    dw_push(a_state, a_qidx, subdir);
+                }
+                if (a_state->ordered)
+                    a_dir->subdirs[i] = subdir;
+            }
+        }
+
+        if (a_state->ordered) {
+            a_dir->metas[i] = a_fs_file->meta;
+            a_fs_file->meta = NULL;
+        }
+        else if (a_fs_file->meta) {
+            tsk_fs_meta_close(a_fs_file->meta);
+            a_fs_file->meta = NULL;
+        }
+        a_fs_file->name = NULL;
+
+        if (last) {
+            i++;
+            break;
+        }
+    }
+    a_dir->names_walked = i;
+
+    if (named.empty() == false) {
+        std::lock_guard < std::mutex > guard(a_state->named_lock);
+        a_state->named.insert(a_state->named.end(), named.begin(),
+            named.end());
+    }
+
+    if (a_state->ordered) {
+        a_state->backlog++;
+        a_dir->state = DW_DONE;
+        dw_wake(a_state);
+    }
+    else {
+        dw_dir_free(a_state, a_dir);
+    }
+    dw_loaded(a_state);
+}
+
+/* Main loop of the worker threads */
+static void
+dw_worker(DW_STATE * a_state, size_t a_qidx)
+{
+    TSK_FS_FILE *fs_file;
+
+    if ((fs_file = tsk_fs_file_alloc(a_state->fs)) == NULL) {
+        // the other threads will do our share of the work
+        tsk_error_reset();
+        return;
+    }
+
+    for (;;) {
+        if (a_state->stop || a_state->finished)
+            break;
+
+        // let the callbacks catch up
+        if (a_state->ordered && a_state->backlog >= DW_BACKLOG_MAX) {
+            a_state->throttled++;
+            dw_sleep(a_state, [a_state] {
+                return a_state->stop || a_state->finished
+                    || a_state->backlog < DW_BACKLOG_MAX;
+            });
+            a_state->throttled--;
+            continue;
+        }
+
+        DW_DIR *dir = dw_next(a_state, a_qidx);
+        if (dir == NULL) {
+            dw_sleep(a_state, [a_state] {
+                return a_state->stop || a_state->finished
+                    || a_state->queued != 0;
+            });
+            continue;
+        }
+        dw_load(a_state, a_qidx, dir, fs_file);
+    }
+
+    tsk_fs_file_close(fs_file);
+}
+
+/* Wait for a dir to be loaded.  The calling thread loads the dir itself
+ * if no worker has started on it yet and helps out with other dirs while
+ * it waits. */
+static void
+dw_wait(DW_STATE * a_state, size_t a_qidx, DW_DIR * a_dir,
+    TSK_FS_FILE * a_fs_file)
+{
+    while (a_dir->state != DW_DONE) {
+        if (dw_take(a_state, a_dir)) {
+            dw_load(a_state, a_qidx, a_dir, a_fs_file);
+            break;
+        }
+
+        DW_DIR *other = dw_next(a_state, a_qidx);
+        if (other) {
+            dw_load(a_state, a_qidx, other, a_fs_file);
+            continue;
+        }
+
+        // a deferred dir is pushed once it is released
+        dw_sleep(a_state, [a_state, a_dir] {
+            return a_dir->state == DW_DONE || a_state->queued != 0;
+        });
+    }
+}
+
+/* Wait for the subdirs that were not called back (because a callback
+ * failed) to be loaded and then free a_dir. */
+static void
+dw_discard(DW_STATE * a_state, size_t a_qidx, DW_DIR * a_dir,
+    TSK_FS_FILE * a_fs_file)
+{
+    for (size_t i = 0; i < a_dir->subdirs.size(); i++) {
+        if (a_dir->subdirs[i]) {
+            dw_wait(a_state, a_qidx, a_dir->subdirs[i], a_fs_file);
+            dw_discard(a_state, a_qidx, a_dir->subdirs[i], a_fs_file);
+            a_dir->subdirs[i] = NULL;
+        }
+    }
+    dw_dir_free(a_state, a_dir);
+}
+
+/* Ordered mode: call the callback for the names in a_dir and its subdirs
+ * in the same order that tsk_fs_dir_walk_lcl() does. */
+static TSK_WALK_RET_ENUM
+dw_emit(DW_STATE * a_state, size_t a_qidx, DW_DIR * a_dir,
+    TSK_FS_FILE * a_fs_file, TSK_FS_FILE * a_load_file)
+{
+    dw_wait(a_state, a_qidx, a_dir, a_load_file);
+
+    for (size_t i = 0; i < a_dir->names_walked; i++) {
+        a_fs_file->name = &a_dir->fs_dir->names[i];
+        a_fs_file->meta = a_dir->metas[i];
+        a_dir->metas[i] = NULL;
+
+        // call the action if we have the right flags.
+        if ((a_fs_file->name->flags & a_state->flags) ==
+            a_fs_file->name->flags) {
+            TSK_WALK_RET_ENUM retval = a_state->action(a_fs_file,
+                a_dir->path.c_str(), a_state->ptr);
+            if (retval != TSK_WALK_CONT) {
+                a_dir->metas[i] = a_fs_file->meta;
+                a_fs_file->meta = NULL;
+                a_fs_file->name = NULL;
+                return retval;
+            }
+        }
+
+        a_fs_file->name = NULL;
+        if (a_fs_file->meta) {
+            tsk_fs_meta_close(a_fs_file->meta);
+            a_fs_file->meta = NULL;
+        }
+
+        DW_DIR *subdir = a_dir->subdirs[i];
+        if (subdir) {
+            TSK_WALK_RET_ENUM retval = dw_emit(a_state, a_qidx, subdir,
+                a_fs_file, a_load_file);
+            if (retval == TSK_WALK_STOP)
+                return TSK_WALK_STOP;
+            else if (retval == TSK_WALK_ERROR) {
+                /* A failure in a subdir does not end the walk,
+                 * which is what tsk_fs_dir_walk_lcl() does */
+                if (tsk_verbose) {
+                    tsk_fprintf(stderr,
+                        "tsk_fs_dir_walk_parallel: error reading directory: %"
+                        PRIuINUM "\n", subdir->addr);
+                    tsk_error_print(stderr);
+                }
+                tsk_error_reset();
+            }
+            dw_discard(a_state, a_qidx, subdir, a_load_file);
+            a_dir->subdirs[i] = NULL;
+
+            if (a_state->throttled && a_state->backlog < DW_BACKLOG_MAX)
+                dw_wake(a_state);
+        }
+    }
+    return TSK_WALK_CONT;
+}
+
+#endif
+
+
+/** \ingroup fslib
+* Walk the file names in a directory and obtain the details of the files via a callback,
+* using several threads to load the directories.  This is the same walk as
+* tsk_fs_dir_walk() (including the loop detection and orphan file handling), but the
+* directories are spread over up to tsk_parallel_get_threads() threads.  Each thread
+* takes subdirectories from its own queue and steals from the queues of the others
+* when it runs out.
+*
+* In TSK_FS_DIR_WALK_PARALLEL_ORDERED mode, the callback is called on the calling thread
+* with the files in the same order as tsk_fs_dir_walk().  The workers load ahead of the
+* callbacks.  In TSK_FS_DIR_WALK_PARALLEL_CONCURRENT mode, the workers call the callback
+* as soon as they load each file, so it can be called by several threads at the same time
+* and in any order.  In that mode, returning TSK_WALK_ERROR from any callback ends the
+* whole walk.
+*
+* @param a_fs File system to analyze
+* @param a_addr Metadata address of the directory to analyze
+* @param a_flags Flags used during analysis
+* @param a_mode How the callback is called
+* @param a_action Callback function that is called for each file name
+* @param a_ptr Pointer to data that is passed to the callback function each time
+* @returns 1 on error and 0 on success
+*/
+uint8_t
+tsk_fs_dir_walk_parallel(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
+    TSK_FS_DIR_WALK_FLAG_ENUM a_flags, TSK_FS_DIR_WALK_PARALLEL_ENUM a_mode,
+    TSK_FS_DIR_WALK_CB a_action, void *a_ptr)
+{
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_dir_walk_parallel: called with NULL or unallocated structures");
+        return 1;
+    }
+
+#ifdef TSK_MULTITHREAD_LIB
+    size_t nthreads = tsk_parallel_get_threads();
+
+    // there is nothing to spread out if we do not recurse
+    if ((nthreads < 2) || ((a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE) == 0))
+        return tsk_fs_dir_walk(a_fs, a_addr, a_flags, a_action, a_ptr);
+
+    /* Sanity check on flags -- make sure at least one ALLOC is set */
+    if (((a_flags & TSK_FS_DIR_WALK_FLAG_ALLOC) == 0) &&
+        ((a_flags & TSK_FS_DIR_WALK_FLAG_UNALLOC) == 0)) {
+        a_flags = (TSK_FS_DIR_WALK_FLAG_ENUM) (a_flags |
+            TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_UNALLOC);
+    }
+
+    // in ordered mode, the calling thread only loads dirs when it has to wait
+    bool ordered = (a_mode != TSK_FS_DIR_WALK_PARALLEL_CONCURRENT);
+    size_t nworkers = ordered ? nthreads - 1 : nthreads;
+    DW_STATE state(nworkers + (ordered ? 1 : 0));
+    state.fs = a_fs;
+    state.flags = a_flags;
+    state.action = a_action;
+    state.ptr = a_ptr;
+    state.ordered = ordered;
+
+    /* if the flags are right, we can collect info that may be needed
+     * for an orphan walk. */
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    if ((a_fs->inum_named == NULL) && (a_addr == a_fs->root_inum))
+        state.save_named = true;
+    tsk_release_lock(&a_fs->list_inum_named_lock);
+
+    // load the first directory here so that its errors are reported
+    DW_DIR *root = dw_dir_alloc(a_addr);
+    if ((root->fs_dir = tsk_fs_dir_open_meta(a_fs, a_addr)) == NULL) {
+        delete root;
+        return 1;
+    }
+    root->save_named = state.save_named;
+
+    std::vector < std::thread > workers;
+    TSK_WALK_RET_ENUM retval = TSK_WALK_CONT;
+    if (ordered) {
+        TSK_FS_FILE *fs_file = tsk_fs_file_alloc(a_fs);
+        TSK_FS_FILE *load_file = tsk_fs_file_alloc(a_fs);
+        if ((fs_file == NULL) || (load_file == NULL)) {
+            if (fs_file)
+                tsk_fs_file_close(fs_file);
+            dw_dir_free(&state, root);
+            return 1;
+        }
+
+        // the root dir is claimed by dw_wait() and never queued
+        state.pending = 1;
+        try {
+            for (size_t i = 0; i < nworkers; i++)
+                workers.push_back(std::thread(dw_worker, &state, i));
+        }
+        catch(...) {
+            // could not start as many threads as requested, carry on
+            // with the ones that we have
+        }
+
+        retval = dw_emit(&state, nworkers, root, fs_file, load_file);
+        if (retval == TSK_WALK_CONT)
+            dw_discard(&state, nworkers, root, load_file);
+        else
+            dw_set_stop(&state, retval);
+
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+
+        // after a stop, all of the dirs that are left hang off of the root
+        if (retval != TSK_WALK_CONT)
+            dw_dir_free(&state, root);
+        tsk_fs_file_close(fs_file);
+        tsk_fs_file_close(load_file);
+    }
+    else {
+        dw_push(&state, 0, root);
+        try {
+            for (size_t i = 1; i < nworkers; i++)
+                workers.push_back(std::thread(dw_worker, &state, i));
+        }
+        catch(...) {
+        }
+        dw_worker(&state, 0);
+
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+
+        // after a stop, free the dirs that were not loaded
+        for (size_t i = 0; i < state.queues.size(); i++) {
+            for (size_t j = 0; j < state.queues[i].dirs.size(); j++)
+                dw_dir_free(&state, state.queues[i].dirs[j]);
+        }
+        for (size_t i = 0; i < state.deferred.size(); i++)
+            dw_dir_free(&state, state.deferred[i]);
+
+        retval = (TSK_WALK_RET_ENUM) (int) state.stop;
+        if (retval == TSK_WALK_ERROR) {
+            TSK_ERROR_INFO *info = tsk_error_get_info();
+            if (info != NULL)
+                memcpy(info, &state.error, sizeof(TSK_ERROR_INFO));
+        }
+    }
+
+    if (retval == TSK_WALK_ERROR)
+        return 1;
+    else
+        return 0;
+#else
+    (void) a_mode;
+    return tsk_fs_dir_walk(a_fs, a_addr, a_flags, a_action, a_ptr);
+#endif
+}
@@ -639,7 +639,7 @@ tsk_fs_file_hash_calc(TSK_FS_FILE * a_fs_file,
     }
 
     hash_data.flags = a_flags;
-    if (tsk_fs_file_walk(a_fs_file, TSK_FS_FILE_WALK_FLAG_NONE,
+    if (tsk_fs_file_walk(a_fs_file, TSK_FS_FILE_WALK_FLAG_LARGE,
             tsk_fs_file_hash_calc_callback, (void *) &hash_data)) {
         tsk_error_set_errno(TSK_ERR_FS_ARG);
         tsk_error_set_errstr("tsk_fs_file_hash_calc: error in file walk");
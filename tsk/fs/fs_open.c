@@ -25,6 +25,14 @@
  --*/
 
 #include "tsk_fs_i.h"
+#include "tsk_ntfs.h"
+#include "tsk_ext2fs.h"
+#include "tsk_ffs.h"
+#include "tsk_hfs.h"
+#include "tsk_iso9660.h"
+#include "tsk_xfs.h"
+
+#include <stddef.h>
 
 /**
  * \file fs_open.c
@@ -68,6 +76,105 @@ tsk_fs_open_vol(const TSK_VS_PART_INFO * a_part_info,
     return tsk_fs_open_img(a_part_info->vs->img_info, offset, a_ftype);
 }
 
+/* Number of bytes at the start of the volume that are read once during
+ * autodetection and shared by the probe functions below.  It must cover
+ * the last UFS2 superblock location. */
+#define TSK_FS_PROBE_LEN   (UFS2_SBOFF2 + 4096)
+
+/* Test if the 16-bit value at a_off in the probe buffer matches a_val in
+ * either byte order.  Locations that could not be read are treated as
+ * a possible match so that the real open routine makes the decision. */
+static uint8_t
+fs_probe_u16(const uint8_t * a_buf, size_t a_len, size_t a_off,
+    uint16_t a_val)
+{
+    if (a_off + 2 > a_len)
+        return 1;
+    return ((tsk_getu16(TSK_LIT_ENDIAN, &a_buf[a_off]) == a_val) ||
+        (tsk_getu16(TSK_BIG_ENDIAN, &a_buf[a_off]) == a_val));
+}
+
+/* Same as fs_probe_u16() for a 32-bit value */
+static uint8_t
+fs_probe_u32(const uint8_t * a_buf, size_t a_len, size_t a_off,
+    uint32_t a_val)
+{
+    if (a_off + 4 > a_len)
+        return 1;
+    return ((tsk_getu32(TSK_LIT_ENDIAN, &a_buf[a_off]) == a_val) ||
+        (tsk_getu32(TSK_BIG_ENDIAN, &a_buf[a_off]) == a_val));
+}
+
+/* The probe functions return 1 if the volume could be of the given type
+ * and 0 if the signature that the open routine would check is missing.
+ * They only look at the same magic values as the open routines, so they
+ * never reject a volume that the open routine would accept. */
+
+static uint8_t
+ntfs_probe(const uint8_t * a_buf, size_t a_len)
+{
+    return fs_probe_u16(a_buf, a_len, offsetof(ntfs_sb, magic),
+        NTFS_FS_MAGIC);
+}
+
+static uint8_t
+ext2fs_probe(const uint8_t * a_buf, size_t a_len)
+{
+    return fs_probe_u16(a_buf, a_len,
+        EXT2FS_SBOFF + offsetof(ext2fs_sb, s_magic), EXT2FS_FS_MAGIC);
+}
+
+static uint8_t
+ffs_probe(const uint8_t * a_buf, size_t a_len)
+{
+    return (fs_probe_u32(a_buf, a_len,
+            UFS2_SBOFF + offsetof(ffs_sb2, magic), UFS2_FS_MAGIC)
+        || fs_probe_u32(a_buf, a_len,
+            UFS2_SBOFF2 + offsetof(ffs_sb2, magic), UFS2_FS_MAGIC)
+        || fs_probe_u32(a_buf, a_len,
+            UFS1_SBOFF + offsetof(ffs_sb1, magic), UFS1_FS_MAGIC));
+}
+
+static uint8_t
+hfs_probe(const uint8_t * a_buf, size_t a_len)
+{
+    size_t off = HFS_VH_OFF + offsetof(hfs_plus_vh, signature);
+    return (fs_probe_u16(a_buf, a_len, off, HFS_VH_SIG_HFSPLUS)
+        || fs_probe_u16(a_buf, a_len, off, HFS_VH_SIG_HFSX)
+        || fs_probe_u16(a_buf, a_len, off, HFS_VH_SIG_HFS));
+}
+
+static uint8_t
+iso9660_probe(const uint8_t * a_buf, size_t a_len)
+{
+    /* iso9660_open() also tries raw CD images with 16 and 24 byte block
+     * headers (2352 byte sectors), so check all three locations of the
+     * first volume descriptor */
+    size_t offs[3];
+    size_t blk = ISO9660_SBOFF / 2048;
+    size_t i;
+
+    offs[0] = ISO9660_SBOFF;
+    offs[1] = ISO9660_SBOFF + blk * (16 + 288) + 16;
+    offs[2] = ISO9660_SBOFF + blk * (24 + 280) + 24;
+
+    for (i = 0; i < 3; i++) {
+        size_t off = offs[i] + offsetof(iso9660_gvd, magic);
+        if (off + 5 > a_len)
+            return 1;
+        if (memcmp(&a_buf[off], ISO9660_MAGIC, 5) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static uint8_t
+xfs_probe(const uint8_t * a_buf, size_t a_len)
+{
+    return fs_probe_u32(a_buf, a_len,
+        XFS_SBOFF + offsetof(xfs_sb, sb_magicnum), XFS_FS_MAGIC);
+}
+
 /**
  * \ingroup fslib
  * Tries to process data in a disk image at a given offset as a file system.
@@ -90,17 +197,18 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
         TSK_FS_INFO* (*open)(TSK_IMG_INFO*, TSK_OFF_T,
                                  TSK_FS_TYPE_ENUM, uint8_t);
         TSK_FS_TYPE_ENUM type;
+        uint8_t (*probe)(const uint8_t*, size_t);   // NULL to always try
     } FS_OPENERS[] = {
-        { "NTFS",     ntfs_open,    TSK_FS_TYPE_NTFS_DETECT    },
-        { "FAT",      fatfs_open,   TSK_FS_TYPE_FAT_DETECT     },
-        { "EXT2/3/4", ext2fs_open,  TSK_FS_TYPE_EXT_DETECT     },
-        { "UFS",      ffs_open,     TSK_FS_TYPE_FFS_DETECT     },
-        { "YAFFS2",   yaffs2_open,  TSK_FS_TYPE_YAFFS2_DETECT  },
+        { "NTFS",     ntfs_open,    TSK_FS_TYPE_NTFS_DETECT,    ntfs_probe    },
+        { "FAT",      fatfs_open,   TSK_FS_TYPE_FAT_DETECT,     NULL          },
+        { "EXT2/3/4", ext2fs_open,  TSK_FS_TYPE_EXT_DETECT,     ext2fs_probe  },
+        { "UFS",      ffs_open,     TSK_FS_TYPE_FFS_DETECT,     ffs_probe     },
+        { "YAFFS2",   yaffs2_open,  TSK_FS_TYPE_YAFFS2_DETECT,  NULL          },
 #if TSK_USE_HFS
-        { "HFS",      hfs_open,     TSK_FS_TYPE_HFS_DETECT     },
+        { "HFS",      hfs_open,     TSK_FS_TYPE_HFS_DETECT,     hfs_probe     },
 #endif
-        { "ISO9660",  iso9660_open, TSK_FS_TYPE_ISO9660_DETECT },
-        { "XFS",      xfs_open,     TSK_FS_TYPE_XFS_DETECT     }
+        { "ISO9660",  iso9660_open, TSK_FS_TYPE_ISO9660_DETECT, iso9660_probe },
+        { "XFS",      xfs_open,     TSK_FS_TYPE_XFS_DETECT,     xfs_probe     }
     };
 
     if (a_img_info == NULL) {
@@ -117,13 +225,52 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
         unsigned long i;
         const char *name_first = "";
         TSK_FS_INFO *fs_first = NULL;
+        uint8_t *probe_buf;
+        ssize_t probe_len;
 
         if (tsk_verbose)
             tsk_fprintf(stderr,
                 "fsopen: Auto detection mode at offset %" PRIuOFF "\n",
                 a_offset);
 
+        /* Read the start of the volume once and use it to skip the file
+         * systems whose signature is not there, instead of having every
+         * open routine allocate and read its own copy of the superblock.
+         * It is read in pieces that fit in the image cache so that the
+         * superblock reads of the open routines that are tried come from
+         * the cache.  If the read fails, every file system is tried. */
+        if ((probe_buf = (uint8_t *) tsk_malloc(TSK_FS_PROBE_LEN)) == NULL)
+            return NULL;
+        probe_len = 0;
+        while (probe_len < TSK_FS_PROBE_LEN) {
+            TSK_OFF_T off = a_offset + probe_len;
+            size_t len = TSK_IMG_INFO_CACHE_LEN - (size_t) (off % 512);
+            ssize_t cnt;
+
+            if (len > (size_t) (TSK_FS_PROBE_LEN - probe_len))
+                len = (size_t) (TSK_FS_PROBE_LEN - probe_len);
+            cnt = tsk_img_read(a_img_info, off,
+                (char *) &probe_buf[probe_len], len);
+            if (cnt < 0)
+                tsk_error_reset();
+            if (cnt <= 0)
+                break;
+            probe_len += cnt;
+            if ((size_t) cnt < len)
+                break;
+        }
+
         for (i = 0; i < sizeof(FS_OPENERS)/sizeof(FS_OPENERS[0]); ++i) {
+            if ((FS_OPENERS[i].probe != NULL) && (probe_len > 0)
+                && (FS_OPENERS[i].probe(probe_buf,
+                        (size_t) probe_len) == 0)) {
+                if (tsk_verbose)
+                    tsk_fprintf(stderr,
+                        "fsopen: Skipping %s, signature not found\n",
+                        FS_OPENERS[i].name);
+                continue;
+            }
+
             if ((fs_info = FS_OPENERS[i].open(
                     a_img_info, a_offset, FS_OPENERS[i].type, 1)) != NULL) {
                 // fs opens as type i
@@ -137,6 +284,7 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
                     // cannot autodetect the fs type and must give up
                     fs_first->close(fs_first);
                     fs_info->close(fs_info);
+                    free(probe_buf);
                     tsk_error_reset();
                     tsk_error_set_errno(TSK_ERR_FS_UNKTYPE);
                     tsk_error_set_errstr(
@@ -150,6 +298,8 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
             }
         }
 
+        free(probe_buf);
+
         if (fs_first == NULL) {
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_FS_UNKTYPE);
@@ -222,6 +372,7 @@ tsk_fs_malloc(size_t a_len)
     tsk_init_lock(&fs_info->orphan_dir_lock);
 
     fs_info->list_inum_named = NULL;
+    fs_info->inum_named = NULL;
 
     return fs_info;
 }
@@ -236,6 +387,10 @@ tsk_fs_free(TSK_FS_INFO * a_fs_info)
         tsk_list_free(a_fs_info->list_inum_named);
         a_fs_info->list_inum_named = NULL;
     }
+    if (a_fs_info->inum_named) {
+        tsk_addr_set_free(a_fs_info->inum_named);
+        a_fs_info->inum_named = NULL;
+    }
 
     /* we should probably get the lock, but we're 
      * about to kill the entire object so there are
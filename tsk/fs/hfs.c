@@ -422,6 +422,301 @@ hfs_extents_to_attr(TSK_FS_INFO * a_fs, const hfs_ext_desc * a_extents,
 }
 
 
+/**
+ * @param hfs
+ * @param a_node Leaf node that the record is in
+ * @param a_node_num Number of the node
+ * @param a_rec_off Byte offset of the record (key) in the node
+ * @param a_ptr Pointer to data that was passed into hfs_btree_leaf_walk()
+ * @returns 1 to stop the walk and 0 to continue
+ */
+typedef uint8_t(*TSK_HFS_BTREE_LEAF_CB) (HFS_INFO *, const char *a_node,
+    uint32_t a_node_num, size_t a_rec_off, void *a_ptr);
+
+/** \internal
+ * Call a_cb for every record in the leaf nodes of a B-tree, in key order.
+ * The chain of leaf nodes is followed from the first one and the nodes
+ * are read several at a time, since they mostly follow each other in the
+ * file.  This is used to load whole trees into memory, so it gives up
+ * (without setting an error) on anything unexpected, including a number
+ * of records that does not match the header.
+ *
+ * @param hfs File system
+ * @param a_attr Data attribute of the B-tree file
+ * @param a_header Header record of the B-tree
+ * @param a_cb Callback to call with each record; it returns 1 to stop
+ * the walk
+ * @param a_ptr Pointer to pass to the callback
+ * @returns 1 if the walk was stopped and 0 if all records were processed
+ */
+static uint8_t
+hfs_btree_leaf_walk(HFS_INFO * hfs, const TSK_FS_ATTR * a_attr,
+    const hfs_btree_header_record * a_header, TSK_HFS_BTREE_LEAF_CB a_cb,
+    void *a_ptr)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint16_t nodesize = tsk_getu16(fs->endian, a_header->nodesize);
+    uint32_t total_nodes = tsk_getu32(fs->endian, a_header->totalNodes);
+    uint32_t leaf_recs = tsk_getu32(fs->endian, a_header->leafRecords);
+    uint32_t cur_node = tsk_getu32(fs->endian, a_header->firstLeafNode);
+    uint32_t buf_start = 0, buf_cnt = 0, buf_max;
+    uint32_t nodes_seen = 0, recs_seen = 0;
+    char *buf;
+
+    if (nodesize < sizeof(hfs_btree_node))
+        return 1;
+
+    buf_max = HFS_BTREE_LEAF_READ_B / nodesize;
+    if (buf_max == 0)
+        buf_max = 1;
+    if ((buf = (char *) tsk_malloc((size_t) buf_max * nodesize)) == NULL) {
+        tsk_error_reset();
+        return 1;
+    }
+
+    while (cur_node != 0) {
+        hfs_btree_node *node_desc;
+        char *node;
+        uint16_t num_rec;
+        int rec;
+
+        if ((++nodes_seen > total_nodes) || (cur_node >= total_nodes))
+            goto fail;
+
+        if ((cur_node < buf_start) || (cur_node >= buf_start + buf_cnt)) {
+            uint32_t cnt_nodes = buf_max;
+            TSK_OFF_T left = a_attr->size - (TSK_OFF_T) cur_node * nodesize;
+            ssize_t cnt;
+
+            if (cnt_nodes > total_nodes - cur_node)
+                cnt_nodes = total_nodes - cur_node;
+            if ((TSK_OFF_T) cnt_nodes * nodesize > left)
+                cnt_nodes = (uint32_t) (left / nodesize);
+            if (cnt_nodes == 0)
+                goto fail;
+
+            cnt = tsk_fs_attr_read(a_attr, (TSK_OFF_T) cur_node * nodesize,
+                buf, (size_t) cnt_nodes * nodesize, 0);
+            if (cnt != (ssize_t) cnt_nodes * nodesize)
+                goto fail;
+            buf_start = cur_node;
+            buf_cnt = cnt_nodes;
+        }
+        node = &buf[(size_t) (cur_node - buf_start) * nodesize];
+        node_desc = (hfs_btree_node *) node;
+
+        if (node_desc->type != HFS_BT_NODE_TYPE_LEAF)
+            goto fail;
+        num_rec = tsk_getu16(fs->endian, node_desc->num_rec);
+        if ((size_t) num_rec * 2 > nodesize - sizeof(hfs_btree_node))
+            goto fail;
+
+        for (rec = 0; rec < num_rec; ++rec) {
+            size_t rec_off = tsk_getu16(fs->endian,
+                &node[nodesize - (rec + 1) * 2]);
+
+            if ((rec_off < sizeof(hfs_btree_node))
+                || (++recs_seen > leaf_recs)
+                || a_cb(hfs, node, cur_node, rec_off, a_ptr))
+                goto fail;
+        }
+
+        cur_node = tsk_getu32(fs->endian, node_desc->flink);
+    }
+
+    if (recs_seen != leaf_recs)
+        goto fail;
+
+    free(buf);
+    return 0;
+
+  fail:
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hfs_btree_leaf_walk: stopped at leaf node %" PRIu32 "\n",
+            cur_node);
+    tsk_error_reset();
+    free(buf);
+    return 1;
+}
+
+
+/* State of hfs_ext_map_build() while it walks the leaf records */
+typedef struct {
+    HFS_EXT_MAP *map;
+    uint16_t nodesize;
+} HFS_EXT_MAP_BUILD;
+
+static uint8_t
+hfs_ext_map_build_cb(HFS_INFO * hfs, const char *a_node,
+    uint32_t a_node_num, size_t a_rec_off, void *a_ptr)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    HFS_EXT_MAP_BUILD *build = (HFS_EXT_MAP_BUILD *) a_ptr;
+    HFS_EXT_MAP *map = build->map;
+    const hfs_btree_key_ext *key;
+    HFS_EXT_MAP_ENTRY *ent;
+    size_t keylen;
+
+    if (a_rec_off + sizeof(hfs_btree_key_ext) > build->nodesize)
+        return 1;
+    key = (const hfs_btree_key_ext *) &a_node[a_rec_off];
+    keylen = 2 + tsk_getu16(fs->endian, key->key_len);
+    if ((keylen < sizeof(hfs_btree_key_ext))
+        || (a_rec_off + keylen + sizeof(hfs_extents) > build->nodesize))
+        return 1;
+
+    ent = &map->entries[map->count];
+    ent->cnid = tsk_getu32(fs->endian, key->file_id);
+    ent->fork_type = key->fork_type;
+    ent->start_blk = tsk_getu32(fs->endian, key->start_block);
+    memcpy(ent->extents, &a_node[a_rec_off + keylen], sizeof(hfs_extents));
+
+    // the keys have to be in the order that the tree search relies on
+    if (map->count > 0) {
+        const HFS_EXT_MAP_ENTRY *prev = &map->entries[map->count - 1];
+        if ((prev->cnid > ent->cnid) || ((prev->cnid == ent->cnid)
+                && ((prev->fork_type > ent->fork_type)
+                    || ((prev->fork_type == ent->fork_type)
+                        && (prev->start_blk >= ent->start_blk)))))
+            return 1;
+    }
+    map->count++;
+    return 0;
+}
+
+/** \internal
+ * Load all of the records of the extents overflow B-tree into memory.
+ * The map is only made if the leaf records are in strictly increasing key
+ * order, so that it gives the same runs as a search from the root would.
+ *
+ * @param hfs File system (the extents file must have been loaded)
+ * @returns the map or NULL if it could not be made (no error is set)
+ */
+static HFS_EXT_MAP *
+hfs_ext_map_build(HFS_INFO * hfs)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint32_t leaf_recs =
+        tsk_getu32(fs->endian, hfs->extents_header.leafRecords);
+    HFS_EXT_MAP_BUILD build;
+    HFS_EXT_MAP *map;
+
+    if ((uint64_t) leaf_recs * sizeof(HFS_EXT_MAP_ENTRY) >
+        hfs->ext_map_max)
+        return NULL;
+
+    if ((map = (HFS_EXT_MAP *) tsk_malloc(sizeof(HFS_EXT_MAP))) == NULL) {
+        tsk_error_reset();
+        return NULL;
+    }
+    if ((map->entries = (HFS_EXT_MAP_ENTRY *) tsk_malloc((leaf_recs + 1) *
+                sizeof(HFS_EXT_MAP_ENTRY))) == NULL) {
+        tsk_error_reset();
+        free(map);
+        return NULL;
+    }
+
+    build.map = map;
+    build.nodesize = tsk_getu16(fs->endian, hfs->extents_header.nodesize);
+    if (hfs_btree_leaf_walk(hfs, hfs->extents_attr, &hfs->extents_header,
+            hfs_ext_map_build_cb, &build)) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "hfs_ext_map_build: not loading the extents overflow file\n");
+        free(map->entries);
+        free(map);
+        return NULL;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hfs_ext_map_build: loaded %" PRIuSIZE " extents records\n",
+            map->count);
+    return map;
+}
+
+/** \internal
+ * Load the extents overflow map if that was not done or tried before.
+ * Only one thread loads it; the others keep searching the B-tree until it
+ * is published.
+ * @param hfs File system
+ */
+static void
+hfs_ext_map_load(HFS_INFO * hfs)
+{
+    HFS_EXT_MAP *map;
+
+    tsk_take_lock(&(hfs->cat_cache_lock));
+    if (hfs->ext_map_tried || (hfs->ext_map_max == 0)) {
+        tsk_release_lock(&(hfs->cat_cache_lock));
+        return;
+    }
+    hfs->ext_map_tried = 1;
+    tsk_release_lock(&(hfs->cat_cache_lock));
+
+    if ((map = hfs_ext_map_build(hfs)) != NULL)
+        tsk_atomic_ptr_cas((void *volatile *) &hfs->ext_map, NULL, map);
+}
+
+/** \internal
+ * Add the runs of the extents overflow records of a fork to an attribute,
+ * using the in-memory map.  The records are processed in the same order
+ * and with the same stop conditions as the B-tree search in
+ * hfs_ext_find_extent_record_attr().
+ *
+ * @param hfs File system
+ * @param a_map Extents overflow map
+ * @param cnid File id of the file
+ * @param a_attr Attribute to add extents runs to
+ * @param a_fork_type HFS_EXT_KEY_TYPE_DATA or HFS_EXT_KEY_TYPE_RSRC
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+hfs_ext_map_find(HFS_INFO * hfs, const HFS_EXT_MAP * a_map, uint32_t cnid,
+    TSK_FS_ATTR * a_attr, uint8_t a_fork_type)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    size_t lo = 0, hi = a_map->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_map->entries[mid].cnid < cnid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; (lo < a_map->count) && (a_map->entries[lo].cnid == cnid); lo++) {
+        const HFS_EXT_MAP_ENTRY *ent = &a_map->entries[lo];
+        TSK_FS_ATTR_RUN *attr_run;
+
+        if (ent->fork_type != a_fork_type) {
+            if (a_fork_type == HFS_EXT_KEY_TYPE_DATA)
+                break;
+            continue;
+        }
+
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "hfs_ext_map_find: record (%" PRIu32 ", %" PRIu8 ", %"
+                PRIu32 ")\n", ent->cnid, ent->fork_type, ent->start_blk);
+
+        attr_run = hfs_extents_to_attr(fs, ent->extents, ent->start_blk);
+        if ((attr_run == NULL) && (tsk_error_get_errno() != 0)) {
+            tsk_error_errstr2_concat(" - hfs_ext_find_extent_record_attr");
+            return 1;
+        }
+
+        if (tsk_fs_attr_add_run(fs, a_attr, attr_run)) {
+            tsk_error_errstr2_concat(" - hfs_ext_find_extent_record_attr");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
 /**
  * Look in the extents catalog for entries for a given file. Add the runs
  * to the passed attribute structure.
@@ -442,6 +737,7 @@ hfs_ext_find_extent_record_attr(HFS_INFO * hfs, uint32_t cnid,
     char *node = NULL;
     uint8_t is_done;
     uint8_t desiredType;
+    HFS_EXT_MAP *map;
 
     tsk_error_reset();
 
@@ -495,6 +791,13 @@ hfs_ext_find_extent_record_attr(HFS_INFO * hfs, uint32_t cnid,
         }
     }
 
+    // use the in-memory copy of the tree once many forks were looked up
+    if (tsk_atomic_add(&hfs->ext_lookup_cnt, 1) == HFS_EXT_MAP_LOOKUPS)
+        hfs_ext_map_load(hfs);
+    if ((map = (HFS_EXT_MAP *) tsk_atomic_ptr_load((void *volatile *)
+                &hfs->ext_map)) != NULL)
+        return hfs_ext_map_find(hfs, map, cnid, a_attr, desiredType);
+
     // allocate a node buffer
     nodesize = tsk_getu16(fs->endian, hfs->extents_header.nodesize);
     if ((node = (char *) tsk_malloc(nodesize)) == NULL) {
@@ -822,6 +1125,79 @@ hfs_cat_compare_keys(HFS_INFO * hfs, const hfs_btree_key_cat * key1,
 }
 
 
+/** \internal
+ * Read data from the catalog file.  The B-tree nodes that the data is in
+ * are kept in a small direct-mapped cache so that the nodes near the root
+ * and the leaf records that are looked up repeatedly are not read from the
+ * image each time.
+ *
+ * @param hfs File system
+ * @param a_off Byte offset in the catalog file
+ * @param a_buf [out] Buffer to copy the data into
+ * @param a_len Number of bytes to read
+ * @returns Number of bytes read or -1 on error (see tsk_fs_attr_read())
+ */
+static ssize_t
+hfs_cat_read(HFS_INFO * hfs, TSK_OFF_T a_off, char *a_buf, size_t a_len)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint16_t nodesize =
+        tsk_getu16(fs->endian, hfs->catalog_header.nodesize);
+    size_t done = 0;
+
+    while ((done < a_len) && (nodesize > 0)) {
+        int64_t node = (int64_t) ((a_off + done) / nodesize);
+        size_t node_off = (size_t) ((a_off + done) % nodesize);
+        size_t slot = (size_t) (node % HFS_CAT_NODE_CACHE_N);
+        size_t len = nodesize - node_off;
+        char *slot_buf;
+
+        if (len > a_len - done)
+            len = a_len - done;
+
+        tsk_take_lock(&(hfs->cat_cache_lock));
+        if (hfs->cat_node_cache == NULL) {
+            size_t i;
+            if ((hfs->cat_node_cache =
+                    (char *) tsk_malloc((size_t) nodesize *
+                        HFS_CAT_NODE_CACHE_N)) == NULL) {
+                tsk_release_lock(&(hfs->cat_cache_lock));
+                tsk_error_reset();
+                break;
+            }
+            for (i = 0; i < HFS_CAT_NODE_CACHE_N; i++)
+                hfs->cat_node_tag[i] = -1;
+        }
+        slot_buf = &hfs->cat_node_cache[slot * nodesize];
+
+        if (hfs->cat_node_tag[slot] != node) {
+            ssize_t cnt = tsk_fs_attr_read(hfs->catalog_attr,
+                (TSK_OFF_T) node * nodesize, slot_buf, nodesize, 0);
+            if (cnt != nodesize) {
+                // read what was asked for below, without the cache
+                hfs->cat_node_tag[slot] = -1;
+                tsk_release_lock(&(hfs->cat_cache_lock));
+                tsk_error_reset();
+                break;
+            }
+            hfs->cat_node_tag[slot] = node;
+        }
+        memcpy(&a_buf[done], &slot_buf[node_off], len);
+        tsk_release_lock(&(hfs->cat_cache_lock));
+        done += len;
+    }
+
+    if (done < a_len) {
+        ssize_t cnt = tsk_fs_attr_read(hfs->catalog_attr, a_off + done,
+            &a_buf[done], a_len - done, 0);
+        if (cnt < 0)
+            return -1;
+        done += cnt;
+    }
+    return (ssize_t) done;
+}
+
+
 /** \internal
  *
  * Traverse the HFS catalog file.  Call the callback for each
@@ -889,8 +1265,7 @@ hfs_cat_traverse(HFS_INFO * hfs,
 
         // read the current node
         cur_off = cur_node * nodesize;
-        cnt = tsk_fs_attr_read(hfs->catalog_attr, cur_off,
-            node, nodesize, 0);
+        cnt = hfs_cat_read(hfs, cur_off, node, nodesize);
         if (cnt != nodesize) {
             if (cnt >= 0) {
                 tsk_error_reset();
@@ -1203,7 +1578,7 @@ hfs_cat_read_thread_record(HFS_INFO * hfs, TSK_OFF_T off,
     ssize_t cnt;
 
     memset(thread, 0, sizeof(hfs_thread));
-    cnt = tsk_fs_attr_read(hfs->catalog_attr, off, (char *) thread, 10, 0);
+    cnt = hfs_cat_read(hfs, off, (char *) thread, 10);
     if (cnt != 10) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1235,8 +1610,8 @@ hfs_cat_read_thread_record(HFS_INFO * hfs, TSK_OFF_T off,
     }
 
     cnt =
-        tsk_fs_attr_read(hfs->catalog_attr, off + 10,
-        (char *) thread->name.unicode, uni_len * 2, 0);
+        hfs_cat_read(hfs, off + 10, (char *) thread->name.unicode,
+        uni_len * 2);
     if (cnt != uni_len * 2) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1269,7 +1644,7 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 
     memset(record, 0, sizeof(hfs_file_folder));
 
-    cnt = tsk_fs_attr_read(hfs->catalog_attr, off, rec_type, 2, 0);
+    cnt = hfs_cat_read(hfs, off, rec_type, 2);
     if (cnt != 2) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1283,8 +1658,7 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 
     if (tsk_getu16(fs->endian, rec_type) == HFS_FOLDER_RECORD) {
         cnt =
-            tsk_fs_attr_read(hfs->catalog_attr, off, (char *) record,
-            sizeof(hfs_folder), 0);
+            hfs_cat_read(hfs, off, (char *) record, sizeof(hfs_folder));
         if (cnt != sizeof(hfs_folder)) {
             if (cnt >= 0) {
                 tsk_error_reset();
@@ -1298,8 +1672,7 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
     }
     else if (tsk_getu16(fs->endian, rec_type) == HFS_FILE_RECORD) {
         cnt =
-            tsk_fs_attr_read(hfs->catalog_attr, off, (char *) record,
-            sizeof(hfs_file), 0);
+            hfs_cat_read(hfs, off, (char *) record, sizeof(hfs_file));
         if (cnt != sizeof(hfs_file)) {
             if (cnt >= 0) {
                 tsk_error_reset();
@@ -1323,6 +1696,264 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 }
 
 
+/* qsort callback to sort the catalog index by CNID */
+static int
+hfs_cat_index_cmp(const void *a_ent1, const void *a_ent2)
+{
+    uint32_t cnid1 = ((const HFS_CAT_INDEX_ENTRY *) a_ent1)->cnid;
+    uint32_t cnid2 = ((const HFS_CAT_INDEX_ENTRY *) a_ent2)->cnid;
+
+    if (cnid1 < cnid2)
+        return -1;
+    return (cnid1 > cnid2);
+}
+
+/* State of hfs_cat_index_build() while it walks the leaf records */
+typedef struct {
+    HFS_CAT_INDEX_ENTRY *ents;
+    size_t cnt;
+    hfs_btree_key_cat prev_key;
+    uint8_t has_prev;
+} HFS_CAT_INDEX_BUILD;
+
+static uint8_t
+hfs_cat_index_build_cb(HFS_INFO * hfs, const char *a_node,
+    uint32_t a_node_num, size_t a_rec_off, void *a_ptr)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    HFS_CAT_INDEX_BUILD *build = (HFS_CAT_INDEX_BUILD *) a_ptr;
+    uint16_t nodesize =
+        tsk_getu16(fs->endian, hfs->catalog_header.nodesize);
+    const hfs_btree_key_cat *key;
+    hfs_btree_key_cat empty_key;
+    size_t keylen;
+
+    if (a_rec_off + 8 > nodesize)
+        return 1;
+    key = (const hfs_btree_key_cat *) &a_node[a_rec_off];
+    keylen = 2 + tsk_getu16(fs->endian, key->key_len);
+    if ((keylen < 8) || (a_rec_off + keylen > nodesize)
+        || (8 + 2 * (size_t) tsk_getu16(fs->endian,
+                key->name.length) > keylen))
+        return 1;
+
+    if (build->has_prev
+        && (hfs_cat_compare_keys(hfs, &build->prev_key, key) >= 0))
+        return 1;
+
+    memset(&empty_key, 0, sizeof(empty_key));
+    memcpy(empty_key.parent_cnid, key->parent_cnid,
+        sizeof(empty_key.parent_cnid));
+
+    // thread records have the CNID and an empty name as key
+    if (hfs_cat_compare_keys(hfs, key, &empty_key) == 0) {
+        HFS_CAT_INDEX_ENTRY *ent = &build->ents[build->cnt++];
+        ent->cnid = tsk_getu32(fs->endian, key->parent_cnid);
+        ent->thread_node = a_node_num;
+        ent->thread_off = (uint16_t) a_rec_off;
+        ent->rec_node = 0;
+        ent->rec_off = 0;
+    }
+    // file and folder records have the CNID at the same offset
+    else if (a_rec_off + keylen + 12 <= nodesize) {
+        uint16_t rec_type =
+            tsk_getu16(fs->endian, &a_node[a_rec_off + keylen]);
+        if ((rec_type == HFS_FOLDER_RECORD)
+            || (rec_type == HFS_FILE_RECORD)) {
+            HFS_CAT_INDEX_ENTRY *ent = &build->ents[build->cnt++];
+            ent->cnid = tsk_getu32(fs->endian,
+                &a_node[a_rec_off + keylen + 8]);
+            ent->thread_node = 0;
+            ent->thread_off = 0;
+            ent->rec_node = a_node_num;
+            ent->rec_off = (uint16_t) a_rec_off;
+        }
+    }
+
+    memset(&build->prev_key, 0, sizeof(build->prev_key));
+    memcpy(&build->prev_key, key,
+        keylen < sizeof(build->prev_key) ? keylen : sizeof(build->prev_key));
+    build->has_prev = 1;
+    return 0;
+}
+
+/** \internal
+ * Make the CNID index of the catalog with one pass over its leaf records.
+ * The index is only made if the leaf records are in strictly increasing
+ * key order, so that it finds the same records as a search from the root
+ * would.
+ *
+ * @param hfs File system
+ * @returns the index or NULL if it could not be made (no error is set)
+ */
+static HFS_CAT_INDEX *
+hfs_cat_index_build(HFS_INFO * hfs)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint32_t leaf_recs =
+        tsk_getu32(fs->endian, hfs->catalog_header.leafRecords);
+    HFS_CAT_INDEX_BUILD build;
+    HFS_CAT_INDEX *idx;
+    size_t i;
+
+    if ((uint64_t) leaf_recs * sizeof(HFS_CAT_INDEX_ENTRY) >
+        hfs->cat_index_max)
+        return NULL;
+
+    memset(&build, 0, sizeof(build));
+    if ((build.ents = (HFS_CAT_INDEX_ENTRY *) tsk_malloc((leaf_recs + 1) *
+                sizeof(HFS_CAT_INDEX_ENTRY))) == NULL) {
+        tsk_error_reset();
+        return NULL;
+    }
+
+    if (hfs_btree_leaf_walk(hfs, hfs->catalog_attr, &hfs->catalog_header,
+            hfs_cat_index_build_cb, &build)) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "hfs_cat_index_build: not indexing the catalog\n");
+        free(build.ents);
+        return NULL;
+    }
+
+    // merge the thread and file / folder records of each CNID
+    qsort(build.ents, build.cnt, sizeof(HFS_CAT_INDEX_ENTRY),
+        hfs_cat_index_cmp);
+    if (build.cnt > 0) {
+        size_t cnt = 1;
+        for (i = 1; i < build.cnt; i++) {
+            HFS_CAT_INDEX_ENTRY *last = &build.ents[cnt - 1];
+            if (last->cnid != build.ents[i].cnid) {
+                build.ents[cnt++] = build.ents[i];
+                continue;
+            }
+            if (last->thread_node == 0) {
+                last->thread_node = build.ents[i].thread_node;
+                last->thread_off = build.ents[i].thread_off;
+            }
+            if (last->rec_node == 0) {
+                last->rec_node = build.ents[i].rec_node;
+                last->rec_off = build.ents[i].rec_off;
+            }
+        }
+        build.cnt = cnt;
+    }
+
+    if ((idx = (HFS_CAT_INDEX *) tsk_malloc(sizeof(HFS_CAT_INDEX))) == NULL) {
+        tsk_error_reset();
+        free(build.ents);
+        return NULL;
+    }
+    idx->entries = build.ents;
+    idx->count = build.cnt;
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hfs_cat_index_build: indexed %" PRIu32 " records\n",
+            leaf_recs);
+    return idx;
+}
+
+/** \internal
+ * Make the CNID index of the catalog if that was not done or tried before.
+ * Only one thread builds it; the others keep searching the B-tree until it
+ * is published.
+ * @param hfs File system
+ */
+static void
+hfs_cat_index_load(HFS_INFO * hfs)
+{
+    HFS_CAT_INDEX *idx;
+
+    tsk_take_lock(&(hfs->cat_cache_lock));
+    if (hfs->cat_index_tried || (hfs->cat_index_max == 0)) {
+        tsk_release_lock(&(hfs->cat_cache_lock));
+        return;
+    }
+    hfs->cat_index_tried = 1;
+    tsk_release_lock(&(hfs->cat_cache_lock));
+
+    if ((idx = hfs_cat_index_build(hfs)) != NULL)
+        tsk_atomic_ptr_cas((void *volatile *) &hfs->cat_index, NULL, idx);
+}
+
+/** \internal
+ * Find the byte offset of the thread record of a CNID or of its file or
+ * folder record with the CNID index.  The key of the record is compared
+ * with a_needle, so the result is the same as that of
+ * hfs_cat_get_record_offset().
+ *
+ * @param hfs File system
+ * @param a_cnid CNID of the file or folder
+ * @param a_needle Key to search for
+ * @param a_thread 1 to find the thread record and 0 for the file or
+ * folder record
+ * @param a_off [out] Byte offset of the record (not including key) or 0 if
+ * the thread record does not exist
+ * @returns 1 if a_off was set and 0 if the B-tree has to be searched
+ */
+static uint8_t
+hfs_cat_index_find(HFS_INFO * hfs, uint32_t a_cnid,
+    const hfs_btree_key_cat * a_needle, uint8_t a_thread, TSK_OFF_T * a_off)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint16_t nodesize =
+        tsk_getu16(fs->endian, hfs->catalog_header.nodesize);
+    HFS_CAT_INDEX *idx;
+    const HFS_CAT_INDEX_ENTRY *ent = NULL;
+    hfs_btree_key_cat key;
+    size_t lo, hi, len;
+    uint32_t node;
+    uint16_t off;
+    TSK_OFF_T key_off;
+
+    if ((idx = (HFS_CAT_INDEX *) tsk_atomic_ptr_load((void *volatile *)
+                &hfs->cat_index)) == NULL)
+        return 0;
+
+    lo = 0;
+    hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].cnid < a_cnid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ((lo < idx->count) && (idx->entries[lo].cnid == a_cnid))
+        ent = &idx->entries[lo];
+
+    node = (ent == NULL) ? 0 :
+        (a_thread ? ent->thread_node : ent->rec_node);
+    off = (ent == NULL) ? 0 : (a_thread ? ent->thread_off : ent->rec_off);
+
+    // every thread record is in the index, but a file or folder record
+    // with a different CNID could still have the key we are looking for
+    if (node == 0) {
+        if (a_thread) {
+            *a_off = 0;
+            return 1;
+        }
+        return 0;
+    }
+
+    memset(&key, 0, sizeof(key));
+    len = nodesize - off;
+    if (len > sizeof(key))
+        len = sizeof(key);
+    key_off = (TSK_OFF_T) node * nodesize + off;
+    if (hfs_cat_read(hfs, key_off, (char *) &key, len) != (ssize_t) len) {
+        tsk_error_reset();
+        return 0;
+    }
+    if (hfs_cat_compare_keys(hfs, &key, a_needle) != 0)
+        return 0;
+
+    *a_off = key_off + 2 + tsk_getu16(fs->endian, key.key_len);
+    return 1;
+}
+
+
 // hfs_lookup_hard_link appears to be unnecessary - it looks up the cnid
 // by seeing if there's a file/dir with the standard hard link name plus
 // linknum and returns the meta_addr. But this should always be the same as linknum,
@@ -1389,6 +2020,113 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 //    return 0;
 //}
 
+/** \internal
+ * Look up a folder that is a direct child of the root folder by name and
+ * return its cnid and creation time.  This goes straight to the catalog
+ * B-tree instead of listing the root directory, so it does not do any
+ * hard link processing.
+ * @param hfs File system being analyzed
+ * @param name Name of the folder (ASCII, may contain nulls)
+ * @param name_len Number of characters in name
+ * @param inum [out] cnid of the folder
+ * @param crtime [out] Creation time of the folder
+ * @returns 0 if the folder was found and 1 if not (or on error)
+ */
+static uint8_t
+hfs_find_root_folder(HFS_INFO * hfs, const char *name, size_t name_len,
+    TSK_INUM_T * inum, time_t * crtime)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & (hfs->fs_info);
+    hfs_btree_key_cat key;
+    hfs_file_folder record;
+    TSK_OFF_T off;
+    size_t i;
+
+    memset((char *) &key, 0, sizeof(hfs_btree_key_cat));
+    cnid_to_array(HFS_ROOT_INUM, key.parent_cnid);
+    key.name.length[0] = (uint8_t) (name_len >> 8);
+    key.name.length[1] = (uint8_t) (name_len & 0xff);
+    for (i = 0; i < name_len; i++) {
+        key.name.unicode[2 * i] = 0;
+        key.name.unicode[2 * i + 1] = (uint8_t) name[i];
+    }
+
+    off = hfs_cat_get_record_offset(hfs, &key);
+    if (off == 0)
+        return 1;
+
+    if (hfs_cat_read_file_folder_record(hfs, off, &record))
+        return 1;
+
+    if (tsk_getu16(fs->endian,
+            record.folder.std.rec_type) != HFS_FOLDER_RECORD)
+        return 1;
+
+    *inum = tsk_getu32(fs->endian, record.folder.std.cnid);
+    *crtime =
+        (time_t) hfs_convert_2_unix_time(tsk_getu32(fs->endian,
+            record.folder.std.crtime));
+    return 0;
+}
+
+/** \internal
+ * Find the two hard link metadata folders and cache their addresses and
+ * creation times.  This is not done in hfs_open() because it is only
+ * needed once a possible hard link is seen.  Safe to call more than once.
+ * @param hfs File system being analyzed
+ */
+static void
+hfs_load_metadata_dirs(HFS_INFO * hfs)
+{
+    TSK_INUM_T inum;
+    time_t crtime;
+
+    tsk_take_lock(&(hfs->metadata_dir_cache_lock));
+    if (hfs->metadata_dirs_loaded) {
+        tsk_release_lock(&(hfs->metadata_dir_cache_lock));
+        return;
+    }
+
+    // The (file) metadata directory is a sub-directory of the root.  Its name
+    // begins with four nulls, followed by "HFS+ Private Data".
+    if (hfs_find_root_folder(hfs, "\0\0\0\0HFS+ Private Data", 21,
+            &inum, &crtime) == 0) {
+        hfs->meta_crtime = crtime;
+        hfs->has_meta_crtime = TRUE;
+        hfs->meta_inum = inum;
+    }
+
+    // The "directory" metadata directory, where hardlinked directories
+    // actually live, is also a subdirectory of the root.  Its name is
+    // ".HFS+ Private Directory Data" followed by a carriage return.
+    if (hfs_find_root_folder(hfs, ".HFS+ Private Directory Data\r", 29,
+            &inum, &crtime) == 0) {
+        hfs->metadir_crtime = crtime;
+        hfs->has_meta_dir_crtime = TRUE;
+        hfs->meta_dir_inum = inum;
+    }
+
+    if (tsk_verbose) {
+        if (hfs->has_meta_crtime)
+            tsk_fprintf(stderr,
+                "hfs_load_metadata_dirs: \"/^^^^HFS+ Private Data\" metadata folder is accessible.\n");
+        else
+            tsk_fprintf(stderr,
+                "hfs_load_metadata_dirs: Optional \"^^^^HFS+ Private Data\" metadata folder is not accessible, or does not exist.\n");
+        if (hfs->has_meta_dir_crtime)
+            tsk_fprintf(stderr,
+                "hfs_load_metadata_dirs: \"/HFS+ Private Directory Data^\" metadata folder is accessible.\n");
+        else
+            tsk_fprintf(stderr,
+                "hfs_load_metadata_dirs: Optional \"/HFS+ Private Directory Data^\" metadata folder is not accessible, or does not exist.\n");
+    }
+
+    // a failed lookup just means that there is no such folder
+    tsk_error_reset();
+    hfs->metadata_dirs_loaded = 1;
+    tsk_release_lock(&(hfs->metadata_dir_cache_lock));
+}
+
 /*
  * Given a catalog entry, will test that entry to see if it is a hard link.
  * If it is a hard link, the function returns the inum (or cnid) of the target file.
@@ -1448,9 +2186,8 @@ hfs_follow_hard_link(HFS_INFO * hfs, hfs_file * cat,
         && file_creator == HFS_HARDLINK_FILE_CREATOR) {
 
         // see if we have the HFS+ Private Data dir for file links;
-        // if not, it can't be a hard link.  (We could warn the user, but
-        // we also rely on this when finding the HFS+ Private Data dir in
-        // the first place and we don't want a warning on every hfs_open.)
+        // if not, it can't be a hard link.
+        hfs_load_metadata_dirs(hfs);
         if (hfs->meta_inum == 0)
             return cnid;
 
@@ -1495,9 +2232,8 @@ hfs_follow_hard_link(HFS_INFO * hfs, hfs_file * cat,
         && file_creator == HFS_LINKDIR_FILE_CREATOR) {
 
         // see if we have the HFS+ Private Directory Data dir for links;
-        // if not, it can't be a hard link.  (We could warn the user, but
-        // we also rely on this when finding the HFS+ Private Directory Data dir in
-        // the first place and we don't want a warning on every hfs_open.)
+        // if not, it can't be a hard link.
+        hfs_load_metadata_dirs(hfs);
         if (hfs->meta_dir_inum == 0)
             return cnid;
 
@@ -1588,6 +2324,10 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
     }
 
 
+    // index the catalog once it is clear that many files are looked up
+    if (tsk_atomic_add(&hfs->cat_lookup_cnt, 1) == HFS_CAT_INDEX_LOOKUPS)
+        hfs_cat_index_load(hfs);
+
     /* first look up the thread record for the item we're searching for */
 
     /* set up the thread record key */
@@ -1600,7 +2340,8 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
             ")\n", inum);
 
     /* look up the thread record */
-    off = hfs_cat_get_record_offset(hfs, &key);
+    if (hfs_cat_index_find(hfs, (uint32_t) inum, &key, 1, &off) == 0)
+        off = hfs_cat_get_record_offset(hfs, &key);
     if (off == 0) {
         // no parsing error, just not found
         if (tsk_error_get_errno() == 0) {
@@ -1639,7 +2380,8 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
                 key.parent_cnid));
 
     /* look up the record */
-    off = hfs_cat_get_record_offset(hfs, &key);
+    if (hfs_cat_index_find(hfs, (uint32_t) inum, &key, 0, &off) == 0)
+        off = hfs_cat_get_record_offset(hfs, &key);
     if (off == 0) {
         // no parsing error, just not found
         if (tsk_error_get_errno() == 0) {
@@ -2613,12 +3355,6 @@ hfs_inode_lookup(TSK_FS_INFO * fs, TSK_FS_FILE * a_fs_file,
 }
 
 
-typedef struct {
-    uint32_t offset;
-    uint32_t length;
-} CMP_OFFSET_ENTRY;
-
-
 /**
  * \internal
  * Reads the ZLIB compression block table from the attribute.
@@ -2997,10 +3733,232 @@ static ssize_t read_and_decompress_block(
     return (ssize_t)uncLen;
 }
 
+/**
+ * \internal
+ * Free a block table that is no longer referenced.
+ *
+ * @param tbl the block table
+ */
+static void
+hfs_cmp_table_free(HFS_CMP_TABLE * tbl)
+{
+    free(tbl->table);
+    free(tbl);
+}
+
+/**
+ * \internal
+ * Get the block table of a compressed file.  Block tables are kept in
+ * HFS_INFO so that random reads of a file do not read its table again.
+ * The table must be released with hfs_cmp_table_release().
+ *
+ * @param hfs the file system
+ * @param rAttr the resource fork attribute of the file
+ * @param read_block_table pointer to block table read function
+ * @return the block table or NULL on error
+ */
+static HFS_CMP_TABLE *
+hfs_cmp_table_get(HFS_INFO * hfs, const TSK_FS_ATTR * rAttr,
+    int (*read_block_table)(const TSK_FS_ATTR *rAttr,
+                            CMP_OFFSET_ENTRY** offsetTableOut,
+                            uint32_t* tableSizeOut,
+                            uint32_t* tableOffsetOut))
+{
+    TSK_INUM_T inum = rAttr->fs_file->meta->addr;
+    HFS_CMP_TABLE *tbl;
+    HFS_CMP_TABLE *victim;
+    int i, slot = 0;
+
+    tsk_take_lock(&(hfs->cmp_cache_lock));
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_N; i++) {
+        tbl = hfs->cmp_tables[i];
+        if ((tbl != NULL) && (tbl->inum == inum)) {
+            tbl->refcnt++;
+            tbl->last_use = ++hfs->cmp_clock;
+            tsk_release_lock(&(hfs->cmp_cache_lock));
+            return tbl;
+        }
+    }
+    tsk_release_lock(&(hfs->cmp_cache_lock));
+
+    if ((tbl = (HFS_CMP_TABLE *) tsk_malloc(sizeof(HFS_CMP_TABLE))) == NULL)
+        return NULL;
+    if (!read_block_table(rAttr, &tbl->table, &tbl->table_size,
+            &tbl->table_offset)) {
+        free(tbl);
+        return NULL;
+    }
+    tbl->inum = inum;
+    tbl->refcnt = 2;            // the caller and the cache
+
+    // Take a free slot, the slot of the same file if another thread
+    // loaded it in the meantime, or the least recently used one.
+    tsk_take_lock(&(hfs->cmp_cache_lock));
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_N; i++) {
+        if ((hfs->cmp_tables[i] == NULL)
+            || (hfs->cmp_tables[i]->inum == inum)) {
+            slot = i;
+            break;
+        }
+        if (hfs->cmp_tables[i]->last_use < hfs->cmp_tables[slot]->last_use)
+            slot = i;
+    }
+    victim = hfs->cmp_tables[slot];
+    if ((victim != NULL) && (--victim->refcnt == 0))
+        hfs_cmp_table_free(victim);
+    tbl->last_use = ++hfs->cmp_clock;
+    hfs->cmp_tables[slot] = tbl;
+    tsk_release_lock(&(hfs->cmp_cache_lock));
+
+    return tbl;
+}
+
+/**
+ * \internal
+ * Release a block table returned by hfs_cmp_table_get().
+ *
+ * @param hfs the file system
+ * @param tbl the block table
+ */
+static void
+hfs_cmp_table_release(HFS_INFO * hfs, HFS_CMP_TABLE * tbl)
+{
+    int unused;
+
+    tsk_take_lock(&(hfs->cmp_cache_lock));
+    unused = (--tbl->refcnt == 0);
+    tsk_release_lock(&(hfs->cmp_cache_lock));
+    if (unused)
+        hfs_cmp_table_free(tbl);
+}
+
+/**
+ * \internal
+ * Decompress a block, using the cache of recently decompressed blocks
+ * in HFS_INFO.  Reads that are smaller than a compression unit would
+ * otherwise decompress the same unit over and over.
+ *
+ * @param hfs the file system
+ * @param rAttr the attribute to read
+ * @param rawBuf buffer for the compressed data
+ * @param uncBuf the decompressed data
+ * @param tbl block table of the file
+ * @param indx index of block to read
+ * @param decompress_block pointer to decompression function
+ * @return decompressed size on success, -1 on error
+ */
+static ssize_t
+hfs_cmp_read_unit(HFS_INFO * hfs, const TSK_FS_ATTR * rAttr,
+    char *rawBuf, char *uncBuf, const HFS_CMP_TABLE * tbl, size_t indx,
+    int (*decompress_block)(char* rawBuf,
+                            uint32_t len,
+                            char* uncBuf,
+                            uint64_t* uncLen))
+{
+    TSK_INUM_T inum = rAttr->fs_file->meta->addr;
+    HFS_CMP_CHUNK *chunk;
+    ssize_t uncLen;
+    int i, slot = -1;
+
+    tsk_take_lock(&(hfs->cmp_cache_lock));
+    for (i = 0; i < HFS_CMP_CHUNK_CACHE_N; i++) {
+        chunk = hfs->cmp_chunks[i];
+        if ((chunk != NULL) && (chunk->len > 0) && (chunk->inum == inum)
+            && (chunk->indx == indx)) {
+            memcpy(uncBuf, chunk->data, chunk->len);
+            chunk->last_use = ++hfs->cmp_clock;
+            uncLen = chunk->len;
+            tsk_release_lock(&(hfs->cmp_cache_lock));
+            return uncLen;
+        }
+    }
+    tsk_release_lock(&(hfs->cmp_cache_lock));
+
+    uncLen = read_and_decompress_block(rAttr, rawBuf, uncBuf,
+        tbl->table, tbl->table_size, tbl->table_offset, indx,
+        decompress_block);
+    if (uncLen <= 0)
+        return uncLen;
+
+    tsk_take_lock(&(hfs->cmp_cache_lock));
+    for (i = 0; i < HFS_CMP_CHUNK_CACHE_N; i++) {
+        if (hfs->cmp_chunks[i] == NULL) {
+            // caching is optional, so ignore allocation failures
+            hfs->cmp_chunks[i] =
+                (HFS_CMP_CHUNK *) malloc(sizeof(HFS_CMP_CHUNK));
+            if (hfs->cmp_chunks[i] != NULL)
+                slot = i;
+            break;
+        }
+        if ((slot == -1)
+            || (hfs->cmp_chunks[i]->last_use <
+                hfs->cmp_chunks[slot]->last_use))
+            slot = i;
+    }
+    if (slot != -1) {
+        chunk = hfs->cmp_chunks[slot];
+        chunk->inum = inum;
+        chunk->indx = indx;
+        chunk->len = uncLen;
+        chunk->last_use = ++hfs->cmp_clock;
+        memcpy(chunk->data, uncBuf, uncLen);
+    }
+    tsk_release_lock(&(hfs->cmp_cache_lock));
+
+    return uncLen;
+}
+
+/* A batch of compression units that are decompressed in parallel by
+ * hfs_cmp_batch_task() during a file walk */
+typedef struct {
+    const TSK_FS_ATTR *rAttr;
+    const HFS_CMP_TABLE *tbl;
+    int (*decompress_block)(char* rawBuf,
+                            uint32_t len,
+                            char* uncBuf,
+                            uint64_t* uncLen);
+    size_t first;               /* index of the first unit of the batch */
+    char *rawBufs;              /* COMPRESSION_UNIT_SIZE + 1 bytes per unit */
+    char *uncBufs;              /* COMPRESSION_UNIT_SIZE bytes per unit */
+    ssize_t *lens;              /* result of read_and_decompress_block() per unit */
+    TSK_ERROR_INFO *errors;     /* error of each unit that failed */
+} HFS_CMP_BATCH;
+
+/**
+ * \internal
+ * Worker pool task that decompresses one unit of a batch.  A
+ * failure is recorded with the unit rather than returned, so that the
+ * walk reports it only after the units before it were passed to the
+ * callback, just like a sequential walk.
+ */
+static uint8_t
+hfs_cmp_batch_task(void *a_ptr, size_t a_idx)
+{
+    HFS_CMP_BATCH *batch = (HFS_CMP_BATCH *) a_ptr;
+
+    batch->lens[a_idx] = read_and_decompress_block(batch->rAttr,
+        batch->rawBufs + a_idx * (COMPRESSION_UNIT_SIZE + 1),
+        batch->uncBufs + a_idx * COMPRESSION_UNIT_SIZE,
+        batch->tbl->table, batch->tbl->table_size,
+        batch->tbl->table_offset, batch->first + a_idx,
+        batch->decompress_block);
+    if (batch->lens[a_idx] == -1) {
+        TSK_ERROR_INFO *info = tsk_error_get_info();
+        if (info != NULL)
+            memcpy(&batch->errors[a_idx], info, sizeof(TSK_ERROR_INFO));
+        tsk_error_reset();
+    }
+    return 0;
+}
+
 /**
  * \internal
  * Attr walk callback function for compressed resources
  *
+ * Files with at least HFS_CMP_PARALLEL_MIN compression units are
+ * decompressed in batches by a worker pool that lives for the whole walk;
+ * the callback is still called from this thread, in file order.
+ *
  * @param fs_attr the attribute to read
  * @param flags
  * @param a_action action callback
@@ -3024,11 +3982,11 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
     TSK_FS_INFO *fs;
     TSK_FS_FILE *fs_file;
     const TSK_FS_ATTR *rAttr;   // resource fork attribute
-    char *rawBuf = NULL;               // compressed data
-    char *uncBuf = NULL;               // uncompressed data
-    uint32_t offsetTableOffset;
-    uint32_t offsetTableSize;         // The number of table entries
-    CMP_OFFSET_ENTRY *offsetTable = NULL;
+    HFS_CMP_TABLE *tbl;         // block table of the file
+    HFS_CMP_BATCH batch;        // units decompressed in one go
+    size_t batchSize = 1;       // number of units in a full batch
+    size_t batchCnt;            // number of units in the current batch
+    TSK_PARALLEL_POOL *pool = NULL;     // decompresses the batches
     size_t indx;                // index for looping over the offset table
     TSK_OFF_T off = 0;          // the offset in the uncompressed data stream consumed thus far
 
@@ -3081,42 +4039,66 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
     }
 
     // read the offset table from the fork header
-    if (!read_block_table(rAttr, &offsetTable, &offsetTableSize, &offsetTableOffset)) {
+    if ((tbl = hfs_cmp_table_get((HFS_INFO *) fs, rAttr,
+                read_block_table)) == NULL) {
       return 1;
     }
 
-    // Allocate two buffers for the raw and uncompressed data
+    if ((tbl->table_size >= HFS_CMP_PARALLEL_MIN)
+        && (tsk_parallel_get_threads() > 1))
+        batchSize = tsk_parallel_get_threads() * 2;
+
+    // Allocate buffers for the raw and uncompressed data of a batch
     /* Raw data can be COMPRESSION_UNIT_SIZE+1 if the data is not
      * compressed and there is a 1-byte flag that indicates that
      * the data is not compressed. */
-    rawBuf = (char *) tsk_malloc(COMPRESSION_UNIT_SIZE + 1);
-    if (rawBuf == NULL) {
+    batch.rAttr = rAttr;
+    batch.tbl = tbl;
+    batch.decompress_block = decompress_block;
+    batch.rawBufs = (char *) tsk_malloc(batchSize * (COMPRESSION_UNIT_SIZE + 1));
+    batch.uncBufs = (char *) tsk_malloc(batchSize * COMPRESSION_UNIT_SIZE);
+    batch.lens = (ssize_t *) tsk_malloc(batchSize * sizeof(ssize_t));
+    batch.errors = (TSK_ERROR_INFO *) tsk_malloc(batchSize * sizeof(TSK_ERROR_INFO));
+    if ((batch.rawBufs == NULL) || (batch.uncBufs == NULL)
+        || (batch.lens == NULL) || (batch.errors == NULL)) {
         error_returned
             (" %s: buffers for reading and uncompressing", __func__);
         goto on_error;
     }
-
-    uncBuf = (char *) tsk_malloc(COMPRESSION_UNIT_SIZE);
-    if (uncBuf == NULL) {
+    if ((batchSize > 1) && ((pool = tsk_parallel_pool_alloc()) == NULL)) {
         error_returned
-            (" %s: buffers for reading and uncompressing", __func__);
+            (" %s: worker pool for uncompressing", __func__);
         goto on_error;
     }
+    batchCnt = 0;
+    batch.first = 0;
 
     // FOR entry in the table DO
-    for (indx = 0; indx < offsetTableSize; ++indx) {
+    for (indx = 0; indx < tbl->table_size; ++indx) {
         ssize_t uncLen;        // uncompressed length
         unsigned int blockSize;
         uint64_t lumpSize;
         uint64_t remaining;
         char *lumpStart;
 
-        switch ((uncLen = read_and_decompress_block(
-                    rAttr, rawBuf, uncBuf,
-                    offsetTable, offsetTableSize, offsetTableOffset, indx,
-                    decompress_block)))
+        // Decompress the next batch of units
+        if (indx == batch.first + batchCnt) {
+            batch.first = indx;
+            batchCnt = tbl->table_size - indx;
+            if (batchCnt > batchSize)
+                batchCnt = batchSize;
+            tsk_parallel_pool_run(pool, batchCnt, hfs_cmp_batch_task,
+                &batch);
+        }
+
+        switch ((uncLen = batch.lens[indx - batch.first]))
         {
         case -1:
+            // report the error of the unit from this thread
+            if (tsk_error_get_info() != NULL)
+                memcpy(tsk_error_get_info(),
+                    &batch.errors[indx - batch.first],
+                    sizeof(TSK_ERROR_INFO));
             goto on_error;
         case  0:
             continue;
@@ -3128,7 +4110,7 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
         // that are at most the block size.
         blockSize = fs->block_size;
         remaining = uncLen;
-        lumpStart = uncBuf;
+        lumpStart = batch.uncBufs + (indx - batch.first) * COMPRESSION_UNIT_SIZE;
 
         while (remaining > 0) {
             int retval;         // action return value
@@ -3167,15 +4149,21 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
     }
 
     // Done, so free up the allocated resources.
-    free(offsetTable);
-    free(rawBuf);
-    free(uncBuf);
+    tsk_parallel_pool_free(pool);
+    hfs_cmp_table_release((HFS_INFO *) fs, tbl);
+    free(batch.rawBufs);
+    free(batch.uncBufs);
+    free(batch.lens);
+    free(batch.errors);
     return 0;
 
 on_error:
-    free(offsetTable);
-    free(rawBuf);
-    free(uncBuf);
+    tsk_parallel_pool_free(pool);
+    hfs_cmp_table_release((HFS_INFO *) fs, tbl);
+    free(batch.rawBufs);
+    free(batch.uncBufs);
+    free(batch.lens);
+    free(batch.errors);
     return 1;
 }
 
@@ -3253,9 +4241,7 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
     const TSK_FS_ATTR *rAttr;
     char *rawBuf = NULL;
     char *uncBuf = NULL;
-    uint32_t offsetTableOffset;
-    uint32_t offsetTableSize;         // Size of the offset table
-    CMP_OFFSET_ENTRY *offsetTable = NULL;
+    HFS_CMP_TABLE *tbl;         // block table of the file
     TSK_OFF_T indx;                // index for looping over the offset table
     TSK_OFF_T startUnit = 0;
     uint32_t startUnitOffset = 0;
@@ -3326,7 +4312,8 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
     }
 
     // read the offset table from the fork header
-    if (!read_block_table(rAttr, &offsetTable, &offsetTableSize, &offsetTableOffset)) {
+    if ((tbl = hfs_cmp_table_get((HFS_INFO *) fs_file->fs_info, rAttr,
+                read_block_table)) == NULL) {
       return -1;
     }
 
@@ -3335,13 +4322,13 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
     startUnitOffset = a_offset % COMPRESSION_UNIT_SIZE;
     endUnit = (a_offset + a_len - 1) / COMPRESSION_UNIT_SIZE;
 
-    if (startUnit >= offsetTableSize || endUnit >= offsetTableSize) {
+    if (startUnit >= tbl->table_size || endUnit >= tbl->table_size) {
         error_detected(TSK_ERR_FS_ARG,
             "%s: range of bytes requested %lld - %lld falls past the "
             "end of the uncompressed stream %llu\n",
             __func__, a_offset, a_offset + a_len,
-            offsetTable[offsetTableSize-1].offset +
-            offsetTable[offsetTableSize-1].length);
+            tbl->table[tbl->table_size-1].offset +
+            tbl->table[tbl->table_size-1].length);
         goto on_error;
     }
 
@@ -3375,10 +4362,9 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
         char *uncBufPtr = uncBuf;
         size_t bytesToCopy;
 
-        switch ((uncLen = read_and_decompress_block(
-                    rAttr, rawBuf, uncBuf,
-                    offsetTable, offsetTableSize, offsetTableOffset, (size_t)indx,
-                    decompress_block)))
+        switch ((uncLen = hfs_cmp_read_unit(
+                    (HFS_INFO *) fs_file->fs_info, rAttr, rawBuf, uncBuf,
+                    tbl, (size_t)indx, decompress_block)))
         {
         case -1:
             goto on_error;
@@ -3420,14 +4406,14 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
         memset(a_buf + bytesCopied, 0, a_len - (size_t) bytesCopied);   // cast OK because diff must be < compression unit size
     }
 
-    free(offsetTable);
+    hfs_cmp_table_release((HFS_INFO *) fs_file->fs_info, tbl);
     free(rawBuf);
     free(uncBuf);
 
     return (ssize_t) bytesCopied;       // cast OK, cannot be greater than a_len which cannot be greater than SIZE_MAX/2 (rounded down).
 
 on_error:
-    free(offsetTable);
+    hfs_cmp_table_release((HFS_INFO *) fs_file->fs_info, tbl);
     free(rawBuf);
     free(uncBuf);
     return -1;
@@ -5114,12 +6100,52 @@ hfs_load_attrs(TSK_FS_FILE * fs_file)
     }
 
     // Finish up.
+    if (tsk_fs_attrlist_run_idx_build(fs_file->meta->attr)) {
+        error_returned(" - hfs_load_attrs");
+        return 1;
+    }
     fs_file->meta->attr_state = TSK_FS_META_ATTR_STUDIED;
 
     return 0;
 }
 
 
+/** \internal
+* Load the allocation (blockmap) file if it has not been loaded yet.
+*
+* @param hfs File system being analyzed
+* @returns 1 on error and 0 on success
+*/
+static uint8_t
+hfs_blockmap_load(HFS_INFO * hfs)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+
+    if (hfs->blockmap_file != NULL)
+        return 0;
+
+    if ((hfs->blockmap_file =
+            tsk_fs_file_open_meta(fs, NULL,
+                HFS_ALLOCATION_FILE_ID)) == NULL) {
+        tsk_error_errstr2_concat(" - Loading blockmap file");
+        return 1;
+    }
+
+    /* cache the data attribute */
+    hfs->blockmap_attr =
+        tsk_fs_attrlist_get(hfs->blockmap_file->meta->attr,
+        TSK_FS_ATTR_TYPE_DEFAULT);
+    if (!hfs->blockmap_attr) {
+        tsk_error_errstr2_concat
+            (" - Data Attribute not found in Blockmap File");
+        return 1;
+    }
+    hfs->blockmap_cache_start = -1;
+    hfs->blockmap_cache_len = 0;
+    return 0;
+}
+
+
 /** \internal
 * Get allocation status of file system block.
 * adapted from IsAllocationBlockUsed from:
@@ -5132,31 +6158,12 @@ hfs_load_attrs(TSK_FS_FILE * fs_file)
 static int8_t
 hfs_block_is_alloc(HFS_INFO * hfs, TSK_DADDR_T a_addr)
 {
-    TSK_FS_INFO *fs = &(hfs->fs_info);
     TSK_OFF_T b;
     size_t b2;
 
     // lazy loading
-    if (hfs->blockmap_file == NULL) {
-        if ((hfs->blockmap_file =
-                tsk_fs_file_open_meta(fs, NULL,
-                    HFS_ALLOCATION_FILE_ID)) == NULL) {
-            tsk_error_errstr2_concat(" - Loading blockmap file");
-            return -1;
-        }
-
-        /* cache the data attribute */
-        hfs->blockmap_attr =
-            tsk_fs_attrlist_get(hfs->blockmap_file->meta->attr,
-            TSK_FS_ATTR_TYPE_DEFAULT);
-        if (!hfs->blockmap_attr) {
-            tsk_error_errstr2_concat
-                (" - Data Attribute not found in Blockmap File");
-            return -1;
-        }
-        hfs->blockmap_cache_start = -1;
-        hfs->blockmap_cache_len = 0;
-    }
+    if (hfs_blockmap_load(hfs))
+        return -1;
 
     // get the byte offset
     b = (TSK_OFF_T) a_addr / 8;
@@ -5197,15 +6204,89 @@ hfs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
 }
 
 
+/* Size of the chunks of the allocation file read by hfs_block_run_walk() */
+#define HFS_BLOCKMAP_RUN_READ_SIZE 65536
+
+/*
+ * Report runs of blocks with the same allocation status.  The
+ * allocation file is read in large chunks into a private buffer, so the
+ * cache used by hfs_block_is_alloc() is not disturbed.
+ *
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+hfs_block_run_walk(TSK_FS_INFO * fs, TSK_DADDR_T start_blk,
+    TSK_DADDR_T end_blk, TSK_FS_BLOCK_RUN_WALK_CB action, void *ptr)
+{
+    HFS_INFO *hfs = (HFS_INFO *) fs;
+    TSK_DADDR_T addr = start_blk;
+    TSK_WALK_RET_ENUM retval;
+    uint8_t *buf;
+
+    if (hfs_blockmap_load(hfs))
+        return 1;
+
+    if ((buf = (uint8_t *) tsk_malloc(HFS_BLOCKMAP_RUN_READ_SIZE)) == NULL)
+        return 1;
+
+    while (addr <= end_blk) {
+        TSK_OFF_T off = (TSK_OFF_T) (addr / 8);
+        TSK_DADDR_T base = (TSK_DADDR_T) off * 8;
+        TSK_DADDR_T cend;
+        ssize_t cnt;
+
+        /* The blocks that the bitmap does not cover are reported as
+         * allocated, as hfs_block_walk() always did */
+        if (off >= hfs->blockmap_file->meta->size) {
+            free(buf);
+            retval = action(fs, addr, end_blk - addr + 1,
+                TSK_FS_BLOCK_FLAG_ALLOC, ptr);
+            return (retval == TSK_WALK_ERROR) ? 1 : 0;
+        }
+
+        cnt = tsk_fs_attr_read(hfs->blockmap_attr, off, (char *) buf,
+            HFS_BLOCKMAP_RUN_READ_SIZE, 0);
+        if (cnt < 1) {
+            free(buf);
+            tsk_error_set_errstr2
+                ("hfs_block_run_walk: Error reading block bitmap at offset %"
+                PRIuOFF, off);
+            return 1;
+        }
+
+        cend = base + (TSK_DADDR_T) cnt * 8 - 1;
+        if (cend > end_blk)
+            cend = end_blk;
+
+        while (addr <= cend) {
+            uint64_t b = addr - base;
+            int alloc = (buf[b / 8] & (1 << (7 - (b % 8)))) ? 1 : 0;
+            TSK_DADDR_T next = base +
+                tsk_fs_bitmap_find(buf, b, cend - base + 1,
+                (uint8_t) ! alloc, 1);
+
+            retval = action(fs, addr, next - addr,
+                alloc ? TSK_FS_BLOCK_FLAG_ALLOC :
+                TSK_FS_BLOCK_FLAG_UNALLOC, ptr);
+            if (retval != TSK_WALK_CONT) {
+                free(buf);
+                return (retval == TSK_WALK_ERROR) ? 1 : 0;
+            }
+            addr = next;
+        }
+    }
+
+    free(buf);
+    return 0;
+}
+
+
 static uint8_t
 hfs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T start_blk,
     TSK_DADDR_T end_blk, TSK_FS_BLOCK_WALK_FLAG_ENUM flags,
     TSK_FS_BLOCK_WALK_CB action, void *ptr)
 {
     char *myname = "hfs_block_walk";
-    HFS_INFO *hfs = (HFS_INFO *) fs;
-    TSK_FS_BLOCK *fs_block;
-    TSK_DADDR_T addr;
 
     if (tsk_verbose)
         tsk_fprintf(stderr,
@@ -5235,63 +6316,11 @@ hfs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T start_blk,
     if (start_blk > end_blk)
         XSWAP(start_blk, end_blk);
 
-    /* Sanity check on flags -- make sure at least one ALLOC is set */
-    if (((flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC) == 0) &&
-        ((flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC) == 0)) {
-        flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_ALLOC |
-            TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
-    }
-    if (((flags & TSK_FS_BLOCK_WALK_FLAG_META) == 0) &&
-        ((flags & TSK_FS_BLOCK_WALK_FLAG_CONT) == 0)) {
-        flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_CONT | TSK_FS_BLOCK_WALK_FLAG_META);
-    }
-
-    if ((fs_block = tsk_fs_block_alloc(fs)) == NULL) {
-        return 1;
-    }
-
     /*
-     * Iterate
+     * Iterate over the runs of the allocation file
      */
-    for (addr = start_blk; addr <= end_blk; ++addr) {
-        int retval;
-        int myflags;
-
-        /* identify if the block is allocated or not */
-        myflags = hfs_block_is_alloc(hfs, addr) ?
-            TSK_FS_BLOCK_FLAG_ALLOC : TSK_FS_BLOCK_FLAG_UNALLOC;
-
-        // test if we should call the callback with this one
-        if ((myflags & TSK_FS_BLOCK_FLAG_ALLOC)
-            && (!(flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
-            && (!(flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
-            continue;
-
-        if (flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-            myflags |= TSK_FS_BLOCK_FLAG_AONLY;
-
-        if (tsk_fs_block_get_flag(fs, fs_block, addr,
-                (TSK_FS_BLOCK_FLAG_ENUM) myflags) == NULL) {
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-
-        retval = action(fs_block, ptr);
-        if (TSK_WALK_STOP == retval) {
-            break;
-        }
-        else if (TSK_WALK_ERROR == retval) {
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-    }
-
-    tsk_fs_block_free(fs_block);
-    return 0;
+    return tsk_fs_block_walk_runs(fs, start_blk, end_blk, flags, action,
+        ptr, myname);
 }
 
 
@@ -5359,6 +6388,9 @@ hfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     if (start_inum > end_inum)
         XSWAP(start_inum, end_inum);
 
+    if (end_inum - start_inum >= HFS_CAT_INDEX_LOOKUPS)
+        hfs_cat_index_load((HFS_INFO *) fs);
+
     for (inum = start_inum; inum <= end_inum; ++inum) {
         int retval;
 
@@ -5938,6 +6970,7 @@ hfs_istat(TSK_FS_INFO * fs, TSK_FS_ISTAT_FLAG_ENUM istat_flags, FILE * hFile, TS
         tsk_fprintf(hFile, "File Name: %s\n", name_buf);
 
         // Test here to see if this is a hard link.
+        hfs_load_metadata_dirs(hfs);
         par_cnid = tsk_getu32(fs->endian, &(entry.thread.parent_cnid));
         if ((hfs->has_meta_dir_crtime && par_cnid == hfs->meta_dir_inum) ||
             (hfs->has_meta_crtime && par_cnid == hfs->meta_inum)) {
@@ -6414,6 +7447,7 @@ static void
 hfs_close(TSK_FS_INFO * fs)
 {
     HFS_INFO *hfs = (HFS_INFO *) fs;
+    int i;
     // We'll grab this lock a bit early.
     tsk_take_lock(&(hfs->metadata_dir_cache_lock));
     fs->tag = 0;
@@ -6448,6 +7482,25 @@ hfs_close(TSK_FS_INFO * fs)
     tsk_release_lock(&(hfs->metadata_dir_cache_lock));
     tsk_deinit_lock(&(hfs->metadata_dir_cache_lock));
 
+    free(hfs->cat_node_cache);
+    if (hfs->cat_index) {
+        free(hfs->cat_index->entries);
+        free(hfs->cat_index);
+    }
+    if (hfs->ext_map) {
+        free(hfs->ext_map->entries);
+        free(hfs->ext_map);
+    }
+    tsk_deinit_lock(&(hfs->cat_cache_lock));
+
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_N; i++) {
+        if (hfs->cmp_tables[i])
+            hfs_cmp_table_free(hfs->cmp_tables[i]);
+    }
+    for (i = 0; i < HFS_CMP_CHUNK_CACHE_N; i++)
+        free(hfs->cmp_chunks[i]);
+    tsk_deinit_lock(&(hfs->cmp_cache_lock));
+
     tsk_fs_free((TSK_FS_INFO *)hfs);
 }
 
@@ -6464,9 +7517,7 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     unsigned int len;
     TSK_FS_INFO *fs;
     ssize_t cnt;
-    TSK_FS_FILE *file;          // The root directory, or the metadata directories
-    TSK_INUM_T inum;            // The inum (or CNID) of the metadata directories
-    int8_t result;              // of tsk_fs_path2inum()
+    TSK_FS_FILE *file;          // The root directory
 
     tsk_error_reset();
 
@@ -6619,14 +7670,19 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         fs->last_block_act =
             (img_info->size - offset) / fs->block_size - 1;
 
-    // Initialize the lock
+    // Initialize the locks
     tsk_init_lock(&(hfs->metadata_dir_cache_lock));
+    tsk_init_lock(&(hfs->cat_cache_lock));
+    tsk_init_lock(&(hfs->cmp_cache_lock));
+    hfs->cat_index_max = HFS_CAT_INDEX_MAX;
+    hfs->ext_map_max = HFS_EXT_MAP_MAX;
 
     /*
      * Set function pointers
      */
     fs->inode_walk = hfs_inode_walk;
     fs->block_walk = hfs_block_walk;
+    fs->block_run_walk = hfs_block_run_walk;
     fs->block_getflags = hfs_block_getflags;
     fs->load_attrs = hfs_load_attrs;
     fs->get_default_attr_type = hfs_get_default_attr_type;
@@ -6748,7 +7804,10 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         hfs->is_case_sensitive = 0;
     }
 
-    // update the numbers.
+    // update the numbers.  This stays in the open, unlike the lookup of
+    // the hard link folders, because last_inum is a public field that
+    // callers read directly.  It only reads the nodes on the path to the
+    // right-most leaf of the catalog.
     fs->last_inum = hfs_find_highest_inum(hfs);
     fs->inum_count = fs->last_inum + 1;
 
@@ -6778,60 +7837,14 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     }
     file = NULL;
 
-    // disable hard link traversal while finding the hard
-    // link directories themselves (to prevent problems if
-    // there are hard links in the root directory)
+    // The hard link metadata folders are looked up the first time that
+    // they are needed (see hfs_load_metadata_dirs()).
     hfs->meta_inum = 0;
     hfs->meta_dir_inum = 0;
-
-    // Now the (file) metadata directory
-
-    // The metadata directory is a sub-directory of the root.  Its name begins with four nulls, followed
-    // by "HFS+ Private Data".  The file system parsing code replaces nulls in filenames with UTF8_NULL_REPLACE.
-    // In the released version of TSK, this replacement is the character '^'.
-    // NOTE: There is a standard Unicode replacement which is 0xfffd in UTF16 and 0xEF 0xBF 0xBD in UTF8.
-    // Systems that require the standard definition can redefine UTF8_NULL_REPLACE and UTF16_NULL_REPLACE
-    // in tsk_hfs.h
     hfs->has_meta_crtime = FALSE;
-    result =
-        tsk_fs_path2inum(fs,
-        "/" UTF8_NULL_REPLACE UTF8_NULL_REPLACE UTF8_NULL_REPLACE
-        UTF8_NULL_REPLACE "HFS+ Private Data", &inum, NULL);
-    if (result == 0) {
-        TSK_FS_FILE *file_tmp = tsk_fs_file_open_meta(fs, NULL, inum);
-        if (file_tmp != NULL) {
-            hfs->meta_crtime = file_tmp->meta->crtime;
-            hfs->has_meta_crtime = TRUE;
-            hfs->meta_inum = inum;
-            tsk_fs_file_close(file_tmp);
-        }
-    }
-
-    // Now, the directory metadata directory
-
-    // The "directory" metadata directory, where hardlinked directories actually live, is a subdirectory
-    // of the root.  The beginning of the name of this directory is ".HFS+ Private Directory Data" which
-    // is followed by a carriage return (ASCII 13).
     hfs->has_meta_dir_crtime = FALSE;
-    result =
-        tsk_fs_path2inum(fs, "/.HFS+ Private Directory Data\r", &inum,
-        NULL);
-    if (result == 0) {
-        TSK_FS_FILE *file_tmp = tsk_fs_file_open_meta(fs, NULL, inum);
-        if (file_tmp != NULL) {
-            hfs->metadir_crtime = file_tmp->meta->crtime;
-            hfs->has_meta_dir_crtime = TRUE;
-            hfs->meta_dir_inum = inum;
-            tsk_fs_file_close(file_tmp);
-        }
-    }
+    hfs->metadata_dirs_loaded = 0;
 
-    if (hfs->has_root_crtime && hfs->has_meta_crtime
-        && hfs->has_meta_dir_crtime) {
-        if (tsk_verbose)
-            tsk_fprintf(stderr,
-                "hfs_open: Creation times for key folders have been read and cached.\n");
-    }
     if (!hfs->has_root_crtime) {
         if (tsk_verbose)
             tsk_fprintf(stderr,
@@ -6843,21 +7856,6 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
             "hfs_open: The root directory is accessible.\n");
     }
 
-    if (tsk_verbose) {
-        if (hfs->has_meta_crtime)
-            tsk_fprintf(stderr,
-                "hfs_open: \"/^^^^HFS+ Private Data\" metadata folder is accessible.\n");
-        else
-            tsk_fprintf(stderr,
-                "hfs_open: Optional \"^^^^HFS+ Private Data\" metadata folder is not accessible, or does not exist.\n");
-        if (hfs->has_meta_dir_crtime)
-            tsk_fprintf(stderr,
-                "hfs_open: \"/HFS+ Private Directory Data^\" metadata folder is accessible.\n");
-        else
-            tsk_fprintf(stderr,
-                "hfs_open: Optional \"/HFS+ Private Directory Data^\" metadata folder is not accessible, or does not exist.\n");
-    }
-
     // These caches will be set, if they are needed.
     hfs->meta_dir = NULL;
     hfs->dir_meta_dir = NULL;
@@ -233,6 +233,55 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
 
         TSK_FS_DIR *fs_dir = NULL;
 
+        /* If the file system has an index for the directory, use it to
+         * find an allocated entry without loading the entire directory.
+         * Any miss falls through to the full scan below, which is what
+         * finds deleted names. */
+        if ((a_fs->dir_find_name != NULL) && (cur_attr == NULL)) {
+            TSK_FS_NAME *fs_name_idx;
+            int8_t retval;
+
+            if ((fs_name_idx = tsk_fs_name_alloc(clen, 0)) == NULL) {
+                free(cpath);
+                return -1;
+            }
+
+            retval =
+                a_fs->dir_find_name(a_fs, next_meta, cur_dir, fs_name_idx);
+            if (retval == -1) {
+                tsk_error_reset();
+            }
+            else if (retval == 0) {
+                const char *pname = cur_dir;
+
+                cur_dir = (char *) strtok_r(NULL, "/", &(strtok_last));
+                if (tsk_verbose)
+                    tsk_fprintf(stderr,
+                        "Found it (%s) using index, now looking for %s\n",
+                        pname, cur_dir);
+
+                if (cur_dir == NULL) {
+                    *a_result = fs_name_idx->meta_addr;
+                    if (a_fs_name)
+                        tsk_fs_name_copy(a_fs_name, fs_name_idx);
+                    tsk_fs_name_free(fs_name_idx);
+                    free(cpath);
+                    return 0;
+                }
+
+                if (TSK_FS_TYPE_ISNTFS(a_fs->ftype)
+                    && ((cur_attr = strchr(cur_dir, ':')) != NULL)) {
+                    *(cur_attr) = '\0';
+                    cur_attr++;
+                }
+
+                next_meta = fs_name_idx->meta_addr;
+                tsk_fs_name_free(fs_name_idx);
+                continue;
+            }
+            tsk_fs_name_free(fs_name_idx);
+        }
+
         // open the next directory in the recursion
         if ((fs_dir = tsk_fs_dir_open_meta(a_fs, next_meta)) == NULL) {
             free(cpath);
@@ -67,18 +67,206 @@
 #include <ctype.h>
 
 
-/* free all memory used by inode linked list */
+static void
+iso9660_inode_idx_free(iso9660_inode_idx * idx)
+{
+    free(idx->keys);
+    free(idx->vals);
+    memset(idx, 0, sizeof(iso9660_inode_idx));
+}
+
+/* free all memory used by the inode table and its indexes */
 static void
 iso9660_inode_list_free(TSK_FS_INFO * fs)
 {
     ISO_INFO *iso = (ISO_INFO *) fs;
+    size_t i;
 
-    while (iso->in_list) {
-        iso9660_inode_node *tmp = iso->in_list;
-        iso->in_list = iso->in_list->next;
-        free(tmp);
+    for (i = 0; i < iso->in_count; i++) {
+        free(iso->in_list[i].inode.rr);
     }
+    free(iso->in_list);
     iso->in_list = NULL;
+    iso->in_count = 0;
+    iso->in_alloc = 0;
+
+    iso9660_inode_idx_free(&iso->in_by_extent);
+    iso9660_inode_idx_free(&iso->in_by_content);
+    iso9660_inode_idx_free(&iso->in_by_dentry);
+}
+
+static size_t
+iso9660_inode_idx_bucket(const iso9660_inode_idx * idx, uint64_t key)
+{
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (idx->size -
+        1);
+}
+
+/** \internal
+ * Add a key to an index, unless it is already there (the index keeps the
+ * first inode that was added with each key).
+ *
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+iso9660_inode_idx_add(iso9660_inode_idx * idx, uint64_t key,
+    TSK_INUM_T inum)
+{
+    size_t b;
+
+    // keep the load at or below one half
+    if ((idx->used + 1) * 2 > idx->size) {
+        iso9660_inode_idx old = *idx;
+        size_t i;
+
+        idx->size = old.size ? old.size * 2 : 256;
+        idx->used = 0;
+        if ((idx->keys =
+                (uint64_t *) tsk_malloc(idx->size * sizeof(uint64_t))) ==
+            NULL) {
+            *idx = old;
+            return 1;
+        }
+        if ((idx->vals =
+                (uint32_t *) tsk_malloc(idx->size * sizeof(uint32_t))) ==
+            NULL) {
+            free(idx->keys);
+            *idx = old;
+            return 1;
+        }
+        for (i = 0; i < old.size; i++) {
+            if (old.vals[i] == 0)
+                continue;
+            b = iso9660_inode_idx_bucket(idx, old.keys[i]);
+            while (idx->vals[b])
+                b = (b + 1) & (idx->size - 1);
+            idx->keys[b] = old.keys[i];
+            idx->vals[b] = old.vals[i];
+            idx->used++;
+        }
+        iso9660_inode_idx_free(&old);
+    }
+
+    b = iso9660_inode_idx_bucket(idx, key);
+    while (idx->vals[b]) {
+        if (idx->keys[b] == key)
+            return 0;
+        b = (b + 1) & (idx->size - 1);
+    }
+    idx->keys[b] = key;
+    idx->vals[b] = (uint32_t) (inum + 1);
+    idx->used++;
+    return 0;
+}
+
+/* return the first inode added to an index with the given key or NULL */
+static iso9660_inode_node *
+iso9660_inode_idx_find(ISO_INFO * iso, const iso9660_inode_idx * idx,
+    uint64_t key)
+{
+    size_t b;
+
+    if (idx->size == 0)
+        return NULL;
+
+    b = iso9660_inode_idx_bucket(idx, key);
+    while (idx->vals[b]) {
+        if (idx->keys[b] == key)
+            return &iso->in_list[idx->vals[b] - 1];
+        b = (b + 1) & (idx->size - 1);
+    }
+    return NULL;
+}
+
+/* key of the content index: extent location and size */
+static uint64_t
+iso9660_inode_content_key(TSK_FS_INFO * fs, iso9660_inode_node * in_node)
+{
+    return ((uint64_t) tsk_getu32(fs->endian,
+            in_node->inode.dr.ext_loc_m) << 32) | (uint32_t) in_node->size;
+}
+
+/** \internal
+ * Copy a loaded inode into the inode table at its inum and add it to the
+ * indexes.  Entries below its inum that were never filled are marked
+ * as unused.  Once copied, the table owns the RockRidge data and
+ * in_node->inode.rr is cleared.
+ *
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+iso9660_inode_list_add(TSK_FS_INFO * fs, iso9660_inode_node * in_node)
+{
+    ISO_INFO *iso = (ISO_INFO *) fs;
+    TSK_INUM_T inum = in_node->inum;
+
+    if (inum >= UINT32_MAX) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("iso9660_inode_list_add: too many inodes");
+        return 1;
+    }
+
+    if (inum >= iso->in_alloc) {
+        size_t alloc = iso->in_alloc ? iso->in_alloc * 2 : 256;
+        iso9660_inode_node *tmp;
+
+        while (alloc <= inum)
+            alloc *= 2;
+        if ((tmp = (iso9660_inode_node *) tsk_realloc(iso->in_list,
+                    alloc * sizeof(iso9660_inode_node))) == NULL)
+            return 1;
+        iso->in_list = tmp;
+        iso->in_alloc = alloc;
+    }
+    while (iso->in_count < inum) {
+        memset(&iso->in_list[iso->in_count], 0,
+            sizeof(iso9660_inode_node));
+        iso->in_list[iso->in_count].inum = ISO9660_INUM_UNUSED;
+        iso->in_count++;
+    }
+    memcpy(&iso->in_list[inum], in_node, sizeof(iso9660_inode_node));
+    iso->in_count = inum + 1;
+    in_node->inode.rr = NULL;
+
+    if (iso9660_inode_idx_add(&iso->in_by_extent,
+            tsk_getu32(fs->endian, in_node->inode.dr.ext_loc_m), inum)
+        || iso9660_inode_idx_add(&iso->in_by_content,
+            iso9660_inode_content_key(fs, in_node), inum)
+        || iso9660_inode_idx_add(&iso->in_by_dentry,
+            (uint64_t) in_node->dentry_offset, inum))
+        return 1;
+    return 0;
+}
+
+/**
+ * \internal
+ * Find the first inode in the table with the given extent location.
+ *
+ * @param iso File system
+ * @param ext_loc Block address of the extent
+ * @returns the inode or NULL if none was found
+ */
+iso9660_inode_node *
+iso9660_inode_by_extent(ISO_INFO * iso, uint32_t ext_loc)
+{
+    return iso9660_inode_idx_find(iso, &iso->in_by_extent, ext_loc);
+}
+
+/**
+ * \internal
+ * Find the first inode in the table whose directory entry is at the given
+ * offset.
+ *
+ * @param iso File system
+ * @param dentry_offset Byte offset of the directory entry in the file system
+ * @returns the inode or NULL if none was found
+ */
+iso9660_inode_node *
+iso9660_inode_by_dentry(ISO_INFO * iso, TSK_OFF_T dentry_offset)
+{
+    return iso9660_inode_idx_find(iso, &iso->in_by_dentry,
+        (uint64_t) dentry_offset);
 }
 
 
@@ -695,55 +883,47 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                 in_node->inode.susp_len = 0;
             }
 
-            /* add inode to the list */
-            if (iso->in_list) {
-                iso9660_inode_node *tmp, *prev_tmp;
-
-                for (tmp = iso->in_list; tmp; tmp = tmp->next) {
-                    /* When processing the "first" volume descriptor, all entries get added to the list.
-                     * for the later ones, we skip duplicate ones that have content (blocks) that overlaps
-                     * with entries from a previous volume descriptor. */
-                    if ((in_node->offset == tmp->offset)
-                        && (in_node->size == tmp->size)
-                        && (in_node->size) && (is_first == 0)) {
-                        
-                        // if we found rockridge, then update original if needed.
-                        if (in_node->inode.rr) {
-                            if (tmp->inode.rr == NULL) {
-                                tmp->inode.rr = in_node->inode.rr;
-                                tmp->inode.susp_off =
-                                    in_node->inode.susp_off;
-                                tmp->inode.susp_len =
-                                    in_node->inode.susp_len;
-                                in_node->inode.rr = NULL;
-                            }
-                            else {
-                                free(in_node->inode.rr);
-                                in_node->inode.rr = NULL;
-                            }
+            /* When processing the "first" volume descriptor, all entries get added to the table.
+             * for the later ones, we skip duplicate ones that have content (blocks) that overlaps
+             * with entries from a previous volume descriptor. */
+            if ((in_node->size) && (is_first == 0)) {
+                iso9660_inode_node *tmp =
+                    iso9660_inode_idx_find(iso, &iso->in_by_content,
+                    iso9660_inode_content_key(fs, in_node));
+
+                if (tmp) {
+                    // if we found rockridge, then update original if needed.
+                    if (in_node->inode.rr) {
+                        if (tmp->inode.rr == NULL) {
+                            tmp->inode.rr = in_node->inode.rr;
+                            tmp->inode.susp_off = in_node->inode.susp_off;
+                            tmp->inode.susp_len = in_node->inode.susp_len;
+                            in_node->inode.rr = NULL;
+                        }
+                        else {
+                            free(in_node->inode.rr);
+                            in_node->inode.rr = NULL;
                         }
-
-                        if (tsk_verbose)
-                            tsk_fprintf(stderr,
-                                "iso9660_load_inodes_dir: Removing duplicate entry for: %s (orig name: %s start: %d size: %d)\n",
-                                in_node->inode.fn, tmp->inode.fn, in_node->offset, in_node->size);
-                        free(in_node);
-                        in_node = NULL;
-                        count--;
-                        break;
                     }
-                    prev_tmp = tmp;
-                }
 
-                // add it to the end (if we didn't get rid of it above)
-                if (in_node) {
-                    prev_tmp->next = in_node;
-                    in_node->next = NULL;
+                    if (tsk_verbose)
+                        tsk_fprintf(stderr,
+                            "iso9660_load_inodes_dir: Removing duplicate entry for: %s (orig name: %s start: %d size: %d)\n",
+                            in_node->inode.fn, tmp->inode.fn, in_node->offset, in_node->size);
+                    free(in_node);
+                    in_node = NULL;
+                    count--;
                 }
             }
-            else {
-                iso->in_list = in_node;
-                in_node->next = NULL;
+
+            /* add inode to the table (if we didn't get rid of it above) */
+            if (in_node) {
+                uint8_t ret = iso9660_inode_list_add(fs, in_node);
+
+                free(in_node->inode.rr);
+                free(in_node);
+                if (ret)
+                    return -1;
             }
 
             // skip two entries if this was the root directory (the . and ..).
@@ -900,7 +1080,6 @@ iso9660_load_inodes_pt(ISO_INFO * iso)
 
     /* initialize in case repeatedly called */
     iso9660_inode_list_free(fs);
-    iso->in_list = NULL;
 
     /* The secondary volume descriptor table will contain the
      * longer / unicode files, so we process it first to give them
@@ -1002,14 +1181,8 @@ uint8_t
 iso9660_dinode_load(ISO_INFO * iso, TSK_INUM_T inum,
     iso9660_inode * dinode)
 {
-    iso9660_inode_node *n;
-
-    n = iso->in_list;
-    while (n && (n->inum != inum))
-        n = n->next;
-
-    if (n) {
-        memcpy(dinode, &n->inode, sizeof(iso9660_inode));
+    if ((inum < iso->in_count) && (iso->in_list[inum].inum == inum)) {
+        memcpy(dinode, &iso->in_list[inum].inode, sizeof(iso9660_inode));
         return 0;
     }
     else {
@@ -1146,14 +1319,7 @@ iso9660_close(TSK_FS_INFO * fs)
         free(s);
     }
 
-    while (iso->in_list != NULL) {
-        iso9660_inode_node *in = iso->in_list;
-        iso->in_list = iso->in_list->next;
-        if (in->inode.rr != NULL) {
-            free(in->inode.rr);
-        }
-        free(in);
-    }
+    iso9660_inode_list_free(fs);
 
     tsk_fs_free(fs);
 }
@@ -1395,18 +1561,24 @@ static int
 iso9660_is_block_alloc(TSK_FS_INFO * fs, TSK_DADDR_T blk_num)
 {
     ISO_INFO *iso = (ISO_INFO *) fs;
-    iso9660_inode_node *in_node;
+    size_t i;
 
     if (tsk_verbose)
         tsk_fprintf(stderr, "iso9660_is_block_alloc: "
             " blk_num: %" PRIuDADDR "\n", blk_num);
 
-    for (in_node = iso->in_list; in_node; in_node = in_node->next) {
-        TSK_DADDR_T first_block = in_node->offset / fs->block_size;
-        TSK_DADDR_T file_size =
-            tsk_getu32(fs->endian, in_node->inode.dr.data_len_m);
-        TSK_DADDR_T last_block =
-            first_block + (file_size / fs->block_size);
+    for (i = 0; i < iso->in_count; i++) {
+        iso9660_inode_node *in_node = &iso->in_list[i];
+        TSK_DADDR_T first_block;
+        TSK_DADDR_T file_size;
+        TSK_DADDR_T last_block;
+
+        if (in_node->inum == ISO9660_INUM_UNUSED)
+            continue;
+
+        first_block = in_node->offset / fs->block_size;
+        file_size = tsk_getu32(fs->endian, in_node->inode.dr.data_len_m);
+        last_block = first_block + (file_size / fs->block_size);
         if (file_size % fs->block_size)
             last_block++;
 
@@ -2544,6 +2716,8 @@ iso9660_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
 
     iso->rr_found = 0;
     iso->in_list = NULL;
+    iso->in_count = 0;
+    iso->in_alloc = 0;
 
     fs->ftype = TSK_FS_TYPE_ISO9660;
     fs->duname = "Block";
@@ -830,8 +830,266 @@ invalid_match_distance:
 #endif
 }
 
-size_t lzvn_decode_buffer(void *dst, size_t dst_size,
-                          const void *src, size_t src_size) {
+//  ===============================================================
+//  Fast path
+//
+//  lzvn_decode_fast( ) decodes the bulk of a stream while the destination
+//  has at least LZVN_FAST_MARGIN bytes left. An instruction writes at most
+//  271 bytes and the copies below run at most 7 bytes past that, so the
+//  destination end is checked once per instruction instead of in every
+//  copy, and the source end once per instruction and literal.
+//
+//  It stops at the instructions it does not handle (end-of-stream,
+//  undefined opcodes and invalid distances) and when it runs out of margin.
+//  Like lzvn_decode( ), it records the start of each instruction it decodes
+//  in state, so lzvn_decode( ) then replays the last one and carries on with
+//  identical results.
+#define LZVN_FAST_MARGIN 320
+
+enum {
+  K_SML_D, K_MED_D, K_LRG_D, K_PRE_D, K_SML_M, K_LRG_M, K_SML_L, K_LRG_L,
+  K_NOP, K_EOS, K_UDEF
+};
+
+#if !HAVE_LABELS_AS_VALUES
+//  Instruction kind of each opcode (same classification as opc_tbl)
+static const unsigned char lzvn_opc_kind[256] = {
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_EOS,    K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_NOP,    K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_NOP,    K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_UDEF,   K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_UDEF,   K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_UDEF,   K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_UDEF,   K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_UDEF,   K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,
+    K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,
+    K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,
+    K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,
+    K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,  K_MED_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_SML_D,  K_PRE_D,  K_LRG_D,
+    K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,
+    K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,   K_UDEF,
+    K_LRG_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,
+    K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,  K_SML_L,
+    K_LRG_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,
+    K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M,  K_SML_M};
+#endif
+
+//  Smallest multiple of each distance below 8 that is at least 8. A zero
+//  distance (sml_m or lrg_m before any match) copies bytes onto themselves,
+//  as in lzvn_decode( ).
+static const unsigned char lzvn_d8[8] = {0, 8, 8, 9, 8, 10, 12, 14};
+
+#if HAVE_LABELS_AS_VALUES
+#  define FAST_CASE(kind, label) label
+#  define FAST_NEXT                                                            \
+  do {                                                                         \
+    if (src_end - src_ptr < 8 || dst_ptr > dst_last)                           \
+      return;                                                                  \
+    opc = src_ptr[0];                                                          \
+    goto *fast_tbl[opc];                                                       \
+  } while (0)
+#else
+#  define FAST_CASE(kind, label) case kind
+#  define FAST_NEXT continue
+#endif
+
+static void lzvn_decode_fast(lzvn_decoder_state *state) {
+#if HAVE_LABELS_AS_VALUES
+  static const void *fast_tbl[256] = {
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&eos,   &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&nop,   &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&nop,   &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&udef,  &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&udef,  &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&udef,  &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&udef,  &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&udef,  &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,
+      &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d,
+      &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d,
+      &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d,
+      &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d, &&med_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&sml_d, &&pre_d, &&lrg_d,
+      &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,
+      &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,  &&udef,
+      &&lrg_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l,
+      &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l, &&sml_l,
+      &&lrg_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m,
+      &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m, &&sml_m};
+#endif
+  const unsigned char *src_ptr = state->src;
+  unsigned char *dst_ptr = state->dst;
+  const unsigned char *src_end = state->src_end;
+  unsigned char *dst_last;
+  const unsigned char *dst_begin = state->dst_begin;
+  size_t D = state->d_prev;
+  unsigned char opc;
+  size_t opc_len, L, M, i;
+
+  // A partially expanded match is left to lzvn_decode( )
+  if (state->L != 0 || state->M != 0)
+    return;
+  if (state->dst_end - dst_ptr < LZVN_FAST_MARGIN)
+    return;
+  dst_last = state->dst_end - LZVN_FAST_MARGIN;
+
+  //  At least 8 source bytes covers the opcode and the 4 byte literal copy
+  //  of every instruction with a match
+  for (;;) {
+    if (src_end - src_ptr < 8 || dst_ptr > dst_last)
+      return;
+    opc = src_ptr[0];
+#if HAVE_LABELS_AS_VALUES
+    goto *fast_tbl[opc];
+#else
+    switch (lzvn_opc_kind[opc]) {
+#endif
+
+    FAST_CASE(K_SML_D, sml_d):
+      UPDATE_GOOD;
+      opc_len = 2;
+      L = opc >> 6;
+      M = ((opc >> 3) & 7) + 3;
+      D = (size_t)(opc & 7) << 8 | src_ptr[1];
+      goto literal_and_match;
+
+    FAST_CASE(K_MED_D, med_d): {
+      UPDATE_GOOD;
+      uint16_t opc23 = load2(&src_ptr[1]);
+      opc_len = 3;
+      L = (opc >> 3) & 3;
+      M = (size_t)((opc & 7) << 2 | (opc23 & 3)) + 3;
+      D = opc23 >> 2;
+      goto literal_and_match;
+    }
+
+    FAST_CASE(K_LRG_D, lrg_d):
+      UPDATE_GOOD;
+      opc_len = 3;
+      L = opc >> 6;
+      M = ((opc >> 3) & 7) + 3;
+      D = load2(&src_ptr[1]);
+      goto literal_and_match;
+
+    FAST_CASE(K_PRE_D, pre_d):
+      UPDATE_GOOD;
+      opc_len = 1;
+      L = opc >> 6;
+      M = ((opc >> 3) & 7) + 3;
+
+    literal_and_match:
+      if (D > (size_t)(dst_ptr + L - dst_begin) || D == 0)
+        return;
+      //  Literal of 0-3 bytes
+      store4(dst_ptr, load4(&src_ptr[opc_len]));
+      src_ptr += opc_len + L;
+      dst_ptr += L;
+      goto match;
+
+    FAST_CASE(K_SML_M, sml_m):
+      UPDATE_GOOD;
+      M = opc & 15;
+      src_ptr += 1;
+      goto match;
+
+    FAST_CASE(K_LRG_M, lrg_m):
+      UPDATE_GOOD;
+      M = src_ptr[1] + 16;
+      src_ptr += 2;
+
+    match:
+      if (D >= 8) {
+        for (i = 0; i < M; i += 8)
+          store8(&dst_ptr[i], load8(&dst_ptr[i - D]));
+      } else {
+        //  The match repeats the last D bytes. Copy bytes one at a time up
+        //  to the smallest multiple of D that is at least 8, then copy 8
+        //  bytes at a time from that far back.
+        size_t D8 = lzvn_d8[D];
+        for (i = 0; i < D8 && i < M; i++)
+          dst_ptr[i] = dst_ptr[i - D];
+        for (; i < M; i += 8)
+          store8(&dst_ptr[i], load8(&dst_ptr[i - D8]));
+      }
+      dst_ptr += M;
+      FAST_NEXT;
+
+    FAST_CASE(K_SML_L, sml_l):
+      UPDATE_GOOD;
+      opc_len = 1;
+      L = opc & 15;
+      goto literal;
+
+    FAST_CASE(K_LRG_L, lrg_l):
+      UPDATE_GOOD;
+      opc_len = 2;
+      L = src_ptr[1] + 16;
+
+    literal:
+      //  Literal only; D is preserved. The copy reads up to 7 bytes past
+      //  the literal.
+      if ((size_t)(src_end - src_ptr) < opc_len + L + 8)
+        return;
+      src_ptr += opc_len;
+      //  8 byte steps like lzvn_decode( ): while D is still 0 a match
+      //  exposes the bytes written past the literal
+      for (i = 0; i < L; i += 8)
+        store8(&dst_ptr[i], load8(&src_ptr[i]));
+      src_ptr += L;
+      dst_ptr += L;
+      FAST_NEXT;
+
+    FAST_CASE(K_NOP, nop):
+      UPDATE_GOOD;
+      src_ptr++;
+      FAST_NEXT;
+
+#if HAVE_LABELS_AS_VALUES
+    eos:
+    udef:
+#else
+    default:
+#endif
+      //  Left to lzvn_decode( )
+      return;
+#if !HAVE_LABELS_AS_VALUES
+    }
+#endif
+  }
+}
+
+#undef FAST_CASE
+#undef FAST_NEXT
+
+static size_t lzvn_decode_buffer_impl(void *dst, size_t dst_size,
+                                      const void *src, size_t src_size,
+                                      int fast) {
   // Init LZVN decoder state
   lzvn_decoder_state dstate;
   memset(&dstate, 0x00, sizeof(dstate));
@@ -846,8 +1104,20 @@ size_t lzvn_decode_buffer(void *dst, size_t dst_size,
   dstate.end_of_stream = 0;
 
   // Run LZVN decoder
+  if (fast)
+    lzvn_decode_fast(&dstate);
   lzvn_decode(&dstate);
 
   // This is how much we decompressed
   return dstate.dst - (unsigned char*) dst;
 }
+
+size_t lzvn_decode_buffer(void *dst, size_t dst_size,
+                          const void *src, size_t src_size) {
+  return lzvn_decode_buffer_impl(dst, dst_size, src, src_size, 1);
+}
+
+size_t lzvn_decode_buffer_checked(void *dst, size_t dst_size,
+                                  const void *src, size_t src_size) {
+  return lzvn_decode_buffer_impl(dst, dst_size, src, src_size, 0);
+}
@@ -13,6 +13,13 @@ size_t lzvn_decode_buffer(void* dst,
                           const void* src,
                           size_t src_size);
 
+/* Same as lzvn_decode_buffer(), but without the fast path.  Used to check
+ * the fast path against the fully bounds-checked decoder. */
+size_t lzvn_decode_buffer_checked(void* dst,
+                                  size_t dst_size,
+                                  const void* src,
+                                  size_t src_size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
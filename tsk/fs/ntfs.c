@@ -213,10 +213,18 @@ ntfs_dinode_lookup(NTFS_INFO * a_ntfs, char *a_buf, TSK_INUM_T a_mftnum)
         /* NOTE: data_run values are in clusters
          *
          * cycle through the runs in $Data and identify which
-         * has the MFT entry that we want
+         * has the MFT entry that we want.  If the runs have been
+         * indexed, then we can start at the right one.
          */
-        for (data_run = a_ntfs->mft_data->nrd.run;
-            data_run != NULL; data_run = data_run->next) {
+        data_run = a_ntfs->mft_data->nrd.run;
+        if (a_ntfs->mft_data->run_idx) {
+            data_run = tsk_fs_attr_run_find(a_ntfs->mft_data,
+                offset / a_ntfs->csize_b);
+            if (data_run)
+                offset -= data_run->offset * a_ntfs->csize_b;
+        }
+
+        for (; data_run != NULL; data_run = data_run->next) {
 
             /* Test for possible overflows / error conditions */
             if ((offset < 0) || (data_run->len >= (TSK_DADDR_T)(LLONG_MAX / a_ntfs->csize_b))){
@@ -1561,7 +1569,8 @@ ntfs_file_read_special(const TSK_FS_ATTR * a_fs_attr,
         byteoffset = (size_t) (a_offset - cu_blkoffset * fs->block_size);
 
         // cycle through the run until we find where we can start to process the clusters
-        for (data_run_cur = a_fs_attr->nrd.run;
+        for (data_run_cur =
+            tsk_fs_attr_run_find(a_fs_attr, cu_blkoffset);
             (data_run_cur) && (buf_idx < a_len);
             data_run_cur = data_run_cur->next) {
 
@@ -2738,6 +2747,11 @@ ntfs_dinode_copy(NTFS_INFO * ntfs, TSK_FS_FILE * a_fs_file, char *a_buf,
         return retval;
     }
 
+    // all of the runs are known now, so index them for random reads
+    if (tsk_fs_attrlist_run_idx_build(a_fs_file->meta->attr)) {
+        return TSK_ERR;
+    }
+
     /* The entry has been 'used' if it has attributes */
 
     if ((a_fs_file->meta->attr == NULL)
@@ -3302,19 +3316,20 @@ ntfs_get_sds(TSK_FS_INFO * fs, uint32_t secid)
     }
 
 
-    // Loop through all the SII entries looking for the security id matching that found in the file.
-    // This lookup is obviously O(n^2) for all n files. However, since so many files have the exact
-    // same security identifier, it is not really that bad. In reality, 100,000 files may only map to
-    // 10,000 security identifiers. Since SII entries are 0x28 bytes each and security identifiers
-    // increase incrementally, we could go directly to the entry in question ((secid * 0x28) + 256).
-    // SII entries started at 256 on Vista; however, I did not look at the starting secid for other
-    // versions of NTFS.
-    for (i = 0; i < ntfs->sii_data.used; i++) {
-        if (tsk_getu32(fs->endian,
-                ((ntfs_attr_sii *) (ntfs->sii_data.buffer))[i].
-                key_sec_id) == secid) {
+    // Binary search the sorted index of the SII entries for the first entry
+    // with the security id that was found in the file.
+    if (ntfs->sii_idx != NULL) {
+        size_t lo = 0, hi = ntfs->sii_data.used;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (ntfs->sii_idx[mid].sec_id < secid)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if ((lo < ntfs->sii_data.used) && (ntfs->sii_idx[lo].sec_id == secid)) {
+            i = ntfs->sii_idx[lo].idx;
             sii = &((ntfs_attr_sii *) (ntfs->sii_data.buffer))[i];
-            break;
         }
     }
 
@@ -3386,6 +3401,94 @@ ntfs_get_sds(TSK_FS_INFO * fs, uint32_t secid)
 }
 #endif
 
+#if TSK_USE_SID
+static uint8_t ntfs_load_secure(NTFS_INFO * ntfs);
+
+/* Slot of a security id in the SID cache (the size is a power of 2) */
+#define NTFS_SID_CACHE_SLOT(ntfs, secid) \
+    (((secid) * 2654435761U) & ((ntfs)->sid_cache_size - 1))
+
+/** \internal
+ * Look up the owner SID string of a security id in the SID cache.
+ *
+ * Note: This routine assumes &ntfs->sid_lock is locked by the caller.
+ *
+ * @param ntfs File system
+ * @param secid Security id to look up
+ * @returns The cached string (owned by the cache) or NULL if not cached
+ */
+static const char *
+ntfs_sid_cache_get(NTFS_INFO * ntfs, uint32_t secid)
+{
+    size_t slot;
+
+    if (ntfs->sid_cache == NULL)
+        return NULL;
+
+    for (slot = NTFS_SID_CACHE_SLOT(ntfs, secid);
+        ntfs->sid_cache[slot].sec_id != 0;
+        slot = (slot + 1) & (ntfs->sid_cache_size - 1)) {
+        if (ntfs->sid_cache[slot].sec_id == secid)
+            return ntfs->sid_cache[slot].sid_str;
+    }
+    return NULL;
+}
+
+/** \internal
+ * Add a copy of the owner SID string of a security id to the SID cache.
+ * The table is doubled when it gets half full.
+ *
+ * Note: This routine assumes &ntfs->sid_lock is locked by the caller.
+ *
+ * @param ntfs File system
+ * @param secid Security id (must not be 0 or already be in the cache)
+ * @param sid_str String to store
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+ntfs_sid_cache_add(NTFS_INFO * ntfs, uint32_t secid, const char *sid_str)
+{
+    size_t slot, len;
+    char *copy;
+
+    if ((ntfs->sid_cache_used + 1) * 2 > ntfs->sid_cache_size) {
+        NTFS_SID_CACHE_ENTRY *old_cache = ntfs->sid_cache;
+        size_t old_size = ntfs->sid_cache_size, i;
+        size_t new_size = old_size ? old_size * 2 : 256;
+        NTFS_SID_CACHE_ENTRY *new_cache;
+
+        if ((new_cache = (NTFS_SID_CACHE_ENTRY *)
+                tsk_malloc(new_size * sizeof(NTFS_SID_CACHE_ENTRY))) == NULL)
+            return 1;
+
+        ntfs->sid_cache = new_cache;
+        ntfs->sid_cache_size = new_size;
+        for (i = 0; i < old_size; i++) {
+            if (old_cache[i].sec_id == 0)
+                continue;
+            for (slot = NTFS_SID_CACHE_SLOT(ntfs, old_cache[i].sec_id);
+                new_cache[slot].sec_id != 0;
+                slot = (slot + 1) & (new_size - 1));
+            new_cache[slot] = old_cache[i];
+        }
+        free(old_cache);
+    }
+
+    len = strlen(sid_str) + 1;
+    if ((copy = (char *) tsk_malloc(len)) == NULL)
+        return 1;
+    memcpy(copy, sid_str, len);
+
+    for (slot = NTFS_SID_CACHE_SLOT(ntfs, secid);
+        ntfs->sid_cache[slot].sec_id != 0;
+        slot = (slot + 1) & (ntfs->sid_cache_size - 1));
+    ntfs->sid_cache[slot].sec_id = secid;
+    ntfs->sid_cache[slot].sid_str = copy;
+    ntfs->sid_cache_used++;
+    return 0;
+}
+#endif
+
 /** \internal
  * NTFS-specific function (pointed to in FS_INFO) that maps a security ID
  * to an ASCII printable string.
@@ -3393,7 +3496,8 @@ ntfs_get_sds(TSK_FS_INFO * fs, uint32_t secid)
  * to get the security id. Once we have the security id, we will
  * search $Secure:$SII to find a matching security id. That $SII entry
  * will contain the offset within the $SDS stream for the $SDS entry,
- * which contains the owner SID
+ * which contains the owner SID.  $Secure is loaded the first time that
+ * this is called and the strings are cached by security id.
  *
  * @param a_fs_file File to get security info on
  * @param sid_str [out] location where string representation of security info will be stored.
@@ -3408,6 +3512,8 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
     ntfs_attr_si *si;
     const ntfs_attr_sds *sds;
     NTFS_INFO *ntfs = (NTFS_INFO *) a_fs_file->fs_info;
+    uint32_t sec_id;
+    const char *cached;
 
     *sid_str = NULL;
 
@@ -3435,11 +3541,36 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
         return 1;
     }
 
+    sec_id = tsk_getu32(a_fs_file->fs_info->endian, si->sec_id);
+
     tsk_take_lock(&ntfs->sid_lock);
+
+    // $Secure is only loaded the first time that it is needed.  A failed
+    // load is not retried; the lookups below then fail like they do for
+    // a file system without $Secure.
+    if (ntfs->secure_loaded == 0) {
+        ntfs->secure_loaded = 1;
+        if (ntfs_load_secure(ntfs)) {
+            tsk_release_lock(&ntfs->sid_lock);
+            tsk_error_set_errstr2("- ntfs_file_get_sidstr: loading $Secure");
+            return 1;
+        }
+    }
+
+    // see if we already made the string for this security id
+    if ((cached = ntfs_sid_cache_get(ntfs, sec_id)) != NULL) {
+        size_t len = strlen(cached) + 1;
+        if ((*sid_str = (char *) tsk_malloc(len)) == NULL) {
+            tsk_release_lock(&ntfs->sid_lock);
+            return 1;
+        }
+        memcpy(*sid_str, cached, len);
+        tsk_release_lock(&ntfs->sid_lock);
+        return 0;
+    }
+
     // sds points inside ntfs->sds_data, which we've just locked
-    sds =
-        ntfs_get_sds(a_fs_file->fs_info,
-        tsk_getu32(a_fs_file->fs_info->endian, si->sec_id));
+    sds = ntfs_get_sds(a_fs_file->fs_info, sec_id);
     if (!sds) {
         tsk_release_lock(&ntfs->sid_lock);
         tsk_error_set_errstr2("- ntfs_file_get_sidstr:SI attribute");
@@ -3450,6 +3581,9 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
         tsk_error_set_errstr2("- ntfs_file_get_sidstr:SI attribute");
         return 1;
     }
+
+    // a failure to cache the string is not an error
+    ntfs_sid_cache_add(ntfs, sec_id, *sid_str);
     tsk_release_lock(&ntfs->sid_lock);
     return 0;
 #else
@@ -3558,11 +3692,26 @@ ntfs_proc_sii(TSK_FS_INFO * fs, NTFS_SXX_BUFFER * sii_buffer)
 }
 
 
+/* qsort() callback to sort the $SII index by security id */
+static int
+ntfs_sii_idx_cmp(const void *a, const void *b)
+{
+    const NTFS_SII_IDX *sa = (const NTFS_SII_IDX *) a;
+    const NTFS_SII_IDX *sb = (const NTFS_SII_IDX *) b;
+
+    if (sa->sec_id != sb->sec_id)
+        return (sa->sec_id < sb->sec_id) ? -1 : 1;
+    // keep the first of duplicate entries first
+    if (sa->idx != sb->idx)
+        return (sa->idx < sb->idx) ? -1 : 1;
+    return 0;
+}
+
 /*
  * Load the $Secure attributes so that we can identify the user.
  *
- * Note: This routine is called only from ntfs_open and therefore does
- * not need to lock ntfs->sid_lock.
+ * Note: This routine assumes &ntfs->sid_lock is locked by the caller.
+ * It is called the first time that an owner SID is needed.
  *
  * @returns 1 on error (which occurs only if malloc or other system error).
  */
@@ -3646,9 +3795,11 @@ ntfs_load_secure(NTFS_INFO * ntfs)
             tsk_fprintf(stderr,
                 "ntfs_load_secure: sii_buffer.size is too large: %z\n",
                 sii_buffer.size);
+        tsk_fs_file_close(secure);
         return 0;
     }
     if ((sii_buffer.buffer = tsk_malloc(sii_buffer.size)) == NULL) {
+        tsk_fs_file_close(secure);
         return 1;
     }
 
@@ -3739,6 +3890,33 @@ ntfs_load_secure(NTFS_INFO * ntfs)
     }
 
     tsk_fs_file_close(secure);
+
+    // Sort the $SII entries by security id so that they can be
+    // binary searched by ntfs_get_sds()
+    if (ntfs->sii_data.used) {
+        size_t i;
+
+        if ((ntfs->sii_idx = (NTFS_SII_IDX *)
+                tsk_malloc(ntfs->sii_data.used * sizeof(NTFS_SII_IDX))) ==
+            NULL) {
+            free(ntfs->sii_data.buffer);
+            ntfs->sii_data.buffer = NULL;
+            ntfs->sii_data.used = 0;
+            ntfs->sii_data.size = 0;
+            free(ntfs->sds_data.buffer);
+            ntfs->sds_data.buffer = NULL;
+            ntfs->sds_data.used = 0;
+            ntfs->sds_data.size = 0;
+            return 1;
+        }
+        for (i = 0; i < ntfs->sii_data.used; i++) {
+            ntfs->sii_idx[i].sec_id = tsk_getu32(fs->endian,
+                ((ntfs_attr_sii *) (ntfs->sii_data.buffer))[i].key_sec_id);
+            ntfs->sii_idx[i].idx = (uint32_t) i;
+        }
+        qsort(ntfs->sii_idx, ntfs->sii_data.used, sizeof(NTFS_SII_IDX),
+            ntfs_sii_idx_cmp);
+    }
     return 0;
 }
 
@@ -3770,6 +3948,106 @@ ntfs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
 
 
 
+/*
+ * Report runs of clusters with the same allocation status.  The runs
+ * are computed a bitmap cluster at a time from a private copy of the
+ * cluster, so the shared bitmap cache is not disturbed.
+ *
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+ntfs_block_run_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
+    TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr)
+{
+    NTFS_INFO *ntfs = (NTFS_INFO *) fs;
+    TSK_DADDR_T bits_p_clust = 8 * (TSK_DADDR_T) fs->block_size;
+    TSK_DADDR_T addr = a_start_blk;
+    TSK_WALK_RET_ENUM retval;
+    char *buf;
+
+    /* See is_clustalloc() */
+    if (ntfs->loading_the_MFT == 1) {
+        retval = a_action(fs, a_start_blk, a_end_blk - a_start_blk + 1,
+            TSK_FS_BLOCK_FLAG_ALLOC, a_ptr);
+        return (retval == TSK_WALK_ERROR) ? 1 : 0;
+    }
+    else if (ntfs->bmap == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("ntfs_block_run_walk: Bitmap pointer is null");
+        return 1;
+    }
+
+    if ((buf = (char *) tsk_malloc(fs->block_size)) == NULL)
+        return 1;
+
+    while (addr <= a_end_blk) {
+        TSK_DADDR_T base = addr / bits_p_clust;
+        TSK_DADDR_T base_addr = base * bits_p_clust;
+        TSK_DADDR_T c = base, fsaddr = 0, cend;
+        TSK_FS_ATTR_RUN *run;
+        ssize_t cnt;
+
+        /* get the file system address of the bitmap cluster */
+        for (run = ntfs->bmap; run; run = run->next) {
+            if (run->len <= c) {
+                c -= run->len;
+            }
+            else {
+                fsaddr = run->addr + c;
+                break;
+            }
+        }
+        if ((fsaddr == 0) || (fsaddr > fs->last_block)) {
+            free(buf);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
+            tsk_error_set_errstr
+                ("ntfs_block_run_walk: cluster not found in bitmap: %"
+                PRIuDADDR "", addr);
+            return 1;
+        }
+
+        cnt = tsk_fs_read_block(fs, fsaddr, buf, fs->block_size);
+        if (cnt != fs->block_size) {
+            free(buf);
+            if (cnt >= 0) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_READ);
+            }
+            tsk_error_set_errstr2
+                ("ntfs_block_run_walk: Error reading bitmap at %" PRIuDADDR,
+                fsaddr);
+            return 1;
+        }
+
+        cend = base_addr + bits_p_clust - 1;
+        if (cend > a_end_blk)
+            cend = a_end_blk;
+
+        while (addr <= cend) {
+            uint64_t b = addr - base_addr;
+            int alloc = isset(buf, b) ? 1 : 0;
+            TSK_DADDR_T next = base_addr +
+                tsk_fs_bitmap_find((uint8_t *) buf, b,
+                cend - base_addr + 1, (uint8_t) ! alloc, 0);
+
+            retval = a_action(fs, addr, next - addr,
+                alloc ? TSK_FS_BLOCK_FLAG_ALLOC : TSK_FS_BLOCK_FLAG_UNALLOC,
+                a_ptr);
+            if (retval != TSK_WALK_CONT) {
+                free(buf);
+                return (retval == TSK_WALK_ERROR) ? 1 : 0;
+            }
+            addr = next;
+        }
+    }
+
+    free(buf);
+    return 0;
+}
+
+
 /*
  * flags: TSK_FS_BLOCK_FLAG_ALLOC and FS_FLAG_UNALLOC
  *
@@ -3783,9 +4061,6 @@ ntfs_block_walk(TSK_FS_INFO * fs,
     void *a_ptr)
 {
     char *myname = "ntfs_block_walk";
-    NTFS_INFO *ntfs = (NTFS_INFO *) fs;
-    TSK_DADDR_T addr;
-    TSK_FS_BLOCK *fs_block;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -3808,75 +4083,9 @@ ntfs_block_walk(TSK_FS_INFO * fs,
         return 1;
     }
 
-    /* Sanity check on a_flags -- make sure at least one ALLOC is set */
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_ALLOC |
-            TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
-    }
-    if (((a_flags & TSK_FS_BLOCK_WALK_FLAG_META) == 0) &&
-        ((a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT) == 0)) {
-        a_flags |=
-            (TSK_FS_BLOCK_WALK_FLAG_CONT | TSK_FS_BLOCK_WALK_FLAG_META);
-    }
-
-
-    if ((fs_block = tsk_fs_block_alloc(fs)) == NULL) {
-        return 1;
-    }
-
-    /* Cycle through the blocks */
-    for (addr = a_start_blk; addr <= a_end_blk; addr++) {
-        int retval;
-        int myflags;
-
-        /* identify if the cluster is allocated or not */
-        retval = is_clustalloc(ntfs, addr);
-        if (retval == -1) {
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-
-        else if (retval == 1) {
-            myflags = TSK_FS_BLOCK_FLAG_ALLOC;
-        }
-        else {
-            myflags = TSK_FS_BLOCK_FLAG_UNALLOC;
-        }
-
-        // test if we should call the callback with this one
-        if ((myflags & TSK_FS_BLOCK_FLAG_ALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
-            continue;
-
-        if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-            myflags |= TSK_FS_BLOCK_FLAG_AONLY;
-
-        if (tsk_fs_block_get_flag(fs, fs_block, addr,
-                (TSK_FS_BLOCK_FLAG_ENUM) myflags) == NULL) {
-            tsk_error_set_errstr2
-                ("ntfs_block_walk: Error reading block at %" PRIuDADDR,
-                addr);
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-
-        retval = a_action(fs_block, a_ptr);
-        if (retval == TSK_WALK_STOP) {
-            break;
-        }
-        else if (retval == TSK_WALK_ERROR) {
-            tsk_fs_block_free(fs_block);
-            return 1;
-        }
-    }
-
-    tsk_fs_block_free(fs_block);
-    return 0;
+    /* Cycle through the runs of clusters */
+    return tsk_fs_block_walk_runs(fs, a_start_blk, a_end_blk, a_flags,
+        a_action, a_ptr, myname);
 }
 
 
@@ -4889,6 +5098,16 @@ ntfs_close(TSK_FS_INFO * fs)
     free(ntfs->sds_data.buffer);
     ntfs->sds_data.buffer = NULL;
 
+    free(ntfs->sii_idx);
+    ntfs->sii_idx = NULL;
+
+    if (ntfs->sid_cache) {
+        size_t i;
+        for (i = 0; i < ntfs->sid_cache_size; i++)
+            free(ntfs->sid_cache[i].sid_str);
+        free(ntfs->sid_cache);
+        ntfs->sid_cache = NULL;
+    }
 #endif
 
     fs->tag = 0;
@@ -5111,6 +5330,7 @@ ntfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
      */
     fs->inode_walk = ntfs_inode_walk;
     fs->block_walk = ntfs_block_walk;
+    fs->block_run_walk = ntfs_block_run_walk;
     fs->block_getflags = ntfs_block_getflags;
 
     fs->get_default_attr_type = ntfs_get_default_attr_type;
@@ -5203,16 +5423,14 @@ ntfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         goto on_error;
     }
 
-    /* load the SID data into ntfs_info ($Secure - $SDS, $SDH, $SII */
-
-
+    /* The SID data ($Secure - $SDS, $SDH, $SII) is loaded by
+     * ntfs_file_get_sidstr() the first time that it is needed */
 #if TSK_USE_SID
-    if (ntfs_load_secure(ntfs)) {
-        if (tsk_verbose)
-            fprintf(stderr, "ntfs_open: Error loading Secure Info (%s)\n",
-                tsk_error_get());
-        goto on_error;
-    }
+    ntfs->secure_loaded = 0;
+    ntfs->sii_idx = NULL;
+    ntfs->sid_cache = NULL;
+    ntfs->sid_cache_size = 0;
+    ntfs->sid_cache_used = 0;
 #endif
 
     // initialize the caches
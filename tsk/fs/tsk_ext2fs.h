@@ -89,6 +89,7 @@ extern "C" {
 #define EXT2FS_NDADDR      12
 #define EXT2FS_NIADDR      3
 #define EXT2FS_SBOFF       1024
+#define EXT2FS_BITMAP_CACHE_MAX (64 * 1024 * 1024)     ///< Default memory budget for cached group bitmaps
 #define EXT2FS_FS_MAGIC    0xef53
 #define EXT2FS_MAXNAMLEN	255
 #define EXT2FS_MAXPATHLEN	4096
@@ -206,6 +207,10 @@ extern "C" {
 #define EXT2FS_REV_ORIG		0
 #define EXT2FS_REV_DYN		1
 
+/* s_flags values */
+#define EXT2FS_FLAGS_SIGNED_HASH	0x0001  /* directory hashes use signed chars */
+#define EXT2FS_FLAGS_UNSIGNED_HASH	0x0002  /* directory hashes use unsigned chars */
+
 /* feature flags */
 #define EXT2FS_HAS_COMPAT_FEATURE(fs,sb,mask)\
     ((tsk_getu32(fs->endian,sb->s_feature_compat) & mask) != 0)
@@ -365,6 +370,8 @@ extern "C" {
         uint8_t eh_generation[4];       /* u32 */
     } ext2fs_extent_header;
 
+#define EXT2FS_EXTENT_MAX_DEPTH 5       /* levels below the inode */
+
 /* MODE */
 #define EXT2_IN_FMT  0170000
 #define EXT2_IN_SOCK 0140000
@@ -455,6 +462,39 @@ extern "C" {
 #define EXT2_DE_V2	2
 
 
+/*
+ * Hash tree (dir_index) directory structures.  The dx_root lives in the
+ * first block of the directory after the "." and ".." entries and the
+ * dx_node blocks start with an empty directory entry that covers the block.
+ */
+    typedef struct {
+        uint8_t reserved_zero[4];       /* u32 */
+        uint8_t hash_version;   /* u8 */
+        uint8_t info_length;    /* u8 */
+        uint8_t indirect_levels;        /* u8 */
+        uint8_t unused_flags;   /* u8 */
+    } ext2fs_dx_root_info;
+
+    typedef struct {
+        uint8_t limit[2];       /* u16 */
+        uint8_t count[2];       /* u16 */
+    } ext2fs_dx_countlimit;
+
+    typedef struct {
+        uint8_t hash[4];        /* u32 */
+        uint8_t block[4];       /* u32 */
+    } ext2fs_dx_entry;
+
+#define EXT2_DX_HASH_LEGACY             0
+#define EXT2_DX_HASH_HALF_MD4           1
+#define EXT2_DX_HASH_TEA                2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT2_DX_HASH_TEA_UNSIGNED       5
+
+#define EXT2_DX_MAX_LEVELS      3       /* with EXT4FS_FEATURE_INCOMPAT_LARGEDIR */
+
+
 
 
 /* Extended Attributes
@@ -633,6 +673,34 @@ extern "C" {
     } EXT2FS_JINFO;
 
 
+/* Number of decoded extent trees that are kept by ext2fs_load_attrs */
+#define EXT2FS_EXTENT_CACHE_N   16
+
+/* Leaf extent of an ext4 extent tree */
+    typedef struct {
+        uint32_t lblk;          /* first logical block */
+        uint16_t len;           /* length as stored in ee_len */
+        TSK_DADDR_T pblk;       /* first physical block */
+    } EXT2FS_EXTENT;
+
+/* Decoded extent tree of a file.  Maps in the cache are not changed after
+ * they are added and are reference counted so that they can be used
+ * without holding extent_cache_lock. */
+    typedef struct {
+        TSK_INUM_T inum;
+        uint32_t root[EXT2FS_NDADDR + EXT2FS_NIADDR];   /* i_block contents the tree was read from */
+        EXT2FS_EXTENT *extents; /* leaf extents in tree order */
+        size_t extent_cnt;
+        size_t extent_alloc;
+        TSK_DADDR_T *blocks;    /* tree blocks below the inode in the order they were read */
+        size_t block_cnt;
+        size_t block_alloc;
+        uint8_t sorted;         /* 1 if the extents are in increasing logical order without overlap */
+        uint8_t cached;         /* 1 while the map is in extent_cache */
+        int refs;               /* users of the map - extent_cache_lock */
+    } EXT2FS_EXTENT_MAP;
+
+
 
     /*
      * Structure of an ext2fs file system handle.
@@ -644,9 +712,24 @@ extern "C" {
         /* lock protects grp_buf, grp_num, bmap_buf, bmap_grp_num, imap_buf, imap_grp_num */
         tsk_lock_t lock;
 
-        // one of the below will be allocated and populated by ext2fs_group_load depending on the FS type
-        ext4fs_gd *ext4_grp_buf; /* cached group descriptor for 64-bit ext4 r/w shared - lock */
-        ext2fs_gd *grp_buf;     /* cached group descriptor for ext2,ext3,32-bit ext4 r/w shared - lock */
+        /* group descriptor table, read once by ext2fs_open (read only after that) */
+        uint8_t *grp_descs;     /* copy of the on-disk group descriptors */
+        size_t grp_desc_size;   /* size of each descriptor in grp_descs */
+        uint8_t grp_desc_64;    /* 1 if the descriptors are ext4fs_gd and 0 if ext2fs_gd */
+        EXT2_GRPNUM_T grp_descs_count;  /* nr of descriptors that could be read */
+
+        /* block and inode bitmaps of each group (grp_descs_count entries).
+         * The entries are filled on first use with an atomic compare and swap
+         * and are not changed after that, so they can be read without a lock.
+         * Once bitmap_cache_max bytes are cached, bmap_buf and imap_buf are used. */
+        void **bmap_cache;
+        void **imap_cache;
+        size_t bitmap_cache_used;       /* bytes cached (atomic) */
+        size_t bitmap_cache_max;        /* memory budget for the bitmap caches */
+
+        // one of the below will point into grp_descs after ext2fs_group_load depending on the FS type
+        ext4fs_gd *ext4_grp_buf; /* current group descriptor for 64-bit ext4 r/w shared - lock */
+        ext2fs_gd *grp_buf;     /* current group descriptor for ext2,ext3,32-bit ext4 r/w shared - lock */
 
         EXT2_GRPNUM_T grp_num;  /* cached group number r/w shared - lock */
 
@@ -663,12 +746,21 @@ extern "C" {
         TSK_DADDR_T first_data_block;
 
         EXT2FS_JINFO *jinfo;
+
+        /* most recently used extent trees (most recent first) so that opening
+         * the same file again does not re-read the index blocks */
+        tsk_lock_t extent_cache_lock;
+        EXT2FS_EXTENT_MAP *extent_cache[EXT2FS_EXTENT_CACHE_N];
     } EXT2FS_INFO;
 
 
     extern TSK_RETVAL_ENUM
         ext2fs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
         TSK_INUM_T a_addr);
+    extern int8_t ext2fs_dir_find_name(TSK_FS_INFO * a_fs,
+        TSK_INUM_T a_addr, const char *a_name, TSK_FS_NAME * a_fs_name);
+    extern uint8_t ext2fs_dinode_load(EXT2FS_INFO * ext2fs,
+        TSK_INUM_T dino_inum, ext2fs_inode * dino_buf);
     extern uint8_t ext2fs_jentry_walk(TSK_FS_INFO *, int,
         TSK_FS_JENTRY_WALK_CB, void *);
     extern uint8_t ext2fs_jblk_walk(TSK_FS_INFO *, TSK_DADDR_T,
@@ -55,6 +55,10 @@
 /* This must be at least 1024 bytes or else fat12 will get messed up */
 #define FATFS_FAT_CACHE_N		4       // number of caches
 #define FATFS_FAT_CACHE_B		4096
+#define FATFS_FAT_TABLE_MAX	(64 * 1024 * 1024)      ///< Default memory budget for the in-memory FAT
+
+/* maximum size of the reads that fatfs_inode_walk() does in the data area */
+#define FATFS_INODE_WALK_READ_B	(1024 * 1024)
 
 #define FATFS_MASTER_BOOT_RECORD_SIZE 512
 
@@ -205,6 +209,17 @@ extern "C" {
         TSK_DADDR_T fatc_addr[FATFS_FAT_CACHE_N];     // r/w shared - lock
         uint8_t fatc_ttl[FATFS_FAT_CACHE_N];  //r/w shared - lock
 
+        /* In-memory copy of the whole FAT, loaded by the first fatfs_getFAT()
+         * call if it fits in fat_table_max bytes.  fat_table holds
+         * lastclust + 1 decoded (and sanity checked) entries followed by
+         * lastclust + 1 run lengths: the number of clusters starting at each
+         * cluster that follow each other on disk in the chain.  It is
+         * published with an atomic compare and swap and is read only after
+         * that.  If it cannot be loaded, the caches above are used. */
+        uint32_t *fat_table;
+        uint8_t fat_table_tried;        // r/w shared - lock
+        size_t fat_table_max;   // memory budget for fat_table (0 to disable it)
+
         /* First sector of FAT */
         TSK_DADDR_T firstfatsect;
 
@@ -244,6 +259,10 @@ extern "C" {
         tsk_lock_t dir_lock;    //< Lock that protects inum2par.
         void *inum2par;         //< Maps subfolder metadata address to parent folder metadata addresses.
 
+        /* Bitmap of the sectors allocated to directories, made by the first
+         * inode walk and published with an atomic compare and swap. */
+        uint8_t *dir_sectors_bitmap;
+
 		char boot_sector_buffer[FATFS_MASTER_BOOT_RECORD_SIZE];
         int using_backup_boot_sector;
 
@@ -309,6 +328,11 @@ extern "C" {
         TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags,
         TSK_FS_BLOCK_WALK_CB a_action, void *a_ptr);
 
+    extern uint8_t
+    fatfs_block_run_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
+        TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_RUN_WALK_CB a_action,
+        void *a_ptr);
+
     extern TSK_FS_BLOCK_FLAG_ENUM
     fatfs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr);
 
@@ -320,6 +344,25 @@ extern "C" {
     extern uint8_t fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust,
         TSK_DADDR_T * value);
 
+    extern TSK_DADDR_T fatfs_getFAT_run(FATFS_INFO * fatfs,
+        TSK_DADDR_T clust);
+
+    /* 
+     * Sorted set of cluster ranges that have been visited while following
+     * a cluster chain, used to find loops.
+     */
+    typedef struct {
+        TSK_DADDR_T *rng;       // first and last cluster of each range
+        size_t cnt;             // number of ranges in rng
+        size_t alloc;           // number of ranges allocated in rng
+    } FATFS_CLUST_SEEN;
+
+    extern TSK_DADDR_T fatfs_clust_seen_find(const FATFS_CLUST_SEEN * seen,
+        TSK_DADDR_T first, TSK_DADDR_T last);
+    extern uint8_t fatfs_clust_seen_add(FATFS_CLUST_SEEN * seen,
+        TSK_DADDR_T first, TSK_DADDR_T last);
+    extern void fatfs_clust_seen_free(FATFS_CLUST_SEEN * seen);
+
     extern uint8_t 
     fatfs_dir_buf_add(FATFS_INFO * fatfs, TSK_INUM_T par_inum, TSK_INUM_T dir_inum); 
 
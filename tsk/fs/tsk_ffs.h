@@ -43,6 +43,7 @@ extern "C" {
 
 #define FFS_MAXNAMLEN 	255
 #define FFS_MAXPATHLEN	1024
+#define FFS_GRP_CACHE_MAX (64 * 1024 * 1024)   ///< Default memory budget for cached cylinder group blocks
 #define FFS_DIRBLKSIZ	512
 
 #define FFS_FILE_CONTENT_LEN     ((FFS_NDADDR + FFS_NIADDR) * sizeof(TSK_DADDR_T))
@@ -491,6 +492,14 @@ extern "C" {
         FFS_GRPNUM_T grp_num;   ///< Cyl grp num that is cached (r/w shared - lock)
         TSK_DADDR_T grp_addr;   ///< Address where cached cyl grp data was read from (r/w shared - lock)
 
+        /* cylinder group blocks (groups_count entries).  The entries are
+         * filled on first use with an atomic compare and swap and are not
+         * changed after that, so they can be read without a lock.  Once
+         * grp_cache_max bytes are cached, grp_buf is used. */
+        void **grp_cache;
+        size_t grp_cache_used;  ///< Bytes cached (atomic)
+        size_t grp_cache_max;   ///< Memory budget for grp_cache
+
         FFS_GRPNUM_T groups_count;      /* nr of descriptor group blocks */
 
         unsigned int ffsbsize_f;        /* num of frags in an FFS block */
@@ -117,6 +117,21 @@ extern "C" {
     typedef TSK_WALK_RET_ENUM(*TSK_FS_BLOCK_WALK_CB) (const TSK_FS_BLOCK *
         a_block, void *a_ptr);
 
+    /**
+    * Function definition used for callback to tsk_fs_block_run_walk().
+    * It is called for each range of consecutive blocks that have the same flags.
+    *
+    * @param a_fs File system being analyzed
+    * @param a_addr Address of the first block in the run
+    * @param a_len Number of blocks in the run
+    * @param a_flags Flags of every block in the run (alloc or unalloc, meta or content)
+    * @param a_ptr Pointer that was supplied by the caller who called tsk_fs_block_run_walk
+    * @returns Value to identify if walk should continue, stop, or stop because of error
+    */
+    typedef TSK_WALK_RET_ENUM(*TSK_FS_BLOCK_RUN_WALK_CB) (TSK_FS_INFO *
+        a_fs, TSK_DADDR_T a_addr, TSK_DADDR_T a_len,
+        TSK_FS_BLOCK_FLAG_ENUM a_flags, void *a_ptr);
+
 
     // external block-level functions
     extern void tsk_fs_block_free(TSK_FS_BLOCK * a_fs_block);
@@ -129,6 +144,10 @@ extern "C" {
         TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
         TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags, TSK_FS_BLOCK_WALK_CB a_action,
         void *a_ptr);
+    extern uint8_t tsk_fs_block_run_walk(TSK_FS_INFO * a_fs,
+        TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
+        TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags,
+        TSK_FS_BLOCK_RUN_WALK_CB a_action, void *a_ptr);
 
     //@}
 
@@ -207,6 +226,7 @@ extern "C" {
         TSK_FS_FILE_WALK_FLAG_NOID = 0x02,      ///< Ignore the Id argument given in the API (use only the type)
         TSK_FS_FILE_WALK_FLAG_AONLY = 0x04,     ///< Provide callback with only addresses and no file content.
         TSK_FS_FILE_WALK_FLAG_NOSPARSE = 0x08,  ///< Do not include sparse blocks in the callback.
+        TSK_FS_FILE_WALK_FLAG_LARGE = 0x10,     ///< Give consecutive blocks that have the same flags to the callback at once (a_addr is then the first one).  Only applies to non-resident attributes that are not compressed.
     } TSK_FS_FILE_WALK_FLAG_ENUM;
 
 
@@ -309,6 +329,9 @@ extern "C" {
             TSK_OFF_T a_offset, char *a_buf, size_t a_len);
          uint8_t(*w) (const TSK_FS_ATTR * fs_attr,
             int flags, TSK_FS_FILE_WALK_CB, void *);
+
+        struct TSK_FS_ATTR_RUN_IDX *run_idx;    ///< \internal Array of the runs in nrd.run, sorted by offset (can be NULL).  Call tsk_fs_attr_read() instead.
+        size_t run_idx_cnt;     ///< \internal Number of entries in run_idx
     };
 
 
@@ -649,6 +672,15 @@ extern "C" {
         TSK_FS_DIR_WALK_FLAG_NOORPHAN = 0x08,   ///< Do not return (or recurse into) the special Orphan directory
     } TSK_FS_DIR_WALK_FLAG_ENUM;
 
+    /**
+    * Flags that are used by tsk_fs_dir_walk_parallel() to select how the
+    * callback is called.
+    */
+    typedef enum {
+        TSK_FS_DIR_WALK_PARALLEL_ORDERED = 0x00,        ///< Call the callback on the calling thread in the same order as tsk_fs_dir_walk()
+        TSK_FS_DIR_WALK_PARALLEL_CONCURRENT = 0x01,     ///< Call the callback from the worker threads as files are loaded (callback must be thread safe)
+    } TSK_FS_DIR_WALK_PARALLEL_ENUM;
+
 
     extern TSK_FS_DIR *tsk_fs_dir_open_meta(TSK_FS_INFO * a_fs,
         TSK_INUM_T a_addr);
@@ -657,6 +689,10 @@ extern "C" {
     extern uint8_t tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_inode,
         TSK_FS_DIR_WALK_FLAG_ENUM a_flags, TSK_FS_DIR_WALK_CB a_action,
         void *a_ptr);
+    extern uint8_t tsk_fs_dir_walk_parallel(TSK_FS_INFO * a_fs,
+        TSK_INUM_T a_inode, TSK_FS_DIR_WALK_FLAG_ENUM a_flags,
+        TSK_FS_DIR_WALK_PARALLEL_ENUM a_mode, TSK_FS_DIR_WALK_CB a_action,
+        void *a_ptr);
     extern size_t tsk_fs_dir_getsize(const TSK_FS_DIR *);
     extern TSK_FS_FILE *tsk_fs_dir_get(const TSK_FS_DIR *, size_t);
     extern const TSK_FS_NAME *tsk_fs_dir_get_name(const TSK_FS_DIR * a_fs_dir, size_t a_idx);
@@ -942,17 +978,14 @@ extern "C" {
 
         TSK_ENDIAN_ENUM endian; ///< Endian order of data
 
-        /* list_inum_named_lock protects list_inum_named */
+        /* list_inum_named_lock protects list_inum_named and inum_named */
         tsk_lock_t list_inum_named_lock;        // taken when r/w the list_inum_named list
-        TSK_LIST *list_inum_named;      /**< List of unallocated inodes that
-                                        * are pointed to by a file name --
-                                        * Used to find orphan files.  Is filled
-                                        * after looking for orphans
-                                        * or afer a full name_walk is performed.
-                                        * (r/w shared - lock) */
+        TSK_LIST *list_inum_named;      /**< No longer filled.  The unallocated
+                                        * inodes that are pointed to by a file
+                                        * name are kept in inum_named. */
 
         /* orphan_hunt_lock protects orphan_dir */
-        tsk_lock_t orphan_dir_lock;     // taken for the duration of orphan hunting (not just when updating orphan_dir)
+        tsk_lock_t orphan_dir_lock;     // taken when r/w the orphan_dir pointer
         TSK_FS_DIR *orphan_dir; ///< Files and dirs in the top level of the $OrphanFiles directory.  NULL if orphans have not been hunted for yet. (r/w shared - lock)
 
          uint8_t(*block_walk) (TSK_FS_INFO * fs, TSK_DADDR_T start, TSK_DADDR_T end, TSK_FS_BLOCK_WALK_FLAG_ENUM flags, TSK_FS_BLOCK_WALK_CB cb, void *ptr);    ///< FS-specific function: Call tsk_fs_block_walk() instead.
@@ -999,6 +1032,12 @@ extern "C" {
         void (*close) (TSK_FS_INFO * fs);       ///< FS-specific function: Call tsk_fs_close() instead.
 
          uint8_t(*fread_owner_sid) (TSK_FS_FILE *, char **);    // FS-specific function. Call tsk_fs_file_get_owner_sid() instead.
+
+         uint8_t(*block_run_walk) (TSK_FS_INFO * fs, TSK_DADDR_T start, TSK_DADDR_T end, TSK_FS_BLOCK_RUN_WALK_CB cb, void *ptr);      ///< \internal FS-specific function (can be NULL): Call tsk_fs_block_run_walk() instead.
+
+         int8_t(*dir_find_name) (TSK_FS_INFO * fs, TSK_INUM_T dir_addr, const char *name, TSK_FS_NAME * fs_name);       ///< \internal FS-specific function (can be NULL): Find an allocated name in a directory using an on-disk index. Returns -1 on error, 0 if found and 1 if the caller must scan the directory. Call tsk_fs_path2inum() instead.
+
+        TSK_ADDR_SET *inum_named;       ///< \internal Set of unallocated inodes that are pointed to by a file name -- Used to find orphan files.  Is filled after looking for orphans or after a full name_walk is performed and is not changed once it is set. (r/w shared - list_inum_named_lock)
     };
 
 
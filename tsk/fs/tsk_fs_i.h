@@ -84,8 +84,26 @@ extern "C" {
     extern TSK_FS_BLOCK *tsk_fs_block_alloc(TSK_FS_INFO * fs);
     extern int tsk_fs_block_set(TSK_FS_INFO * fs, TSK_FS_BLOCK * fs_block,
         TSK_DADDR_T a_addr, TSK_FS_BLOCK_FLAG_ENUM a_flags, char *a_buf);
+    extern uint8_t tsk_fs_block_walk_runs(TSK_FS_INFO * a_fs,
+        TSK_DADDR_T a_start_blk, TSK_DADDR_T a_end_blk,
+        TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags, TSK_FS_BLOCK_WALK_CB a_action,
+        void *a_ptr, const char *a_myname);
+    extern uint64_t tsk_fs_bitmap_find(const uint8_t * a_map,
+        uint64_t a_start, uint64_t a_end, uint8_t a_value,
+        uint8_t a_msb_first);
 
     /* FS_DATA */
+    /* Entry in the sorted array of the runs of a non-resident attribute
+     * (TSK_FS_ATTR.run_idx).  The end offset is kept next to the run
+     * pointer so that a binary search does not need to follow the
+     * pointers. */
+    typedef struct TSK_FS_ATTR_RUN_IDX {
+        TSK_DADDR_T end;        // offset (in blocks) of the first block after the run
+        TSK_FS_ATTR_RUN *run;   // run in the linked list
+    } TSK_FS_ATTR_RUN_IDX;
+
+#define TSK_FS_ATTR_RUN_IDX_MIN 16      ///< Minimum number of runs that tsk_fs_attr_run_idx_build() indexes
+#define TSK_FS_ATTR_WALK_LARGE_SIZE (4 * 1024 * 1024)   ///< Most bytes given to a callback at once with TSK_FS_FILE_WALK_FLAG_LARGE
     extern TSK_FS_ATTR *tsk_fs_attr_alloc(TSK_FS_ATTR_FLAG_ENUM);
     extern void tsk_fs_attr_free(TSK_FS_ATTR *);
     extern void tsk_fs_attr_clear(TSK_FS_ATTR *);
@@ -101,6 +119,9 @@ extern "C" {
     extern void tsk_fs_attr_append_run(TSK_FS_INFO * fs,
         TSK_FS_ATTR * a_fs_attr, TSK_FS_ATTR_RUN * a_data_run);
     extern uint8_t tsk_fs_attr_print(const TSK_FS_ATTR * a_fs_attr, FILE * hFile);
+    extern uint8_t tsk_fs_attr_run_idx_build(TSK_FS_ATTR * a_fs_attr);
+    extern TSK_FS_ATTR_RUN *tsk_fs_attr_run_find(const TSK_FS_ATTR *
+        a_fs_attr, TSK_DADDR_T a_blk);
 
     /* FS_DATALIST */
     extern TSK_FS_ATTRLIST *tsk_fs_attrlist_alloc();
@@ -109,6 +130,7 @@ extern "C" {
     extern TSK_FS_ATTR *tsk_fs_attrlist_getnew(TSK_FS_ATTRLIST *,
         TSK_FS_ATTR_FLAG_ENUM a_atype);
     extern void tsk_fs_attrlist_markunused(TSK_FS_ATTRLIST *);
+    extern uint8_t tsk_fs_attrlist_run_idx_build(TSK_FS_ATTRLIST *);
     extern const TSK_FS_ATTR *tsk_fs_attrlist_get(const TSK_FS_ATTRLIST *,
         TSK_FS_ATTR_TYPE_ENUM);
     extern const TSK_FS_ATTR *tsk_fs_attrlist_get_id(const TSK_FS_ATTRLIST
@@ -143,7 +165,13 @@ extern "C" {
     extern uint8_t tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash);
     extern uint32_t tsk_fs_dir_hash(const char *str);
 
+    /* Limits on the recursion of the directory walks */
+#define TSK_FS_DIR_WALK_MAX_DEPTH   128
+#define TSK_FS_DIR_WALK_PATH_SIZE   4096
+
     /* Orphan Directory Support */
+    extern void tsk_fs_dir_save_inum_named(TSK_FS_INFO * a_fs,
+        TSK_ADDR_SET * a_set);
     TSK_RETVAL_ENUM tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs);
     uint8_t tsk_fs_dir_find_inum_named(TSK_FS_INFO * a_fs,
         TSK_INUM_T a_inum);
@@ -264,9 +292,37 @@ extern "C" {
     typedef TSK_WALK_RET_ENUM(*TSK_FS_USNJENTRY_WALK_CB) (
         TSK_USN_RECORD_HEADER *a_header, void *a_record, void *a_ptr);
 
+    /**
+    * Flags that identify which fields of TSK_FS_USNJ_FILTER are in use.
+    */
+    enum TSK_FS_USNJ_FILTER_FLAG_ENUM {
+        TSK_FS_USNJ_FILTER_NONE = 0x00,
+        TSK_FS_USNJ_FILTER_USN = 0x01,  ///< Only records with usn_min <= USN <= usn_max
+        TSK_FS_USNJ_FILTER_REASON = 0x02,       ///< Only records with a reason bit in reason_mask
+        TSK_FS_USNJ_FILTER_TIME = 0x04  ///< Only records with time_min <= time <= time_max
+    };
+    typedef enum TSK_FS_USNJ_FILTER_FLAG_ENUM TSK_FS_USNJ_FILTER_FLAG_ENUM;
+
+    /**
+    * Conditions that a USN record must meet to be passed to the walk
+    * callback.  The USN range is also used to limit which parts of the
+    * journal are read (the USN of a record is its offset in $J).
+    */
+    typedef struct {
+        TSK_FS_USNJ_FILTER_FLAG_ENUM flags;
+        uint64_t usn_min;
+        uint64_t usn_max;
+        uint32_t reason_mask;
+        uint32_t time_min;      ///< Unix time (seconds)
+        uint32_t time_max;      ///< Unix time (seconds)
+    } TSK_FS_USNJ_FILTER;
+
     extern uint8_t tsk_ntfs_usnjopen(TSK_FS_INFO * fs, TSK_INUM_T inum);
     extern uint8_t tsk_ntfs_usnjentry_walk(TSK_FS_INFO * fs,
         TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
+    extern uint8_t tsk_ntfs_usnjentry_walk_filter(TSK_FS_INFO * fs,
+        const TSK_FS_USNJ_FILTER * filter,
+        TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
 
     enum TSK_FS_USNJLS_FLAG_ENUM {
         TSK_FS_USNJLS_NONE = 0x00,
@@ -275,7 +331,7 @@ extern "C" {
     };
     typedef enum TSK_FS_USNJLS_FLAG_ENUM TSK_FS_USNJLS_FLAG_ENUM;
     extern uint8_t tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode,
-        TSK_FS_USNJLS_FLAG_ENUM flags);
+        TSK_FS_USNJLS_FLAG_ENUM flags, const TSK_FS_USNJ_FILTER * filter);
 
 
 // Endian macros - actual functions in misc/
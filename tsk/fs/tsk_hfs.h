@@ -547,6 +547,35 @@ typedef enum {
 
 #define COMPRESSION_UNIT_SIZE 65536U
 
+#define HFS_CMP_TABLE_CACHE_N 32        ///< Number of decmpfs block tables kept in HFS_INFO
+#define HFS_CMP_CHUNK_CACHE_N 16        ///< Number of decompressed compression units kept in HFS_INFO
+#define HFS_CMP_PARALLEL_MIN 8  ///< Number of compression units from which a file walk decompresses in parallel
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} CMP_OFFSET_ENTRY;
+
+/* Block table of the resource fork of a compressed file.  Entries are
+ * shared by the cache and its users and freed when refcnt drops to 0. */
+typedef struct {
+    TSK_INUM_T inum;
+    CMP_OFFSET_ENTRY *table;
+    uint32_t table_size;        /* number of entries in table */
+    uint32_t table_offset;      /* offset of the table in the resource fork */
+    uint64_t last_use;
+    int refcnt;
+} HFS_CMP_TABLE;
+
+/* One decompressed compression unit of a file */
+typedef struct {
+    TSK_INUM_T inum;
+    size_t indx;                /* index of the unit in the block table */
+    ssize_t len;                /* decompressed length (0 for an unused slot) */
+    uint64_t last_use;
+    char data[COMPRESSION_UNIT_SIZE];
+} HFS_CMP_CHUNK;
+
 
 /********* CATALOG Record structures *********/
 typedef struct {
@@ -637,6 +666,42 @@ typedef union {
     hfs_file file;
 } hfs_file_folder;
 
+#define HFS_CAT_NODE_CACHE_N 256        ///< Number of catalog B-tree nodes kept in HFS_INFO
+#define HFS_CAT_INDEX_MAX (64 * 1024 * 1024)    ///< Default memory budget for the catalog CNID index
+#define HFS_CAT_INDEX_LOOKUPS 128       ///< Number of catalog lookups after which the CNID index is built
+#define HFS_EXT_MAP_MAX (64 * 1024 * 1024)      ///< Default memory budget for the extents overflow map
+#define HFS_EXT_MAP_LOOKUPS 32  ///< Number of extents overflow lookups after which the map is loaded
+#define HFS_BTREE_LEAF_READ_B (1024 * 1024)     ///< Maximum size of the reads made while loading a whole B-tree
+
+/* Location of the catalog records of one CNID (node 0 means no record) */
+typedef struct {
+    uint32_t cnid;
+    uint32_t thread_node;       /* node with the thread record */
+    uint32_t rec_node;          /* node with the file or folder record */
+    uint16_t thread_off;        /* offset of the thread record key in thread_node */
+    uint16_t rec_off;           /* offset of the file or folder record key in rec_node */
+} HFS_CAT_INDEX_ENTRY;
+
+/* CNID index of the catalog leaf records, sorted by CNID */
+typedef struct {
+    HFS_CAT_INDEX_ENTRY *entries;
+    size_t count;
+} HFS_CAT_INDEX;
+
+/* One record of the extents overflow B-tree */
+typedef struct {
+    uint32_t cnid;
+    uint32_t start_blk;         /* first block of the fork that the extents cover */
+    uint8_t fork_type;          /* HFS_EXT_KEY_TYPE_DATA or HFS_EXT_KEY_TYPE_RSRC */
+    hfs_ext_desc extents[8];    /* raw extents (as on disk) */
+} HFS_EXT_MAP_ENTRY;
+
+/* All records of the extents overflow B-tree, in key order */
+typedef struct {
+    HFS_EXT_MAP_ENTRY *entries;
+    size_t count;
+} HFS_EXT_MAP;
+
 typedef struct {
     TSK_FS_INFO fs_info;        /* SUPER CLASS */
 
@@ -657,10 +722,39 @@ typedef struct {
     const TSK_FS_ATTR *catalog_attr;
     hfs_btree_header_record catalog_header;
 
+    /* cat_cache_lock protects cat_node_cache, cat_node_tag, cat_index_tried
+     * and ext_map_tried */
+    tsk_lock_t cat_cache_lock;
+    char *cat_node_cache;       ///< HFS_CAT_NODE_CACHE_N catalog nodes, allocated on first use (r/w shared - lock)
+    int64_t cat_node_tag[HFS_CAT_NODE_CACHE_N]; ///< Node number in each slot of cat_node_cache or -1 (r/w shared - lock)
+
+    /* CNID index of the catalog, made by one pass over the leaf nodes once
+     * enough lookups have been done.  It is published with an atomic
+     * compare and swap and is read only after that. */
+    HFS_CAT_INDEX *cat_index;
+    uint8_t cat_index_tried;    ///< (r/w shared - lock)
+    size_t cat_index_max;       ///< memory budget for cat_index (0 to disable it)
+    size_t cat_lookup_cnt;      ///< number of catalog lookups done so far (atomic)
+
     TSK_FS_FILE *extents_file;
     const TSK_FS_ATTR *extents_attr;
     hfs_btree_header_record extents_header;
 
+    /* In-memory copy of the extents overflow B-tree, loaded once enough
+     * lookups have been done.  It is published with an atomic compare and
+     * swap and is read only after that. */
+    HFS_EXT_MAP *ext_map;
+    uint8_t ext_map_tried;      ///< (r/w shared - cat_cache_lock)
+    size_t ext_map_max;         ///< memory budget for ext_map (0 to disable it)
+    size_t ext_lookup_cnt;      ///< number of extents overflow lookups done so far (atomic)
+
+    /* cmp_cache_lock protects cmp_tables, cmp_chunks and cmp_clock, the
+     * caches of block tables and decompressed units of compressed files */
+    tsk_lock_t cmp_cache_lock;
+    HFS_CMP_TABLE *cmp_tables[HFS_CMP_TABLE_CACHE_N];   ///< (r/w shared - lock)
+    HFS_CMP_CHUNK *cmp_chunks[HFS_CMP_CHUNK_CACHE_N];   ///< allocated on first use (r/w shared - lock)
+    uint64_t cmp_clock;         ///< LRU clock of the two caches (r/w shared - lock)
+
     TSK_OFF_T hfs_wrapper_offset;       /* byte offset of this FS within an HFS wrapper */
 
     /* Creation times needed for hard link recognition */
@@ -673,6 +767,7 @@ typedef struct {
 
     TSK_INUM_T meta_inum;
     TSK_INUM_T meta_dir_inum;
+    unsigned char metadata_dirs_loaded;        // Boolean -- have the two fields above been looked up? (metadata_dir_cache_lock)
 
     // We cache the two metadata directory structures here, to speed up hard link resolution
     TSK_FS_DIR *meta_dir;
@@ -369,17 +369,27 @@ typedef struct {
     TSK_OFF_T susp_len;         ///< Length in bytes of SUSP
 } iso9660_inode;
 
-/* inode linked list node */
+/* entry in the inode table */
 typedef struct iso9660_inode_node {
     iso9660_inode inode;
     TSK_OFF_T offset;           /* byte offset of first block of file in file system */
     TSK_OFF_T dentry_offset;    /* byte offset of directory entry structure in file system */
-    TSK_INUM_T inum;            /* identifier of inode (assigned by TSK) */
+    TSK_INUM_T inum;            /* identifier of inode (assigned by TSK), ISO9660_INUM_UNUSED if none */
     int size;                   /* number of bytes in file */
     int ea_size;                /* length of ext attributes */
-    struct iso9660_inode_node *next;
 } iso9660_inode_node;
 
+#define ISO9660_INUM_UNUSED ((TSK_INUM_T) -1)
+
+/* Hash index from a key to the first entry in the inode table that was
+ * added with that key (open addressing, linear probing) */
+typedef struct {
+    uint64_t *keys;
+    uint32_t *vals;             /* inum + 1, 0 if the bucket is empty */
+    size_t size;                /* number of buckets (power of 2) */
+    size_t used;                /* number of buckets in use */
+} iso9660_inode_idx;
+
 /* The all important ISO_INFO struct */
 typedef struct {
     TSK_FS_INFO fs_info;        /* SUPER CLASS */
@@ -387,7 +397,12 @@ typedef struct {
     uint32_t root_addr;         /* address of root dir extent */
     iso9660_pvd_node *pvd;      ///< Head of primary volume descriptor list (there should be only one...)
     iso9660_svd_node *svd;      ///< Head of secondary volume descriptor list 
-    iso9660_inode_node *in_list;        /* list of inodes */
+    iso9660_inode_node *in_list;        /* table of inodes, indexed by inum */
+    size_t in_count;            /* number of entries in in_list */
+    size_t in_alloc;            /* number of entries allocated in in_list */
+    iso9660_inode_idx in_by_extent;     /* extent location -> inode */
+    iso9660_inode_idx in_by_content;    /* extent location and size -> inode */
+    iso9660_inode_idx in_by_dentry;     /* dentry offset -> inode */
     uint8_t rr_found;           /* 1 if rockridge found */
 } ISO_INFO;
 
@@ -397,6 +412,11 @@ extern TSK_RETVAL_ENUM iso9660_dir_open_meta(TSK_FS_INFO * a_fs,
 extern uint8_t iso9660_dinode_load(ISO_INFO * iso, TSK_INUM_T inum,
     iso9660_inode * dinode);
 
+extern iso9660_inode_node *iso9660_inode_by_extent(ISO_INFO * iso,
+    uint32_t ext_loc);
+extern iso9660_inode_node *iso9660_inode_by_dentry(ISO_INFO * iso,
+    TSK_OFF_T dentry_offset);
+
 extern int iso9660_name_cmp(TSK_FS_INFO *, const char *, const char *);
 
 /**********************************************************
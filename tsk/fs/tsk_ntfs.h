@@ -536,6 +536,22 @@ extern "C" {
         size_t used;            ///< Number of records used in the buffer (size depends on type of data stored)
     } NTFS_SXX_BUFFER;
 
+/*
+ * Entry in the sorted index of the $SII entries
+ */
+    typedef struct {
+        uint32_t sec_id;        ///< Security ID of the entry
+        uint32_t idx;           ///< Index of the entry in NTFS_INFO.sii_data
+    } NTFS_SII_IDX;
+
+/*
+ * Entry in the cache of security ID to owner SID strings
+ */
+    typedef struct {
+        uint32_t sec_id;        ///< Security ID (0 if the slot is free)
+        char *sid_str;          ///< Owner SID as a string
+    } NTFS_SID_CACHE_ENTRY;
+
 
 
 /************************************************************************
@@ -729,10 +745,15 @@ extern "C" {
         void *orphan_map;       // map that lists par directory to its orphans. (r/w shared - lock)
 
 #if TSK_USE_SID
-        /* sid_lock protects sii_data, sds_data */
+        /* sid_lock protects secure_loaded, sii_data, sds_data, sii_idx and sid_cache */
         tsk_lock_t sid_lock;
+        uint8_t secure_loaded;  // 1 once loading $Secure was tried (r/w shared - lock)
         NTFS_SXX_BUFFER sii_data;       // (r/w shared - lock)
         NTFS_SXX_BUFFER sds_data;       // (r/w shared - lock)
+        NTFS_SII_IDX *sii_idx;  // sii_data entries sorted by security id (r/w shared - lock)
+        NTFS_SID_CACHE_ENTRY *sid_cache;        // hash table of owner SID strings (r/w shared - lock)
+        size_t sid_cache_size;  // number of slots in sid_cache (a power of 2)
+        size_t sid_cache_used;  // number of slots in use in sid_cache
 #endif
 
         /* Number of allocated regular files. 0 until a directory is
@@ -44,6 +44,17 @@ extern "C" {
 
 #define XFS_MAXNAMLEN 255
 
+#define XFS_AGI_MAGIC       0x58414749  /* "XAGI" */
+#define XFS_IBT_MAGIC       0x49414254  /* "IABT" */
+#define XFS_IBT_CRC_MAGIC   0x49414233  /* "IAB3" */
+#define XFS_AGI_SECT        2           /* AGI is in the third sector of the AG */
+#define XFS_NULLAGBLOCK     0xffffffff
+#define XFS_INODES_PER_CHUNK    64
+#define XFS_INODES_PER_HOLEMASK_BIT 4
+#define XFS_MAX_AGBLKLOG    31          /* AGs have at most 2^31 blocks */
+#define XFS_MAX_INOPBLOG    8           /* 64K blocks of 256 byte inodes */
+#define XFS_SB_FEAT_INCOMPAT_SPINODES   0x2     /* sparse inode chunks */
+
     typedef struct xfs_dinode_core {
         uint8_t           di_magic[2];
         uint8_t           di_mode[2];
@@ -119,8 +130,8 @@ extern "C" {
         uint8_t sb_ifree[8];
         uint8_t sb_fdblocks[8];
         uint8_t sb_frextents[8];
-        uint8_t sb_uquotino[4];
-        uint8_t sb_gquotino[4];
+        uint8_t sb_uquotino[8];
+        uint8_t sb_gquotino[8];
         uint8_t sb_qflags[2];
         uint8_t sb_flags;
         uint8_t sb_shared_vn;
@@ -146,6 +157,48 @@ extern "C" {
 
     } xfs_sb;
 
+    /* Allocation group inode header (only the fields that we use) */
+    typedef struct {
+        uint8_t agi_magicnum[4];
+        uint8_t agi_versionnum[4];
+        uint8_t agi_seqno[4];
+        uint8_t agi_length[4];
+        uint8_t agi_count[4];
+        uint8_t agi_root[4];        /* inode B+tree root block in the AG */
+        uint8_t agi_level[4];       /* levels in the inode B+tree */
+        uint8_t agi_freecount[4];
+        uint8_t agi_newino[4];
+        uint8_t agi_dirino[4];
+    } xfs_agi;
+
+    /* Header of a short form (AG relative) B+tree block */
+    typedef struct {
+        uint8_t bb_magic[4];
+        uint8_t bb_level[2];
+        uint8_t bb_numrecs[2];
+        uint8_t bb_leftsib[4];
+        uint8_t bb_rightsib[4];
+    } xfs_btree_sblock;
+
+    /* Header of a short form B+tree block with CRCs (v5 file systems) */
+    typedef struct {
+        xfs_btree_sblock bb_hdr;
+        uint8_t bb_blkno[8];
+        uint8_t bb_lsn[8];
+        uint8_t bb_uuid[16];
+        uint8_t bb_owner[4];
+        uint8_t bb_crc[4];
+    } xfs_btree_sblock_crc;
+
+    /* Inode B+tree leaf record, one per chunk of 64 inodes */
+    typedef struct {
+        uint8_t ir_startino[4];     /* AG relative inode number of the chunk */
+        uint8_t ir_holemask[2];     /* sparse chunks: 1 bit per 4 inodes that are not on disk */
+        uint8_t ir_count;
+        uint8_t ir_freecount;       /* the 4 bytes are a u32 freecount without sparse chunks */
+        uint8_t ir_free[8];         /* 1 bit per free inode */
+    } xfs_inobt_rec;
+
     typedef __uint16_t xfs_dir2_data_off_t;
     typedef __uint32_t xfs_dir2_dataptr_t;
     typedef __uint64_t xfs_ino_t;
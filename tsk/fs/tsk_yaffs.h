@@ -174,12 +174,17 @@ typedef enum {
     struct _YaffsCacheVersion;
     struct _YaffsCacheChunk;
 
+    /*
+     * The cache is stored in three flat arrays.  Chunks are sorted by
+     * object id, sequence number and offset, objects are sorted by object
+     * id, and the versions of an object are stored next to each other,
+     * oldest first.
+     */
     typedef struct _YaffsCacheObject {
-        struct _YaffsCacheObject *yco_next;
-
         uint32_t yco_obj_id;
 
-        struct _YaffsCacheVersion *yco_latest;
+        struct _YaffsCacheVersion *yco_first;   // oldest version
+        struct _YaffsCacheVersion *yco_latest;  // newest version
     } YaffsCacheObject;
 
 #define YAFFS_OBJECT_ID_MASK         0x0003ffff
@@ -187,8 +192,6 @@ typedef enum {
 #define YAFFS_VERSION_NUM_MASK       0x00003fff
 
     typedef struct _YaffsCacheVersion {
-        struct _YaffsCacheVersion *ycv_prior;
-
         uint32_t ycv_version;
         uint32_t ycv_seq_number;
 
@@ -198,22 +201,13 @@ typedef enum {
     } YaffsCacheVersion;
 
     typedef struct _YaffsCacheChunk {
-        struct _YaffsCacheChunk *ycc_next;
-        struct _YaffsCacheChunk *ycc_prev;
-
         TSK_OFF_T ycc_offset;
         uint32_t ycc_seq_number;
         uint32_t ycc_obj_id;
         uint32_t ycc_chunk_id;
         uint32_t ycc_parent_id;
-        uint32_t ycc_n_bytes;
     } YaffsCacheChunk;
 
-    typedef struct _YaffsCacheChunkGroup {
-        YaffsCacheChunk *cache_chunks_head;
-        YaffsCacheChunk *cache_chunks_tail;
-    } YaffsCacheChunkGroup;
-
     /*
      * Structure of an yaffsfs file system handle.
      */
@@ -235,7 +229,11 @@ typedef enum {
 
         tsk_lock_t cache_lock;
         YaffsCacheObject *cache_objects;
-         std::map < uint32_t, YaffsCacheChunkGroup > *chunkMap;
+        size_t cache_object_count;
+        YaffsCacheVersion *cache_versions;
+        size_t cache_version_count;
+        YaffsCacheChunk *cache_chunks;
+        size_t cache_chunk_count;
 
         // If the user specified that the image is YAFFS2, print out additional verbose error messages
         int autoDetect;
@@ -439,6 +439,11 @@ tsk_fs_unix_make_data_run(TSK_FS_FILE * fs_file)
         return 1;
     }
 
+    if (tsk_fs_attrlist_run_idx_build(fs_meta->attr)) {
+        fs_meta->attr_state = TSK_FS_META_ATTR_ERROR;
+        return 1;
+    }
+
     fs_meta->attr_state = TSK_FS_META_ATTR_STUDIED;
 
     return 0;
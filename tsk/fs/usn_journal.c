@@ -18,56 +18,77 @@
 #include "tsk_ntfs.h"
 
 
-/*
- * Search the next record in the buffer skipping null bytes.
- * Records are alway aligned at 8 bytes.
- * Returns the offset of the next record.
- */
-static TSK_OFF_T
-search_record(const unsigned char *buf, TSK_OFF_T offset, ssize_t bufsize)
-{
-    for ( ; offset < bufsize; offset++)
-        if (buf[offset] != '\0')
-            return offset - (offset % 8);
+/* Size of the pieces that the journal stream is read and decoded in */
+#define USNJ_CHUNK_SIZE (1024 * 1024)
 
-    return offset;
-}
+/* Records never legitimately exceed this size.  Each chunk buffer has this
+ * many extra bytes at the end so that a record that starts in the chunk can
+ * be decoded even if it ends in the next one. */
+#define USNJ_MAX_RECORD_LEN 4096
 
+/* Offset of the file name in a V2 record */
+#define USNJ_V2_NAME_OFF 60
 
-/*
- * Convert the record file name from UTF16 to UTF8.
- * Returns 0 on success, 1 otherwise
- */
-static uint8_t
-parse_fname(const unsigned char *buf, uint16_t nlen,
-            TSK_USN_RECORD_V2 *record, TSK_ENDIAN_ENUM endian)
-{
-    int ret = 0;
-    UTF8 *temp_name = NULL;
-    size_t src_len = (size_t) nlen, dst_len = (size_t) nlen * 2;
 
-    record->fname = tsk_malloc(dst_len + 1);
-    if (record->fname == NULL)
-        return 1;
+/* Byte range of the journal stream that is backed by real clusters */
+typedef struct {
+    TSK_OFF_T off;
+    TSK_OFF_T len;
+} USNJ_RANGE;
 
-    temp_name = (UTF8*)record->fname;
+/* A decoded record that is waiting to be passed to the callback */
+typedef struct {
+    TSK_USN_RECORD_HEADER header;
+    TSK_USN_RECORD_V2 record;
+    size_t name_off;            // offset of the name in USNJ_CHUNK.names
+} USNJ_ENTRY;
+
+/* One piece of the stream, read and decoded by a worker thread */
+typedef struct {
+    TSK_OFF_T off;              // offset of the chunk in the stream
+    size_t len;                 // bytes that belong to this chunk
+    size_t buf_len;             // bytes in buf (len plus the look-ahead)
+    unsigned char *buf;
+
+    USNJ_ENTRY *entries;
+    size_t entry_cnt;
+    size_t entry_alloc;
+    char *names;
+    size_t names_len;
+    size_t names_alloc;
+
+    TSK_OFF_T next;             // stream offset where the scan stopped
+    TSK_OFF_T bad_off;          // offset of an unsupported record, or -1
+    uint16_t bad_version;
+} USNJ_CHUNK;
+
+/* State shared by the workers of one batch of chunks */
+typedef struct {
+    const TSK_FS_ATTR *fs_attr;
+    TSK_ENDIAN_ENUM endian;
+    const TSK_FS_USNJ_FILTER *filter;
+    USNJ_CHUNK *chunks;
+} USNJ_BATCH;
 
-    ret = tsk_UTF16toUTF8(endian,
-                          (const UTF16**)&buf, (UTF16*)&buf[src_len],
-                          (UTF8**)&temp_name, (UTF8*)&temp_name[dst_len],
-                          TSKlenientConversion);
 
-    if (ret != TSKconversionOK) {
-        if (tsk_verbose)
-            tsk_fprintf(
-                stderr, "parse_v2_record: USN name to UTF8 conversion error.");
+/*
+ * Search the next record in the buffer skipping null bytes.
+ * Records are alway aligned at 8 bytes, so the buffer is checked
+ * a 64-bit word at a time.  offset must be a multiple of 8.
+ * Returns the offset of the next record.
+ */
+static size_t
+search_record(const unsigned char *buf, size_t offset, size_t bufsize)
+{
+    uint64_t word;
 
-        record->fname[0] = '\0';
+    for ( ; offset + 8 <= bufsize; offset += 8) {
+        memcpy(&word, &buf[offset], 8);
+        if (word != 0)
+            return offset;
     }
-    else
-        record->fname[dst_len] = '\0';
 
-    return 0;
+    return bufsize;
 }
 
 
@@ -82,15 +103,14 @@ parse_record_header(const unsigned char *buf, TSK_USN_RECORD_HEADER *header,
 
 
 /*
- * Parse a V 2.0 USN record.
- * Returns 0 on success, 1 otherwise
+ * Parse the fixed part of a V 2.0 USN record.  The name is converted
+ * separately so that it is skipped for records that are filtered out.
  */
-static uint8_t
-parse_v2_record(const unsigned char *buf, TSK_USN_RECORD_HEADER *header,
-                TSK_USN_RECORD_V2 *record, TSK_ENDIAN_ENUM endian)
+static void
+parse_v2_record(const unsigned char *buf, TSK_USN_RECORD_V2 *record,
+                TSK_ENDIAN_ENUM endian)
 {
     uint64_t timestamp = 0;
-    uint16_t name_offset = 0, name_length = 0;
 
     record->refnum = tsk_getu48(endian, &buf[8]);
     record->refnum_seq = tsk_getu16(endian, &buf[14]);
@@ -107,127 +127,426 @@ parse_v2_record(const unsigned char *buf, TSK_USN_RECORD_HEADER *header,
     record->source_info = tsk_getu32(endian, &buf[44]);
     record->security = tsk_getu32(endian, &buf[48]);
     record->attributes = tsk_getu32(endian, &buf[52]);
-
-    /* Extract file name */
-    name_length = tsk_getu16(endian, &buf[56]);
-    name_offset = tsk_getu16(endian, &buf[58]);
-
-    return parse_fname(&buf[name_offset], name_length, record, endian);
+    record->fname = NULL;
 }
 
 
 /*
- * Parse the UsnJrnl record.
- * Calls the action callback.
- * Returns TSK_WALK_CONT on success, TSK_WALK_ERROR on error.
+ * Returns 1 if the record passes the filter and 0 otherwise.
  */
-static TSK_WALK_RET_ENUM
-parse_record(const unsigned char *buf, TSK_USN_RECORD_HEADER *header,
-             TSK_ENDIAN_ENUM endian, TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
+static uint8_t
+filter_record(const TSK_FS_USNJ_FILTER *filter,
+              const TSK_USN_RECORD_V2 *record)
 {
-    TSK_WALK_RET_ENUM ret;
+    if (filter == NULL)
+        return 1;
 
-    switch (header->major_version) {
-    case 2: {
-        TSK_USN_RECORD_V2 record;
+    if ((filter->flags & TSK_FS_USNJ_FILTER_USN)
+        && ((record->usn < filter->usn_min)
+            || (record->usn > filter->usn_max)))
+        return 0;
 
-        ret = parse_v2_record(buf, header, &record, endian);
-        if (ret == 1)
-            return TSK_WALK_ERROR;
+    if ((filter->flags & TSK_FS_USNJ_FILTER_REASON)
+        && ((record->reason & filter->reason_mask) == 0))
+        return 0;
 
-        ret = (*action)(header, &record, ptr);
+    if ((filter->flags & TSK_FS_USNJ_FILTER_TIME)
+        && ((record->time_sec < filter->time_min)
+            || (record->time_sec > filter->time_max)))
+        return 0;
 
-        free(record.fname);
+    return 1;
+}
 
-        return ret;
-    }
-    case 3: {
-        if (tsk_verbose)
-            tsk_fprintf(stderr,
-                        "parse_record: USN records V 3 not supported yet.");
 
-        return TSK_WALK_CONT;
+/*
+ * Convert the record file name from UTF16 to UTF8 and store it in
+ * the name buffer of the chunk.
+ * Returns 0 on success, 1 otherwise
+ */
+static uint8_t
+parse_fname(USNJ_CHUNK *chunk, const unsigned char *buf, uint16_t nlen,
+            USNJ_ENTRY *entry, TSK_ENDIAN_ENUM endian)
+{
+    int ret = 0;
+    UTF8 *temp_name = NULL;
+    size_t src_len = (size_t) nlen, dst_len = (size_t) nlen * 2;
+
+    if (chunk->names_len + dst_len + 1 > chunk->names_alloc) {
+        size_t new_alloc = chunk->names_alloc * 2;
+        if (new_alloc < chunk->names_len + dst_len + 1)
+            new_alloc = chunk->names_len + dst_len + 1 + 4096;
+        if ((chunk->names = tsk_realloc(chunk->names, new_alloc)) == NULL)
+            return 1;
+        chunk->names_alloc = new_alloc;
     }
-    case 4: {
+
+    entry->name_off = chunk->names_len;
+    temp_name = (UTF8*)&chunk->names[chunk->names_len];
+
+    ret = tsk_UTF16toUTF8(endian,
+                          (const UTF16**)&buf, (UTF16*)&buf[src_len],
+                          (UTF8**)&temp_name,
+                          (UTF8*)&chunk->names[chunk->names_len + dst_len],
+                          TSKlenientConversion);
+
+    if (ret != TSKconversionOK) {
         if (tsk_verbose)
-            tsk_fprintf(stderr,
-                        "parse_record: USN records V 4 not supported yet.");
+            tsk_fprintf(
+                stderr, "parse_v2_record: USN name to UTF8 conversion error.");
 
-        return TSK_WALK_CONT;
+        chunk->names[chunk->names_len] = '\0';
+        chunk->names_len++;
     }
-    default: return TSK_WALK_ERROR;
+    else {
+        *temp_name = '\0';
+        chunk->names_len = (char *) temp_name - chunk->names + 1;
     }
+
+    return 0;
 }
 
 
 /*
- * Parse the UsnJrnl block buffer.
- *
- * Recover the record size from the header.
- *
- * If the record does not fit in the entire buffer, returns to the callee
- * its offset for alignment.
- *
- * If the buffer is big enough, parses the USN record.
- *
- * Returns -1 on error, 0 in case the action callback decided to stop,
- * a number greater than 0 if the buffer is not big enough.
+ * Decode the records of a chunk starting at the local offset a_start.
+ * Only records that start inside of the chunk are decoded.  An unsupported
+ * record version stops the scan and is recorded in bad_off so that the
+ * error is reported in stream order.
+ * Returns 0 on success, 1 on (memory) error
  */
-static int
-parse_buffer(const unsigned char *buf, ssize_t bufsize,
-             TSK_ENDIAN_ENUM endian, TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
+static uint8_t
+decode_chunk(USNJ_CHUNK *chunk, size_t a_start, TSK_ENDIAN_ENUM endian,
+             const TSK_FS_USNJ_FILTER *filter)
 {
-    TSK_OFF_T offset = 0;
-    TSK_WALK_RET_ENUM ret = 0;
+    size_t offset = a_start;
     TSK_USN_RECORD_HEADER header;
 
-    while ((offset = search_record(buf, offset, bufsize)) < bufsize) {
-        parse_record_header(&buf[offset], &header, endian);
+    chunk->entry_cnt = 0;
+    chunk->names_len = 0;
+    chunk->bad_off = -1;
+
+    while ((offset = search_record(chunk->buf, offset, chunk->len))
+           < chunk->len) {
+        USNJ_ENTRY *entry;
+        uint16_t name_length, name_offset;
+
+        parse_record_header(&chunk->buf[offset], &header, endian);
+
+        /* Garbage between records: keep scanning at the next slot */
+        if ((header.length < 8) || (header.length % 8)
+            || (header.length > USNJ_MAX_RECORD_LEN)) {
+            offset += 8;
+            continue;
+        }
+
+        /* The record is cut off by the end of the stream */
+        if (offset + header.length > chunk->buf_len)
+            break;
+
+        if (header.major_version == 3 || header.major_version == 4) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                            "parse_record: USN records V %d not supported yet.",
+                            header.major_version);
+            offset += header.length;
+            continue;
+        }
+        else if (header.major_version != 2) {
+            chunk->bad_off = chunk->off + offset;
+            chunk->bad_version = header.major_version;
+            break;
+        }
+
+        if (header.length < USNJ_V2_NAME_OFF) {
+            offset += 8;
+            continue;
+        }
+
+        if (chunk->entry_cnt == chunk->entry_alloc) {
+            size_t new_alloc = chunk->entry_alloc ? chunk->entry_alloc * 2 : 1024;
+            chunk->entries = tsk_realloc(chunk->entries,
+                                         new_alloc * sizeof(USNJ_ENTRY));
+            if (chunk->entries == NULL)
+                return 1;
+            chunk->entry_alloc = new_alloc;
+        }
+        entry = &chunk->entries[chunk->entry_cnt];
+        entry->header = header;
+        parse_v2_record(&chunk->buf[offset], &entry->record, endian);
+
+        if (filter_record(filter, &entry->record)) {
+            name_length = tsk_getu16(endian, &chunk->buf[offset + 56]);
+            name_offset = tsk_getu16(endian, &chunk->buf[offset + 58]);
+            if ((uint32_t) name_offset + name_length > header.length)
+                name_length = 0;
+
+            if (parse_fname(chunk, &chunk->buf[offset + name_offset],
+                            name_length, entry, endian))
+                return 1;
+            chunk->entry_cnt++;
+        }
 
-        /* The buffer does not contain the entire record */
-        if (offset + header.length > bufsize)
-            return bufsize - offset;
+        offset += header.length;
+    }
+
+    chunk->next = chunk->off + offset;
+    return 0;
+}
+
+
+/*
+ * Worker callback: read and decode one chunk of the batch.
+ */
+static uint8_t
+read_chunk_task(void *ptr, size_t idx)
+{
+    USNJ_BATCH *batch = (USNJ_BATCH *) ptr;
+    USNJ_CHUNK *chunk = &batch->chunks[idx];
+    ssize_t cnt;
+
+    cnt = tsk_fs_attr_read(batch->fs_attr, chunk->off, (char *) chunk->buf,
+                           chunk->len + USNJ_MAX_RECORD_LEN,
+                           TSK_FS_FILE_READ_FLAG_NONE);
+    if (cnt <= 0) {
+        chunk->len = 0;
+        chunk->buf_len = 0;
+    }
+    else {
+        chunk->buf_len = (size_t) cnt;
+        if (chunk->len > chunk->buf_len)
+            chunk->len = chunk->buf_len;
+    }
+
+    return decode_chunk(chunk, 0, batch->endian, batch->filter);
+}
+
+
+/*
+ * Build the list of byte ranges of the stream that need to be read.
+ * Sparse and filler runs only contain zeros and are skipped, as is
+ * anything outside of the USN range of the filter.
+ * Returns the number of ranges and -1 on error.
+ */
+static ssize_t
+load_ranges(NTFS_INFO * ntfs, const TSK_FS_ATTR *fs_attr,
+            const TSK_FS_USNJ_FILTER *filter, USNJ_RANGE **a_ranges)
+{
+    TSK_OFF_T start = 0, end = fs_attr->size;
+    USNJ_RANGE *ranges = NULL;
+    size_t cnt = 0, alloc = 0;
+    TSK_FS_ATTR_RUN *run;
+
+    if ((fs_attr->flags & TSK_FS_ATTR_NONRES) && (fs_attr->nrd.initsize < end))
+        end = fs_attr->nrd.initsize;
+
+    if (filter && (filter->flags & TSK_FS_USNJ_FILTER_USN)) {
+        /* Start at a page boundary, which is always a record boundary */
+        if ((uint64_t) start < filter->usn_min)
+            start = (TSK_OFF_T) (filter->usn_min & ~((uint64_t) USNJ_MAX_RECORD_LEN - 1));
+        if (filter->usn_max < (uint64_t) end)
+            end = (TSK_OFF_T) filter->usn_max + USNJ_MAX_RECORD_LEN;
+    }
+    if (start >= end) {
+        *a_ranges = NULL;
+        return 0;
+    }
 
-        ret = parse_record(&buf[offset], &header, endian, action, ptr);
-        if (ret == TSK_WALK_ERROR)
+    /* Resident streams and streams with compressed or encrypted data are
+     * read as a whole */
+    if (((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0)
+        || (fs_attr->flags & (TSK_FS_ATTR_COMP | TSK_FS_ATTR_ENC))) {
+        if ((ranges = tsk_malloc(sizeof(USNJ_RANGE))) == NULL)
             return -1;
-        else if (ret == TSK_WALK_STOP)
-            return 0;
+        ranges[0].off = start;
+        ranges[0].len = end - start;
+        *a_ranges = ranges;
+        return 1;
+    }
 
-        offset += header.length;
+    for (run = fs_attr->nrd.run; run != NULL; run = run->next) {
+        TSK_OFF_T roff = (TSK_OFF_T) run->offset * ntfs->fs_info.block_size;
+        TSK_OFF_T rend = roff + (TSK_OFF_T) run->len * ntfs->fs_info.block_size;
+
+        if (run->flags & (TSK_FS_ATTR_RUN_FLAG_SPARSE | TSK_FS_ATTR_RUN_FLAG_FILLER))
+            continue;
+        if (roff < start)
+            roff = start;
+        if (rend > end)
+            rend = end;
+        if (roff >= rend)
+            continue;
+
+        /* Merge with the previous range if they touch */
+        if (cnt && ranges[cnt - 1].off + ranges[cnt - 1].len == roff) {
+            ranges[cnt - 1].len += rend - roff;
+            continue;
+        }
+
+        if (cnt == alloc) {
+            alloc = alloc ? alloc * 2 : 32;
+            if ((ranges = tsk_realloc(ranges, alloc * sizeof(USNJ_RANGE))) == NULL)
+                return -1;
+        }
+        ranges[cnt].off = roff;
+        ranges[cnt].len = rend - roff;
+        cnt++;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr, "usn journal: %" PRIuSIZE
+                    " non-sparse ranges in stream of %" PRIdOFF " bytes\n",
+                    cnt, fs_attr->size);
+
+    *a_ranges = ranges;
+    return cnt;
+}
+
+
+/*
+ * Pass the decoded records of a chunk to the callback.
+ * Returns TSK_WALK_CONT, TSK_WALK_STOP or TSK_WALK_ERROR.
+ */
+static TSK_WALK_RET_ENUM
+deliver_chunk(USNJ_CHUNK *chunk, TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
+{
+    size_t i;
+    TSK_WALK_RET_ENUM ret;
+
+    for (i = 0; i < chunk->entry_cnt; i++) {
+        USNJ_ENTRY *entry = &chunk->entries[i];
+
+        entry->record.fname = &chunk->names[entry->name_off];
+        ret = (*action)(&entry->header, &entry->record, ptr);
+        if (ret != TSK_WALK_CONT)
+            return ret;
     }
 
-    return offset;
+    if (chunk->bad_off != -1) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr("usn journal: unsupported record version %"
+                             PRIu16 " at offset %" PRIdOFF,
+                             chunk->bad_version, chunk->bad_off);
+        return TSK_WALK_ERROR;
+    }
+
+    return TSK_WALK_CONT;
 }
 
 
 /*
  * Parse the UsnJrnl file.
- * Iterates through the file in blocks.
+ *
+ * The non-sparse parts of the stream are split in chunks that are
+ * read and decoded in batches by the worker threads.  The records
+ * are then passed to the callback in stream order.  If a record crosses
+ * the end of a chunk, the following chunk is decoded again starting
+ * at the end of that record.
+ *
  * Returns 0 on success, 1 otherwise
  */
 static uint8_t
-parse_file(NTFS_INFO * ntfs, unsigned char *buf,
+parse_file(NTFS_INFO * ntfs, const TSK_FS_ATTR *fs_attr,
+           const TSK_FS_USNJ_FILTER *filter,
            TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
 {
-    ssize_t size = 0;
-    TSK_OFF_T offset = 0, ret = 0;
-
-    while ((size = tsk_fs_file_read(ntfs->usnjinfo->fs_file, offset,
-                                    (char*)buf, ntfs->usnjinfo->bsize,
-                                    TSK_FS_FILE_READ_FLAG_NONE)) > 0)
-    {
-        ret = parse_buffer(buf, size, ntfs->fs_info.endian, action, ptr);
-
-        if (ret < 0)
-            return 1;
-        else if (ret == 0)
-            return 0;
+    USNJ_RANGE *ranges = NULL;
+    ssize_t range_cnt;
+    size_t range_idx = 0, batch_size, i;
+    TSK_OFF_T range_pos = 0, prev_next = 0;
+    USNJ_BATCH batch;
+    uint8_t retval = 0;
+
+    range_cnt = load_ranges(ntfs, fs_attr, filter, &ranges);
+    if (range_cnt < 0)
+        return 1;
+    if (range_cnt == 0)
+        return 0;
+
+    batch_size = tsk_parallel_get_threads() * 2;
+    batch.fs_attr = fs_attr;
+    batch.endian = ntfs->fs_info.endian;
+    batch.filter = filter;
+    batch.chunks = tsk_malloc(batch_size * sizeof(USNJ_CHUNK));
+    if (batch.chunks == NULL) {
+        free(ranges);
+        return 1;
+    }
+    for (i = 0; i < batch_size; i++) {
+        batch.chunks[i].buf = tsk_malloc(USNJ_CHUNK_SIZE + USNJ_MAX_RECORD_LEN);
+        if (batch.chunks[i].buf == NULL) {
+            retval = 1;
+            goto done;
+        }
+    }
 
-        offset += ret;
+    range_pos = ranges[0].off;
+    while (range_idx < (size_t) range_cnt) {
+        size_t chunk_cnt = 0;
+
+        /* Lay out the next batch of chunks */
+        while ((chunk_cnt < batch_size) && (range_idx < (size_t) range_cnt)) {
+            USNJ_CHUNK *chunk = &batch.chunks[chunk_cnt++];
+            TSK_OFF_T range_end = ranges[range_idx].off + ranges[range_idx].len;
+
+            chunk->off = range_pos;
+            chunk->len = USNJ_CHUNK_SIZE;
+            if (chunk->off + (TSK_OFF_T) chunk->len > range_end)
+                chunk->len = (size_t) (range_end - chunk->off);
+
+            range_pos += chunk->len;
+            if (range_pos >= range_end) {
+                range_idx++;
+                if (range_idx < (size_t) range_cnt)
+                    range_pos = ranges[range_idx].off;
+            }
+        }
+
+        if (tsk_parallel_for(chunk_cnt, read_chunk_task, &batch)) {
+            retval = 1;
+            goto done;
+        }
+
+        for (i = 0; i < chunk_cnt; i++) {
+            USNJ_CHUNK *chunk = &batch.chunks[i];
+            TSK_WALK_RET_ENUM ret;
+
+            /* The previous record ran into this chunk, so the worker
+             * started decoding in the middle of a record */
+            if (prev_next > chunk->off) {
+                if (prev_next >= chunk->off + (TSK_OFF_T) chunk->len) {
+                    chunk->entry_cnt = 0;
+                    chunk->bad_off = -1;
+                    continue;
+                }
+                if (decode_chunk(chunk, (size_t) (prev_next - chunk->off),
+                                 batch.endian, filter)) {
+                    retval = 1;
+                    goto done;
+                }
+            }
+            prev_next = chunk->next;
+
+            ret = deliver_chunk(chunk, action, ptr);
+            if (ret == TSK_WALK_ERROR) {
+                retval = 1;
+                goto done;
+            }
+            else if (ret == TSK_WALK_STOP) {
+                goto done;
+            }
+        }
     }
 
-    return 0;
+  done:
+    for (i = 0; i < batch_size; i++) {
+        free(batch.chunks[i].buf);
+        free(batch.chunks[i].entries);
+        free(batch.chunks[i].names);
+    }
+    free(batch.chunks);
+    free(ranges);
+    return retval;
 }
 
 
@@ -291,9 +610,34 @@ tsk_ntfs_usnjopen(TSK_FS_INFO *fs, TSK_INUM_T inum)
 uint8_t
 tsk_ntfs_usnjentry_walk(TSK_FS_INFO *fs, TSK_FS_USNJENTRY_WALK_CB action,
                         void *ptr)
+{
+    return tsk_ntfs_usnjentry_walk_filter(fs, NULL, action, ptr);
+}
+
+
+/**
+ * Walk through the Update Sequence Number journal file
+ * opened with ntfs_usnjopen and call the callback for the records
+ * that pass the filter.
+ *
+ * Sparse parts of the $J stream are not read and the USN range of the
+ * filter limits the part of the stream that is read.  The records are
+ * decoded on multiple threads, but the callback is always called from
+ * the calling thread and in journal order.
+ *
+ * @param ntfs File system where the journal is stored
+ * @param filter conditions the records must meet (or NULL for all records)
+ * @param action action to be called per each USN entry
+ * @param ptr pointer to data passed to the action callback
+ * @returns 0 on success, 1 otherwise
+ */
+uint8_t
+tsk_ntfs_usnjentry_walk_filter(TSK_FS_INFO *fs,
+                               const TSK_FS_USNJ_FILTER *filter,
+                               TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
 {
     uint8_t ret = 0;
-    unsigned char *buf = NULL;
+    const TSK_FS_ATTR *fs_attr = NULL;
     NTFS_INFO *ntfs = (NTFS_INFO*)fs;
 
     tsk_error_reset();
@@ -310,15 +654,25 @@ tsk_ntfs_usnjentry_walk(TSK_FS_INFO *fs, TSK_FS_USNJENTRY_WALK_CB action,
         return 1;
     }
 
-    buf = tsk_malloc(ntfs->usnjinfo->bsize);
-    if (buf == NULL)
-        return 1;
+    /* The records are in the $J stream, use the default stream if the
+     * file does not have one (i.e. a custom inode was given) */
+    if (ntfs->usnjinfo->fs_file->meta != NULL)
+        fs_attr = tsk_fs_attrlist_get_name_type(
+            ntfs->usnjinfo->fs_file->meta->attr, TSK_FS_ATTR_TYPE_NTFS_DATA,
+            "$J");
+    if (fs_attr == NULL) {
+        tsk_error_reset();
+        fs_attr = tsk_fs_file_attr_get(ntfs->usnjinfo->fs_file);
+    }
 
-    ret = parse_file(ntfs, buf, action, ptr);
+    if (fs_attr == NULL)
+        ret = 1;
+    else
+        ret = parse_file(ntfs, fs_attr, filter, action, ptr);
 
     tsk_fs_file_close(ntfs->usnjinfo->fs_file);
     free(ntfs->usnjinfo);
-    free(buf);
+    ntfs->usnjinfo = NULL;
 
     return ret;
 }
@@ -308,9 +308,10 @@ print_usnjent_act(TSK_USN_RECORD_HEADER *a_header, void *a_record, void *a_ptr)
 }
 
 
-/* Returns 0 on success and 1 on error */
+/* Returns 0 on success and 1 on error.  filter can be NULL to list all records. */
 uint8_t
-tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags)
+tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags,
+              const TSK_FS_USNJ_FILTER * filter)
 {
     uint8_t ret = 0;
 
@@ -326,5 +327,6 @@ tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags)
     if (ret == 1)
         return 1;
 
-    return tsk_ntfs_usnjentry_walk(fs, print_usnjent_act, &flags);
+    return tsk_ntfs_usnjentry_walk_filter(fs, filter, print_usnjent_act,
+                                          &flags);
 }
@@ -5,6 +5,34 @@
 #define xfs_cgbase_lcl(fsi, fs, c)	\
 	tsk_getu32(fsi->endian, fs->sb_agblocks)*c
 
+/* xfs_agblock_off - byte offset of a block of an allocation group
+ */
+static TSK_OFF_T
+xfs_agblock_off(XFS_INFO * xfs, uint32_t agno, uint32_t agbno)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & xfs->fs_info;
+
+    return (TSK_OFF_T) (((uint64_t) agno *
+            tsk_getu32(fs->endian, xfs->fs->sb_agblocks) + agbno) *
+        fs->block_size);
+}
+
+/* xfs_inode_off - byte offset of an inode.  Inode numbers are made of
+ * the AG number, the block in the AG and the inode in the block.
+ */
+static TSK_OFF_T
+xfs_inode_off(XFS_INFO * xfs, TSK_INUM_T inum)
+{
+    xfs_sb *sb = xfs->fs;
+    uint32_t agno = (uint32_t) (inum >> (sb->sb_agblklog + sb->sb_inopblog));
+    uint32_t agbno = (uint32_t) ((inum >> sb->sb_inopblog) &
+        (((uint64_t) 1 << sb->sb_agblklog) - 1));
+    uint32_t off = (uint32_t) (inum & (((uint64_t) 1 << sb->sb_inopblog) - 1));
+
+    return xfs_agblock_off(xfs, agno, agbno) +
+        (TSK_OFF_T) off * xfs->inode_size;
+}
+
 /** \internal
  * Add the data runs and extents to the file attributes.
  *
@@ -172,7 +200,6 @@ xfs_dinode_copy(XFS_INFO * xfs, TSK_FS_META * fs_meta,
     }
 
     TSK_OFF_T addr;
-    ssize_t cnt;
     xfs_dinode_core *dino_core_buf = &(dino_buf->di_core);
 
     uint16_t inodesize = tsk_getu16(fs->endian, xfs->fs->sb_inodesize);
@@ -182,7 +209,7 @@ xfs_dinode_copy(XFS_INFO * xfs, TSK_FS_META * fs_meta,
     // todo b tree ~~  
     if (dino_core_buf->di_format == 0x1) { // short form
         fs_meta->inode_format = 0x1;
-        addr = tsk_getu64(fs->endian, dino_core_buf->di_ino) * inodesize + sizeof(xfs_dinode_core);
+        addr = xfs_inode_off(xfs, inum) + sizeof(xfs_dinode_core);
         TSK_DADDR_T *addr_ptr;
         // fs_meta->content_type = TSK_FS_META_CONTENT_TYPE_EXT4_EXTENTS;
         /* NOTE TSK_DADDR_T != uint32_t, so lets make sure we use uint32_t */
@@ -192,54 +219,35 @@ xfs_dinode_copy(XFS_INFO * xfs, TSK_FS_META * fs_meta,
     else if (dino_core_buf->di_format == 0x2) {  // extent
         // extent list
         fs_meta->inode_format = 0x2;
-        xfs_bmbt_rec_32_t *di_bmx;
-        addr = tsk_getu64(fs->endian, dino_core_buf->di_ino) * inodesize + sizeof(xfs_dinode_core);
+        const uint8_t *di_fork = (const uint8_t *) dino_buf + sizeof(xfs_dinode_core);
+        uint32_t nextents = tsk_getu32(fs->endian, dino_core_buf->di_nextents);
+        uint32_t agblklog = xfs->fs->sb_agblklog;
         TSK_DADDR_T *addr_ptr;
         addr_ptr = (TSK_DADDR_T *) fs_meta->content_ptr;
-        for (int i = 0; i < tsk_getu32(fs->endian, dino_core_buf->di_nextents); i++) {
-            di_bmx = &(dino_buf->di_u.di_bmx[i]);
-            cnt = tsk_fs_read(fs, addr, (char *) di_bmx, sizeof(xfs_bmbt_rec_32_t));
-            if (cnt != sizeof(xfs_bmbt_rec_32_t)) {
-                if (cnt >= 0) {
-                    tsk_error_reset();
-                    tsk_error_set_errno(TSK_ERR_FS_READ);
-                }
-                tsk_error_set_errstr2("xfs_dinode_load: Inode %" PRIuINUM
-                    " from %" PRIuOFF, inum, addr);
-                return 1;
-            }
 
-            uint64_t space[7];
-            space[0] = tsk_getu32(fs->endian, di_bmx->l0) >> 31;
-            space[1] = tsk_getu32(fs->endian, di_bmx->l0) & ((1 << 32) - 1);
-            space[3] = tsk_getu32(fs->endian, di_bmx->l1) & ((1 << 10) - 1);
-            space[4] = tsk_getu32(fs->endian, di_bmx->l2);
-            space[5] = tsk_getu32(fs->endian, di_bmx->l3) >> 21;
-            space[6] = tsk_getu32(fs->endian, di_bmx->l3) & ((1 << 21) - 1);
-            
-            uint64_t starting = (space[3] << 43) + 
-                                (space[4] << 11) +
-                                (space[5]);
-
-            addr = ((starting >> xfs->fs->sb_agblklog) & xfs->fs->sb_inopblog)
-                     * tsk_getu32(fs->endian, xfs->fs->sb_agblocks);
-            addr += (starting & ((1 << xfs->fs->sb_agblklog) - 1))
-                    * tsk_getu32(fs->endian, xfs->fs->sb_blocksize);
-            
+        /* The extents are in the data fork, which was loaded with the
+         * rest of the inode */
+        if (inodesize <= sizeof(xfs_dinode_core))
+            nextents = 0;
+        else if (nextents > (inodesize - sizeof(xfs_dinode_core)) / sizeof(xfs_bmbt_rec_32_t))
+            nextents = (inodesize - sizeof(xfs_dinode_core)) / sizeof(xfs_bmbt_rec_32_t);
+        if (nextents > XFS_FILE_CONTENT_LEN / sizeof(TSK_DADDR_T))
+            nextents = XFS_FILE_CONTENT_LEN / sizeof(TSK_DADDR_T);
+
+        for (uint32_t i = 0; i < nextents; i++) {
+            const xfs_bmbt_rec_32_t *di_bmx =
+                (const xfs_bmbt_rec_32_t *) &di_fork[i * sizeof(xfs_bmbt_rec_32_t)];
+
+            // start block is bits 21-72 of the 128-bit record
+            uint64_t starting =
+                ((uint64_t) (tsk_getu32(fs->endian, di_bmx->l1) & 0x1ff) << 43) +
+                ((uint64_t) tsk_getu32(fs->endian, di_bmx->l2) << 11) +
+                (tsk_getu32(fs->endian, di_bmx->l3) >> 21);
+
+            addr = xfs_agblock_off(xfs, (uint32_t) (starting >> agblklog),
+                (uint32_t) (starting & (((uint64_t) 1 << agblklog) - 1)));
             addr += 0x40; // header length
 
-            uint64_t inode;
-            uint8_t namelen;
-            char* name = tsk_malloc(XFS_MAXNAMLEN);
-            uint8_t ftype;
-            uint8_t start[2];
-            
-            char* buf = tsk_malloc(tsk_getu32(fs->endian, xfs->fs->sb_blocksize));
-            cnt = tsk_fs_read(fs, addr, (char *) buf, space[6] * tsk_getu32(fs->endian, xfs->fs->sb_blocksize));
-            int idx = 0;
-            inode = &(buf[idx]);
-            
-
             addr_ptr[i] = addr; // directory entry addrs
         }
     }
@@ -288,17 +296,10 @@ xfs_dinode_load(XFS_INFO * xfs, TSK_INUM_T dino_inum,
     }                                                                    /*      * Look up the group descriptor for this inode.      */
     tsk_take_lock(&xfs->lock);
 
-    // uint64_t root_ino = tsk_getu64(fs->endian, xfs->fs->sb_rootino);
-    uint16_t inodesize = tsk_getu16(fs->endian, xfs->fs->sb_inodesize);
-    //addr = tsk_getu64(fs->endian, xfs->fs->sb_rootino) * tsk_getu16(fs->endian, xfs->fs->sb_inodesize);
-    //addr = dino_inum * inodesize;
-
-    addr += (dino_inum >> xfs->fs->sb_inopblog) & ((1 << xfs->fs->sb_agblklog) - 1) + 
-        (dino_inum >> (xfs->fs->sb_agblklog + xfs->fs->sb_inopblog)) * (tsk_getu32(fs->endian, xfs->fs->sb_blocksize) * tsk_getu32(fs->endian, xfs->fs->sb_agblocks));
-    addr *= tsk_getu32(fs->endian, xfs->fs->sb_blocksize);
-    addr += (dino_inum & 7) * tsk_getu16(fs->endian, xfs->fs->sb_sectsize);
-    cnt = tsk_fs_read(fs, addr, (char *)dino_core_buf, sizeof(xfs_dinode_core));
-    if (cnt != sizeof(xfs_dinode_core)) {
+    addr = xfs_inode_off(xfs, dino_inum);
+    cnt = tsk_fs_read(fs, addr, (char *)dino_core_buf, xfs->inode_size);
+    if (cnt != xfs->inode_size) {
+        tsk_release_lock(&xfs->lock);
         if (cnt >= 0) {
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_FS_READ);
@@ -312,7 +313,273 @@ xfs_dinode_load(XFS_INFO * xfs, TSK_INUM_T dino_inum,
 
     return 0;
 }
+
+/* An allocated chunk of XFS_INODES_PER_CHUNK inodes from the inode B+tree */
+typedef struct {
+    TSK_INUM_T startino;        /* first inode of the chunk */
+    uint64_t free;              /* bit i is set if inode startino + i is free */
+    uint64_t holes;             /* bit i is set if inode startino + i is not on disk */
+} XFS_INO_CHUNK;
+
+/* The inode chunks of one allocation group */
+typedef struct {
+    XFS_INO_CHUNK *chunks;      /* sorted by startino */
+    size_t cnt;
+    uint8_t failed;             /* set if the inode B+tree could not be read */
+    TSK_ERROR_INFO error;       /* error of the failed load */
+} XFS_AG_CHUNKS;
+
+typedef struct {
+    XFS_INFO *xfs;
+    XFS_AG_CHUNKS *ags;
+} XFS_INOBT_LOAD;
+
+/* A batch of inode chunks that are read by tsk_parallel_for() */
+typedef struct {
+    XFS_INFO *xfs;
+    XFS_INO_CHUNK *chunks;      /* first chunk of the batch */
+    char *bufs;                 /* XFS_INODES_PER_CHUNK inodes per chunk */
+    uint8_t *failed;            /* set for each chunk that could not be read */
+    TSK_ERROR_INFO *errors;     /* error of each chunk that failed */
+} XFS_INO_BATCH;
+
+/* xfs_inobt_load - collect the allocated inode chunks of an AG by
+ * walking the leaves of its inode B+tree
+ *
+ * returns 1 on error and 0 on success
+ * */
+static uint8_t
+xfs_inobt_load(XFS_INFO * xfs, uint32_t agno, XFS_AG_CHUNKS * ag)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & xfs->fs_info;
+    xfs_sb *sb = xfs->fs;
+    uint32_t agblocks = tsk_getu32(fs->endian, sb->sb_agblocks);
+    uint8_t sparse = 0;
+    xfs_agi agi;
+    TSK_OFF_T addr;
+    ssize_t cnt;
+    char *blk;
+    size_t alloc = 0;
+    uint32_t agbno, level, nblocks = 0;
+
+    if (((tsk_getu16(fs->endian, sb->sb_versionnum) & 0xf) == 5) &&
+        (tsk_getu32(fs->endian, sb->sb_features_incmpt) &
+            XFS_SB_FEAT_INCOMPAT_SPINODES))
+        sparse = 1;
+
+    addr = xfs_agblock_off(xfs, agno, 0) +
+        XFS_AGI_SECT * tsk_getu16(fs->endian, sb->sb_sectsize);
+    cnt = tsk_fs_read(fs, addr, (char *) &agi, sizeof(agi));
+    if (cnt != sizeof(agi)) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("xfs_inobt_load: AGI of AG %" PRIu32, agno);
+        return 1;
+    }
+    if (tsk_getu32(fs->endian, agi.agi_magicnum) != XFS_AGI_MAGIC) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr("xfs_inobt_load: invalid AGI magic in AG %"
+            PRIu32, agno);
+        return 1;
+    }
+
+    if ((blk = (char *) tsk_malloc(fs->block_size)) == NULL)
+        return 1;
+
+    agbno = tsk_getu32(fs->endian, agi.agi_root);
+    level = tsk_getu32(fs->endian, agi.agi_level);
+    if (level == 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr("xfs_inobt_load: invalid inode B+tree level in AG %"
+            PRIu32, agno);
+        free(blk);
+        return 1;
+    }
+
+    /* Go down the left edge of the tree to the first leaf and then
+     * follow the sibling pointers through the leaves */
+    while (agbno != XFS_NULLAGBLOCK) {
+        xfs_btree_sblock *hdr = (xfs_btree_sblock *) blk;
+        size_t hdr_len;
+        uint16_t numrecs;
+        uint32_t magic;
+
+        if ((agbno >= agblocks) || (++nblocks > agblocks)) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+            tsk_error_set_errstr("xfs_inobt_load: invalid inode B+tree block %"
+                PRIu32 " in AG %" PRIu32, agbno, agno);
+            free(blk);
+            return 1;
+        }
+
+        addr = xfs_agblock_off(xfs, agno, agbno);
+        cnt = tsk_fs_read(fs, addr, blk, fs->block_size);
+        if (cnt != fs->block_size) {
+            if (cnt >= 0) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_READ);
+            }
+            tsk_error_set_errstr2("xfs_inobt_load: inode B+tree block %"
+                PRIu32 " in AG %" PRIu32, agbno, agno);
+            free(blk);
+            return 1;
+        }
+
+        magic = tsk_getu32(fs->endian, hdr->bb_magic);
+        if (magic == XFS_IBT_CRC_MAGIC)
+            hdr_len = sizeof(xfs_btree_sblock_crc);
+        else if (magic == XFS_IBT_MAGIC)
+            hdr_len = sizeof(xfs_btree_sblock);
+        else
+            hdr_len = 0;
+        numrecs = tsk_getu16(fs->endian, hdr->bb_numrecs);
+
+        if ((hdr_len == 0) ||
+            (tsk_getu16(fs->endian, hdr->bb_level) != level - 1)) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+            tsk_error_set_errstr("xfs_inobt_load: invalid inode B+tree block %"
+                PRIu32 " in AG %" PRIu32, agbno, agno);
+            free(blk);
+            return 1;
+        }
+
+        if (level > 1) {
+            /* Node: the keys are followed by the pointers, which start
+             * after room for the maximum number of keys */
+            size_t maxrecs = (fs->block_size - hdr_len) / 8;
+            if ((numrecs == 0) || (numrecs > maxrecs)) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+                tsk_error_set_errstr("xfs_inobt_load: invalid record count in inode B+tree block %"
+                    PRIu32 " in AG %" PRIu32, agbno, agno);
+                free(blk);
+                return 1;
+            }
+            agbno = tsk_getu32(fs->endian, &blk[hdr_len + maxrecs * 4]);
+            level--;
+            nblocks = 0;
+            continue;
+        }
+
+        /* Leaf */
+        if (numrecs > (fs->block_size - hdr_len) / sizeof(xfs_inobt_rec)) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+            tsk_error_set_errstr("xfs_inobt_load: invalid record count in inode B+tree block %"
+                PRIu32 " in AG %" PRIu32, agbno, agno);
+            free(blk);
+            return 1;
+        }
+
+        for (uint16_t i = 0; i < numrecs; i++) {
+            xfs_inobt_rec *rec =
+                (xfs_inobt_rec *) &blk[hdr_len + i * sizeof(xfs_inobt_rec)];
+            XFS_INO_CHUNK *chunk;
+
+            if (ag->cnt == alloc) {
+                XFS_INO_CHUNK *tmp;
+                alloc = (alloc == 0) ? 64 : alloc * 2;
+                if ((tmp = (XFS_INO_CHUNK *) tsk_realloc(ag->chunks,
+                            alloc * sizeof(XFS_INO_CHUNK))) == NULL) {
+                    free(blk);
+                    return 1;
+                }
+                ag->chunks = tmp;
+            }
+
+            chunk = &ag->chunks[ag->cnt++];
+            chunk->startino = ((TSK_INUM_T) agno <<
+                (sb->sb_agblklog + sb->sb_inopblog)) |
+                tsk_getu32(fs->endian, rec->ir_startino);
+            chunk->free = tsk_getu64(fs->endian, rec->ir_free);
+            chunk->holes = 0;
+            if (sparse) {
+                uint16_t holemask = tsk_getu16(fs->endian, rec->ir_holemask);
+                for (int b = 0; b < 16; b++) {
+                    if (holemask & (1 << b))
+                        chunk->holes |= (uint64_t) 0xf <<
+                            (b * XFS_INODES_PER_HOLEMASK_BIT);
+                }
+            }
+        }
+
+        agbno = tsk_getu32(fs->endian, hdr->bb_rightsib);
+    }
+
+    free(blk);
+    return 0;
+}
+
+/**
+ * \internal
+ * tsk_parallel_for() task that loads the inode chunks of one AG.  A
+ * failure is recorded with the AG, so that the walk reports it only
+ * after the inodes of the AGs before it were passed to the callback.
+ */
+static uint8_t
+xfs_inobt_load_task(void *a_ptr, size_t a_idx)
+{
+    XFS_INOBT_LOAD *load = (XFS_INOBT_LOAD *) a_ptr;
+    XFS_AG_CHUNKS *ag = &load->ags[a_idx];
+
+    if (xfs_inobt_load(load->xfs, (uint32_t) a_idx, ag)) {
+        TSK_ERROR_INFO *info = tsk_error_get_info();
+        if (info != NULL)
+            memcpy(&ag->error, info, sizeof(TSK_ERROR_INFO));
+        tsk_error_reset();
+        ag->failed = 1;
+    }
+    return 0;
+}
+
+/**
+ * \internal
+ * tsk_parallel_for() task that reads the inodes of one chunk of a batch
+ * with a single read.
+ */
+static uint8_t
+xfs_ino_batch_task(void *a_ptr, size_t a_idx)
+{
+    XFS_INO_BATCH *batch = (XFS_INO_BATCH *) a_ptr;
+    XFS_INFO *xfs = batch->xfs;
+    size_t len = (size_t) XFS_INODES_PER_CHUNK * xfs->inode_size;
+    TSK_OFF_T addr = xfs_inode_off(xfs, batch->chunks[a_idx].startino);
+    ssize_t cnt;
+
+    cnt = tsk_fs_read(&xfs->fs_info, addr, &batch->bufs[a_idx * len], len);
+    if (cnt != (ssize_t) len) {
+        TSK_ERROR_INFO *info;
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("xfs_inode_walk: inode chunk %" PRIuINUM
+            " from %" PRIuOFF, batch->chunks[a_idx].startino, addr);
+        info = tsk_error_get_info();
+        if (info != NULL)
+            memcpy(&batch->errors[a_idx], info, sizeof(TSK_ERROR_INFO));
+        tsk_error_reset();
+        batch->failed[a_idx] = 1;
+    }
+    else {
+        batch->failed[a_idx] = 0;
+    }
+    return 0;
+}
+
 /* xfs_inode_walk - inode iterator
+ *
+ * Only the inodes in the chunks that the inode B+trees list are on disk,
+ * so the walk visits those instead of every possible inode number.  The
+ * B+trees of the AGs are loaded in parallel and the chunks are read in
+ * parallel batches of one read per chunk; the callback is called from
+ * this thread in inode order.
  *
  * flags used: TSK_FS_META_FLAG_USED, TSK_FS_META_FLAG_UNUSED,
  *  TSK_FS_META_FLAG_ALLOC, TSK_FS_META_FLAG_UNALLOC, TSK_FS_META_FLAG_ORPHAN
@@ -327,27 +594,240 @@ xfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 {
     char *myname = "xfs_inode_walk";
     XFS_INFO *xfs = (XFS_INFO *) fs;
-    TSK_INUM_T inum;
     TSK_INUM_T end_inum_tmp;
-    TSK_INUM_T ibase = 0;
-    TSK_FS_FILE *fs_file;
-    unsigned int myflags;
-    xfs_dinode_core *dino_buf = NULL;
-    unsigned int size = 0;
+    TSK_FS_FILE *fs_file = NULL;
+    uint32_t agcount = tsk_getu32(fs->endian, xfs->fs->sb_agcount);
+    size_t chunk_len = (size_t) XFS_INODES_PER_CHUNK * xfs->inode_size;
+    size_t batch_size = tsk_parallel_get_threads() * 2;
+    XFS_INOBT_LOAD load;
+    XFS_INO_BATCH batch;
+    uint8_t retval = 1;
+    uint32_t agno;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
 
+    /*
+     * Sanity checks.
+     */
+    if (start_inum < fs->first_inum || start_inum > fs->last_inum) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
+        tsk_error_set_errstr("%s: start inode: %" PRIuINUM "", myname,
+            start_inum);
+        return 1;
+    }
+
+    if (end_inum < fs->first_inum || end_inum > fs->last_inum
+        || end_inum < start_inum) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
+        tsk_error_set_errstr("%s: end inode: %" PRIuINUM "", myname,
+            end_inum);
+        return 1;
+    }
+
+    /* If ORPHAN is wanted, then make sure that the flags are correct */
+    if (flags & TSK_FS_META_FLAG_ORPHAN) {
+        flags |= TSK_FS_META_FLAG_UNALLOC;
+        flags &= ~TSK_FS_META_FLAG_ALLOC;
+        flags |= TSK_FS_META_FLAG_USED;
+        flags &= ~TSK_FS_META_FLAG_UNUSED;
+    }
+    else {
+        if (((flags & TSK_FS_META_FLAG_ALLOC) == 0) &&
+            ((flags & TSK_FS_META_FLAG_UNALLOC) == 0)) {
+            flags |= (TSK_FS_META_FLAG_ALLOC | TSK_FS_META_FLAG_UNALLOC);
+        }
+
+        /* If neither of the USED or UNUSED flags are set, then set them
+         * both
+         */
+        if (((flags & TSK_FS_META_FLAG_USED) == 0) &&
+            ((flags & TSK_FS_META_FLAG_UNUSED) == 0)) {
+            flags |= (TSK_FS_META_FLAG_USED | TSK_FS_META_FLAG_UNUSED);
+        }
+    }
+
+    /* If we are looking for orphan files and have not yet filled
+     * in the list of unalloc inodes that are pointed to, then fill
+     * in the list
+     */
+    if ((flags & TSK_FS_META_FLAG_ORPHAN)) {
+        if (tsk_fs_dir_load_inum_named(fs) != TSK_OK) {
+            tsk_error_errstr2_concat
+                ("- xfs_inode_walk: identifying inodes allocated by file names");
+            return 1;
+        }
+    }
+
+    // we need to handle fs->last_inum specially because it is for the
+    // virtual ORPHANS directory.  Handle it outside of the loop.
+    if (end_inum == TSK_FS_ORPHANDIR_INUM(fs))
+        end_inum_tmp = end_inum - 1;
+    else
+        end_inum_tmp = end_inum;
+
+    memset(&batch, 0, sizeof(batch));
+    load.xfs = xfs;
+    if ((load.ags = (XFS_AG_CHUNKS *) tsk_malloc(agcount *
+                sizeof(XFS_AG_CHUNKS))) == NULL)
+        return 1;
+
+    if ((fs_file = tsk_fs_file_alloc(fs)) == NULL)
+        goto on_exit;
+    if ((fs_file->meta =
+            tsk_fs_meta_alloc(XFS_FILE_CONTENT_LEN)) == NULL)
+        goto on_exit;
+
+    batch.xfs = xfs;
+    batch.bufs = (char *) tsk_malloc(batch_size * chunk_len);
+    batch.failed = (uint8_t *) tsk_malloc(batch_size);
+    batch.errors = (TSK_ERROR_INFO *) tsk_malloc(batch_size *
+        sizeof(TSK_ERROR_INFO));
+    if ((batch.bufs == NULL) || (batch.failed == NULL)
+        || (batch.errors == NULL))
+        goto on_exit;
+
+    tsk_parallel_for(agcount, xfs_inobt_load_task, &load);
+
+    /*
+     * Iterate.
+     */
+    for (agno = 0; agno < agcount; agno++) {
+        XFS_AG_CHUNKS *ag = &load.ags[agno];
+        size_t first = 0, last;
+
+        if (ag->failed) {
+            // report the error of the AG from this thread
+            if (tsk_error_get_info() != NULL)
+                memcpy(tsk_error_get_info(), &ag->error,
+                    sizeof(TSK_ERROR_INFO));
+            goto on_exit;
+        }
+
+        /* Skip the chunks outside of the range */
+        while ((first < ag->cnt) &&
+            (ag->chunks[first].startino + XFS_INODES_PER_CHUNK <= start_inum))
+            first++;
+        last = first;
+        while ((last < ag->cnt) && (ag->chunks[last].startino <= end_inum_tmp))
+            last++;
+
+        while (first < last) {
+            size_t batch_cnt = last - first;
+            size_t i;
+
+            if (batch_cnt > batch_size)
+                batch_cnt = batch_size;
+            batch.chunks = &ag->chunks[first];
+            tsk_parallel_for(batch_cnt, xfs_ino_batch_task, &batch);
+
+            for (i = 0; i < batch_cnt; i++) {
+                XFS_INO_CHUNK *chunk = &batch.chunks[i];
+                int idx;
+
+                if (batch.failed[i]) {
+                    if (tsk_error_get_info() != NULL)
+                        memcpy(tsk_error_get_info(), &batch.errors[i],
+                            sizeof(TSK_ERROR_INFO));
+                    goto on_exit;
+                }
+
+                for (idx = 0; idx < XFS_INODES_PER_CHUNK; idx++) {
+                    TSK_INUM_T inum = chunk->startino + idx;
+                    xfs_dinode *dino_buf =
+                        (xfs_dinode *) &batch.bufs[i * chunk_len +
+                        idx * xfs->inode_size];
+                    unsigned int myflags;
+                    int retval2;
+
+                    if ((inum < start_inum) || (inum > end_inum_tmp))
+                        continue;
+
+                    // inodes in holes of sparse chunks are not on disk
+                    if ((chunk->holes >> idx) & 1)
+                        continue;
+
+                    /*
+                     * Apply the allocated/unallocated restriction.
+                     */
+                    myflags = (((chunk->free >> idx) & 1) ?
+                        TSK_FS_META_FLAG_UNALLOC : TSK_FS_META_FLAG_ALLOC);
+                    if ((flags & myflags) != myflags)
+                        continue;
+
+                    /*
+                     * Apply the used/unused restriction.
+                     */
+                    myflags |= (tsk_getu32(fs->endian,
+                            dino_buf->di_core.di_ctime) ?
+                        TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+                    if ((flags & myflags) != myflags)
+                        continue;
+
+                    /* If we want only orphans, then check if this
+                     * inode is in the seen list
+                     */
+                    if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
+                        (flags & TSK_FS_META_FLAG_ORPHAN) &&
+                        (tsk_fs_dir_find_inum_named(fs, inum))) {
+                        continue;
+                    }
+
+                    /*
+                     * Fill in a file system-independent inode structure and pass control
+                     * to the application.
+                     */
+                    fs_file->meta->flags = (TSK_FS_META_FLAG_ENUM)
+                        (myflags & (TSK_FS_META_FLAG_ALLOC |
+                            TSK_FS_META_FLAG_UNALLOC));
+                    if (xfs_dinode_copy(xfs, fs_file->meta, inum, dino_buf))
+                        goto on_exit;
+
+                    retval2 = a_action(fs_file, a_ptr);
+                    if (retval2 == TSK_WALK_STOP) {
+                        retval = 0;
+                        goto on_exit;
+                    }
+                    else if (retval2 == TSK_WALK_ERROR) {
+                        goto on_exit;
+                    }
+                }
+            }
 
+            first += batch_cnt;
+        }
+    }
 
+    // handle the virtual orphans folder if they asked for it
+    if ((end_inum == TSK_FS_ORPHANDIR_INUM(fs))
+        && (flags & TSK_FS_META_FLAG_ALLOC)
+        && (flags & TSK_FS_META_FLAG_USED)) {
+        int retval2;
+
+        if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta))
+            goto on_exit;
+        /* call action */
+        retval2 = a_action(fs_file, a_ptr);
+        if (retval2 == TSK_WALK_ERROR)
+            goto on_exit;
+    }
+    retval = 0;
 
     /*
      * Cleanup.
      */
+  on_exit:
     tsk_fs_file_close(fs_file);
-    free(dino_buf);
-
-    return 0;
+    for (agno = 0; agno < agcount; agno++)
+        free(load.ags[agno].chunks);
+    free(load.ags);
+    free(batch.bufs);
+    free(batch.failed);
+    free(batch.errors);
+
+    return retval;
 }
 
 /* ext2fs_block_walk - block iterator
@@ -706,11 +1186,52 @@ xfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         return NULL;
     }
 
+    if ((tsk_getu32(fs->endian, xfs->fs->sb_agcount) == 0) ||
+        (tsk_getu32(fs->endian, xfs->fs->sb_agblocks) == 0) ||
+        (tsk_getu16(fs->endian, xfs->fs->sb_inopblock) == 0)) {
+        fs->tag = 0;
+        free(xfs->fs);
+        tsk_fs_free((TSK_FS_INFO *)xfs);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr("xfs_open: invalid AG geometry");
+        return NULL;
+    }
+
+    /* The logs are used as shift counts for inode numbers, so they must be
+     * in range and big enough to hold the AG size and inodes per block */
+    if ((xfs->fs->sb_agblklog > XFS_MAX_AGBLKLOG) ||
+        (xfs->fs->sb_inopblog > XFS_MAX_INOPBLOG) ||
+        (tsk_getu32(fs->endian, xfs->fs->sb_agblocks) >
+            ((uint64_t) 1 << xfs->fs->sb_agblklog)) ||
+        (tsk_getu16(fs->endian, xfs->fs->sb_inopblock) >
+            (1 << xfs->fs->sb_inopblog))) {
+        fs->tag = 0;
+        free(xfs->fs);
+        tsk_fs_free((TSK_FS_INFO *)xfs);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+        tsk_error_set_errstr("xfs_open: invalid AG block or inode per block log (%"
+            PRIu8 ", %" PRIu8 ")", xfs->fs->sb_agblklog,
+            xfs->fs->sb_inopblog);
+        return NULL;
+    }
+
     /*
      * Calculate the meta data info
      */
-    fs->inum_count = tsk_getu64(fs->endian, xfs->fs->sb_icount) + 1;    // we are adding 1 in this calc to account for Orphans directory
-    fs->last_inum = fs->inum_count;
+    /* Inode numbers encode the AG, the block in the AG and the inode in
+     * the block, so they are sparse.  The last inode number is the one of
+     * the last inode slot of the last AG and the one after it is for the
+     * Orphans directory. */
+    fs->last_inum = (((TSK_INUM_T) tsk_getu32(fs->endian,
+                xfs->fs->sb_agcount) - 1) <<
+        (xfs->fs->sb_agblklog + xfs->fs->sb_inopblog)) |
+        (((TSK_INUM_T) tsk_getu32(fs->endian,
+                xfs->fs->sb_agblocks) - 1) << xfs->fs->sb_inopblog) |
+        (tsk_getu16(fs->endian, xfs->fs->sb_inopblock) - 1);
+    fs->last_inum++;
+    fs->inum_count = fs->last_inum + 1;
     fs->first_inum = XFS_FIRSTINO;
     fs->root_inum = tsk_getu64(fs->endian, xfs->fs->sb_rootino);
 
@@ -819,4 +1340,4 @@ xfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     tsk_init_lock(&xfs->lock);
 
     return (fs);
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -8,7 +8,7 @@ xfs_fs_file_read(TSK_FS_FILE * a_fs_file,
     TSK_OFF_T a_offset, char *a_buf, size_t a_len,
     TSK_FS_FILE_READ_FLAG_ENUM a_flags){
 
-    ssize_t cnt;
+    ssize_t cnt = -1;
     XFS_INFO* xfs = (XFS_INFO *) a_fs_file->fs_info;
     TSK_FS_INFO *fs = a_fs_file->fs_info;
     int format = a_fs_file->meta->inode_format;
@@ -23,9 +23,19 @@ xfs_fs_file_read(TSK_FS_FILE * a_fs_file,
         cnt = tsk_fs_read(fs, start_addr, (char *) a_buf, size);
     } else if (format == 0x2) {// extent
         size = tsk_getu32(fs->endian, xfs->fs->sb_blocksize) * (2 << xfs->fs->sb_dirblklog);
-        cnt = tsk_fs_read(fs, start_addr, (char *) a_buf, size);
+    } else {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_UNSUPFUNC);
+        tsk_error_set_errstr("xfs_fs_file_read: unsupported inode format %d",
+            format);
+        return -1;
     }
 
+    // never read past the caller's buffer
+    if (size > a_len)
+        size = a_len;
+    cnt = tsk_fs_read(fs, start_addr, (char *) a_buf, size);
+
     return cnt;
 }
 
@@ -118,12 +128,32 @@ xfs_dent_parse_block(XFS_INFO * xfs, TSK_FS_DIR * a_fs_dir,
         hdr = (xfs_dir2_sf_hdr_t*)dirPtr;
         idx += sizeof(xfs_dir2_sf_hdr_t) - 4;
     }
+    else {
+        // only short form directories are parsed so far
+        tsk_fs_name_free(fs_name);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_UNSUPFUNC);
+        tsk_error_set_errstr("xfs_dent_parse_block: unsupported directory format %d",
+            fs_file->meta->inode_format);
+        return TSK_COR;
+    }
 
     xfs_dir2_sf_entry_t *sf_entry;
     char name[XFS_MAXNAMLEN];
     for (int i = 0; i < hdr->count; i++) {
         dirPtr = &buf[idx];
-        
+
+        // stop at an entry that does not fit in the buffer
+        if ((idx + 4 > len) ||
+            (idx + 4 + ((uint8_t *) buf)[idx] + sizeof(xfs_dir2_inou_t) > (size_t) len)) {
+            tsk_fs_name_free(fs_name);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+            tsk_error_set_errstr("xfs_dent_parse_block: entry %d goes past the end of the directory",
+                i);
+            return TSK_COR;
+        }
+
         sf_entry = (xfs_dir2_sf_entry_t *)dirPtr;
         uint16_t offset = tsk_getu16(fs->endian, sf_entry->offset);
 
@@ -246,11 +276,15 @@ xfs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
     while (size > 0) {
         ssize_t len = (a_fs->block_size < size) ? a_fs->block_size : size;
         ssize_t cnt = xfs_fs_file_read(fs_dir->fs_file, offset, dirbuf, len, (TSK_FS_FILE_READ_FLAG_ENUM)0);
+        if (cnt < 0) {
+            retval_final = TSK_COR;
+            break;
+        }
         retval_tmp =
             xfs_dent_parse_block(xfs, fs_dir,
             (fs_dir->fs_file->meta->
                 flags & TSK_FS_META_FLAG_UNALLOC) ? 1 : 0, &list_seen,
-            dirbuf, len);
+            dirbuf, (int) cnt);
 
         if (retval_tmp == TSK_ERR) {
             retval_final = TSK_ERR;
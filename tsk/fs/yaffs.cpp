@@ -112,101 +112,35 @@ static TSK_RETVAL_ENUM
 
         return TSK_OK;
 }
-
 /*
 * Order it like yaffs2.git does -- sort by (seq_num, offset/block)
 */
-static int
-    yaffscache_chunk_compare(YaffsCacheChunk *curr, uint32_t addee_obj_id, TSK_OFF_T addee_offset, uint32_t addee_seq_number)
+static bool
+    yaffscache_chunk_less(const YaffsCacheChunk &a, const YaffsCacheChunk &b)
 {
-    if (curr->ycc_obj_id == addee_obj_id) {
-        if (curr->ycc_seq_number == addee_seq_number) {
-            if (curr->ycc_offset == addee_offset) {
-                return 0;
-            }
-            else if (curr->ycc_offset < addee_offset) {
-                return -1;
-            }
-            else {
-                return 1;
-            }
-        }
-        else if (curr->ycc_seq_number < addee_seq_number) {
-            return -1;
-        }
-        else {
-            return 1;
-        }
+    if (a.ycc_obj_id != b.ycc_obj_id) {
+        return a.ycc_obj_id < b.ycc_obj_id;
     }
-    else if (curr->ycc_obj_id < addee_obj_id) {
-        return -1;
+    else if (a.ycc_seq_number != b.ycc_seq_number) {
+        return a.ycc_seq_number < b.ycc_seq_number;
     }
     else {
-        return 1;
+        return a.ycc_offset < b.ycc_offset;
     }
 }
 
-static TSK_RETVAL_ENUM
-    yaffscache_chunk_find_insertion_point(YAFFSFS_INFO *yfs, uint32_t obj_id, TSK_OFF_T offset, uint32_t seq_number, YaffsCacheChunk **chunk)
-{
-    YaffsCacheChunk *curr, *prev;
-
-    // Have we seen this obj_id? If not, add an entry for it
-    if(yfs->chunkMap->find(obj_id) == yfs->chunkMap->end()){
-        fflush(stderr);
-        YaffsCacheChunkGroup chunkGroup;
-        chunkGroup.cache_chunks_head = NULL;
-        chunkGroup.cache_chunks_tail = NULL;
-        yfs->chunkMap->insert(std::make_pair(obj_id, chunkGroup));
-    }
-
-    curr = yfs->chunkMap->operator[](obj_id).cache_chunks_head;
-    prev = NULL;
-
-    if (chunk == NULL) {
-        return TSK_ERR;
-    }
-
-    while(curr != NULL) {
-        // Compares obj id, then seq num, then offset. -1 => current < new
-        int cmp = yaffscache_chunk_compare(curr, obj_id, offset, seq_number);
-
-        if (cmp == 0) {
-            *chunk = curr;
-            return TSK_OK;
-        }
-        else if (cmp == 1) {
-            *chunk = prev;
-            return TSK_STOP;
-        }
-
-        prev = curr;
-        curr = curr->ycc_next;
-    }
-
-    *chunk = prev;
-    return TSK_STOP;
-}
-
 /**
- * Add a chunk to the cache. 
- * @param yfs
+ * Fill in a chunk record for the cache.
+ * @param chunk Record to fill in
  * @param offset Byte offset this chunk was found in (in the disk image)
  * @param seq_number Sequence number of this chunk
  * @param obj_id Object Id this chunk is associated with
  * @param parent_id Parent object ID that this chunk/object is associated with
  */
-static TSK_RETVAL_ENUM
-    yaffscache_chunk_add(YAFFSFS_INFO *yfs, TSK_OFF_T offset, uint32_t seq_number,
+static void
+    yaffscache_chunk_init(YaffsCacheChunk *chunk, TSK_OFF_T offset, uint32_t seq_number,
     uint32_t obj_id, uint32_t chunk_id, uint32_t parent_id)
 {
-    TSK_RETVAL_ENUM result;
-    YaffsCacheChunk *prev;
-    YaffsCacheChunk *chunk;
-    if ((chunk = (YaffsCacheChunk*)tsk_malloc(sizeof(YaffsCacheChunk))) == NULL) {
-        return TSK_ERR;
-    }
-
     chunk->ycc_offset = offset;
     chunk->ycc_seq_number = seq_number;
     chunk->ycc_obj_id = obj_id;
@@ -219,41 +153,47 @@ static TSK_RETVAL_ENUM
     if((obj_id == 1) && (parent_id == 1)){
         chunk->ycc_parent_id = 0;
     }
+}
 
-    // Find the chunk that should go right before the new chunk
-    result = yaffscache_chunk_find_insertion_point(yfs, obj_id, offset, seq_number, &prev);
-
-    if (result == TSK_ERR) {
-        return TSK_ERR;
-    }
-
-    if (prev == NULL) {
-        // No previous chunk - new chunk is the lowest we've seen and the new start of the list
-        chunk->ycc_prev = NULL;
-        chunk->ycc_next = yfs->chunkMap->operator[](obj_id).cache_chunks_head;
-    }
-    else {
-        chunk->ycc_prev = prev;
-        chunk->ycc_next = prev->ycc_next;
+/**
+ * Get the next chunk of the same object from the sorted chunk array.
+ * @returns NULL if chunk is the last chunk of its object
+ */
+static YaffsCacheChunk *
+    yaffscache_chunk_next(YAFFSFS_INFO *yfs, YaffsCacheChunk *chunk)
+{
+    if ((chunk + 1 >= yfs->cache_chunks + yfs->cache_chunk_count) ||
+        (chunk[1].ycc_obj_id != chunk->ycc_obj_id)) {
+            return NULL;
     }
+    return chunk + 1;
+}
 
-    if (chunk->ycc_next != NULL) {
-        // If we're not at the end, set the prev pointer on the next chunk to point to our new one
-        chunk->ycc_next->ycc_prev = chunk;
-    }
-    else {
-        yfs->chunkMap->operator[](obj_id).cache_chunks_tail = chunk;
+/**
+ * Get the previous chunk of the same object from the sorted chunk array.
+ * @returns NULL if chunk is the first chunk of its object
+ */
+static YaffsCacheChunk *
+    yaffscache_chunk_prev(YAFFSFS_INFO *yfs, YaffsCacheChunk *chunk)
+{
+    if ((chunk == yfs->cache_chunks) ||
+        (chunk[-1].ycc_obj_id != chunk->ycc_obj_id)) {
+            return NULL;
     }
+    return chunk - 1;
+}
 
-    if (chunk->ycc_prev != NULL) {
-        // If we're not at the beginning, set the next pointer on the previous chunk to point at our new one
-        chunk->ycc_prev->ycc_next = chunk;
-    }
-    else {
-        yfs->chunkMap->operator[](obj_id).cache_chunks_head = chunk;
+/**
+ * Get the version of an object that came before the given one.
+ * @returns NULL if version is the oldest version of the object
+ */
+static YaffsCacheVersion *
+    yaffscache_version_prior(YaffsCacheObject *obj, YaffsCacheVersion *version)
+{
+    if (version == obj->yco_first) {
+        return NULL;
     }
-
-    return TSK_OK;
+    return version - 1;
 }
 
 
@@ -264,87 +204,56 @@ static TSK_RETVAL_ENUM
 static TSK_RETVAL_ENUM
     yaffscache_object_find(YAFFSFS_INFO *yfs, uint32_t obj_id, YaffsCacheObject **obj)
 {
-    YaffsCacheObject *curr, *prev;
-    curr = yfs->cache_objects;
-    prev = NULL;
+    size_t lo = 0;
+    size_t hi = yfs->cache_object_count;
 
     if (obj == NULL) {
         return TSK_ERR;
     }
 
-    while(curr != NULL) {
-        if (curr->yco_obj_id == obj_id) {
-            *obj = curr;
-            return TSK_OK;
+    // cache_objects is sorted by obj_id
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (yfs->cache_objects[mid].yco_obj_id < obj_id) {
+            lo = mid + 1;
         }
-        else if (curr->yco_obj_id > obj_id) {
-            *obj = prev;
-            return TSK_STOP;
+        else {
+            hi = mid;
         }
+    }
 
-        prev = curr;
-        curr = curr->yco_next;
+    if ((lo < yfs->cache_object_count) && (yfs->cache_objects[lo].yco_obj_id == obj_id)) {
+        *obj = &yfs->cache_objects[lo];
+        return TSK_OK;
     }
 
-    *obj = prev;
+    *obj = NULL;
     return TSK_STOP;
 }
 
 /**
- * Add an object to the cache if it does not already exist in there.
- * @returns TSK_ERR  on error, TSK_OK otherwise.
+ * Append a new version for the object whose versions start at index first
+ * of yfs->cache_versions.
+ * @param alloc Number of entries allocated in yfs->cache_versions
  */
 static TSK_RETVAL_ENUM
-    yaffscache_object_find_or_add(YAFFSFS_INFO *yfs, uint32_t obj_id, YaffsCacheObject **obj)
-{
-    YaffsCacheObject *prev;
-    TSK_RETVAL_ENUM result;
-
-    if (obj == NULL) {
-        return TSK_ERR;
-    }
-
-    // Look for this obj_id in yfs->cache_objects
-    // If not found, add it in the correct spot
-    // yaffscache_object_find returns the last object with obj_id less than the one
-    // we were searching for, so use that to insert the new one in the list
-    result = yaffscache_object_find(yfs, obj_id, &prev);
-    if (result == TSK_OK) {
-        *obj = prev;
-        return TSK_OK;
-    }
-    else if (result == TSK_STOP) {
-        *obj = (YaffsCacheObject *) tsk_malloc(sizeof(YaffsCacheObject));
-        (*obj)->yco_obj_id = obj_id;
-        if (prev == NULL) {
-            (*obj)->yco_next = yfs->cache_objects;
-            yfs->cache_objects = *obj;
-        }
-        else {
-            (*obj)->yco_next = prev->yco_next;
-            prev->yco_next = (*obj);
-        }
-        return TSK_OK;
-    }
-    else {
-        *obj = NULL;
-        return TSK_ERR;
-    }
-}
-
-static TSK_RETVAL_ENUM
-    yaffscache_object_add_version(YaffsCacheObject *obj, YaffsCacheChunk *chunk)
+    yaffscache_object_add_version(YAFFSFS_INFO *yfs, size_t first, size_t *alloc, YaffsCacheChunk *chunk)
 {
     uint32_t ver_number;
     YaffsCacheChunk *header_chunk = NULL;
+    YaffsCacheVersion *latest = NULL;
     YaffsCacheVersion *version;
 
     // Going to try ignoring unlinked/deleted headers (objID 3 and 4)
-    if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED) 
+    if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED)
         &&(chunk->ycc_parent_id != YAFFS_OBJECT_DELETED)) {
             header_chunk = chunk;
     }
 
+    if (yfs->cache_version_count > first) {
+        latest = &yfs->cache_versions[yfs->cache_version_count - 1];
+    }
+
     /* If this is the second version (since last header_chunk is not NULL) and no
     * header was added, get rid of this incomplete old version -- can't be
     * reasonably recovered.
@@ -354,29 +263,27 @@ static TSK_RETVAL_ENUM
     *       with no metadata under TSK. This is rare and we don't have
     *       a testcase for it now. Punting right now.
     *
-    * Edit: Shouldn't get to this point anymore. Changes to 
+    * Edit: Shouldn't get to this point anymore. Changes to
     *       yaffscache_versions_insert_chunk make a version continue until it
     *       has a header block.
     */
-    if (obj->yco_latest != NULL) {
-        if (obj->yco_latest->ycv_header_chunk == NULL) {
-            YaffsCacheVersion *incomplete = obj->yco_latest;
-
+    if (latest != NULL) {
+        if (latest->ycv_header_chunk == NULL) {
             if (tsk_verbose)
                 tsk_fprintf(stderr, "yaffscache_object_add_version: "
                 "removed an incomplete first version (no header)\n");
 
-            obj->yco_latest = obj->yco_latest->ycv_prior;
-            free(incomplete);
+            yfs->cache_version_count--;
+            latest = (yfs->cache_version_count > first) ? latest - 1 : NULL;
         }
     }
 
-    if (obj->yco_latest != NULL) {
-        ver_number = obj->yco_latest->ycv_version + 1;
+    if (latest != NULL) {
+        ver_number = latest->ycv_version + 1;
 
         /* Until a new header is given, use the last seen header. */
         if (header_chunk == NULL) {
-            header_chunk = obj->yco_latest->ycv_header_chunk;
+            header_chunk = latest->ycv_header_chunk;
 
             // If we haven't seen a good header yet and we have a deleted/unlinked one, use it
             if((header_chunk == NULL) && (chunk->ycc_chunk_id == 0)){
@@ -388,48 +295,49 @@ static TSK_RETVAL_ENUM
         ver_number = 1;
     }
 
-    if ((version = (YaffsCacheVersion *) tsk_malloc(sizeof(YaffsCacheVersion))) == NULL) {
-        return TSK_ERR;
+    if (yfs->cache_version_count == *alloc) {
+        size_t new_alloc = (*alloc == 0) ? 1024 : *alloc * 2;
+        YaffsCacheVersion *tmp = (YaffsCacheVersion *) tsk_realloc(yfs->cache_versions,
+            new_alloc * sizeof(YaffsCacheVersion));
+        if (tmp == NULL) {
+            return TSK_ERR;
+        }
+        yfs->cache_versions = tmp;
+        *alloc = new_alloc;
     }
 
-    version->ycv_prior = obj->yco_latest;
+    version = &yfs->cache_versions[yfs->cache_version_count++];
     version->ycv_version = ver_number;
     version->ycv_seq_number = chunk->ycc_seq_number;
     version->ycv_header_chunk = header_chunk;
     version->ycv_first_chunk = chunk;
     version->ycv_last_chunk = chunk;
 
-    obj->yco_latest = version;
-
     return TSK_OK;
 }
 
 /**
- * Add a chunk to its corresponding object in the cache. 
+ * Add a chunk to the versions of its object.  The versions of the object
+ * start at index first of yfs->cache_versions.
  */
 static TSK_RETVAL_ENUM
-    yaffscache_versions_insert_chunk(YAFFSFS_INFO *yfs, YaffsCacheChunk *chunk)
+    yaffscache_versions_insert_chunk(YAFFSFS_INFO *yfs, size_t first, size_t *alloc, YaffsCacheChunk *chunk)
 {
-    YaffsCacheObject *obj;
-    TSK_RETVAL_ENUM result;
-    YaffsCacheVersion *version;
+    YaffsCacheVersion *version = NULL;
 
-    // Building a list in yfs->cache_objects, sorted by obj_id
-    result = yaffscache_object_find_or_add(yfs, chunk->ycc_obj_id, &obj);
-    if (result != TSK_OK) {
-        return TSK_ERR;
+    if (yfs->cache_version_count > first) {
+        version = &yfs->cache_versions[yfs->cache_version_count - 1];
     }
-    version = obj->yco_latest;
 
     /* First chunk in this object? */
     if (version == NULL) {
-        yaffscache_object_add_version(obj, chunk);
+        return yaffscache_object_add_version(yfs, first, alloc, chunk);
     }
     else {
         /* Chunk in the same update? */
         if (chunk->ycc_seq_number == version->ycv_seq_number) {
             version->ycv_last_chunk = chunk;
-            if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED) 
+            if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED)
                 &&(chunk->ycc_parent_id != YAFFS_OBJECT_DELETED)) {
                     version->ycv_header_chunk = chunk;
             }
@@ -438,11 +346,11 @@ static TSK_RETVAL_ENUM
             }
         }
         // If there was no header for the last version, continue adding to it instead
-        // of starting a new version. 
+        // of starting a new version.
         else if(version->ycv_header_chunk == NULL){
             version->ycv_seq_number = chunk->ycc_seq_number;
             version->ycv_last_chunk = chunk;
-            if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED) 
+            if ((chunk->ycc_chunk_id == 0) && (chunk->ycc_parent_id != YAFFS_OBJECT_UNLINKED)
                 &&(chunk->ycc_parent_id != YAFFS_OBJECT_DELETED)) {
                     version->ycv_header_chunk = chunk;
             }
@@ -451,57 +359,92 @@ static TSK_RETVAL_ENUM
             }
         }
         else if(chunk->ycc_chunk_id == 0){   // Directories only have a header block
-            // If we're looking at a new version of a directory where the previous version had the same name, 
-            // leave everything in the same version. Multiple versions of the same directory aren't really giving us 
+            // If we're looking at a new version of a directory where the previous version had the same name,
+            // leave everything in the same version. Multiple versions of the same directory aren't really giving us
             // any information.
-            YaffsHeader * newHeader;
+            YaffsHeader * newHeader = NULL;
             yaffsfs_read_header(yfs, &newHeader, chunk->ycc_offset);
             if((newHeader != NULL) && (newHeader->obj_type == YAFFS_TYPE_DIRECTORY)){
                 // Read in the old header
-                YaffsHeader * oldHeader;
+                YaffsHeader * oldHeader = NULL;
                 yaffsfs_read_header(yfs, &oldHeader, version->ycv_header_chunk->ycc_offset);
                 if((oldHeader != NULL) && (oldHeader->obj_type == YAFFS_TYPE_DIRECTORY) &&
                     (0 == strncmp(oldHeader->name, newHeader->name, YAFFS_HEADER_NAME_LENGTH))){
                         version->ycv_seq_number = chunk->ycc_seq_number;
                         version->ycv_last_chunk = chunk;
                         version->ycv_header_chunk = chunk;
+                        free(oldHeader);
+                        free(newHeader);
+                        return TSK_OK;
                 }
-                else{
-                    // The older header either isn't a directory or it doesn't have the same name, so leave it
-                    // as its own version
-                    yaffscache_object_add_version(obj, chunk);
-                }
-            }
-            else{
-                //  Not a directory
-                yaffscache_object_add_version(obj, chunk);
+                free(oldHeader);
             }
+            free(newHeader);
+
+            // The older header either isn't a directory or it doesn't have the same name
+            // (or this isn't a directory at all), so leave it as its own version
+            return yaffscache_object_add_version(yfs, first, alloc, chunk);
         }
         else{
             //  Otherwise, add this chunk as the start of a new version
-            yaffscache_object_add_version(obj, chunk);
+            return yaffscache_object_add_version(yfs, first, alloc, chunk);
         }
     }
 
     return TSK_OK;
 }
 
+/**
+ * Build the object and version arrays from the sorted chunk array.
+ */
 static TSK_RETVAL_ENUM
     yaffscache_versions_compute(YAFFSFS_INFO *yfs)
 {
-    std::map<unsigned int,YaffsCacheChunkGroup>::iterator iter;
-    for( iter = yfs->chunkMap->begin(); iter != yfs->chunkMap->end(); ++iter ) {
-        YaffsCacheChunk *chunk_curr = yfs->chunkMap->operator[](iter->first).cache_chunks_head;
-
-        while(chunk_curr != NULL) {
-            if (yaffscache_versions_insert_chunk(yfs, chunk_curr) != TSK_OK) {
-                return TSK_ERR;
+    size_t obj_alloc = 0;
+    size_t ver_alloc = 0;
+    size_t first = 0;
+    size_t i, v;
+
+    for (i = 0; i < yfs->cache_chunk_count; i++) {
+        YaffsCacheChunk *chunk = &yfs->cache_chunks[i];
+
+        // The chunks of an object are next to each other, so a new obj_id
+        // starts a new object
+        if ((i == 0) || (chunk->ycc_obj_id != chunk[-1].ycc_obj_id)) {
+            if (yfs->cache_object_count == obj_alloc) {
+                size_t new_alloc = (obj_alloc == 0) ? 1024 : obj_alloc * 2;
+                YaffsCacheObject *tmp = (YaffsCacheObject *) tsk_realloc(yfs->cache_objects,
+                    new_alloc * sizeof(YaffsCacheObject));
+                if (tmp == NULL) {
+                    return TSK_ERR;
+                }
+                yfs->cache_objects = tmp;
+                obj_alloc = new_alloc;
             }
+            yfs->cache_objects[yfs->cache_object_count].yco_obj_id = chunk->ycc_obj_id;
+            yfs->cache_object_count++;
+            first = yfs->cache_version_count;
+        }
 
-            chunk_curr = chunk_curr->ycc_next;
+        if (yaffscache_versions_insert_chunk(yfs, first, &ver_alloc, chunk) != TSK_OK) {
+            return TSK_ERR;
         }
     }
 
+    // The version array will not move anymore, so point each object at its versions.
+    // Every object has at least one version, and they are in object order.
+    v = 0;
+    for (i = 0; i < yfs->cache_object_count; i++) {
+        YaffsCacheObject *obj = &yfs->cache_objects[i];
+
+        obj->yco_first = &yfs->cache_versions[v];
+        while ((v < yfs->cache_version_count) &&
+            (yfs->cache_versions[v].ycv_first_chunk->ycc_obj_id == obj->yco_obj_id)) {
+                v++;
+        }
+        obj->yco_latest = &yfs->cache_versions[v - 1];
+    }
+
     return TSK_OK;
 }
 
@@ -524,8 +467,6 @@ typedef TSK_RETVAL_ENUM yc_find_children_cb(YaffsCacheObject *obj, YaffsCacheVer
 static TSK_RETVAL_ENUM
     yaffscache_find_children(YAFFSFS_INFO *yfs, TSK_INUM_T parent_inode, yc_find_children_cb cb, void *args)
 {
-    YaffsCacheObject *obj;
-
     uint32_t parent_id, version_num;
     if (yaffscache_inode_to_obj_id_and_version(parent_inode, &parent_id, &version_num) != TSK_OK) {
         return TSK_ERR;
@@ -533,9 +474,10 @@ static TSK_RETVAL_ENUM
 
     /* Iterate over all objects and all versions of the objects to see if one is the child
      * of the given parent. */
-    for (obj = yfs->cache_objects; obj != NULL; obj = obj->yco_next) {
+    for (size_t i = 0; i < yfs->cache_object_count; i++) {
+        YaffsCacheObject *obj = &yfs->cache_objects[i];
         YaffsCacheVersion *version;
-        for (version = obj->yco_latest; version != NULL; version = version->ycv_prior) {
+        for (version = obj->yco_latest; version != NULL; version = yaffscache_version_prior(obj, version)) {
             /* Is this an incomplete version? */
             if (version->ycv_header_chunk == NULL) {
                 continue;
@@ -558,7 +500,7 @@ static TSK_RETVAL_ENUM
  * @param inode
  * @param version [out] Pointer to store version of the object that was found (if inode had a version of 0)
  * @param obj_ret [out] Pointer to store found object into
- * @returns TSK_ERR on error. 
+ * @returns TSK_ERR on error.
  */
 static TSK_RETVAL_ENUM
     yaffscache_version_find_by_inode(YAFFSFS_INFO *yfs, TSK_INUM_T inode, YaffsCacheVersion **version, YaffsCacheObject **obj_ret) {
@@ -589,8 +531,10 @@ static TSK_RETVAL_ENUM
             return TSK_OK;
         }
 
-        // Find the requested version in the list. 
-        for(curr = obj->yco_latest; curr != NULL; curr = curr->ycv_prior) {
+        // Versions are numbered from 1 in the order they are stored, except for
+        // the latest one, which was renumbered to 0 when the cache was built.
+        if (version_num <= (uint32_t) (obj->yco_latest - obj->yco_first)) {
+            curr = obj->yco_first + (version_num - 1);
             if (curr->ycv_version == version_num) {
                 if (obj_ret != NULL) {
                     *obj_ret = obj;
@@ -608,21 +552,21 @@ static TSK_RETVAL_ENUM
 }
 
 static void
-    yaffscache_object_dump(FILE *fp, YaffsCacheObject *obj)
+    yaffscache_object_dump(FILE *fp, YAFFSFS_INFO *yfs, YaffsCacheObject *obj)
 {
     YaffsCacheVersion *next_version = obj->yco_latest;
     YaffsCacheChunk *chunk = next_version->ycv_last_chunk;
 
     fprintf(fp, "Object %d\n", obj->yco_obj_id);
     while(chunk != NULL && chunk->ycc_obj_id == obj->yco_obj_id) {
-        if (next_version != NULL && 
+        if (next_version != NULL &&
             chunk == next_version->ycv_last_chunk) {
-                fprintf(fp, "  @%d: %p %p %p\n", 
-                    next_version->ycv_version, 
+                fprintf(fp, "  @%d: %p %p %p\n",
+                    next_version->ycv_version,
                     (void*) next_version->ycv_header_chunk,
                     (void*) next_version->ycv_first_chunk,
                     (void*)next_version->ycv_last_chunk);
-                next_version = next_version->ycv_prior;
+                next_version = yaffscache_version_prior(obj, next_version);
         }
 
         fprintf(fp, "    + %p %08x %08x %0" PRIxOFF "\n",
@@ -631,7 +575,7 @@ static void
             chunk->ycc_seq_number,
             chunk->ycc_offset);
 
-        chunk = chunk->ycc_prev;
+        chunk = yaffscache_chunk_prev(yfs, chunk);
     }
 }
 
@@ -639,15 +583,13 @@ static void
 static void
     yaffscache_objects_dump(FILE *fp, YAFFSFS_INFO *yfs)
 {
-    YaffsCacheObject *obj;
-
-    for(obj = yfs->cache_objects; obj != NULL; obj = obj->yco_next)
-        yaffscache_object_dump(fp, obj);
+    for(size_t i = 0; i < yfs->cache_object_count; i++)
+        yaffscache_object_dump(fp, yfs, &yfs->cache_objects[i]);
 }
 */
 
 static void
-    yaffscache_objects_stats(YAFFSFS_INFO *yfs, 
+    yaffscache_objects_stats(YAFFSFS_INFO *yfs,
     unsigned int *obj_count,
     uint32_t *obj_first, uint32_t *obj_last,
     uint32_t *version_count,
@@ -665,14 +607,15 @@ static void
     *version_first = 0xffffffff;
     *version_last = 0;
 
-    for(obj = yfs->cache_objects; obj != NULL; obj = obj->yco_next) {
+    for(size_t i = 0; i < yfs->cache_object_count; i++) {
+        obj = &yfs->cache_objects[i];
         *obj_count += 1;
         if (obj->yco_obj_id < *obj_first)
             *obj_first = obj->yco_obj_id;
         if (obj->yco_obj_id > *obj_last)
             *obj_last = obj->yco_obj_id;
 
-        for(ver = obj->yco_latest; ver != NULL; ver = ver->ycv_prior) {
+        for(ver = obj->yco_latest; ver != NULL; ver = yaffscache_version_prior(obj, ver)) {
             *version_count += 1;
             if (ver->ycv_seq_number < *version_first)
                 *version_first = ver->ycv_seq_number;
@@ -685,44 +628,25 @@ static void
 static void
     yaffscache_objects_free(YAFFSFS_INFO *yfs)
 {
-    if((yfs != NULL) && (yfs->cache_objects != NULL)){
-        YaffsCacheObject *obj = yfs->cache_objects;
-        while(obj != NULL) {
-            YaffsCacheObject *to_free = obj;
-
-            YaffsCacheVersion *ver = obj->yco_latest;
-            while(ver != NULL) {
-                YaffsCacheVersion *v_to_free = ver;
-                ver = ver->ycv_prior;
-                free(v_to_free);
-            }
+    if(yfs != NULL){
+        free(yfs->cache_objects);
+        yfs->cache_objects = NULL;
+        yfs->cache_object_count = 0;
 
-            obj = obj->yco_next;
-            free(to_free);
-        }
+        free(yfs->cache_versions);
+        yfs->cache_versions = NULL;
+        yfs->cache_version_count = 0;
     }
 }
 
 static void
     yaffscache_chunks_free(YAFFSFS_INFO *yfs)
 {
-    if((yfs != NULL) && (yfs->chunkMap != NULL)){
-        // Free the YaffsCacheChunks in each ChunkGroup
-        std::map<unsigned int,YaffsCacheChunkGroup>::iterator iter;
-        for( iter = yfs->chunkMap->begin(); iter != yfs->chunkMap->end(); ++iter ) {
-            YaffsCacheChunk *chunk = yfs->chunkMap->operator[](iter->first).cache_chunks_head;
-            while(chunk != NULL) {
-                YaffsCacheChunk *to_free = chunk;
-                chunk = chunk->ycc_next;
-                free(to_free);
-            }
-        }
-
-        // Free the map
-        yfs->chunkMap->clear();
-        delete yfs->chunkMap;
+    if(yfs != NULL){
+        free(yfs->cache_chunks);
+        yfs->cache_chunks = NULL;
+        yfs->cache_chunk_count = 0;
     }
-
 }
 
 
@@ -1353,6 +1277,53 @@ static uint8_t
     return 0;
 }
 
+/**
+* Parse the YAFFS2 tags in spare bytes that have already been read.
+*
+* @param yfs is a YAFFS fs handle
+* @param spr spare_size bytes of spare area
+* @param sp YaffsSpare object to be populated
+*/
+static void
+    yaffsfs_parse_spare(YAFFSFS_INFO *yfs, const unsigned char *spr, YaffsSpare *sp)
+{
+    uint32_t seq_number;
+    uint32_t object_id;
+    uint32_t chunk_id;
+
+    memset(sp, 0, sizeof(YaffsSpare));
+
+    /*
+    * Complete read of the YAFFS2 spare
+    */
+
+
+    // The format of the spare area should have been determined earlier
+    memcpy(&seq_number, &spr[yfs->spare_seq_offset], 4);
+    memcpy(&object_id, &spr[yfs->spare_obj_id_offset], 4);
+    memcpy(&chunk_id, &spr[yfs->spare_chunk_id_offset], 4);
+
+    if ((YAFFS_SPARE_FLAGS_IS_HEADER & chunk_id) != 0) {
+
+        sp->seq_number = seq_number;
+        sp->object_id = object_id & ~YAFFS_SPARE_OBJECT_TYPE_MASK;
+        sp->chunk_id = 0;
+
+        sp->has_extra_fields = 1;
+        sp->extra_parent_id = chunk_id & YAFFS_SPARE_PARENT_ID_MASK;
+        sp->extra_object_type =
+            (object_id & YAFFS_SPARE_OBJECT_TYPE_MASK)
+            >> YAFFS_SPARE_OBJECT_TYPE_SHIFT;
+    }
+    else {
+        sp->seq_number = seq_number;
+        sp->object_id = object_id;
+        sp->chunk_id = chunk_id;
+
+        sp->has_extra_fields = 0;
+    }
+}
+
 /**
 * Read and parse the YAFFS2 tags in the NAND spare bytes.
 *
@@ -1370,10 +1341,6 @@ static uint8_t
     YaffsSpare *sp;
     TSK_FS_INFO *fs = &(yfs->fs_info);
 
-    uint32_t seq_number;
-    uint32_t object_id;
-    uint32_t chunk_id;
-
     // Should have checked this by now, but just in case
     if((yfs->spare_seq_offset + 4 > yfs->spare_size) ||
         (yfs->spare_obj_id_offset + 4 > yfs->spare_size) ||
@@ -1407,37 +1374,7 @@ static uint8_t
         return 1;
     }
 
-    memset(sp, 0, sizeof(YaffsSpare));
-
-    /*
-    * Complete read of the YAFFS2 spare
-    */
-
-
-    // The format of the spare area should have been determined earlier
-    memcpy(&seq_number, &spr[yfs->spare_seq_offset], 4);
-    memcpy(&object_id, &spr[yfs->spare_obj_id_offset], 4);
-    memcpy(&chunk_id, &spr[yfs->spare_chunk_id_offset], 4);
-
-    if ((YAFFS_SPARE_FLAGS_IS_HEADER & chunk_id) != 0) {
-
-        sp->seq_number = seq_number;
-        sp->object_id = object_id & ~YAFFS_SPARE_OBJECT_TYPE_MASK;
-        sp->chunk_id = 0;
-
-        sp->has_extra_fields = 1;
-        sp->extra_parent_id = chunk_id & YAFFS_SPARE_PARENT_ID_MASK;
-        sp->extra_object_type =
-            (object_id & YAFFS_SPARE_OBJECT_TYPE_MASK)
-            >> YAFFS_SPARE_OBJECT_TYPE_SHIFT;
-    }
-    else {
-        sp->seq_number = seq_number;
-        sp->object_id = object_id;
-        sp->chunk_id = chunk_id;
-
-        sp->has_extra_fields = 0;
-    }
+    yaffsfs_parse_spare(yfs, spr, sp);
 
     free(spr);
     *spare = sp;
@@ -1445,6 +1382,7 @@ static uint8_t
     return 0;
 }
 
+
 static uint8_t 
     yaffsfs_is_spare_valid(YAFFSFS_INFO * /*yfs*/, YaffsSpare *spare)
 {
@@ -1485,81 +1423,194 @@ static uint8_t
     return 0;
 }
 
+/* Number of erase blocks that one task of the spare scan reads */
+#define YAFFS_SCAN_BLOCKS_PER_TASK 16
+
+/* One range of erase blocks of the spare scan */
+typedef struct {
+    TSK_OFF_T first_chunk;      // Index of the first chunk in the range
+    size_t chunk_cnt;           // Number of chunks in the range
+    size_t scanned;             // Number of chunks whose spare could be read
+    YaffsCacheChunk *chunks;    // Chunks with a valid spare, in offset order
+    size_t found;               // Number of entries in chunks
+} YAFFS_SCAN_RANGE;
+
+typedef struct {
+    YAFFSFS_INFO *yfs;
+    YAFFS_SCAN_RANGE *ranges;
+} YAFFS_SCAN;
+
+/**
+ * tsk_parallel_for() task that reads one range of erase blocks and
+ * collects the chunks that have a valid spare.  The range is read with
+ * one call and chunks are only read one by one if that comes up short,
+ * which stops at the first spare that cannot be read like a serial scan.
+ */
+static uint8_t
+    yaffsfs_scan_range_task(void *a_ptr, size_t a_idx)
+{
+    YAFFS_SCAN *scan = (YAFFS_SCAN *) a_ptr;
+    YAFFSFS_INFO *yfs = scan->yfs;
+    YAFFS_SCAN_RANGE *range = &scan->ranges[a_idx];
+    TSK_IMG_INFO *img_info = yfs->fs_info.img_info;
+    size_t chunk_size = yfs->page_size + yfs->spare_size;
+    TSK_OFF_T range_offset = range->first_chunk * chunk_size;
+    unsigned char *buf;
+    ssize_t cnt;
+
+    if ((buf = (unsigned char *) tsk_malloc(range->chunk_cnt * chunk_size)) == NULL) {
+        return 1;
+    }
+    if ((range->chunks = (YaffsCacheChunk *) tsk_malloc(range->chunk_cnt * sizeof(YaffsCacheChunk))) == NULL) {
+        free(buf);
+        return 1;
+    }
+
+    cnt = tsk_img_read(img_info, range_offset, (char *) buf, range->chunk_cnt * chunk_size);
+
+    for (range->scanned = 0; range->scanned < range->chunk_cnt; range->scanned++) {
+        size_t pos = range->scanned * chunk_size;
+        TSK_OFF_T offset = range_offset + pos;
+        unsigned char *page = &buf[pos];
+        int have_page = 1;
+        YaffsSpare spare;
+        uint32_t parentID;
+
+        if ((cnt < 0) || ((size_t) cnt < pos + chunk_size)) {
+            ssize_t spare_cnt = tsk_img_read(img_info, offset + yfs->page_size,
+                (char *) &page[yfs->page_size], yfs->spare_size);
+            if ((spare_cnt < 0) || ((unsigned int) spare_cnt < yfs->spare_size)) {
+                break;
+            }
+            have_page = 0;
+        }
+
+        yaffsfs_parse_spare(yfs, &page[yfs->page_size], &spare);
+        if (yaffsfs_is_spare_valid(yfs, &spare) != TSK_OK) {
+            continue;
+        }
+
+        if((spare.has_extra_fields) || (spare.chunk_id != 0)){
+            parentID = spare.extra_parent_id;
+        }
+        // If we have a header block and didn't extract it already from the spare, get the parent ID from
+        // the non-spare data
+        else if(have_page || (8 == tsk_img_read(img_info, offset, (char*) page, 8))){
+            memcpy(&parentID, &page[4], 4);
+        }
+        else{
+            // Really shouldn't happen
+            fprintf(stderr, "Error reading header to get parent id at offset %" PRIxOFF "\n", offset);
+            parentID = 0;
+        }
+
+        yaffscache_chunk_init(&range->chunks[range->found++], offset,
+            spare.seq_number, spare.object_id, spare.chunk_id, parentID);
+    }
+
+    free(buf);
+    return 0;
+}
+
 /**
  * Cycle through the entire image and populate the cache with objects as they are found.
+ * The spares are read in ranges of erase blocks that are spread over threads, and the
+ * chunks that were found are then merged into one array sorted by object, sequence
+ * number and offset.
  */
 static uint8_t 
     yaffsfs_parse_image_load_cache(YAFFSFS_INFO * yfs)
 {
     uint8_t status = TSK_OK;
-    uint32_t nentries = 0;
-    YaffsSpare *spare = NULL;
-
-    uint8_t tempBuf[8];
-    uint32_t parentID;
+    size_t nentries = 0;
+    size_t chunk_size = yfs->page_size + yfs->spare_size;
+    size_t range_chunks = (size_t) yfs->chunks_per_block * YAFFS_SCAN_BLOCKS_PER_TASK;
+    TSK_OFF_T total_chunks;
+    size_t range_cnt, i;
+    YAFFS_SCAN scan;
 
     if (yfs->cache_objects)
         return 0;
 
-    for(TSK_OFF_T offset = 0;offset < yfs->fs_info.img_info->size;offset += yfs->page_size + yfs->spare_size){
-        status = yaffsfs_read_spare( yfs, &spare, offset + yfs->page_size);
-        if (status != TSK_OK) {
-            break;
-        }
+    // Should have checked this by now, but just in case (yaffsfs_read_spare()
+    // would fail on the first spare)
+    if((yfs->spare_seq_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_obj_id_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_chunk_id_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_size < 46) || (range_chunks == 0)){
+            total_chunks = 0;
+    }
+    else {
+        total_chunks = (yfs->fs_info.img_info->size + chunk_size - 1) / chunk_size;
+    }
 
-        if (yaffsfs_is_spare_valid(yfs, spare) == TSK_OK) {
+    range_cnt = (size_t) ((total_chunks + range_chunks - 1) / range_chunks);
+    scan.yfs = yfs;
+    if ((scan.ranges = (YAFFS_SCAN_RANGE *) tsk_malloc((range_cnt + 1) * sizeof(YAFFS_SCAN_RANGE))) == NULL) {
+        return TSK_ERR;
+    }
+    for (i = 0; i < range_cnt; i++) {
+        scan.ranges[i].first_chunk = (TSK_OFF_T) i * range_chunks;
+        scan.ranges[i].chunk_cnt = range_chunks;
+        if (total_chunks - scan.ranges[i].first_chunk < (TSK_OFF_T) range_chunks) {
+            scan.ranges[i].chunk_cnt = (size_t) (total_chunks - scan.ranges[i].first_chunk);
+        }
+    }
 
+    if (tsk_parallel_for(range_cnt, yaffsfs_scan_range_task, &scan)) {
+        status = TSK_ERR;
+    }
 
-            if((spare->has_extra_fields) || (spare->chunk_id != 0)){
-                yaffscache_chunk_add(yfs,
-                    offset, 
-                    spare->seq_number, 
-                    spare->object_id, 
-                    spare->chunk_id, 
-                    spare->extra_parent_id);
+    // Merge the ranges in image order.  The scan ends at the first spare that
+    // could not be read.
+    if (status == TSK_OK) {
+        size_t used = 0;
+        for (i = 0; i < range_cnt; i++) {
+            nentries += scan.ranges[i].scanned;
+            yfs->cache_chunk_count += scan.ranges[i].found;
+            used++;
+            if (scan.ranges[i].scanned < scan.ranges[i].chunk_cnt) {
+                break;
             }
-            else{
-                // If we have a header block and didn't extract it already from the spare, get the parent ID from
-                // the non-spare data
-                if(8 == tsk_img_read(yfs->fs_info.img_info, offset, (char*) tempBuf, 8)){
-                    memcpy(&parentID, &tempBuf[4], 4);
-
-                    yaffscache_chunk_add(yfs,
-                        offset, 
-                        spare->seq_number, 
-                        spare->object_id, 
-                        spare->chunk_id, 
-                        parentID);
-                }
-                else{
-                    // Really shouldn't happen
-                    fprintf(stderr, "Error reading header to get parent id at offset %" PRIxOFF "\n", offset);
-                    yaffscache_chunk_add(yfs,
-                        offset, 
-                        spare->seq_number, 
-                        spare->object_id, 
-                        spare->chunk_id, 
-                        0);
-                }
+        }
+
+        if ((yfs->cache_chunks = (YaffsCacheChunk *) tsk_malloc((yfs->cache_chunk_count + 1) * sizeof(YaffsCacheChunk))) == NULL) {
+            yfs->cache_chunk_count = 0;
+            status = TSK_ERR;
+        }
+        else {
+            size_t pos = 0;
+            for (i = 0; i < used; i++) {
+                memcpy(&yfs->cache_chunks[pos], scan.ranges[i].chunks,
+                    scan.ranges[i].found * sizeof(YaffsCacheChunk));
+                pos += scan.ranges[i].found;
             }
         }
+    }
 
-        free(spare);
-        spare = NULL;
+    for (i = 0; i < range_cnt; i++) {
+        free(scan.ranges[i].chunks);
+    }
+    free(scan.ranges);
 
-        ++nentries;
+    if (status != TSK_OK) {
+        return TSK_ERR;
     }
 
+    std::sort(yfs->cache_chunks, yfs->cache_chunks + yfs->cache_chunk_count, yaffscache_chunk_less);
+
     if (tsk_verbose)
-        fprintf(stderr, "yaffsfs_parse_image_load_cache: read %d entries\n", nentries);
+        fprintf(stderr, "yaffsfs_parse_image_load_cache: read %" PRIuSIZE " entries\n", nentries);
 
     if (tsk_verbose)
         fprintf(stderr, "yaffsfs_parse_image_load_cache: started processing chunks for version cache...\n");
     fflush(stderr);
 
-    // At this point, we have a list of chunks sorted by obj id, seq number, and offset
-    // This makes the list of objects in cache_objects, which link to different versions
-    yaffscache_versions_compute(yfs);
+    // At this point, we have an array of chunks sorted by obj id, seq number, and offset
+    // This makes the array of objects in cache_objects, which point to their versions
+    if (yaffscache_versions_compute(yfs) != TSK_OK) {
+        return TSK_ERR;
+    }
 
     if (tsk_verbose)
         fprintf(stderr, "yaffsfs_parse_image_load_cache: done version cache!\n");
@@ -1569,9 +1620,9 @@ static uint8_t
     // Having multiple inodes point to the same object seems to cause trouble in TSK, especially in orphan file detection,
     //  so set the version number of the final one to zero.
     // While we're at it, find the highest obj_id and the highest version (before resetting to zero)
-    YaffsCacheObject * currObj = yfs->cache_objects;
-    YaffsCacheVersion * currVer;
-    while(currObj != NULL){
+    for(size_t obj_idx = 0; obj_idx < yfs->cache_object_count; obj_idx++){
+        YaffsCacheObject * currObj = &yfs->cache_objects[obj_idx];
+        YaffsCacheVersion * currVer;
         if(currObj->yco_obj_id > yfs->max_obj_id){
             yfs->max_obj_id = currObj->yco_obj_id;
         }
@@ -1582,7 +1633,6 @@ static uint8_t
         }
 
         currVer->ycv_version = 0;
-        currObj = currObj->yco_next;
     }
 
     // Use the max object id and version number to construct an upper bound on the inode
@@ -1626,7 +1676,7 @@ static uint8_t yaffs_is_version_allocated(YAFFSFS_INFO * yfs, TSK_INUM_T inode){
             if((curr->ycc_parent_id == YAFFS_OBJECT_UNLINKED) || (curr->ycc_parent_id == YAFFS_OBJECT_DELETED)){
                 return 0;
             }
-            curr = curr ->ycc_next;
+            curr = yaffscache_chunk_next(yfs, curr);
         }
         return 1;
     }
@@ -2103,7 +2153,7 @@ static uint8_t
                 }
             }
             if (flags & TSK_FS_META_FLAG_UNALLOC){
-                for (version = curr_obj->yco_latest; version != NULL; version = version->ycv_prior) {
+                for (version = curr_obj->yco_latest; version != NULL; version = yaffscache_version_prior(curr_obj, version)) {
                     if (yaffscache_obj_id_and_version_to_inode(obj_id, version->ycv_version, &curr_inode) != TSK_OK) {
                         tsk_fs_file_close(fs_file);
                         return 1;
@@ -2127,8 +2177,6 @@ static uint8_t
                     }
                 }
             }
-
-            curr_obj = curr_obj->yco_next;
         }
     }
 
@@ -2222,7 +2270,7 @@ static TSK_FS_BLOCK_FLAG_ENUM
                             flags = (TSK_FS_BLOCK_FLAG_ENUM)(flags | TSK_FS_BLOCK_FLAG_UNALLOC);
                             break;
                         }
-                        curr = curr->ycc_prev;
+                        curr = yaffscache_chunk_prev(yfs, curr);
                     }
                 }
             }
@@ -2911,7 +2959,7 @@ static uint8_t
     }
 
     if (tsk_verbose)
-        yaffscache_object_dump(stderr, obj);
+        yaffscache_object_dump(stderr, yfs, obj);
 
     file_block_count = data_run->len;
     /* Cycle through the chunks for this version of this object */
@@ -2959,10 +3007,15 @@ static uint8_t
             tsk_fs_attr_add_run(fs, attr, data_run_new);
         }
 
-        curr = curr->ycc_prev;
+        curr = yaffscache_chunk_prev(yfs, curr);
     }
 
     tsk_list_free(chunks_seen);
+
+    if (tsk_fs_attr_run_idx_build(attr)) {
+        meta->attr_state = TSK_FS_META_ATTR_ERROR;
+        return 1;
+    }
     meta->attr_state = TSK_FS_META_ATTR_STUDIED;
     return 0;
 }
@@ -3042,7 +3095,11 @@ TSK_FS_INFO *
     if ((yaffsfs = (YAFFSFS_INFO *) tsk_fs_malloc(sizeof(YAFFSFS_INFO))) == NULL)
         return NULL;
     yaffsfs->cache_objects = NULL;
-    yaffsfs->chunkMap = NULL;
+    yaffsfs->cache_object_count = 0;
+    yaffsfs->cache_versions = NULL;
+    yaffsfs->cache_version_count = 0;
+    yaffsfs->cache_chunks = NULL;
+    yaffsfs->cache_chunk_count = 0;
 
     fs = &(yaffsfs->fs_info);
 
@@ -3213,9 +3270,10 @@ TSK_FS_INFO *
     /* NOTE: The only modifications to the cache happen here, during at 
     *       the open. Should be fine with no lock, even if access to the
     *       cache is shared among threads.
+    *       It cannot be built on first use: it gives last_inum and the
+    *       root directory that is opened below to detect the file system.
     */
     //tsk_init_lock(&yaffsfs->lock);
-    yaffsfs->chunkMap = new std::map<uint32_t, YaffsCacheChunkGroup>;
     if (TSK_OK != yaffsfs_parse_image_load_cache(yaffsfs)) {
         goto on_error;
     }